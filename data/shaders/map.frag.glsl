@@ -5,6 +5,7 @@ layout(binding = 1) uniform sampler2DArray tex_sampler1;
 layout(binding = 2) uniform sampler2D tex1; // rgb = game, front, tele
 layout(binding = 3) uniform sampler2D tex2; // rgb = tune, speedup, switch
 layout(binding = 4) uniform sampler2D tex3; // rgb = game flags, front flags, switch flags
+layout(binding = 5) uniform sampler2D tex4; // r = earliest tick reached (scaled), g = reached
 
 layout(location = 0) in vec3 frag_color;
 layout(location = 1) in vec2 frag_tex_coord;
@@ -15,6 +16,7 @@ layout(binding = 0) uniform UniformBufferObject {
   vec3 transform;
   float aspect;
   float lod_bias;
+  float overlay_alpha;
 }
 ubo;
 
@@ -155,5 +157,15 @@ void main() {
     final_color = vec4(blended_rgb, blended_alpha);
   }
 
+  // reachability overlay, early ticks green and late ticks red
+  if (ubo.overlay_alpha > 0.0) {
+    vec4 overlay = texture(tex4, tex_coord);
+    if (overlay.g > 0.0) {
+      vec3 heat = mix(vec3(0.2, 1.0, 0.3), vec3(1.0, 0.15, 0.1), overlay.r);
+      float alpha = ubo.overlay_alpha;
+      final_color = vec4(heat * alpha + final_color.rgb * (1.0 - alpha), alpha + final_color.a * (1.0 - alpha));
+    }
+  }
+
   out_color = final_color;
 }
@@ -2,8 +2,6 @@
 
 #include <atomic>
 #include <chrono>
-#include <omp.h>
-#include <thread>
 
 #define CIMGUI_INCLUDED
 #include "imgui.h"
@@ -45,102 +43,101 @@ private:
   int m_TicksPerIteration;
   bool m_UseMultiThreading;
 
-  // benchmark state
+  // benchmark state, the run itself lives on the host's thread pool
   std::atomic<bool> m_IsRunning;
   std::atomic<int> m_Progress;
-  std::thread m_BenchmarkThread;
+  std::atomic<bool> m_Cancelled; // stops the iterations too, job_cancel only reaches the outer job
+  job_handle_t m_BenchmarkJob;
+  SWorldCore m_StartWorld;
   double m_LastElapsedTime;
 
 public:
   PhysicsProfilerPlugin(tas_context_t *pContext, const tas_api_t *pAPI)
       : m_pAPI(pAPI), m_pContext(pContext), m_ShowWindow(true), m_Iterations(200), m_TicksPerIteration(500), m_UseMultiThreading(true),
-        m_IsRunning(false), m_Progress(0), m_LastElapsedTime(0.0) {
+        m_IsRunning(false), m_Progress(0), m_Cancelled(false), m_BenchmarkJob(JOB_HANDLE_INVALID), m_StartWorld(wc_empty()), m_LastElapsedTime(0.0) {
 
     m_pAPI->log_info("Physics Profiler", "Plugin initialized.");
   }
 
   ~PhysicsProfilerPlugin() {
-    if (m_BenchmarkThread.joinable()) {
-      m_BenchmarkThread.join();
+    // the outer job waits for the iterations it fans out, so waiting on it joins the whole tree
+    if (m_BenchmarkJob != JOB_HANDLE_INVALID) {
+      m_Cancelled = true;
+      m_pAPI->job_cancel(m_BenchmarkJob);
+      m_pAPI->job_wait(m_BenchmarkJob);
     }
+    wc_free(&m_StartWorld);
     m_pAPI->log_info("Physics Profiler", "Plugin shutting down.");
   }
 
-  void Benchmark() {
-    if (!m_pAPI->get_initial_world()) return;
-    ZoneScopedN("Benchmark Execution"); // Tracy Zone for the whole benchmark
+  void RunIteration(int i) {
+    ZoneScopedN("Single Iteration");
+    unsigned int global_seed = 0; // (unsigned)time(NULL);
+    unsigned int run_seed = global_seed ^ (i * 0x9E3779B9u);
+    SWorldCore World = {};
+    wc_copy_world(&World, &m_StartWorld);
+    for (int t = 0; t < m_TicksPerIteration; ++t) {
+      ZoneScopedN("Physics Tick");
+      unsigned int local_seed = run_seed ^ i;
+      for (int c = 0; c < World.m_NumCharacters; c++) {
+        SPlayerInput Input = {};
+        generate_random_input(&Input, &local_seed);
+        cc_on_input(&World.m_pCharacters[c], &Input);
+      }
+      wc_tick(&World);
+    }
+    wc_free(&World);
+    m_Progress++;
+  }
 
-    m_IsRunning = true;
-    m_Progress = 0;
-    m_LastElapsedTime = 0.0;
-    auto startTime = std::chrono::high_resolution_clock::now();
+  static void IterationsJob(void *pUser, int Begin, int End) {
+    PhysicsProfilerPlugin *pSelf = static_cast<PhysicsProfilerPlugin *>(pUser);
+    for (int i = Begin; i < End && !pSelf->m_Cancelled; ++i) {
+      FrameMarkNamed("Worker Thread Frame");
+      pSelf->RunIteration(i);
+    }
+  }
 
-    SWorldCore StartWorld = wc_empty();
-    wc_copy_world(&StartWorld, m_pAPI->get_initial_world());
+  // runs as a single job on the pool, the parallel variant fans out into one item per iteration
+  static void BenchmarkJob(void *pUser, int, int) {
+    PhysicsProfilerPlugin *pSelf = static_cast<PhysicsProfilerPlugin *>(pUser);
+    ZoneScopedN("Benchmark Execution"); // Tracy Zone for the whole benchmark
+    auto startTime = std::chrono::high_resolution_clock::now();
 
-    unsigned int global_seed = 0; // (unsigned)time(NULL);
-    if (m_UseMultiThreading) {
-#pragma omp parallel for
-      for (int i = 0; i < m_Iterations; ++i) {
-        FrameMarkNamed("Worker Thread Frame");
-        ZoneScopedN("Single Iteration (Parallel)");
-
-        unsigned int run_seed = global_seed ^ (i * 0x9E3779B9u);
-        SWorldCore World = {};
-        wc_copy_world(&World, &StartWorld);
-        for (int t = 0; t < m_TicksPerIteration; ++t) {
-          ZoneScopedN("Physics Tick");
-          unsigned int local_seed = run_seed ^ i;
-          for (int c = 0; c < World.m_NumCharacters; c++) {
-            SPlayerInput Input = {};
-            generate_random_input(&Input, &local_seed);
-            cc_on_input(&World.m_pCharacters[c], &Input);
-          }
-          wc_tick(&World);
-        }
-        wc_free(&World);
-        m_Progress++;
-      }
+    if (pSelf->m_UseMultiThreading) {
+      job_handle_t Job = pSelf->m_pAPI->job_parallel_for(pSelf->m_Iterations, 1, IterationsJob, pSelf);
+      if (Job == JOB_HANDLE_INVALID) IterationsJob(pSelf, 0, pSelf->m_Iterations);
+      else pSelf->m_pAPI->job_wait(Job);
     } else {
-      for (int i = 0; i < m_Iterations; ++i) {
-        FrameMarkNamed("Worker Thread Frame");
-        ZoneScopedN("Single Iteration (Serial)");
-
-        unsigned int run_seed = global_seed ^ (i * 0x9E3779B9u);
-        SWorldCore World = {};
-        wc_copy_world(&World, &StartWorld);
-        for (int t = 0; t < m_TicksPerIteration; ++t) {
-          ZoneScopedN("Physics Tick");
-          unsigned int local_seed = run_seed ^ i;
-          for (int c = 0; c < World.m_NumCharacters; c++) {
-            SPlayerInput Input = {};
-            generate_random_input(&Input, &local_seed);
-            cc_on_input(&World.m_pCharacters[c], &Input);
-          }
-          wc_tick(&World);
-        }
-        wc_free(&World);
-        m_Progress++;
-      }
+      IterationsJob(pSelf, 0, pSelf->m_Iterations);
     }
 
     auto endTime = std::chrono::high_resolution_clock::now();
-    m_LastElapsedTime = std::chrono::duration<double>(endTime - startTime).count();
-
-    wc_free(&StartWorld);
-    m_IsRunning = false;
+    pSelf->m_LastElapsedTime = std::chrono::duration<double>(endTime - startTime).count();
+    pSelf->m_IsRunning = false;
   }
 
-  void StartBenchmarkThread() {
-    if (m_IsRunning) return;
+  void StartBenchmark() {
+    if (m_IsRunning || !m_pAPI->get_initial_world()) return;
+    if (m_BenchmarkJob != JOB_HANDLE_INVALID) m_pAPI->job_wait(m_BenchmarkJob);
 
-    if (m_BenchmarkThread.joinable()) {
-      m_BenchmarkThread.join();
-    }
-    m_BenchmarkThread = std::thread(&PhysicsProfilerPlugin::Benchmark, this);
+    wc_copy_world(&m_StartWorld, m_pAPI->get_initial_world());
+    m_IsRunning = true;
+    m_Cancelled = false;
+    m_Progress = 0;
+    m_LastElapsedTime = 0.0;
+    m_BenchmarkJob = m_pAPI->job_submit(BenchmarkJob, this);
   }
 
   void Update() {
+    if (!m_IsRunning && m_BenchmarkJob != JOB_HANDLE_INVALID) {
+      m_pAPI->job_wait(m_BenchmarkJob);
+      m_BenchmarkJob = JOB_HANDLE_INVALID;
+    }
+  }
+
+  // separate from Update so the window stays up while the host throttles the plugin
+  void Draw() {
     ImGui::SetCurrentContext(m_pContext->imgui_context);
     if (ImGui::BeginMainMenuBar()) {
       if (ImGui::BeginMenu("Physics Profiler")) {
@@ -158,7 +155,8 @@ public:
 
         ImGui::InputInt("Iterations", &m_Iterations);
         ImGui::InputInt("Ticks per Iteration", &m_TicksPerIteration);
-        ImGui::Checkbox("Use Multi-threading (OpenMP)", &m_UseMultiThreading);
+        ImGui::Checkbox("Use Multi-threading", &m_UseMultiThreading);
+        ImGui::Text("Host thread pool: %d workers", m_pAPI->get_worker_count());
 
         ImGui::Separator();
 
@@ -167,7 +165,7 @@ public:
           ImGui::ProgressBar((float)m_Progress / m_Iterations);
         } else {
           if (ImGui::Button("Start Benchmark")) {
-            StartBenchmarkThread();
+            StartBenchmark();
           }
           if (m_LastElapsedTime > 0.0) {
             ImGui::Text("Last run took: %.4f seconds", m_LastElapsedTime);
@@ -203,5 +201,7 @@ FT_API void *plugin_init(tas_context_t *context, const tas_api_t *api) { return
 
 FT_API void plugin_update(void *plugin_data) { static_cast<PhysicsProfilerPlugin *>(plugin_data)->Update(); }
 
+FT_API void plugin_draw(void *plugin_data) { static_cast<PhysicsProfilerPlugin *>(plugin_data)->Draw(); }
+
 FT_API void plugin_shutdown(void *plugin_data) { delete static_cast<PhysicsProfilerPlugin *>(plugin_data); }
 }
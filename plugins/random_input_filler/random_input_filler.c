@@ -40,7 +40,6 @@ static void fill_tracks_with_random_inputs(random_input_state_t *state) {
     return;
   }
 
-  timeline_state_t *ts = state->context->timeline;
   int track_count = state->api->get_track_count();
   if (track_count <= 0) {
     if (state->auto_create_track) {
@@ -59,69 +58,19 @@ static void fill_tracks_with_random_inputs(random_input_state_t *state) {
   }
 
   uint32_t rng_state = state->seed ? state->seed : 0x6d2b79f5u;
-  int created_snippets = 0;
-  int updated_snippets = 0;
   int failed_tracks = 0;
   int total_ticks_written = 0;
 
+  // every track is staged and written back as one undo step with one physics invalidation
   for (int track_index = 0; track_index < track_count; ++track_index) {
-    int snippet_id = -1;
-    int tick_offset = 0;
-    int fill_count = state->snippet_length;
-    undo_command_t *create_cmd =
-        state->api->do_create_snippet(track_index, state->start_tick, state->snippet_length, &snippet_id);
-
-    if (create_cmd) {
-      state->api->register_undo_command(create_cmd);
-      created_snippets++;
-      tick_offset = 0;
-      fill_count = state->snippet_length;
-    } else {
-      player_track_t *track = &ts->player_tracks[track_index];
-      input_snippet_t *target_snippet = NULL;
-      for (int s = 0; s < track->snippet_count; ++s) {
-        input_snippet_t *snip = &track->snippets[s];
-        if (snip->start_tick <= state->start_tick && snip->end_tick > state->start_tick) {
-          target_snippet = snip;
-          break;
-        }
-      }
-      if (!target_snippet) {
-        state->api->log_warning("Random Input Filler",
-                                "Could not create snippet due to overlap and no suitable snippet exists.");
-        failed_tracks++;
-        continue;
-      }
-      snippet_id = target_snippet->id;
-      tick_offset = state->start_tick - target_snippet->start_tick;
-      int available = target_snippet->input_count - tick_offset;
-      if (available <= 0) {
-        state->api->log_warning("Random Input Filler",
-                                "Target snippet does not extend past the requested start tick.");
-        failed_tracks++;
-        continue;
-      }
-      if (fill_count > available) {
-        fill_count = available;
-        state->api->log_warning("Random Input Filler",
-                                "Snippet shorter than requested length; filling available portion only.");
-      }
-      updated_snippets++;
-    }
-
-    if (fill_count <= 0 || snippet_id < 0) {
-      failed_tracks++;
-      continue;
-    }
-
-    SPlayerInput *buffer = (SPlayerInput *)malloc(sizeof(SPlayerInput) * (size_t)fill_count);
+    SPlayerInput *buffer = state->api->stage_inputs(track_index, state->start_tick, state->snippet_length);
     if (!buffer) {
-      state->api->log_error("Random Input Filler", "Failed to allocate input buffer.");
+      state->api->log_error("Random Input Filler", "Failed to stage inputs for a track.");
       failed_tracks++;
       continue;
     }
 
-    for (int tick = 0; tick < fill_count; ++tick) {
+    for (int tick = 0; tick < state->snippet_length; ++tick) {
       SPlayerInput input = (SPlayerInput){0};
 
       uint32_t r = rng_next(&rng_state);
@@ -153,17 +102,12 @@ static void fill_tracks_with_random_inputs(random_input_state_t *state) {
 
       buffer[tick] = input;
     }
+    total_ticks_written += state->snippet_length;
+  }
 
-    undo_command_t *set_cmd = state->api->do_set_inputs(snippet_id, tick_offset, fill_count, buffer);
-    if (set_cmd) {
-      state->api->register_undo_command(set_cmd);
-      total_ticks_written += fill_count;
-    } else {
-      state->api->log_warning("Random Input Filler", "Failed to apply random inputs to a snippet.");
-      failed_tracks++;
-    }
-
-    free(buffer);
+  if (!state->api->commit_inputs("Random Input Fill")) {
+    state->api->log_warning("Random Input Filler", "Some inputs could not be written, no free snippet layer.");
+    failed_tracks++;
   }
 
   if (state->advance_seed)
@@ -171,8 +115,7 @@ static void fill_tracks_with_random_inputs(random_input_state_t *state) {
 
   char summary[128];
   snprintf(summary, sizeof(summary),
-           "Tracks: %d | New snippets: %d | Updated snippets: %d | Failures: %d | Ticks written: %d",
-           track_count, created_snippets, updated_snippets, failed_tracks, total_ticks_written);
+           "Tracks: %d | Failures: %d | Ticks written: %d", track_count, failed_tracks, total_ticks_written);
   set_status(state, summary);
 }
 
@@ -3,6 +3,10 @@
 #include "renderer/renderer.h"
 #include "user_interface/user_interface.h"
 #include <particles/particle_system.h>
+#include <search/search_worker.h>
+#include <string.h>
+#include <system/process.h>
+#include <system/profiler.h>
 #include <time.h>
 
 #define GLFW_INCLUDE_NONE
@@ -13,8 +17,15 @@
 #include <windows.h>
 #endif
 
-int main(void) {
+int main(int argc, char **argv) {
   logger_init();
+  profiler_init();
+  profiler_set_thread_name("Main");
+  process_set_argv0(argv[0]);
+
+  // headless search worker, see search_coordinator.c
+  for (int i = 1; i < argc; ++i)
+    if (strcmp(argv[i], SEARCH_WORKER_FLAG) == 0) return search_worker_main(argc, argv);
 
   static struct gfx_handler_t handler;
   if (init_gfx_handler(&handler) != 0) return 1;
@@ -44,6 +55,7 @@ int main(void) {
       }
     }
     last_time = now;
+    PROFILE_FRAME();
 
     int frame_result = gfx_begin_frame(&handler);
     if (frame_result == FRAME_EXIT) break;
@@ -61,8 +73,8 @@ int main(void) {
 
     handler.user_interface.particle_system.current_time = (double)(handler.user_interface.timeline.current_tick + intra) * 0.02;
     particle_system_update_sim(&handler.user_interface.particle_system, handler.map_data);
-    particle_system_render(&handler.user_interface.particle_system, &handler, 0);
-    particle_system_render(&handler.user_interface.particle_system, &handler, 1);
+    particle_system_cull(&handler.user_interface.particle_system, &handler);
+    particle_system_render(&handler.user_interface.particle_system, &handler);
     render_cursor(&handler.user_interface);
     renderer_flush_queue(&handler, handler.current_frame_command_buffer);
 
@@ -82,5 +94,6 @@ int main(void) {
   }
 
   gfx_cleanup(&handler);
+  profiler_shutdown();
   return 0;
 }
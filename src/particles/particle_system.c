@@ -1,12 +1,15 @@
 #include "particle_system.h"
 #include "renderer/renderer.h"
 #include <ddnet_physics/collision.h>
+#include <ddnet_physics/vmath.h>
 #include <logger/logger.h>
+#include <limits.h>
 #include <math.h>
 #include <renderer/graphics_backend.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <system/profiler.h>
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846f
@@ -33,35 +36,350 @@ static void random_direction(particle_system_t *ps, vec2 out) {
 
 static void mix_colors(vec4 c1, vec4 c2, float t, vec4 out) { glm_vec4_lerp(c1, c2, t, out); }
 
+static void state_free(particle_state_t *s) {
+  free(s->pos_x);
+  free(s->pos_y);
+  free(s->vel_x);
+  free(s->vel_y);
+  free(s->gravity);
+  free(s->drag);
+  free(s->flow_affected);
+  free(s->life_span);
+  free(s->spawn_time);
+  free(s->last_sim_time);
+  free(s->age);
+  free(s->seed);
+  free(s->flags);
+  free(s->expired);
+  free(s->history);
+  free(s->histories);
+  free(s->free_histories);
+  memset(s, 0, sizeof(particle_state_t));
+}
+
+// Pool
+
+// bytes of every per-particle array for one particle
+static size_t particle_bytes(void) {
+  size_t state = 8 * sizeof(float) + 2 * sizeof(double) + sizeof(uint16_t) + sizeof(uint32_t) + sizeof(int32_t) + 2;
+  return sizeof(particle_t) + 1 + state;
+}
+
+// resizes one array, it is left as it was when that fails
+static bool resize_array(void *array, size_t size) {
+  void **data = array;
+  if (size == 0) {
+    free(*data);
+    *data = NULL;
+    return true;
+  }
+  void *resized = realloc(*data, size);
+  if (!resized) return false;
+  *data = resized;
+  return true;
+}
+
+// Resizes every per-particle array. Arrays that did resize keep their new size when another one
+// fails, so the usable capacity is the smaller of the old and the requested one.
+static bool pool_resize(particle_system_t *ps, int capacity) {
+  particle_state_t *s = &ps->state;
+  size_t n = (size_t)capacity;
+  bool ok = resize_array(&ps->particles, n * sizeof(particle_t));
+  ok = resize_array(&ps->visible, n) && ok;
+  ok = resize_array(&s->pos_x, n * sizeof(float)) && ok;
+  ok = resize_array(&s->pos_y, n * sizeof(float)) && ok;
+  ok = resize_array(&s->vel_x, n * sizeof(float)) && ok;
+  ok = resize_array(&s->vel_y, n * sizeof(float)) && ok;
+  ok = resize_array(&s->gravity, n * sizeof(float)) && ok;
+  ok = resize_array(&s->drag, n * sizeof(float)) && ok;
+  ok = resize_array(&s->flow_affected, n * sizeof(float)) && ok;
+  ok = resize_array(&s->life_span, n * sizeof(float)) && ok;
+  ok = resize_array(&s->spawn_time, n * sizeof(double)) && ok;
+  ok = resize_array(&s->last_sim_time, n * sizeof(double)) && ok;
+  ok = resize_array(&s->age, n * sizeof(uint16_t)) && ok;
+  ok = resize_array(&s->seed, n * sizeof(uint32_t)) && ok;
+  ok = resize_array(&s->flags, n) && ok;
+  ok = resize_array(&s->expired, n) && ok;
+  ok = resize_array(&s->history, n * sizeof(int32_t)) && ok;
+  ps->capacity = ok ? capacity : imin(ps->capacity, capacity);
+  return ok;
+}
+
+static int pool_pages(int particles) { return (particles + PARTICLE_POOL_PAGE - 1) / PARTICLE_POOL_PAGE * PARTICLE_POOL_PAGE; }
+
+// grows by half the pool, at least a page, so a burst of spawns does not copy the pool every page
+static bool pool_grow(particle_system_t *ps) {
+  if (ps->capacity >= MAX_PARTICLES) return false;
+  int capacity = imin(pool_pages(ps->capacity + imax(ps->capacity / 2, PARTICLE_POOL_PAGE)), MAX_PARTICLES);
+  if (!pool_resize(ps, capacity)) {
+    log_warn("ParticleSystem", "Failed to grow the particle pool to %d particles", capacity);
+    return false;
+  }
+  return true;
+}
+
+// History
+
+static int history_pages(int histories) { return (histories + PARTICLE_HISTORY_PAGE - 1) / PARTICLE_HISTORY_PAGE * PARTICLE_HISTORY_PAGE; }
+
+// Takes a history slot for a simulated particle, -1 when the store can not grow
+static int history_acquire(particle_state_t *s) {
+  if (s->free_history_count == 0) {
+    int capacity = imin(history_pages(s->history_capacity + imax(s->history_capacity / 2, PARTICLE_HISTORY_PAGE)), MAX_PARTICLES);
+    if (capacity <= s->history_capacity) return -1;
+    if (!resize_array(&s->free_histories, (size_t)capacity * sizeof(int32_t)) ||
+        !resize_array(&s->histories, (size_t)capacity * sizeof(particle_history_t))) {
+      log_warn("ParticleSystem", "Failed to grow the particle history store to %d entries", capacity);
+      return -1;
+    }
+    // pushed in reverse so the lowest new slot is taken first
+    for (int slot = capacity - 1; slot >= s->history_capacity; --slot)
+      s->free_histories[s->free_history_count++] = slot;
+    s->history_capacity = capacity;
+  }
+  int slot = s->free_histories[--s->free_history_count];
+  s->histories[slot].checkpoint_count = 0;
+  s->histories[slot].trail_base = PARTICLE_TRAIL_NONE;
+  return slot;
+}
+
+// hands the history of particle `i` back, before it is dropped or overwritten
+static void history_release(particle_state_t *s, int i) {
+  if (s->history[i] < 0) return;
+  s->free_histories[s->free_history_count++] = s->history[i];
+  s->history[i] = -1;
+}
+
+// Moves the histories in use below a smaller capacity and releases the pages above it
+static void history_trim(particle_system_t *ps) {
+  particle_state_t *s = &ps->state;
+  int capacity = history_pages((s->history_capacity - s->free_history_count) * 2);
+  if (capacity >= s->history_capacity) return;
+
+  // free slots below the new capacity, each one takes a history from above it
+  int free_count = 0;
+  for (int k = 0; k < s->free_history_count; ++k)
+    if (s->free_histories[k] < capacity) s->free_histories[free_count++] = s->free_histories[k];
+  for (int i = 0; i < ps->active_count; ++i) {
+    if (s->history[i] < capacity) continue;
+    int slot = s->free_histories[--free_count];
+    s->histories[slot] = s->histories[s->history[i]];
+    s->history[i] = slot;
+  }
+  s->free_history_count = free_count;
+  // shrinking can not lose data, the arrays may just stay larger when realloc fails
+  resize_array(&s->histories, (size_t)capacity * sizeof(particle_history_t));
+  resize_array(&s->free_histories, (size_t)capacity * sizeof(int32_t));
+  s->history_capacity = capacity;
+}
+
+// releases the pages of a pool that has been mostly empty for a while, keeping room to double
+static void pool_trim(particle_system_t *ps) {
+  if (ps->active_count > ps->capacity / 4) {
+    ps->idle_updates = 0;
+    return;
+  }
+  if (++ps->idle_updates < PARTICLE_POOL_IDLE_UPDATES) return;
+  ps->idle_updates = 0;
+  int capacity = pool_pages(ps->active_count * 2);
+  if (capacity < ps->capacity) pool_resize(ps, capacity);
+  history_trim(ps);
+}
+
+// moves particle `src` into slot `dst`, used to keep the live particles packed
+static void particle_move(particle_system_t *ps, int dst, int src) {
+  particle_state_t *s = &ps->state;
+  ps->particles[dst] = ps->particles[src];
+  s->pos_x[dst] = s->pos_x[src];
+  s->pos_y[dst] = s->pos_y[src];
+  s->vel_x[dst] = s->vel_x[src];
+  s->vel_y[dst] = s->vel_y[src];
+  s->gravity[dst] = s->gravity[src];
+  s->drag[dst] = s->drag[src];
+  s->flow_affected[dst] = s->flow_affected[src];
+  s->life_span[dst] = s->life_span[src];
+  s->spawn_time[dst] = s->spawn_time[src];
+  s->last_sim_time[dst] = s->last_sim_time[src];
+  s->age[dst] = s->age[src];
+  s->seed[dst] = s->seed[src];
+  s->flags[dst] = s->flags[src];
+  s->history[dst] = s->history[src]; // the history itself stays in its slot
+}
+
+// puts particle `i` back into its spawn state
+static void particle_reset(particle_system_t *ps, int i) {
+  const particle_t *p = &ps->particles[i];
+  particle_state_t *s = &ps->state;
+  s->pos_x[i] = p->start_pos[0];
+  s->pos_y[i] = p->start_pos[1];
+  s->vel_x[i] = p->start_vel[0];
+  s->vel_y[i] = p->start_vel[1];
+  s->last_sim_time[i] = p->spawn_time;
+  s->age[i] = 0;
+  s->seed[i] = p->seed;
+}
+
+static double step_time(const particle_state_t *s, int i, int age) { return s->spawn_time[i] + age * PARTICLE_STEP; }
+
+// Position and velocity of a particle that is not PARTICLE_FLAG_SIMULATED after `n` steps. Solves
+// the recurrence particle_simulate_step runs for it, v' = (v + g * dt) * drag and p' = p + v' * dt.
+static void particle_closed_form(const particle_state_t *s, int i, int n, vec2 pos, vec2 vel) {
+  const double dt = PARTICLE_STEP, drag = s->drag[i], g = s->gravity[i] * dt;
+  // sum of drag^k for k = 1..n, and the sum of those partial sums
+  double decay = pow(drag, n), sum, sum_of_sums;
+  if (drag == 1.0) {
+    sum = n;
+    sum_of_sums = n * (n + 1) / 2.0;
+  } else {
+    sum = drag * (1.0 - decay) / (1.0 - drag);
+    sum_of_sums = drag / (1.0 - drag) * (n - sum);
+  }
+  vel[0] = (float)(s->vel_x[i] * decay);
+  vel[1] = (float)(s->vel_y[i] * decay + g * sum);
+  pos[0] = (float)(s->pos_x[i] + dt * s->vel_x[i] * sum);
+  pos[1] = (float)(s->pos_y[i] + dt * (s->vel_y[i] * sum + g * sum_of_sums));
+}
+
+// steps an incremental simulation would have taken by `time`
+static int closed_form_steps(const particle_state_t *s, int i, double time) {
+  return imax((int)floor((time + 0.0001 - s->spawn_time[i]) / PARTICLE_STEP), 0);
+}
+
+// State of particle `i` at its last whole step before `time`, returns when that step was taken.
+// `steps` is only set for particles evaluated in closed form.
+static double particle_last_step(const particle_state_t *s, int i, double time, vec2 pos, vec2 vel, int *steps) {
+  if (s->flags[i] & PARTICLE_FLAG_SIMULATED) {
+    pos[0] = s->pos_x[i];
+    pos[1] = s->pos_y[i];
+    vel[0] = s->vel_x[i];
+    vel[1] = s->vel_y[i];
+    return s->last_sim_time[i];
+  }
+  *steps = closed_form_steps(s, i, time);
+  particle_closed_form(s, i, *steps, pos, vel);
+  return step_time(s, i, *steps);
+}
+
+static void checkpoint_save(const particle_state_t *s, int i, particle_checkpoint_t *c) {
+  c->pos[0] = s->pos_x[i];
+  c->pos[1] = s->pos_y[i];
+  c->vel[0] = s->vel_x[i];
+  c->vel[1] = s->vel_y[i];
+  c->seed = s->seed[i];
+}
+
+// Called with the state of particle `i` after `age` steps, keeps it when that step is the next
+// checkpoint or falls into the trail.
+static void checkpoint_record(particle_state_t *s, int i, int age) {
+  particle_history_t *h = &s->histories[s->history[i]];
+  unsigned offset = (unsigned)(age - h->trail_base);
+  if (offset < PARTICLE_CHECKPOINT_INTERVAL) checkpoint_save(s, i, &h->trail[offset]);
+  if (age % PARTICLE_CHECKPOINT_INTERVAL != 0) return;
+  int slot = age / PARTICLE_CHECKPOINT_INTERVAL - 1;
+  if (slot != h->checkpoint_count || slot >= PARTICLE_CHECKPOINTS) return;
+  checkpoint_save(s, i, &h->checkpoints[slot]);
+  ++h->checkpoint_count;
+}
+
+// Restarts particle `i` from its newest saved step that is not past `sim_target`, or from its
+// spawn state when there is none. The steps re-simulated from a checkpoint go into the trail.
+static void particle_rewind(particle_system_t *ps, int i, double sim_target) {
+  particle_state_t *s = &ps->state;
+  particle_history_t *h = &s->histories[s->history[i]];
+  int age = 0;
+  const particle_checkpoint_t *from = NULL;
+  for (int slot = h->checkpoint_count - 1; slot >= 0 && !from; --slot) {
+    int slot_age = (slot + 1) * PARTICLE_CHECKPOINT_INTERVAL;
+    if (step_time(s, i, slot_age) > sim_target + 0.0001) continue;
+    age = slot_age;
+    from = &h->checkpoints[slot];
+  }
+  bool from_trail = false;
+  const int base = h->trail_base;
+  for (int k = PARTICLE_CHECKPOINT_INTERVAL - 1; base != PARTICLE_TRAIL_NONE && k >= 0 && !from_trail; --k) {
+    if (base + k <= age || step_time(s, i, base + k) > sim_target + 0.0001) continue;
+    age = base + k;
+    from = &h->trail[k];
+    from_trail = true;
+  }
+
+  if (!from) {
+    particle_reset(ps, i);
+  } else {
+    s->pos_x[i] = from->pos[0];
+    s->pos_y[i] = from->pos[1];
+    s->vel_x[i] = from->vel[0];
+    s->vel_y[i] = from->vel[1];
+    s->seed[i] = from->seed;
+    s->age[i] = (uint16_t)age;
+    s->last_sim_time[i] = step_time(s, i, age);
+  }
+  if (from_trail) return;
+  int target_age = imax((int)((sim_target + 0.0001 - s->spawn_time[i]) / PARTICLE_STEP), age);
+  h->trail_base = (uint16_t)(target_age - target_age % PARTICLE_CHECKPOINT_INTERVAL);
+  checkpoint_record(s, i, age);
+}
+
 void particle_system_init(particle_system_t *ps) {
   memset(ps, 0, sizeof(particle_system_t));
-  ps->particles = calloc(MAX_PARTICLES, sizeof(particle_t));
-  if (!ps->particles) {
-    log_error("ParticleSystem", "Failed to allocate particles");
-  }
   ps->active_count = 0;
   ps->next_flow_index = 0;
+  ps->first_simulated_tick = 0;
   ps->last_simulated_tick = -1;
+  ps->expired_time = 0.0;
+  for (int i = 0; i < FLOW_DECAY_TICKS * FLOW_DECAY_RESOLUTION + 2; ++i)
+    ps->flow_decay[i] = powf(0.85f, (float)i / FLOW_DECAY_RESOLUTION);
 }
 
 void particle_system_cleanup(particle_system_t *ps) {
-  if (ps->particles) {
-    free(ps->particles);
-    ps->particles = NULL;
+  free(ps->particles);
+  ps->particles = NULL;
+  free(ps->visible);
+  ps->visible = NULL;
+  ps->visible_count = 0;
+  ps->active_count = 0;
+  ps->capacity = 0;
+  for (int layer = 0; layer < PARTICLE_LAYERS; ++layer) {
+    for (int atlas = 0; atlas < PARTICLE_ATLASES; ++atlas) {
+      free(ps->batches[layer][atlas].instances);
+      memset(&ps->batches[layer][atlas], 0, sizeof(particle_batch_t));
+    }
   }
+  state_free(&ps->state);
 }
 
-void particle_system_prune_by_time(particle_system_t *ps, double min_time) {
-  int target_tick = (int)(min_time * 50.0 + 0.1);
+void particle_system_get_stats(const particle_system_t *ps, particle_pool_stats_t *out) {
+  out->active_count = ps->active_count;
+  out->capacity = ps->capacity;
+  out->high_water = ps->high_water;
+  out->bytes = (size_t)ps->capacity * particle_bytes() +
+               (size_t)ps->state.history_capacity * (sizeof(particle_history_t) + sizeof(int32_t));
+}
 
+void particle_system_clear(particle_system_t *ps, int first_tick) {
+  for (int i = 0; i < ps->active_count; ++i)
+    history_release(&ps->state, i);
+  ps->active_count = 0;
+  ps->visible_count = 0;
+  memset(ps->flow_events, 0, sizeof(ps->flow_events));
+  ps->next_flow_index = 0;
+  ps->flow_dirty = true;
+  ps->first_simulated_tick = first_tick;
+  ps->last_simulated_tick = first_tick - 1;
+  ps->expired_time = 0.0;
+}
+
+void particle_system_truncate(particle_system_t *ps, int tick) {
   // Compact particles
   int valid_count = 0;
   for (int i = 0; i < ps->active_count; ++i) {
-    if (ps->particles[i].life_span > 0.0001f && ps->particles[i].creation_tick <= target_tick) {
+    if (ps->particles[i].life_span > 0.0001f && ps->particles[i].creation_tick < tick) {
       if (i != valid_count) {
-        ps->particles[valid_count] = ps->particles[i];
+        particle_move(ps, valid_count, i);
       }
       valid_count++;
+    } else {
+      history_release(&ps->state, i);
     }
   }
   ps->active_count = valid_count;
@@ -69,7 +387,7 @@ void particle_system_prune_by_time(particle_system_t *ps, double min_time) {
   // Compact flow events
   int valid_flow = 0;
   for (int i = 0; i < MAX_FLOW_EVENTS; ++i) {
-    if (ps->flow_events[i].active && ps->flow_events[i].creation_tick <= target_tick) {
+    if (ps->flow_events[i].active && ps->flow_events[i].creation_tick < tick) {
       if (i != valid_flow) {
         ps->flow_events[valid_flow] = ps->flow_events[i];
       }
@@ -80,19 +398,23 @@ void particle_system_prune_by_time(particle_system_t *ps, double min_time) {
     memset(&ps->flow_events[valid_flow], 0, (MAX_FLOW_EVENTS - valid_flow) * sizeof(flow_event_t));
   }
   ps->next_flow_index = valid_flow % MAX_FLOW_EVENTS;
+  ps->flow_dirty = true;
 
-  if (target_tick < ps->last_simulated_tick) {
-    ps->last_simulated_tick = target_tick;
-  }
+  ps->first_simulated_tick = imin(ps->first_simulated_tick, tick);
+  ps->last_simulated_tick = imin(ps->last_simulated_tick, tick - 1);
 }
 
 void particle_spawn(particle_system_t *ps, int group, particle_t *p_template, float time_passed) {
   int current_tick = (int)(ps->current_time * 50.0 + 0.1);
   if (current_tick <= ps->last_simulated_tick) return;
 
-  if (ps->active_count >= MAX_PARTICLES) return;
+  if (ps->active_count >= ps->capacity && !pool_grow(ps)) return;
+  bool simulated = p_template->collides || p_template->flow_affected > 0.0f;
+  int history = simulated ? history_acquire(&ps->state) : -1;
+  if (simulated && history < 0) return;
 
   int id = ps->active_count++;
+  ps->high_water = imax(ps->high_water, ps->active_count);
   particle_t *p = &ps->particles[id];
   *p = *p_template;
 
@@ -100,16 +422,21 @@ void particle_spawn(particle_system_t *ps, int group, particle_t *p_template, fl
   p->group = group;
   // Initialize deterministic seed for this particle
   p->seed = ps->rng_seed;
-  p->current_seed = p->seed;
   p->creation_tick = current_tick;
   ps_frand01(ps); // Advance the generator
+  p->layer = group == GROUP_PROJECTILE_TRAIL || group == GROUP_TRAIL_EXTRA ? 0 : 1;
+  p->atlas = p->sprite_index < PARTICLE_SPRITE_OFFSET ? 0 : (p->sprite_index < EXTRA_SPRITE_OFFSET ? 1 : 2);
+  p->atlas_sprite = (uint32_t)(p->sprite_index - (p->atlas == 0 ? 0 : (p->atlas == 1 ? PARTICLE_SPRITE_OFFSET : EXTRA_SPRITE_OFFSET)));
 
-  glm_vec2_copy(p_template->start_pos, p->start_pos);
-  glm_vec2_copy(p_template->start_vel, p->start_vel);
-
-  glm_vec2_copy(p->start_pos, p->current_pos);
-  glm_vec2_copy(p->start_vel, p->current_vel);
-  p->last_sim_time = p->spawn_time;
+  particle_state_t *s = &ps->state;
+  s->gravity[id] = p->gravity;
+  s->drag[id] = p->friction > 0.0f ? powf(p->friction, (float)PARTICLE_STEP / 0.05f) : 1.0f;
+  s->flow_affected[id] = p->flow_affected;
+  s->life_span[id] = p->life_span;
+  s->spawn_time[id] = p->spawn_time;
+  s->flags[id] = (p->collides ? PARTICLE_FLAG_COLLIDES : 0) | (p->flow_affected > 0.0f ? PARTICLE_FLAG_FLOW : 0);
+  s->history[id] = history;
+  particle_reset(ps, id);
 }
 
 static void flow_add(particle_system_t *ps, vec2 pos, float strength) {
@@ -120,31 +447,76 @@ static void flow_add(particle_system_t *ps, vec2 pos, float strength) {
   ps->flow_events[id].strength = strength;
   ps->flow_events[id].creation_tick = (int)(ps->current_time * 50.0 + 0.1);
   glm_vec2_copy(pos, ps->flow_events[id].pos);
+  ps->flow_dirty = true;
+}
+
+static int64_t flow_bin_key(int bx, int by) { return (int64_t)by * 4294967296LL + bx; }
+
+static int compare_flow_bins(const void *a, const void *b) {
+  const flow_bin_t *x = a, *y = b;
+  if (x->key != y->key) return x->key < y->key ? -1 : 1;
+  return x->event - y->event;
+}
+
+// Files the active events under their bins. Must run on the calling thread before simulating or
+// drawing, flow_get only reads the bins.
+static void flow_rebuild(particle_system_t *ps) {
+  if (!ps->flow_dirty) return;
+  ps->flow_bin_count = 0;
+  for (int i = 0; i < MAX_FLOW_EVENTS; ++i) {
+    const flow_event_t *e = &ps->flow_events[i];
+    if (!e->active) continue;
+    flow_bin_t *bin = &ps->flow_bins[ps->flow_bin_count++];
+    bin->key = flow_bin_key((int)floorf(e->pos[0] / FLOW_RADIUS), (int)floorf(e->pos[1] / FLOW_RADIUS));
+    bin->event = i;
+  }
+  qsort(ps->flow_bins, ps->flow_bin_count, sizeof(flow_bin_t), compare_flow_bins);
+  ps->flow_dirty = false;
+}
+
+// first bin with a key of at least `key`
+static int flow_lower_bound(const particle_system_t *ps, int64_t key) {
+  int lo = 0, hi = ps->flow_bin_count;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (ps->flow_bins[mid].key < key) lo = mid + 1;
+    else hi = mid;
+  }
+  return lo;
 }
 
-static void flow_get(particle_system_t *ps, double sim_time, vec2 pos, vec2 out_vel) {
+static void flow_get(const particle_system_t *ps, double sim_time, vec2 pos, vec2 out_vel) {
   out_vel[0] = 0;
   out_vel[1] = 0;
-  for (int i = 0; i < MAX_FLOW_EVENTS; ++i) {
-    if (!ps->flow_events[i].active) continue;
-    double age = sim_time - ps->flow_events[i].time;
-    if (age < 0 || age > 1.5) continue; // Decays fully after 1.5s
+  if (ps->flow_bin_count == 0) return;
 
-    // Match reference: 0.85 decay per tick (50Hz)
-    float decay = powf(0.85f, (float)(age * 50.0));
-    if (decay < 0.01f) continue;
+  int bx = (int)floorf(pos[0] / FLOW_RADIUS), by = (int)floorf(pos[1] / FLOW_RADIUS);
+  for (int row = by - 1; row <= by + 1; ++row) {
+    int64_t last = flow_bin_key(bx + 1, row);
+    for (int b = flow_lower_bound(ps, flow_bin_key(bx - 1, row)); b < ps->flow_bin_count && ps->flow_bins[b].key <= last; ++b) {
+      const flow_event_t *e = &ps->flow_events[ps->flow_bins[b].event];
+      double age = sim_time - e->time;
+      if (age < 0) continue;
 
-    float dist = glm_vec2_distance(pos, ps->flow_events[i].pos);
-    if (dist > 128.0f || dist < 0.1f) continue;
+      // Match reference: 0.85 decay per tick (50Hz), read from the table instead of powf
+      float ticks = (float)(age * 50.0) * FLOW_DECAY_RESOLUTION;
+      if (ticks >= FLOW_DECAY_TICKS * FLOW_DECAY_RESOLUTION) continue;
+      int sample = (int)ticks;
+      float decay = ps->flow_decay[sample] + (ps->flow_decay[sample + 1] - ps->flow_decay[sample]) * (ticks - (float)sample);
+      if (decay < 0.01f) continue;
 
-    float dist_factor = 1.0f - (dist / 128.0f);
-    vec2 dir;
-    glm_vec2_sub(pos, ps->flow_events[i].pos, dir);
-    glm_vec2_normalize(dir);
+      float dist = glm_vec2_distance(pos, (float *)e->pos);
+      if (dist > FLOW_RADIUS || dist < 0.1f) continue;
 
-    float force = ps->flow_events[i].strength * decay * dist_factor;
-    out_vel[0] += dir[0] * force;
-    out_vel[1] += dir[1] * force;
+      float dist_factor = 1.0f - (dist / FLOW_RADIUS);
+      vec2 dir;
+      glm_vec2_sub(pos, (float *)e->pos, dir);
+      glm_vec2_normalize(dir);
+
+      float force = e->strength * decay * dist_factor;
+      out_vel[0] += dir[0] * force;
+      out_vel[1] += dir[1] * force;
+    }
   }
 }
 
@@ -184,138 +556,272 @@ static void move_point(map_data_t *map, vec2 *inout_pos, vec2 *inout_vel, float
   glm_vec2_add(pos, vel, *inout_pos);
 }
 
-static void particle_simulate_step(particle_system_t *ps, particle_t *p, vec2 pos, vec2 vel, uint32_t *seed, double sim_time, float dt, map_data_t *map) {
-  vel[1] += p->gravity * dt;
+// Steps a PARTICLE_FLAG_SIMULATED particle, also used for render interpolation
+static void particle_simulate_step(particle_system_t *ps, int i, vec2 pos, vec2 vel, uint32_t *seed, double sim_time, map_data_t *map) {
+  const particle_state_t *s = &ps->state;
+  const float dt = (float)PARTICLE_STEP;
+  vel[1] += s->gravity[i] * dt;
 
-  if (p->flow_affected > 0.0f) {
+  if (s->flags[i] & PARTICLE_FLAG_FLOW) {
     vec2 flow_vel;
     flow_get(ps, sim_time, pos, flow_vel);
-    vel[0] += flow_vel[0] * p->flow_affected * dt;
-    vel[1] += flow_vel[1] * p->flow_affected * dt;
+    vel[0] += flow_vel[0] * s->flow_affected[i] * dt;
+    vel[1] += flow_vel[1] * s->flow_affected[i] * dt;
   }
 
-  if (p->friction > 0.0f) {
-    glm_vec2_scale(vel, powf(p->friction, dt / 0.05f), vel);
-  }
+  vel[0] *= s->drag[i];
+  vel[1] *= s->drag[i];
 
-  vec2 move;
-  glm_vec2_scale(vel, dt, move);
-  if (p->collides && map) {
+  vec2 move = {vel[0] * dt, vel[1] * dt};
+  if ((s->flags[i] & PARTICLE_FLAG_COLLIDES) && map) {
     float elasticity = 0.1f + 0.9f * deterministic_frand(seed);
     move_point(map, (vec2 *)pos, &move, elasticity);
-    if (dt > 0.0001f) {
-      glm_vec2_scale(move, 1.0f / dt, vel);
-    }
+    glm_vec2_scale(move, 1.0f / dt, vel);
   } else {
-    glm_vec2_add(pos, move, pos);
+    pos[0] += move[0];
+    pos[1] += move[1];
   }
 }
 
-void particle_system_update_sim(particle_system_t *ps, map_data_t *map) {
-  const double step = 0.02;
-  double sim_target = ps->current_time;
+typedef struct {
+  particle_system_t *ps;
+  map_data_t *map;
+  double sim_target;
+} simulate_job_t;
 
-  for (int i = 0; i < ps->active_count; ++i) {
-    particle_t *p = &ps->particles[i];
+// Simulate phase, touches only particles in [begin, end) so chunks run in parallel. Expired
+// particles are marked and removed by compact_particles afterwards.
+static void simulate_range(particle_system_t *ps, map_data_t *map, double sim_target, int begin, int end) {
+  particle_state_t *s = &ps->state;
+  const double step = PARTICLE_STEP;
 
+  for (int i = begin; i < end; ++i) {
     // Check life
-    double age = sim_target - p->spawn_time;
-    if (age > p->life_span || age < -0.001) {
-      if (i != ps->active_count - 1) {
-        ps->particles[i] = ps->particles[ps->active_count - 1];
-      }
-      ps->active_count--;
-      i--;
-      continue;
-    }
+    double age = sim_target - s->spawn_time[i];
+    // dead particles are kept for a step, drawing a frame of the same tick again does not miss them
+    bool dead = age > s->life_span[i], future = age < -0.001;
+    s->expired[i] = (dead && age > s->life_span[i] + PARTICLE_STEP) || future;
+    if (dead || future || !(s->flags[i] & PARTICLE_FLAG_SIMULATED)) continue;
 
     // Incremental Simulation / Rewind Handling
     // If the particle's last simulation time is in the future compared to target,
-    // we must reset it to its spawn state to re-simulate it forward.
-    if (p->last_sim_time > sim_target + 0.001) {
-      glm_vec2_copy(p->start_pos, p->current_pos);
-      glm_vec2_copy(p->start_vel, p->current_vel);
-      p->last_sim_time = p->spawn_time;
-      p->current_seed = p->seed;
-    }
+    // we restart it from an earlier checkpoint and re-simulate it forward.
+    if (s->last_sim_time[i] > sim_target + 0.001) particle_rewind(ps, i, sim_target);
 
-    while (p->last_sim_time < sim_target) {
-      double next_step_time = p->last_sim_time + step;
+    while (s->last_sim_time[i] < sim_target) {
       // Ensure we don't overshoot the current global system time
-      if (next_step_time > sim_target + 0.0001) break;
+      if (s->last_sim_time[i] + step > sim_target + 0.0001) break;
+
+      vec2 pos = {s->pos_x[i], s->pos_y[i]}, vel = {s->vel_x[i], s->vel_y[i]};
+      particle_simulate_step(ps, i, pos, vel, &s->seed[i], s->last_sim_time[i], map);
+      s->pos_x[i] = pos[0];
+      s->pos_y[i] = pos[1];
+      s->vel_x[i] = vel[0];
+      s->vel_y[i] = vel[1];
+      ++s->age[i];
+      s->last_sim_time[i] = step_time(s, i, s->age[i]);
+      checkpoint_record(s, i, s->age[i]);
+    }
+  }
+}
+
+static void simulate_job(void *user_data, int begin, int end) {
+  simulate_job_t *job = user_data;
+  simulate_range(job->ps, job->map, job->sim_target, begin, end);
+}
 
-      particle_simulate_step(ps, p, p->current_pos, p->current_vel, &p->current_seed, p->last_sim_time, (float)step, map);
-      p->last_sim_time += step;
+// particles that died are gone for good, particles dropped for lying in the future are not
+static void note_expired(particle_system_t *ps, int i) {
+  double death = ps->state.spawn_time[i] + ps->state.life_span[i];
+  if (death < ps->current_time && death > ps->expired_time) ps->expired_time = death;
+  history_release(&ps->state, i);
+}
+
+// Compaction phase, fills the holes left by expired particles with live ones from the end. The
+// result only depends on which particles expired, not on how the simulation was chunked.
+static void compact_particles(particle_system_t *ps) {
+  const uint8_t *expired = ps->state.expired;
+  int count = ps->active_count;
+  for (int i = 0; i < count; ++i) {
+    if (!expired[i]) continue;
+    note_expired(ps, i);
+    while (count > i + 1 && expired[count - 1])
+      note_expired(ps, --count);
+    if (count == i + 1) {
+      count = i;
+      break;
     }
+    particle_move(ps, i, --count);
   }
+  ps->active_count = count;
+}
+
+void particle_system_update_sim(particle_system_t *ps, map_data_t *map) {
+  PROFILE_BEGIN("particle_system_update_sim");
+  flow_rebuild(ps);
+  simulate_job_t job = {ps, map, ps->current_time};
+  job_handle_t handle = JOB_HANDLE_INVALID;
+  if (ps->pool && ps->active_count > PARTICLE_SIM_GRAIN)
+    handle = thread_pool_parallel_for(ps->pool, ps->active_count, PARTICLE_SIM_GRAIN, simulate_job, &job);
+  if (handle == JOB_HANDLE_INVALID) simulate_range(ps, map, job.sim_target, 0, ps->active_count);
+  else thread_pool_wait(ps->pool, handle);
+
+  compact_particles(ps);
+  pool_trim(ps);
+  PROFILE_END();
 }
+
 void particle_system_update(particle_system_t *ps, float dt, map_data_t *map) {
   (void)ps;
   (void)dt;
   (void)map;
 }
 
-void particle_system_render(particle_system_t *ps, gfx_handler_t *gfx, int layer) {
-  int groups_back[] = {GROUP_PROJECTILE_TRAIL, GROUP_TRAIL_EXTRA};
-  int groups_front[] = {GROUP_EXPLOSIONS, GROUP_EXTRA, GROUP_GENERAL};
-  int *groups = layer == 0 ? groups_back : groups_front;
-  int count = layer == 0 ? 2 : 3;
-  int current_atlas_type = -1;
-  atlas_renderer_t *current_ar = NULL;
+// Culling
+
+// the budget is handed out in this order, effects that read as gameplay first
+static const int group_priority[NUM_PARTICLE_GROUPS] = {GROUP_EXPLOSIONS, GROUP_PROJECTILE_TRAIL, GROUP_GENERAL, GROUP_TRAIL_EXTRA, GROUP_EXTRA};
 
-  const double step = 0.02;
+void particle_system_cull(particle_system_t *ps, gfx_handler_t *gfx) {
+  ps->visible_count = 0;
+  if (!ps->visible) return;
+  PROFILE_BEGIN("particle_system_cull");
+  const particle_state_t *s = &ps->state;
 
+  // visible world rect in pixels, nothing is culled without a map
+  bool cull = gfx->map_data && gfx->viewport[0] > 0 && gfx->viewport[1] > 0;
+  float min_x = 0, min_y = 0, max_x = 0, max_y = 0;
+  if (cull) {
+    float x0, y0, x1, y1;
+    screen_to_world(gfx, 0, 0, &x0, &y0);
+    screen_to_world(gfx, gfx->viewport[0], gfx->viewport[1], &x1, &y1);
+    min_x = fminf(x0, x1) * 32.0f;
+    max_x = fmaxf(x0, x1) * 32.0f;
+    min_y = fminf(y0, y1) * 32.0f;
+    max_y = fmaxf(y0, y1) * 32.0f;
+  }
+
+  int in_view[NUM_PARTICLE_GROUPS] = {0};
   for (int i = 0; i < ps->active_count; ++i) {
-    particle_t *p = &ps->particles[i];
-
-    // Group filter
-    bool group_match = false;
-    for (int g = 0; g < count; ++g) {
-      if (p->group == groups[g]) {
-        group_match = true;
-        break;
-      }
+    const particle_t *p = &ps->particles[i];
+    double age = ps->current_time - p->spawn_time;
+    bool visible = age >= 0 && age <= p->life_span;
+    if (visible && cull) {
+      vec2 pos, vel;
+      int steps;
+      particle_last_step(s, i, ps->current_time, pos, vel, &steps);
+      // covers the rotated sprite and the interpolated movement toward the next step
+      float margin = fmaxf(p->start_size, p->end_size) + (fabsf(vel[0]) + fabsf(vel[1])) * (float)PARTICLE_STEP;
+      visible = pos[0] + margin >= min_x && pos[0] - margin <= max_x && pos[1] + margin >= min_y && pos[1] - margin <= max_y;
     }
-    if (!group_match) continue;
+    ps->visible[i] = visible;
+    if (visible) ++in_view[p->group];
+  }
+  ps->visible_count = ps->active_count;
+
+  int remaining = ps->budget > 0 ? ps->budget : INT_MAX;
+  int allowed[NUM_PARTICLE_GROUPS];
+  bool over_budget = false;
+  for (int g = 0; g < NUM_PARTICLE_GROUPS; ++g) {
+    int group = group_priority[g];
+    allowed[group] = imin(in_view[group], remaining);
+    remaining -= allowed[group];
+    over_budget |= allowed[group] < in_view[group];
+  }
+
+  // a group that does not fit keeps a subset picked by seed, so the same particles stay on screen
+  // from frame to frame instead of flickering
+  if (over_budget) {
+    int kept[NUM_PARTICLE_GROUPS] = {0};
+    for (int i = 0; i < ps->active_count; ++i) {
+      const particle_t *p = &ps->particles[i];
+      if (!ps->visible[i] || allowed[p->group] == in_view[p->group]) continue;
+      uint32_t hash = p->seed;
+      bool keep = kept[p->group] < allowed[p->group] && deterministic_frand(&hash) * in_view[p->group] < allowed[p->group];
+      ps->visible[i] = keep;
+      kept[p->group] += keep;
+    }
+  }
+  PROFILE_END();
+}
+
+// Rendering
+
+static atlas_instance_t *batch_push(particle_batch_t *batch) {
+  if (batch->count == batch->capacity) {
+    int capacity = batch->capacity ? batch->capacity * 2 : 1024;
+    atlas_instance_t *grown = realloc(batch->instances, capacity * sizeof(atlas_instance_t));
+    if (!grown) return NULL;
+    batch->instances = grown;
+    batch->capacity = capacity;
+  }
+  return &batch->instances[batch->count++];
+}
+
+void particle_system_render(particle_system_t *ps, gfx_handler_t *gfx) {
+  atlas_renderer_t *atlases[PARTICLE_ATLASES] = {&gfx->renderer.gameskin_renderer, &gfx->renderer.particle_renderer,
+                                                 &gfx->renderer.extras_renderer};
+  const float layer_z[PARTICLE_LAYERS] = {Z_LAYER_PARTICLES_BACK, Z_LAYER_PARTICLES_FRONT};
+  for (int layer = 0; layer < PARTICLE_LAYERS; ++layer)
+    for (int atlas = 0; atlas < PARTICLE_ATLASES; ++atlas)
+      ps->batches[layer][atlas].count = 0;
+
+  const particle_state_t *s = &ps->state;
+  const double step = PARTICLE_STEP;
+  flow_rebuild(ps);
+
+  for (int i = 0; i < ps->active_count; ++i) {
+    if (i < ps->visible_count && !ps->visible[i]) continue;
+    const particle_t *p = &ps->particles[i];
 
     double age = ps->current_time - p->spawn_time;
-    if (age < 0) continue; // Future
+    if (age < 0 || age > p->life_span) continue; // Future or dead
 
-    // Simulation is done in update_sim. We just interpolate.
+    atlas_renderer_t *ar = atlases[p->atlas];
+    if (p->atlas_sprite >= ar->sprite_count) continue;
 
+    // Simulation is done in update_sim, or here in closed form. We just interpolate.
+    vec2 current_pos, current_vel;
+    int steps = 0;
+    double last_sim_time = particle_last_step(s, i, ps->current_time, current_pos, current_vel, &steps);
     vec2 pos;
-    glm_vec2_copy(p->current_pos, pos);
+    glm_vec2_copy(current_pos, pos);
 
     // Interpolation for smooth movement
     // Predict next step without modifying state
-    float t = (float)((ps->current_time - p->last_sim_time) / step);
+    float t = (float)((ps->current_time - last_sim_time) / step);
     if (t > 0.001f && t <= 1.0f) {
-      vec2 next_pos, next_vel;
-      glm_vec2_copy(p->current_pos, next_pos);
-      glm_vec2_copy(p->current_vel, next_vel);
-      uint32_t temp_seed = p->current_seed;
+      vec2 next_pos = {s->pos_x[i], s->pos_y[i]};
+      vec2 next_vel = {s->vel_x[i], s->vel_y[i]};
+      uint32_t temp_seed = s->seed[i];
 
-      particle_simulate_step(ps, p, next_pos, next_vel, &temp_seed, p->last_sim_time, (float)step, gfx->map_data);
-      glm_vec2_lerp(p->current_pos, next_pos, t, pos);
+      if (s->flags[i] & PARTICLE_FLAG_SIMULATED) particle_simulate_step(ps, i, next_pos, next_vel, &temp_seed, last_sim_time, gfx->map_data);
+      else particle_closed_form(s, i, steps + 1, next_pos, next_vel);
+      glm_vec2_lerp(current_pos, next_pos, t, pos);
     }
 
-    float rot = p->rot + p->rot_speed * (float)age;
-
-    int atlas_type = (p->sprite_index < PARTICLE_SPRITE_OFFSET) ? 1 : (p->sprite_index < EXTRA_SPRITE_OFFSET ? 2 : 3);
-    atlas_renderer_t *target_ar =
-        (atlas_type == 1) ? &gfx->renderer.gameskin_renderer : (atlas_type == 2 ? &gfx->renderer.particle_renderer : &gfx->renderer.extras_renderer);
-    int render_sprite_idx = p->sprite_index - (atlas_type == 1 ? 0 : (atlas_type == 2 ? PARTICLE_SPRITE_OFFSET : EXTRA_SPRITE_OFFSET));
+    atlas_instance_t *inst = batch_push(&ps->batches[p->layer][p->atlas]);
+    if (!inst) continue;
+    float life_frac = (float)age / p->life_span;
+    float size = (p->start_size * (1.0f - life_frac) + p->end_size * life_frac) / 32.f;
+    inst->pos[0] = pos[0] / 32.f;
+    inst->pos[1] = pos[1] / 32.f;
+    inst->size[0] = size;
+    inst->size[1] = size;
+    inst->rotation = p->rot + p->rot_speed * (float)age;
+    inst->sprite_index = (int)p->atlas_sprite;
+    inst->tiling[0] = 1.0f;
+    inst->tiling[1] = 1.0f;
+    glm_vec4_copy((float *)p->color, inst->color);
+    if (p->use_alpha_fading) inst->color[3] = p->start_alpha * (1.0f - life_frac) + p->end_alpha * life_frac;
+    renderer_calculate_atlas_uvs(ar, p->atlas_sprite, inst);
+  }
 
-    if (atlas_type != current_atlas_type) {
-      current_atlas_type = atlas_type;
-      current_ar = target_ar;
+  for (int layer = 0; layer < PARTICLE_LAYERS; ++layer) {
+    for (int atlas = 0; atlas < PARTICLE_ATLASES; ++atlas) {
+      const particle_batch_t *batch = &ps->batches[layer][atlas];
+      renderer_submit_atlas_batch(gfx, atlases[atlas], layer_z[layer], batch->instances, (uint32_t)batch->count, false);
     }
-    float life_frac = (float)age / p->life_span;
-    float size = p->start_size * (1.0f - life_frac) + p->end_size * life_frac;
-    vec4 col;
-    glm_vec4_copy(p->color, col);
-    if (p->use_alpha_fading) col[3] = p->start_alpha * (1.0f - life_frac) + p->end_alpha * life_frac;
-    renderer_submit_atlas(gfx, current_ar, layer ? Z_LAYER_PARTICLES_FRONT : Z_LAYER_PARTICLES_BACK, (vec2){pos[0] / 32.f, pos[1] / 32.f}, (vec2){size / 32.f, size / 32.f}, rot, render_sprite_idx, false, col, false);
   }
 }
 
@@ -5,9 +5,25 @@
 #include <ddnet_map_loader.h>
 #include <renderer/renderer.h>
 #include <stdbool.h>
+#include <system/thread_pool.h>
 
 #define MAX_PARTICLES (1024 * 1024)
+#define PARTICLE_POOL_PAGE 16384        // particles per pool page, MAX_PARTICLES is a whole number of pages
+#define PARTICLE_POOL_IDLE_UPDATES 120 // updates spent below a quarter of the pool before pages are released
+#define PARTICLE_HISTORY_PAGE 1024      // rewind histories per page, only simulated particles take one
 #define MAX_FLOW_EVENTS 64
+#define FLOW_RADIUS 128.0f        // also the size of a flow bin, so a particle only checks 3x3 bins
+#define FLOW_DECAY_TICKS 29       // 0.85^29 is below the cutoff, older events are skipped
+#define FLOW_DECAY_RESOLUTION 16  // decay table samples per tick
+#define PARTICLE_STEP 0.02 // seconds per simulation step
+#define PARTICLE_SIM_GRAIN 8192 // particles per simulation task
+#define PARTICLE_CHECKPOINT_INTERVAL 8 // steps between rewind checkpoints
+#define PARTICLE_CHECKPOINTS 9         // per particle, enough for the longest lived effects
+#define PARTICLE_MAX_LIFE_TICKS 75     // longest life_span of any effect, the freezing flakes
+#define PARTICLE_TRAIL_NONE UINT16_MAX
+#define PARTICLE_DEFAULT_BUDGET 20000 // drawn per frame
+#define PARTICLE_LAYERS 2              // back, front
+#define PARTICLE_ATLASES 3             // gameskin, particles, extras
 
 typedef enum { GROUP_PROJECTILE_TRAIL = 0,
                GROUP_TRAIL_EXTRA,
@@ -16,6 +32,7 @@ typedef enum { GROUP_PROJECTILE_TRAIL = 0,
                GROUP_GENERAL,
                NUM_PARTICLE_GROUPS } particle_group_t;
 
+// Spawn and render parameters of a particle, also the template passed to particle_spawn.
 typedef struct {
   double spawn_time;
   vec2 start_pos;
@@ -45,13 +62,64 @@ typedef struct {
   uint32_t seed;
   int creation_tick;
 
-  // State for incremental simulation
-  vec2 current_pos;
-  vec2 current_vel;
-  double last_sim_time;
-  uint32_t current_seed;
+  // render bucket, derived from group and sprite_index at spawn
+  uint8_t layer;
+  uint8_t atlas;
+  uint32_t atlas_sprite;
 } particle_t;
 
+enum {
+  PARTICLE_FLAG_COLLIDES = 1 << 0,
+  PARTICLE_FLAG_FLOW = 1 << 1,
+  // particles without these only follow gravity and drag and are evaluated in closed form when drawn
+  PARTICLE_FLAG_SIMULATED = PARTICLE_FLAG_COLLIDES | PARTICLE_FLAG_FLOW,
+};
+
+// Saved simulation state of one particle. Rewinds restart from the newest saved step that is not
+// past the target instead of from the spawn state.
+typedef struct {
+  float pos[2];
+  float vel[2];
+  uint32_t seed;
+} particle_checkpoint_t;
+
+// Rewind state of one PARTICLE_FLAG_SIMULATED particle, closed form particles never need one
+typedef struct {
+  // slot k holds the state after (k + 1) * PARTICLE_CHECKPOINT_INTERVAL steps
+  particle_checkpoint_t checkpoints[PARTICLE_CHECKPOINTS];
+  // every step of the interval a rewind landed in, so scrubbing further back does not re-simulate
+  particle_checkpoint_t trail[PARTICLE_CHECKPOINT_INTERVAL];
+  uint16_t trail_base; // age of the first trail entry or PARTICLE_TRAIL_NONE
+  uint8_t checkpoint_count;
+} particle_history_t;
+
+// Incremental simulation state, one array per field and indexed like `particles`. The update only
+// streams through these, the wide particle_t is read when rewinding or drawing. Particles that are
+// not PARTICLE_FLAG_SIMULATED keep their spawn state here.
+typedef struct {
+  float *pos_x;
+  float *pos_y;
+  float *vel_x;
+  float *vel_y;
+  float *gravity;
+  float *drag; // velocity scale per step, derived from friction
+  float *flow_affected;
+  float *life_span;
+  double *spawn_time;
+  double *last_sim_time; // always spawn_time + age * PARTICLE_STEP
+  uint16_t *age;         // steps simulated since spawn
+  uint32_t *seed;
+  uint8_t *flags;
+  uint8_t *expired; // set by the update, the particle is removed right after
+  int32_t *history; // slot in `histories`, -1 for particles that are not PARTICLE_FLAG_SIMULATED
+
+  // sparse side store, slots are taken at spawn and handed back when the particle goes away
+  particle_history_t *histories;
+  int32_t *free_histories; // stack of unused slots
+  int history_capacity;
+  int free_history_count;
+} particle_state_t;
+
 typedef struct {
   double time;
   vec2 pos;
@@ -60,25 +128,72 @@ typedef struct {
   int creation_tick;
 } flow_event_t;
 
+// Active flow event filed under its bin, the key orders bins by row so a run of neighbouring bins
+// in one row is one contiguous range.
+typedef struct {
+  int64_t key;
+  int event;
+} flow_bin_t;
+
+// Instances of one (layer, atlas) bucket, rebuilt every frame and submitted as one atlas batch
+typedef struct {
+  atlas_instance_t *instances;
+  int count;
+  int capacity;
+} particle_batch_t;
+
+typedef struct {
+  int active_count;
+  int capacity;   // whole pages, grown while spawning and trimmed once the pool sits mostly empty
+  int high_water; // most particles alive at once since init
+  size_t bytes;   // pool memory
+} particle_pool_stats_t;
+
 typedef struct {
+  // every per-particle array is sized to `capacity`
   particle_t *particles;
+  particle_state_t state;
   int active_count;
+  int capacity;
+  int high_water;
+  int idle_updates;
+  thread_pool_t *pool; // simulates on the calling thread when NULL
+
+  uint8_t *visible;  // written by particle_system_cull for the first visible_count particles
+  int visible_count; // particles added after the last cull are drawn
+  int budget;        // particles drawn per frame, 0 draws all of them
+  particle_batch_t batches[PARTICLE_LAYERS][PARTICLE_ATLASES];
 
   flow_event_t flow_events[MAX_FLOW_EVENTS];
   int next_flow_index;
+  flow_bin_t flow_bins[MAX_FLOW_EVENTS]; // sorted by key, rebuilt when the events change
+  int flow_bin_count;
+  bool flow_dirty;
+  float flow_decay[FLOW_DECAY_TICKS * FLOW_DECAY_RESOLUTION + 2]; // 0.85^ticks
 
   double current_time;
+  int first_simulated_tick; // particles of every tick from here to last_simulated_tick were spawned
   int last_simulated_tick;
+  double expired_time; // latest death of a particle dropped for being dead, drawing before it needs a respawn
   uint32_t rng_seed;
 } particle_system_t;
 
+// Allocates no particles, the pool grows a page at a time as they are spawned
 void particle_system_init(particle_system_t *ps);
 void particle_system_cleanup(particle_system_t *ps);
+void particle_system_get_stats(const particle_system_t *ps, particle_pool_stats_t *out);
 void particle_system_update_sim(particle_system_t *ps, map_data_t *map);
 void particle_system_update(particle_system_t *ps, float dt, map_data_t *map);
-void particle_system_render(particle_system_t *ps, gfx_handler_t *gfx, int layer);
-
-void particle_system_prune_by_time(particle_system_t *ps, double min_time);
+// Picks the particles drawn this frame: those on screen, within the budget by group priority.
+// Runs after particle_system_update_sim and before particle_system_render.
+void particle_system_cull(particle_system_t *ps, gfx_handler_t *gfx);
+// Draws both particle layers, one atlas batch per (layer, atlas) bucket
+void particle_system_render(particle_system_t *ps, gfx_handler_t *gfx);
+
+// Drops every particle and flow event, spawning starts over at `first_tick`
+void particle_system_clear(particle_system_t *ps, int first_tick);
+// Drops the particles and flow events spawned at `tick` or later
+void particle_system_truncate(particle_system_t *ps, int tick);
 void particle_spawn(particle_system_t *ps, int group, particle_t *p_template, float time_passed);
 
 // Effects
@@ -0,0 +1,138 @@
+#include "event_log.h"
+#include <ddnet_physics/vmath.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHAR_HOOK_GRABBED 1
+#define CHAR_HOOKED_PLAYER 2
+#define CHAR_JUMP_HELD 4
+
+void event_log_free(event_log_t *log) {
+  free(log->events);
+  free(log->tick_end);
+  free(log->char_state);
+  memset(log, 0, sizeof(event_log_t));
+}
+
+void event_log_reset(event_log_t *log, int first_tick) {
+  log->first_tick = first_tick;
+  log->tick_count = 0;
+  log->event_count = 0;
+}
+
+void event_log_truncate(event_log_t *log, int tick) {
+  int keep = imax(imin(tick - log->first_tick, log->tick_count), 0);
+  log->tick_count = keep;
+  log->event_count = keep ? log->tick_end[keep - 1] : 0;
+}
+
+const game_event_t *event_log_tick_events(const event_log_t *log, int tick, int *count) {
+  int index = tick - log->first_tick;
+  int begin = index ? log->tick_end[index - 1] : 0;
+  *count = log->tick_end[index] - begin;
+  return log->events + begin;
+}
+
+static bool reserve_events(event_log_t *log, int count) {
+  if (count <= log->event_capacity) return true;
+  int new_capacity = log->event_capacity == 0 ? 256 : log->event_capacity;
+  while (new_capacity < count)
+    new_capacity *= 2;
+  game_event_t *events = realloc(log->events, sizeof(game_event_t) * new_capacity);
+  if (!events) return false;
+  log->events = events;
+  log->event_capacity = new_capacity;
+  return true;
+}
+
+static bool reserve_ticks(event_log_t *log, int count) {
+  if (count <= log->tick_capacity) return true;
+  int new_capacity = log->tick_capacity == 0 ? 1024 : log->tick_capacity;
+  while (new_capacity < count)
+    new_capacity *= 2;
+  int *tick_end = realloc(log->tick_end, sizeof(int) * new_capacity);
+  if (!tick_end) return false;
+  log->tick_end = tick_end;
+  log->tick_capacity = new_capacity;
+  return true;
+}
+
+static void push_event(event_log_t *log, mvec2 pos, int type, int arg, int cid) {
+  if (!reserve_events(log, log->event_count + 1)) return;
+  log->events[log->event_count++] = (game_event_t){{vgetx(pos), vgety(pos)}, (uint8_t)type, (uint8_t)arg, (int16_t)cid};
+}
+
+bool event_log_assign(event_log_t *log, int first_tick, const int *tick_end, int tick_count, const game_event_t *events, int event_count) {
+  event_log_reset(log, first_tick);
+  if (!reserve_ticks(log, tick_count) || !reserve_events(log, event_count)) return false;
+  memcpy(log->tick_end, tick_end, sizeof(int) * tick_count);
+  memcpy(log->events, events, sizeof(game_event_t) * event_count);
+  log->tick_count = tick_count;
+  log->event_count = event_count;
+  return true;
+}
+
+// Recording
+
+static void record_particle_callback(mvec2 pos, int type, int cid, void *user_data) {
+  static const int game_event_of_particle[] = {
+      [PARTICLE_TYPE_SMOKE] = GAME_EVENT_SMOKE,
+      [PARTICLE_TYPE_PLAYER_SPAWN] = GAME_EVENT_SPAWN,
+      [PARTICLE_TYPE_PLAYER_DEATH] = GAME_EVENT_DEATH,
+      [PARTICLE_TYPE_AIR_JUMP] = GAME_EVENT_AIR_JUMP,
+      [PARTICLE_TYPE_BULLET_TRAIL] = GAME_EVENT_BULLET_TRAIL,
+      [PARTICLE_TYPE_BULLET_STARS] = GAME_EVENT_BULLET_STARS,
+      [PARTICLE_TYPE_EXPLOSION] = GAME_EVENT_EXPLOSION,
+      [PARTICLE_TYPE_HAMMER_HIT] = GAME_EVENT_HAMMER_HIT,
+  };
+  if (type < 0 || type >= (int)(sizeof(game_event_of_particle) / sizeof(*game_event_of_particle))) return;
+  push_event(user_data, pos, game_event_of_particle[type], 0, cid);
+}
+
+void event_log_begin_tick(event_log_t *log, SWorldCore *world) {
+  log->char_count = 0;
+  if (world->m_NumCharacters > log->char_capacity) {
+    uint8_t *char_state = realloc(log->char_state, world->m_NumCharacters);
+    if (char_state) {
+      log->char_state = char_state;
+      log->char_capacity = world->m_NumCharacters;
+    }
+  }
+  // without room for the hook states only the physics callback events are recorded
+  if (world->m_NumCharacters <= log->char_capacity) {
+    log->char_count = world->m_NumCharacters;
+    for (int i = 0; i < log->char_count; ++i) {
+      const SCharacterCore *core = &world->m_pCharacters[i];
+      log->char_state[i] = (core->m_HookState == HOOK_GRABBED ? CHAR_HOOK_GRABBED : 0) | (core->m_HookedPlayer != -1 ? CHAR_HOOKED_PLAYER : 0) |
+                           (core->m_Jumped & 1 ? CHAR_JUMP_HELD : 0);
+    }
+  }
+  world->particle = record_particle_callback;
+  world->user_data = log;
+}
+
+void event_log_end_tick(event_log_t *log, SWorldCore *world) {
+  world->particle = NULL;
+  world->user_data = NULL;
+
+  for (int i = 0; i < imin(log->char_count, world->m_NumCharacters); ++i) {
+    const SCharacterCore *core = &world->m_pCharacters[i];
+    if (!(log->char_state[i] & CHAR_HOOK_GRABBED) && core->m_HookState == HOOK_GRABBED)
+      push_event(log, core->m_Pos, GAME_EVENT_HOOK_ATTACH, !(log->char_state[i] & CHAR_HOOKED_PLAYER) && core->m_HookedPlayer != -1, i);
+    // bit 0 of m_Jumped stays set while jump is held, only the tick that sets it jumped
+    if (!(log->char_state[i] & CHAR_JUMP_HELD) && (core->m_Jumped & 1) && core->m_Grounded) push_event(log, core->m_Pos, GAME_EVENT_JUMP, 0, i);
+  }
+  if (world->m_GameTick % 5 == 0) {
+    for (int i = 0; i < world->m_NumCharacters; ++i) {
+      const SCharacterCore *core = &world->m_pCharacters[i];
+      if (core->m_FreezeTime > 0) push_event(log, core->m_Pos, GAME_EVENT_FROZEN, 0, i);
+    }
+  }
+
+  if (!reserve_ticks(log, log->tick_count + 1)) {
+    // the log stops here, the tick is recorded again next time
+    event_log_truncate(log, event_log_end(log));
+    return;
+  }
+  log->tick_end[log->tick_count++] = log->event_count;
+}
@@ -0,0 +1,66 @@
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include <ddnet_physics/gamecore.h>
+#include <stdint.h>
+#include <types.h>
+
+// Gameplay events of a simulation, recorded once per tick while it is ticked. Particles, demo
+// export and the snapshot cache read them back instead of re-running the physics callbacks or
+// diffing worlds. Events of tick t happen while the world goes from tick t to t + 1.
+typedef enum {
+  GAME_EVENT_SPAWN,
+  GAME_EVENT_DEATH,
+  GAME_EVENT_HAMMER_HIT,
+  GAME_EVENT_EXPLOSION,
+  GAME_EVENT_HOOK_ATTACH, // arg is 1 when a player was hooked, 0 for the ground
+  GAME_EVENT_JUMP,        // jump off the ground
+  GAME_EVENT_AIR_JUMP,
+  GAME_EVENT_SMOKE,
+  GAME_EVENT_BULLET_TRAIL,
+  GAME_EVENT_BULLET_STARS,
+  GAME_EVENT_FROZEN, // every 5th tick a tee spends frozen
+  NUM_GAME_EVENTS
+} game_event_type_t;
+
+struct game_event_t {
+  float pos[2];
+  uint8_t type;
+  uint8_t arg;
+  int16_t cid; // character the event belongs to, -1 if none
+};
+
+// events of the ticks [first_tick, first_tick + tick_count), stored back to back
+struct event_log_t {
+  game_event_t *events;
+  int event_count;
+  int event_capacity;
+  int *tick_end; // one past the last event of every logged tick
+  int tick_capacity;
+  int first_tick;
+  int tick_count;
+
+  // hook and jump state of every character before the tick being recorded
+  uint8_t *char_state;
+  int char_count;
+  int char_capacity;
+};
+
+void event_log_free(event_log_t *log);
+// empties the log, the next recorded tick is `first_tick`
+void event_log_reset(event_log_t *log, int first_tick);
+// drops `tick` and every tick after it
+void event_log_truncate(event_log_t *log, int tick);
+static inline int event_log_end(const event_log_t *log) { return log->first_tick + log->tick_count; }
+static inline bool event_log_has_tick(const event_log_t *log, int tick) { return tick >= log->first_tick && tick < event_log_end(log); }
+// events of a logged tick
+const game_event_t *event_log_tick_events(const event_log_t *log, int tick, int *count);
+
+// Recording, `world` has to be at event_log_end(log). Call begin before wc_tick and end after it.
+void event_log_begin_tick(event_log_t *log, SWorldCore *world);
+void event_log_end_tick(event_log_t *log, SWorldCore *world);
+
+// replaces the log with `tick_count` ticks from `first_tick` on, tick_end is relative to `events`
+bool event_log_assign(event_log_t *log, int first_tick, const int *tick_end, int tick_count, const game_event_t *events, int event_count);
+
+#endif // EVENT_LOG_H
@@ -16,85 +16,208 @@
 // it is set once by api_init() and is internal to this file.
 static ui_handler_t *g_ui_handler_for_api = NULL;
 
-static int api_get_current_tick(void) { return g_ui_handler_for_api->timeline.current_tick; }
+// backing storage for every world handed out to plugins
+static world_pool_t g_world_pool;
+static world_handle_t g_world_state_handle = WORLD_HANDLE_INVALID;
 
-static int api_get_track_count(void) { return g_ui_handler_for_api->timeline.player_track_count; }
+// inputs staged by stage_inputs, handed to the timeline on commit
+static InputWrite *g_staged_writes = NULL;
+static int g_staged_count = 0;
+static int g_staged_capacity = 0;
+
+// profiling counters, only active while the plugin manager's count_api_calls is set
+#define API_CALL() plugin_manager_record_api_call(&g_ui_handler_for_api->plugin_manager)
+#define WORLD_CLONE() plugin_manager_record_world_clone(&g_ui_handler_for_api->plugin_manager)
+
+static int api_get_current_tick(void) { API_CALL(); return g_ui_handler_for_api->timeline.current_tick; }
+
+static int api_get_track_count(void) { API_CALL(); return g_ui_handler_for_api->timeline.player_track_count; }
 
 // READ ONLY PLEASE
 static SWorldCore *api_get_initial_world(void) {
+  API_CALL();
   return g_ui_handler_for_api->gfx_handler->physics_handler.loaded ? &g_ui_handler_for_api->gfx_handler->physics_handler.world : NULL;
 }
 
-static void api_log_info(const char *plugin_name, const char *message) { log_info(plugin_name, "%s", message); }
-static void api_log_warning(const char *plugin_name, const char *message) { log_warn(plugin_name, "%s", message); }
-static void api_log_error(const char *plugin_name, const char *message) { log_error(plugin_name, "%s", message); }
+static void api_log_info(const char *plugin_name, const char *message) { API_CALL(); log_info(plugin_name, "%s", message); }
+static void api_log_warning(const char *plugin_name, const char *message) { API_CALL(); log_warn(plugin_name, "%s", message); }
+static void api_log_error(const char *plugin_name, const char *message) { API_CALL(); log_error(plugin_name, "%s", message); }
 
 static SWorldCore *api_get_world_state_at(int tick) {
-  timeline_state_t *ts = &g_ui_handler_for_api->timeline;
-
-  SWorldCore *world_copy = (SWorldCore *)malloc(sizeof(SWorldCore));
-  if (!world_copy) return NULL;
+  API_CALL();
+  WORLD_CLONE();
+  world_pool_release(&g_world_pool, g_world_state_handle);
+  g_world_state_handle = world_pool_clone_timeline(&g_world_pool, &g_ui_handler_for_api->timeline, tick);
+  return world_pool_get(&g_world_pool, g_world_state_handle);
+}
 
-  const int step = 50;
-  int snapshot_index = (tick - 1) / step;
-  snapshot_index = imin(snapshot_index, (int)ts->vec.current_size - 1);
-  snapshot_index = imax(snapshot_index, 0);
+static world_handle_t api_world_clone_at(int tick) {
+  API_CALL();
+  WORLD_CLONE();
+  return world_pool_clone_timeline(&g_world_pool, &g_ui_handler_for_api->timeline, tick);
+}
 
-  if (ts->vec.current_size == 0) {
-    free(world_copy);
-    return NULL;
-  }
+static world_handle_t api_world_clone(world_handle_t source) {
+  API_CALL();
+  WORLD_CLONE();
+  return world_pool_clone(&g_world_pool, source);
+}
 
-  wc_copy_world(world_copy, &ts->vec.data[snapshot_index]);
+static bool api_world_step(world_handle_t handle, const SPlayerInput *inputs, int n_ticks) {
+  API_CALL();
+  return world_pool_step(&g_world_pool, handle, inputs, n_ticks);
+}
 
-  while (world_copy->m_GameTick < tick) {
-    for (int p = 0; p < world_copy->m_NumCharacters; ++p) {
-      SPlayerInput input = model_get_input_at_tick(ts, p, world_copy->m_GameTick);
-      cc_on_input(&world_copy->m_pCharacters[p], &input);
-    }
-    wc_tick(world_copy);
-  }
+static bool api_world_read_character(world_handle_t handle, int character_index, SCharacterCore *out) {
+  API_CALL();
+  return world_pool_read_character(&g_world_pool, handle, character_index, out);
+}
 
-  return world_copy;
+static int api_world_get_tick(world_handle_t handle) {
+  API_CALL();
+  SWorldCore *world = world_pool_get(&g_world_pool, handle);
+  return world ? world->m_GameTick : -1;
 }
 
+static void api_world_release(world_handle_t handle) { API_CALL(); world_pool_release(&g_world_pool, handle); }
+
 static struct undo_command_t *api_do_create_track(const player_info_t *info, int *out_track_index) {
+  API_CALL();
   return timeline_api_create_track(g_ui_handler_for_api, info, out_track_index);
 }
 
 static struct undo_command_t *api_do_create_snippet(int track_index, int start_tick, int duration, int *out_snippet_id) {
+  API_CALL();
   return timeline_api_create_snippet(g_ui_handler_for_api, track_index, start_tick, duration, out_snippet_id);
 }
 
 static struct undo_command_t *api_do_set_inputs(int snippet_id, int tick_offset, int count, const SPlayerInput *new_inputs) {
+  API_CALL();
   return timeline_api_set_snippet_inputs(g_ui_handler_for_api, snippet_id, tick_offset, count, new_inputs);
 }
 
 static void api_register_undo_command(struct undo_command_t *command) {
+  API_CALL();
   if (command) {
     undo_manager_register_command(&g_ui_handler_for_api->undo_manager, command);
   }
 }
 
+static void api_begin_transaction(const char *description) {
+  API_CALL();
+  undo_manager_begin_transaction(&g_ui_handler_for_api->undo_manager, &g_ui_handler_for_api->timeline, description);
+}
+
+static void api_commit_transaction(void) {
+  API_CALL();
+  undo_manager_commit_transaction(&g_ui_handler_for_api->undo_manager, &g_ui_handler_for_api->timeline);
+}
+
+static SPlayerInput *api_stage_inputs(int track_index, int start_tick, int count) {
+  API_CALL();
+  timeline_state_t *ts = &g_ui_handler_for_api->timeline;
+  if (track_index < 0 || track_index >= ts->player_track_count || start_tick < 0 || count <= 0) return NULL;
+
+  if (g_staged_count >= g_staged_capacity) {
+    int new_capacity = g_staged_capacity == 0 ? 8 : g_staged_capacity * 2;
+    InputWrite *new_writes = realloc(g_staged_writes, sizeof(InputWrite) * new_capacity);
+    if (!new_writes) return NULL; // the writes staged so far stay valid
+    g_staged_writes = new_writes;
+    g_staged_capacity = new_capacity;
+  }
+  SPlayerInput *inputs = malloc(sizeof(SPlayerInput) * count);
+  if (!inputs) return NULL;
+  for (int i = 0; i < count; ++i)
+    inputs[i] = model_get_input_at_tick(ts, track_index, start_tick + i);
+
+  g_staged_writes[g_staged_count++] = (InputWrite){track_index, start_tick, count, inputs};
+  return inputs;
+}
+
+static bool api_commit_inputs(const char *description) {
+  API_CALL();
+  bool ok = timeline_api_write_inputs(g_ui_handler_for_api, g_staged_writes, g_staged_count, description);
+  g_staged_count = 0;
+  return ok;
+}
+
+static void discard_staged_writes(void) {
+  for (int i = 0; i < g_staged_count; ++i)
+    free(g_staged_writes[i].inputs);
+  g_staged_count = 0;
+}
+
+static void api_discard_inputs(void) { API_CALL(); discard_staged_writes(); }
+
+static job_handle_t api_job_submit(job_func_t func, void *user_data) {
+  API_CALL();
+  return thread_pool_submit(&g_ui_handler_for_api->thread_pool, func, user_data);
+}
+
+static job_handle_t api_job_parallel_for(int count, int grain, job_func_t func, void *user_data) {
+  API_CALL();
+  return thread_pool_parallel_for(&g_ui_handler_for_api->thread_pool, count, grain, func, user_data);
+}
+
+static void api_job_wait(job_handle_t job) { API_CALL(); thread_pool_wait(&g_ui_handler_for_api->thread_pool, job); }
+static void api_job_cancel(job_handle_t job) { API_CALL(); thread_pool_cancel(&g_ui_handler_for_api->thread_pool, job); }
+static bool api_job_is_cancelled(job_handle_t job) { API_CALL(); return thread_pool_is_cancelled(&g_ui_handler_for_api->thread_pool, job); }
+static bool api_job_is_done(job_handle_t job) { API_CALL(); return thread_pool_is_done(&g_ui_handler_for_api->thread_pool, job); }
+static float api_job_progress(job_handle_t job) { API_CALL(); return thread_pool_progress(&g_ui_handler_for_api->thread_pool, job); }
+static int api_get_worker_count(void) { API_CALL(); return g_ui_handler_for_api->thread_pool.worker_count; }
+
 static void api_draw_line_world(vec2 start, vec2 end, float z, vec4 color, float thickness) {
+  API_CALL();
   renderer_submit_line(g_ui_handler_for_api->gfx_handler, z, start, end, color, thickness);
 }
 
 tas_api_t api_init(ui_handler_t *ui_handler) {
   g_ui_handler_for_api = ui_handler;
+  world_pool_init(&g_world_pool);
+  g_world_state_handle = WORLD_HANDLE_INVALID;
 
   return (tas_api_t){
       .get_current_tick = api_get_current_tick,
       .get_track_count = api_get_track_count,
       .get_initial_world = api_get_initial_world,
       .get_world_state_at = api_get_world_state_at,
+      .world_clone_at = api_world_clone_at,
+      .world_clone = api_world_clone,
+      .world_step = api_world_step,
+      .world_read_character = api_world_read_character,
+      .world_get_tick = api_world_get_tick,
+      .world_release = api_world_release,
       .do_create_track = api_do_create_track,
       .register_undo_command = api_register_undo_command,
+      .begin_transaction = api_begin_transaction,
+      .commit_transaction = api_commit_transaction,
+      .stage_inputs = api_stage_inputs,
+      .commit_inputs = api_commit_inputs,
+      .discard_inputs = api_discard_inputs,
       .do_create_snippet = api_do_create_snippet,
       .do_set_inputs = api_do_set_inputs,
+      .job_submit = api_job_submit,
+      .job_parallel_for = api_job_parallel_for,
+      .job_wait = api_job_wait,
+      .job_cancel = api_job_cancel,
+      .job_is_cancelled = api_job_is_cancelled,
+      .job_is_done = api_job_is_done,
+      .job_progress = api_job_progress,
+      .get_worker_count = api_get_worker_count,
       .draw_line_world = api_draw_line_world,
       .log_info = api_log_info,
       .log_warning = api_log_warning,
       .log_error = api_log_error,
   };
 }
+
+// plugins are gone by now, so anything they still hold can go with the pool
+void api_shutdown(void) {
+  discard_staged_writes();
+  free(g_staged_writes);
+  g_staged_writes = NULL;
+  g_staged_capacity = 0;
+  world_pool_release_all(&g_world_pool);
+  world_pool_destroy(&g_world_pool);
+  g_world_state_handle = WORLD_HANDLE_INVALID;
+}
@@ -6,5 +6,6 @@
 #include <user_interface/user_interface.h>
 
 tas_api_t api_init(ui_handler_t *ui_handler);
+void api_shutdown(void);
 
 #endif // API_IMPL_H
@@ -1,6 +1,8 @@
 #ifndef PLUGIN_API_H
 #define PLUGIN_API_H
 
+#include "world_pool.h"
+#include <system/thread_pool.h>
 #include <types.h>
 #include <user_interface/timeline/timeline.h>
 
@@ -23,14 +25,54 @@ struct tas_api_t {
   int (*get_current_tick)(void);
   int (*get_track_count)(void);
   SWorldCore *(*get_initial_world)(void);
+  // READ ONLY, owned by the host and only valid until the next call
   SWorldCore *(*get_world_state_at)(int);
 
+  // Pooled World API
+  // handles are cheap to create and recycle, every clone must be paired with a world_release.
+  // inputs passed to world_step are laid out tick-major: n_ticks rows of one input per character.
+  // clone/step/read/release work from worker threads, world_clone_at reads the timeline and must
+  // be called from the main thread.
+  world_handle_t (*world_clone_at)(int tick);
+  world_handle_t (*world_clone)(world_handle_t source);
+  bool (*world_step)(world_handle_t handle, const SPlayerInput *inputs, int n_ticks);
+  bool (*world_read_character)(world_handle_t handle, int character_index, SCharacterCore *out);
+  int (*world_get_tick)(world_handle_t handle);
+  void (*world_release)(world_handle_t handle);
+
   // Undo-able Write Operations
+  // these and the bulk writes below edit the timeline and must be called from the main thread
   struct undo_command_t *(*do_create_track)(const player_info_t *info, int *out_track_index);
   struct undo_command_t *(*do_create_snippet)(int track_index, int start_tick, int duration, int *out_snippet_id);
   struct undo_command_t *(*do_delete_snippet)(int snippet_id);
   struct undo_command_t *(*do_set_inputs)(int snippet_id, int tick_offset, int count, const SPlayerInput *new_inputs);
   void (*register_undo_command)(struct undo_command_t *command);
+  // commands registered between begin and commit become a single undo step, adjacent input
+  // edits of the same snippet are merged and physics is only invalidated once on commit
+  void (*begin_transaction)(const char *description);
+  void (*commit_transaction)(void);
+
+  // Bulk Input Writes
+  // stage_inputs returns a host-owned buffer holding the current inputs of [start_tick, start_tick + count)
+  // on a track, which the plugin overwrites in place. any number of ranges on any tracks can be staged.
+  // commit_inputs applies them all as one undo step with a single physics invalidation: parts covered
+  // by an active snippet edit it, gaps get new snippets. buffers are invalid after commit or discard.
+  SPlayerInput *(*stage_inputs)(int track_index, int start_tick, int count);
+  bool (*commit_inputs)(const char *description);
+  void (*discard_inputs)(void);
+
+  // Thread Pool API
+  // the host's worker pool, sized to the machine. func is called with item ranges [begin, end),
+  // single jobs get [0, 1). every job must be passed to job_wait exactly once, which also helps
+  // run queued work. cancelled jobs skip their queued ranges, running ones may poll job_is_cancelled.
+  job_handle_t (*job_submit)(job_func_t func, void *user_data);
+  job_handle_t (*job_parallel_for)(int count, int grain, job_func_t func, void *user_data);
+  void (*job_wait)(job_handle_t job);
+  void (*job_cancel)(job_handle_t job);
+  bool (*job_is_cancelled)(job_handle_t job);
+  bool (*job_is_done)(job_handle_t job);
+  float (*job_progress)(job_handle_t job);
+  int (*get_worker_count)(void);
 
   // Debug Drawing API
   void (*draw_line_world)(vec2 start, vec2 end, float z, vec4 color, float thickness);
@@ -55,6 +97,20 @@ struct plugin_info_t {
 #define GET_PLUGIN_UPDATE_FUNC_NAME "plugin_update"
 #define GET_PLUGIN_SHUTDOWN_FUNC_NAME "plugin_shutdown"
 
+// Optional event hooks, dispatched right before plugin_update.
+// Changes are coalesced per frame: every track gets at most one [start_tick, end_tick) range of
+// changed inputs and invalidations are reported once with the earliest affected tick.
+// After a project load only on_project_loaded is sent, all derived data should be rebuilt.
+#define GET_PLUGIN_ON_TICK_CHANGED_FUNC_NAME "plugin_on_tick_changed"
+#define GET_PLUGIN_ON_INPUTS_CHANGED_FUNC_NAME "plugin_on_inputs_changed"
+#define GET_PLUGIN_ON_PROJECT_LOADED_FUNC_NAME "plugin_on_project_loaded"
+#define GET_PLUGIN_ON_WORLD_INVALIDATED_FUNC_NAME "plugin_on_world_invalidated"
+
+// Optional, draws the plugin's windows from its current state. Called every frame after
+// plugin_update, and on its own while the plugin is over budget and its update is skipped.
+// Plugins that draw inside plugin_update are never throttled, their windows would flicker.
+#define GET_PLUGIN_DRAW_FUNC_NAME "plugin_draw"
+
 #undef FT_API
 #ifdef _WIN32
 #define FT_API __declspec(dllexport)
@@ -1,8 +1,12 @@
 #include "plugin_manager.h"
+#include <GLFW/glfw3.h>
+#include <limits.h>
 #include <logger/logger.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <system/include_cimgui.h>
+#include <user_interface/user_interface.h>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -23,6 +27,22 @@ void *get_symbol(void *handle, const char *name) { return dlsym(handle, name); }
 void close_library(void *handle) { dlclose(handle); }
 #endif
 
+static int open_transactions(plugin_manager_t *manager) {
+  ui_handler_t *ui = manager->context ? manager->context->ui_handler : NULL;
+  return ui ? ui->undo_manager.transaction_depth : 0;
+}
+
+// A transaction a plugin begins and never commits would defer physics recalculation forever, so
+// whatever it leaves open past a callback is committed on its behalf.
+static void close_plugin_transactions(plugin_manager_t *manager, const loaded_plugin_t *p, int depth_before) {
+  int left_open = open_transactions(manager) - depth_before;
+  if (left_open <= 0) return;
+  log_warn(LOG_SOURCE, "'%s' left %d undo transaction(s) open, committing them.", p->info.name, left_open);
+  ui_handler_t *ui = manager->context->ui_handler;
+  for (int i = 0; i < left_open; ++i)
+    undo_manager_commit_transaction(&ui->undo_manager, &ui->timeline);
+}
+
 static void load_plugin(plugin_manager_t *manager, const char *path) {
   void *handle = open_library(path);
   if (!handle) {
@@ -51,12 +71,20 @@ static void load_plugin(plugin_manager_t *manager, const char *path) {
   }
 
   loaded_plugin_t *p = &manager->plugins[manager->count++];
+  memset(p, 0, sizeof(loaded_plugin_t));
   p->handle = handle;
   p->info = get_info();
   p->init = init;
   p->update = update;
   p->shutdown = shutdown;
+  p->on_tick_changed = (plugin_on_tick_changed_func)get_symbol(handle, GET_PLUGIN_ON_TICK_CHANGED_FUNC_NAME);
+  p->on_inputs_changed = (plugin_on_inputs_changed_func)get_symbol(handle, GET_PLUGIN_ON_INPUTS_CHANGED_FUNC_NAME);
+  p->on_project_loaded = (plugin_on_project_loaded_func)get_symbol(handle, GET_PLUGIN_ON_PROJECT_LOADED_FUNC_NAME);
+  p->on_world_invalidated = (plugin_on_world_invalidated_func)get_symbol(handle, GET_PLUGIN_ON_WORLD_INVALIDATED_FUNC_NAME);
+  p->draw = (plugin_draw_func)get_symbol(handle, GET_PLUGIN_DRAW_FUNC_NAME);
+  int depth = open_transactions(manager);
   p->data = p->init(manager->context, manager->api);
+  close_plugin_transactions(manager, p, depth);
 
   if (p->data) {
     log_info(LOG_SOURCE, "Loaded '%s' v%s by %s.", p->info.name, p->info.version, p->info.author);
@@ -74,6 +102,11 @@ void plugin_manager_init(plugin_manager_t *manager, tas_context_t *context, tas_
   manager->capacity = 0;
   manager->context = context;
   manager->api = api;
+  manager->last_tick = -1;
+  manager->frame_changes = NULL;
+  manager->frame_change_capacity = 0;
+  manager->stats_lock = thread_mutex_create();
+  manager->current_plugin = -1;
 }
 
 void plugin_manager_load_all(plugin_manager_t *manager, const char *directory) {
@@ -114,19 +147,187 @@ void plugin_manager_load_all(plugin_manager_t *manager, const char *directory) {
   log_info(LOG_SOURCE, "Loaded %d plugin%s.", plugins, plugins != 1 ? "s" : "");
 }
 
+// Takes the changes the timeline collected since the last frame, so edits plugins make while
+// running are delivered to everyone on the next frame
+typedef struct {
+  bool project_loaded;
+  bool tick_changed;
+  int tick;
+  int change_count;
+  int invalidated_from_tick;
+} frame_events_t;
+
+static frame_events_t collect_events(plugin_manager_t *manager) {
+  timeline_state_t *ts = manager->context->timeline;
+  frame_events_t events = {ts->project_loaded, ts->current_tick != manager->last_tick, ts->current_tick, ts->input_change_count,
+                           ts->invalidated_from_tick};
+  manager->last_tick = ts->current_tick;
+
+  if (events.change_count > manager->frame_change_capacity) {
+    manager->frame_change_capacity = events.change_count;
+    manager->frame_changes = realloc(manager->frame_changes, sizeof(input_change_t) * manager->frame_change_capacity);
+  }
+  if (events.change_count > 0) memcpy(manager->frame_changes, ts->input_changes, sizeof(input_change_t) * events.change_count);
+
+  ts->project_loaded = false;
+  ts->input_change_count = 0;
+  ts->invalidated_from_tick = INT_MAX;
+  return events;
+}
+
+static void dispatch_events(plugin_manager_t *manager, loaded_plugin_t *p, const frame_events_t *events) {
+  if (events->project_loaded) {
+    if (p->on_project_loaded) p->on_project_loaded(p->data);
+  } else {
+    if (p->on_inputs_changed) {
+      for (int c = 0; c < events->change_count; ++c) {
+        const input_change_t *change = &manager->frame_changes[c];
+        p->on_inputs_changed(p->data, change->track_index, change->start_tick, change->end_tick);
+      }
+    }
+    if (p->on_world_invalidated && events->invalidated_from_tick != INT_MAX) p->on_world_invalidated(p->data, events->invalidated_from_tick);
+  }
+  if (p->on_tick_changed && events->tick_changed) p->on_tick_changed(p->data, events->tick);
+}
+
+static void set_current_plugin(plugin_manager_t *manager, int index) {
+  thread_mutex_lock(manager->stats_lock);
+  manager->current_plugin = index;
+  thread_mutex_unlock(manager->stats_lock);
+}
+
+// only plugins with a separate draw keep their windows up while their update is skipped
+static bool can_throttle(plugin_manager_t *manager, loaded_plugin_t *p) {
+  return manager->frame_budget_ms > 0.0f && !p->stats.exempt && p->draw;
+}
+
+// Plugins over budget accumulate debt and skip their update until it is paid off, hooks and draw always run
+static bool should_throttle(plugin_manager_t *manager, loaded_plugin_t *p) {
+  plugin_stats_t *stats = &p->stats;
+  if (!can_throttle(manager, p) || stats->debt_ms <= 0.0f) {
+    stats->debt_ms = 0.0f;
+    return false;
+  }
+  stats->debt_ms -= manager->frame_budget_ms;
+  ++stats->skipped_frames;
+  return true;
+}
+
+static void record_frame(plugin_manager_t *manager, loaded_plugin_t *p, float ms) {
+  plugin_stats_t *stats = &p->stats;
+  stats->frame_ms[stats->frame_head] = ms;
+  stats->frame_head = (stats->frame_head + 1) % PLUGIN_FRAME_HISTORY;
+  stats->avg_ms = stats->avg_ms * 0.95f + ms * 0.05f;
+  stats->peak_ms = 0.0f;
+  for (int i = 0; i < PLUGIN_FRAME_HISTORY; ++i)
+    if (stats->frame_ms[i] > stats->peak_ms) stats->peak_ms = stats->frame_ms[i];
+
+  if (can_throttle(manager, p) && ms > manager->frame_budget_ms) {
+    if (stats->skipped_frames == 0) log_warn(LOG_SOURCE, "'%s' took %.2f ms, throttling it to %.2f ms per frame.", p->info.name, ms, manager->frame_budget_ms);
+    stats->debt_ms += ms - manager->frame_budget_ms;
+  }
+
+  thread_mutex_lock(manager->stats_lock);
+  stats->api_calls = stats->pending_api_calls;
+  stats->world_clones = stats->pending_world_clones;
+  stats->pending_api_calls = 0;
+  stats->pending_world_clones = 0;
+  thread_mutex_unlock(manager->stats_lock);
+}
+
 void plugin_manager_update_all(plugin_manager_t *manager) {
+  frame_events_t events = collect_events(manager);
   for (int i = 0; i < manager->count; ++i) {
-    if (manager->plugins[i].update && manager->plugins[i].data) {
-      manager->plugins[i].update(manager->plugins[i].data);
+    loaded_plugin_t *p = &manager->plugins[i];
+    if (!p->data) continue;
+    set_current_plugin(manager, i);
+    double start = glfwGetTime();
+    int depth = open_transactions(manager);
+
+    dispatch_events(manager, p, &events);
+    if (p->update && !should_throttle(manager, p)) p->update(p->data);
+    if (p->draw) p->draw(p->data);
+    close_plugin_transactions(manager, p, depth);
+
+    record_frame(manager, p, (float)((glfwGetTime() - start) * 1000.0));
+  }
+  set_current_plugin(manager, -1);
+}
+
+void plugin_manager_record_api_call(plugin_manager_t *manager) {
+  if (!manager->count_api_calls) return;
+  thread_mutex_lock(manager->stats_lock);
+  if (manager->current_plugin >= 0) ++manager->plugins[manager->current_plugin].stats.pending_api_calls;
+  thread_mutex_unlock(manager->stats_lock);
+}
+
+void plugin_manager_record_world_clone(plugin_manager_t *manager) {
+  if (!manager->count_api_calls) return;
+  thread_mutex_lock(manager->stats_lock);
+  if (manager->current_plugin >= 0) ++manager->plugins[manager->current_plugin].stats.pending_world_clones;
+  thread_mutex_unlock(manager->stats_lock);
+}
+
+void plugin_manager_render_stats_window(plugin_manager_t *manager) {
+  if (!manager->show_stats_window) return;
+
+  igSetNextWindowSize((ImVec2){560, 320}, ImGuiCond_FirstUseEver);
+  if (igBegin("Plugins", &manager->show_stats_window, 0)) {
+    igSliderFloat("Budget (ms)", &manager->frame_budget_ms, 0.0f, 16.0f, manager->frame_budget_ms <= 0.0f ? "Unlimited" : "%.2f", 0);
+    if (igIsItemHovered(ImGuiHoveredFlags_None)) igSetTooltip("Plugins over budget skip their update for a few frames and keep drawing their last state.\n"
+                   "Plugins without plugin_draw are never throttled.");
+    igCheckbox("Count API calls", &manager->count_api_calls);
+    igSeparator();
+
+    if (manager->count == 0) igTextDisabled("No plugins loaded.");
+    else if (igBeginTable("PluginStats", 7, ImGuiTableFlags_BordersInnerV | ImGuiTableFlags_RowBg, (ImVec2){0, 0}, 0)) {
+      igTableSetupColumn("Plugin", ImGuiTableColumnFlags_WidthStretch, 0.0f, 0);
+      igTableSetupColumn("Frame time", ImGuiTableColumnFlags_WidthFixed, 160.0f, 0);
+      igTableSetupColumn("Avg / Peak", ImGuiTableColumnFlags_WidthFixed, 0.0f, 0);
+      igTableSetupColumn("Calls", ImGuiTableColumnFlags_WidthFixed, 0.0f, 0);
+      igTableSetupColumn("Clones", ImGuiTableColumnFlags_WidthFixed, 0.0f, 0);
+      igTableSetupColumn("Skipped", ImGuiTableColumnFlags_WidthFixed, 0.0f, 0);
+      igTableSetupColumn("Exempt", ImGuiTableColumnFlags_WidthFixed, 0.0f, 0);
+      igTableHeadersRow();
+
+      for (int i = 0; i < manager->count; ++i) {
+        loaded_plugin_t *p = &manager->plugins[i];
+        plugin_stats_t *stats = &p->stats;
+        igPushID_Int(i);
+        igTableNextRow(0, 0);
+        igTableSetColumnIndex(0);
+        igText("%s", p->info.name);
+        igTableSetColumnIndex(1);
+        igPlotHistogram_FloatPtr("##frame_ms", stats->frame_ms, PLUGIN_FRAME_HISTORY, stats->frame_head, NULL, 0.0f,
+                                 stats->peak_ms > 0.0f ? stats->peak_ms : 1.0f, (ImVec2){150, 24}, sizeof(float));
+        igTableSetColumnIndex(2);
+        igText("%.2f / %.2f ms", stats->avg_ms, stats->peak_ms);
+        igTableSetColumnIndex(3);
+        if (manager->count_api_calls) igText("%d", stats->api_calls);
+        else igTextDisabled("-");
+        igTableSetColumnIndex(4);
+        if (manager->count_api_calls) igText("%d", stats->world_clones);
+        else igTextDisabled("-");
+        igTableSetColumnIndex(5);
+        igText("%d", stats->skipped_frames);
+        igTableSetColumnIndex(6);
+        if (p->draw) igCheckbox("##exempt", &stats->exempt);
+        else igTextDisabled("always"); // draws in its update, see plugin_draw
+        igPopID();
+      }
+      igEndTable();
     }
   }
+  igEnd();
 }
 
 void plugin_manager_shutdown(plugin_manager_t *manager) {
   for (int i = 0; i < manager->count; ++i) {
     log_info(LOG_SOURCE, "Shutting down '%s'...", manager->plugins[i].info.name);
     if (manager->plugins[i].shutdown && manager->plugins[i].data) {
+      int depth = open_transactions(manager);
       manager->plugins[i].shutdown(manager->plugins[i].data);
+      close_plugin_transactions(manager, &manager->plugins[i], depth);
     }
     close_library(manager->plugins[i].handle);
   }
@@ -134,6 +335,11 @@ void plugin_manager_shutdown(plugin_manager_t *manager) {
   manager->plugins = NULL;
   manager->count = 0;
   manager->capacity = 0;
+  free(manager->frame_changes);
+  manager->frame_changes = NULL;
+  manager->frame_change_capacity = 0;
+  thread_mutex_destroy(manager->stats_lock);
+  manager->stats_lock = NULL;
 }
 
 void plugin_manager_reload_all(plugin_manager_t *manager, const char *directory) {
@@ -2,15 +2,39 @@
 #define PLUGIN_MANAGER_H
 
 #include "plugin_api.h"
+#include <system/threading.h>
 #include <types.h>
 
+#define PLUGIN_FRAME_HISTORY 120
+
+struct plugin_stats_t {
+  float frame_ms[PLUGIN_FRAME_HISTORY]; // ring buffer of hook + update time, frame_head is the oldest entry
+  int frame_head;
+  float avg_ms;
+  float peak_ms; // over the history window
+  int api_calls; // during the last frame, only counted while count_api_calls is set
+  int world_clones;
+  int pending_api_calls; // guarded by the manager's stats_lock
+  int pending_world_clones;
+  float debt_ms; // time over budget that is paid off by skipping updates, see plugin_draw
+  int skipped_frames;
+  bool exempt; // never throttled
+};
+
 struct loaded_plugin_t {
   void *handle; // DLL/SO handle
   plugin_info_t info;
   plugin_init_func init;
   plugin_update_func update;
   plugin_shutdown_func shutdown;
+  // optional hooks, NULL if not exported
+  plugin_on_tick_changed_func on_tick_changed;
+  plugin_on_inputs_changed_func on_inputs_changed;
+  plugin_on_project_loaded_func on_project_loaded;
+  plugin_on_world_invalidated_func on_world_invalidated;
+  plugin_draw_func draw;
   void *data; // plugin-specific data
+  plugin_stats_t stats;
 };
 
 struct plugin_manager_t {
@@ -19,6 +43,16 @@ struct plugin_manager_t {
   int capacity;
   tas_context_t *context;
   tas_api_t *api;
+  int last_tick; // tick seen by the last on_tick_changed dispatch
+  input_change_t *frame_changes; // this frame's input changes, copied out of the timeline
+  int frame_change_capacity;
+
+  // Profiling, settings survive reloads
+  thread_mutex_t *stats_lock;
+  int current_plugin; // plugin whose hooks or update are running, -1 otherwise
+  float frame_budget_ms; // per plugin and frame, 0 disables throttling
+  bool count_api_calls;
+  bool show_stats_window;
 };
 
 void plugin_manager_init(plugin_manager_t *manager, tas_context_t *context, tas_api_t *api);
@@ -27,4 +61,9 @@ void plugin_manager_update_all(plugin_manager_t *manager);
 void plugin_manager_shutdown(plugin_manager_t *manager);
 void plugin_manager_reload_all(plugin_manager_t *manager, const char *directory);
 
+// called by the API implementation, attributed to the plugin that is currently running
+void plugin_manager_record_api_call(plugin_manager_t *manager);
+void plugin_manager_record_world_clone(plugin_manager_t *manager);
+void plugin_manager_render_stats_window(plugin_manager_t *manager);
+
 #endif // PLUGIN_MANAGER_H
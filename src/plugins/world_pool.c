@@ -0,0 +1,174 @@
+#include "world_pool.h"
+#include <logger/logger.h>
+#include <stdlib.h>
+#include <string.h>
+#include <user_interface/timeline/timeline_model.h>
+
+static const char *LOG_SOURCE = "WorldPool";
+
+#define INDEX_MASK ((1u << WORLD_POOL_INDEX_BITS) - 1)
+#define GENERATION_MASK ((1u << (31 - WORLD_POOL_INDEX_BITS)) - 1)
+
+static world_pool_slot_t *slot_at(world_pool_t *pool, int index) {
+  return &pool->pages[index / WORLD_POOL_PAGE_SIZE][index % WORLD_POOL_PAGE_SIZE];
+}
+
+static world_handle_t make_handle(int index, uint32_t generation) {
+  return (world_handle_t)(((generation & GENERATION_MASK) << WORLD_POOL_INDEX_BITS) | (uint32_t)index);
+}
+
+// Stale handles (released, or from before a release_all) resolve to NULL
+static world_pool_slot_t *resolve(world_pool_t *pool, world_handle_t handle) {
+  if (handle < 0) return NULL;
+  int index = (int)((uint32_t)handle & INDEX_MASK);
+  if (index >= pool->slot_count) return NULL;
+  world_pool_slot_t *slot = slot_at(pool, index);
+  if (!slot->in_use || (slot->generation & GENERATION_MASK) != (uint32_t)handle >> WORLD_POOL_INDEX_BITS) return NULL;
+  return slot;
+}
+
+// expects pool->lock to be held
+static bool grow(world_pool_t *pool) {
+  if (!pool->pages || pool->page_count >= WORLD_POOL_MAX_PAGES) return false;
+  world_pool_slot_t *page = calloc(WORLD_POOL_PAGE_SIZE, sizeof(world_pool_slot_t));
+  if (!page) return false;
+  pool->pages[pool->page_count++] = page;
+
+  // chain the new slots into the free list in index order
+  for (int i = WORLD_POOL_PAGE_SIZE - 1; i >= 0; --i) {
+    page[i].world = wc_empty();
+    page[i].next_free = pool->free_head;
+    pool->free_head = pool->slot_count + i;
+  }
+  pool->slot_count += WORLD_POOL_PAGE_SIZE;
+  return true;
+}
+
+static int acquire(world_pool_t *pool) {
+  thread_mutex_lock(pool->lock);
+  if (pool->free_head < 0 && !grow(pool)) {
+    thread_mutex_unlock(pool->lock);
+    log_error(LOG_SOURCE, "Out of world slots (%d in use).", pool->live_count);
+    return -1;
+  }
+  int index = pool->free_head;
+  world_pool_slot_t *slot = slot_at(pool, index);
+  pool->free_head = slot->next_free;
+  slot->in_use = true;
+  slot->next_free = -1;
+  if (++pool->live_count > pool->peak_count) pool->peak_count = pool->live_count;
+  thread_mutex_unlock(pool->lock);
+  return index;
+}
+
+void world_pool_init(world_pool_t *pool) {
+  memset(pool, 0, sizeof(world_pool_t));
+  pool->free_head = -1;
+  pool->lock = thread_mutex_create();
+  pool->pages = calloc(WORLD_POOL_MAX_PAGES, sizeof(world_pool_slot_t *));
+}
+
+void world_pool_destroy(world_pool_t *pool) {
+  if (pool->live_count > 0) log_warn(LOG_SOURCE, "%d worlds were never released.", pool->live_count);
+  for (int p = 0; p < pool->page_count; ++p) {
+    for (int i = 0; i < WORLD_POOL_PAGE_SIZE; ++i)
+      wc_free(&pool->pages[p][i].world);
+    free(pool->pages[p]);
+  }
+  free(pool->pages);
+  thread_mutex_destroy(pool->lock);
+  memset(pool, 0, sizeof(world_pool_t));
+  pool->free_head = -1;
+}
+
+// Invalidates every outstanding handle but keeps the storage for reuse
+void world_pool_release_all(world_pool_t *pool) {
+  thread_mutex_lock(pool->lock);
+  pool->free_head = -1;
+  for (int i = pool->slot_count - 1; i >= 0; --i) {
+    world_pool_slot_t *slot = slot_at(pool, i);
+    if (slot->in_use) ++slot->generation;
+    slot->in_use = false;
+    slot->next_free = pool->free_head;
+    pool->free_head = i;
+  }
+  pool->live_count = 0;
+  thread_mutex_unlock(pool->lock);
+}
+
+world_handle_t world_pool_clone_world(world_pool_t *pool, SWorldCore *source) {
+  if (!source) return WORLD_HANDLE_INVALID;
+  int index = acquire(pool);
+  if (index < 0) return WORLD_HANDLE_INVALID;
+  world_pool_slot_t *slot = slot_at(pool, index);
+  wc_copy_world(&slot->world, source);
+  // plugin worlds never emit effects into the editor
+  slot->world.particle = NULL;
+  slot->world.user_data = NULL;
+  return make_handle(index, slot->generation);
+}
+
+// Starts from the closest cached snapshot at or before `tick` and simulates the timeline's inputs up to it
+world_handle_t world_pool_clone_timeline(world_pool_t *pool, timeline_state_t *ts, int tick) {
+  if (ts->vec.current_size == 0) return WORLD_HANDLE_INVALID;
+  int snapshot_index = imax(imin(tick / PHYSICS_SNAPSHOT_STEP, (int)ts->vec.current_size - 1), 0);
+  world_handle_t handle = world_pool_clone_world(pool, &ts->vec.data[snapshot_index]);
+  SWorldCore *world = world_pool_get(pool, handle);
+  if (!world) return WORLD_HANDLE_INVALID;
+
+  while (world->m_GameTick < tick) {
+    for (int p = 0; p < world->m_NumCharacters && p < ts->player_track_count; ++p) {
+      SPlayerInput input = model_get_input_at_tick(ts, p, world->m_GameTick);
+      cc_on_input(&world->m_pCharacters[p], &input);
+    }
+    wc_tick(world);
+  }
+  return handle;
+}
+
+world_handle_t world_pool_clone(world_pool_t *pool, world_handle_t source) {
+  world_pool_slot_t *src = resolve(pool, source);
+  if (!src) return WORLD_HANDLE_INVALID;
+  return world_pool_clone_world(pool, &src->world);
+}
+
+// `inputs` holds n_ticks rows of m_NumCharacters inputs each, tick-major
+bool world_pool_step(world_pool_t *pool, world_handle_t handle, const SPlayerInput *inputs, int n_ticks) {
+  world_pool_slot_t *slot = resolve(pool, handle);
+  if (!slot || n_ticks < 0) return false;
+  SWorldCore *world = &slot->world;
+  for (int t = 0; t < n_ticks; ++t) {
+    if (inputs) {
+      const SPlayerInput *row = &inputs[t * world->m_NumCharacters];
+      for (int p = 0; p < world->m_NumCharacters; ++p)
+        cc_on_input(&world->m_pCharacters[p], &row[p]);
+    }
+    wc_tick(world);
+  }
+  return true;
+}
+
+bool world_pool_read_character(world_pool_t *pool, world_handle_t handle, int character_index, SCharacterCore *out) {
+  world_pool_slot_t *slot = resolve(pool, handle);
+  if (!slot || !out || character_index < 0 || character_index >= slot->world.m_NumCharacters) return false;
+  *out = slot->world.m_pCharacters[character_index];
+  return true;
+}
+
+SWorldCore *world_pool_get(world_pool_t *pool, world_handle_t handle) {
+  world_pool_slot_t *slot = resolve(pool, handle);
+  return slot ? &slot->world : NULL;
+}
+
+void world_pool_release(world_pool_t *pool, world_handle_t handle) {
+  world_pool_slot_t *slot = resolve(pool, handle);
+  if (!slot) return;
+  int index = (int)((uint32_t)handle & INDEX_MASK);
+  thread_mutex_lock(pool->lock);
+  slot->in_use = false;
+  ++slot->generation;
+  slot->next_free = pool->free_head;
+  pool->free_head = index;
+  --pool->live_count;
+  thread_mutex_unlock(pool->lock);
+}
@@ -0,0 +1,49 @@
+#ifndef WORLD_POOL_H
+#define WORLD_POOL_H
+
+#include <ddnet_physics/gamecore.h>
+#include <system/threading.h>
+#include <types.h>
+
+#define WORLD_HANDLE_INVALID (-1)
+#define WORLD_POOL_PAGE_SIZE 64
+#define WORLD_POOL_INDEX_BITS 20 // the remaining bits of a handle hold the slot generation
+#define WORLD_POOL_MAX_PAGES ((1 << WORLD_POOL_INDEX_BITS) / WORLD_POOL_PAGE_SIZE)
+
+typedef int32_t world_handle_t;
+
+// slots never move once allocated: characters point back at their SWorldCore
+struct world_pool_slot_t {
+  SWorldCore world;
+  uint32_t generation;
+  int next_free;
+  bool in_use;
+};
+
+// Released worlds keep their buffers, so cloning into a recycled slot does not touch the heap
+// unless the source has more characters than the slot has seen before.
+// Handles may be created and released from any thread, a single handle must only be used by one
+// thread at a time.
+struct world_pool_t {
+  thread_mutex_t *lock; // guards the free list and counters, never held while simulating
+  world_pool_slot_t **pages; // WORLD_POOL_MAX_PAGES entries, never reallocated
+  int page_count;
+  int slot_count;
+  int free_head;
+  int live_count;
+  int peak_count;
+};
+
+void world_pool_init(world_pool_t *pool);
+void world_pool_destroy(world_pool_t *pool);
+void world_pool_release_all(world_pool_t *pool);
+
+world_handle_t world_pool_clone_world(world_pool_t *pool, SWorldCore *source);
+world_handle_t world_pool_clone_timeline(world_pool_t *pool, timeline_state_t *ts, int tick);
+world_handle_t world_pool_clone(world_pool_t *pool, world_handle_t source);
+bool world_pool_step(world_pool_t *pool, world_handle_t handle, const SPlayerInput *inputs, int n_ticks);
+bool world_pool_read_character(world_pool_t *pool, world_handle_t handle, int character_index, SCharacterCore *out);
+SWorldCore *world_pool_get(world_pool_t *pool, world_handle_t handle);
+void world_pool_release(world_pool_t *pool, world_handle_t handle);
+
+#endif // WORLD_POOL_H
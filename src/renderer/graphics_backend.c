@@ -9,6 +9,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <system/profiler.h>
 #include <vulkan/vulkan_core.h>
 
 #define ARRAYSIZE(_ARR) ((int)(sizeof(_ARR) / sizeof(*(_ARR))))
@@ -323,6 +324,7 @@ int gfx_begin_frame(gfx_handler_t *handler) {
 }
 
 bool gfx_end_frame(gfx_handler_t *handler) {
+  PROFILE_BEGIN("gfx_end_frame");
   bool hovered = false;
 
   if (handler->g_swap_chain_rebuild || glfwGetWindowAttrib(handler->window, GLFW_ICONIFIED) != 0) {
@@ -337,6 +339,7 @@ bool gfx_end_frame(gfx_handler_t *handler) {
       vkEndCommandBuffer(handler->current_frame_command_buffer);
       handler->current_frame_command_buffer = VK_NULL_HANDLE;
     }
+    PROFILE_END();
     return hovered;
   }
 
@@ -423,6 +426,7 @@ bool gfx_end_frame(gfx_handler_t *handler) {
     check_vk_result(err);
   }
   wd->SemaphoreIndex = (wd->SemaphoreIndex + 1) % wd->ImageCount;
+  PROFILE_END();
   return hovered;
 }
 
@@ -496,12 +500,24 @@ void on_map_load(gfx_handler_t *handler) {
   handler->map_textures[handler->map_texture_count++] = load_layer_texture(handler, map[0], handler->map_data->width, handler->map_data->height);
   handler->map_textures[handler->map_texture_count++] = load_layer_texture(handler, map[1], handler->map_data->width, handler->map_data->height);
   handler->map_textures[handler->map_texture_count++] = load_layer_texture(handler, map[2], handler->map_data->width, handler->map_data->height);
+  // overlay slot, filled by gfx_set_map_overlay
+  handler->map_textures[handler->map_texture_count++] = handler->renderer.default_texture;
 
   // update physics data
   wc_copy_world(&handler->user_interface.timeline.vec.data[0], &handler->physics_handler.world);
   wc_copy_world(&handler->user_interface.timeline.previous_world, &handler->physics_handler.world);
 }
 
+void gfx_set_map_overlay(gfx_handler_t *handler, const uint8_t **planes) {
+  if (handler->map_texture_count <= MAP_OVERLAY_TEXTURE) return;
+  texture_t *old = handler->map_textures[MAP_OVERLAY_TEXTURE];
+  texture_t *tex = planes ? load_layer_texture(handler, (uint8_t **)planes, handler->map_data->width, handler->map_data->height)
+                          : handler->renderer.default_texture;
+  // destruction is deferred until the frames using the old texture finished
+  if (old && old != handler->renderer.default_texture) renderer_destroy_texture(handler, old);
+  handler->map_textures[MAP_OVERLAY_TEXTURE] = tex;
+}
+
 void on_map_load_path(gfx_handler_t *handler, const char *map_path) {
   timeline_cleanup(&handler->user_interface.timeline);
   timeline_init(&handler->user_interface);
@@ -1153,7 +1169,8 @@ static void frame_render(gfx_handler_t *handler, ImDrawData *draw_data) {
 
       map_buffer_object_t ubo = {.transform = {handler->renderer.camera.pos[0], handler->renderer.camera.pos[1], zoom},
                                  .aspect = aspect,
-                                 .lod_bias = handler->renderer.lod_bias};
+                                 .lod_bias = handler->renderer.lod_bias,
+                                 .overlay_alpha = handler->map_overlay_alpha};
 
       void *ubos[] = {&ubo};
       VkDeviceSize ubo_sizes[] = {sizeof(ubo)};
@@ -28,9 +28,14 @@ enum { FRAME_OK = 0,
        FRAME_SKIP,
        FRAME_EXIT };
 
+#define MAP_OVERLAY_TEXTURE 4 // map_textures slot after the entities and the three layer textures
+
 // public api
 void on_map_load_mem(gfx_handler_t *handler, const unsigned char *map_buffer, size_t size);
 void on_map_load_path(gfx_handler_t *handler, const char *map_path);
+// replaces the per tile overlay drawn over the map, planes are width * height bytes like the layer
+// textures (r = value, g = mask), NULL clears it
+void gfx_set_map_overlay(gfx_handler_t *handler, const uint8_t **planes);
 int init_gfx_handler(gfx_handler_t *handler);
 int gfx_begin_frame(gfx_handler_t *handler);
 bool gfx_end_frame(gfx_handler_t *handler);
@@ -85,6 +90,7 @@ struct gfx_handler_t {
   // TODO: this should be 2
   texture_t *map_textures[MAX_TEXTURES_PER_DRAW];
   uint32_t map_texture_count;
+  float map_overlay_alpha; // 0 hides the overlay texture
 
   // retirement list for delayed frees
   struct {
@@ -25,6 +25,7 @@ static const char *LOG_SOURCE = "Renderer";
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <system/profiler.h>
 
 #define DYNAMIC_UBO_BUFFER_SIZE (16 * 1024 * 1024) // 16 MB
 
@@ -1763,7 +1764,10 @@ void renderer_draw_map(gfx_handler_t *h) {
   float aspect = 1.0f / (window_ratio / map_ratio);
 
   map_buffer_object_t ubo = {
-      .transform = {h->renderer.camera.pos[0], h->renderer.camera.pos[1], zoom}, .aspect = aspect, .lod_bias = h->renderer.lod_bias};
+      .transform = {h->renderer.camera.pos[0], h->renderer.camera.pos[1], zoom},
+      .aspect = aspect,
+      .lod_bias = h->renderer.lod_bias,
+      .overlay_alpha = h->map_overlay_alpha};
 
   void *ubos[] = {&ubo};
   VkDeviceSize ubo_sizes[] = {sizeof(ubo)};
@@ -1876,30 +1880,33 @@ void renderer_flush_skins(gfx_handler_t *h, VkCommandBuffer cmd, texture_t *skin
   sr->instance_count = 0;
 }
 
-int renderer_load_skin_from_memory(gfx_handler_t *h, const unsigned char *buffer, size_t size, texture_t **out_preview_texture) {
+#define SKIN_PREVIEW_WIDTH 128
+#define SKIN_PREVIEW_HEIGHT 64
+#define SKIN_FINAL_SIZE 512
+
+// CPU half of skin loading: decode, repack into the atlas layout and compute the grayscale weight.
+// Touches no renderer state, so skins can be decoded on worker threads and uploaded afterwards.
+bool renderer_decode_skin(const unsigned char *buffer, size_t size, bool want_preview, decoded_skin_t *out) {
+  memset(out, 0, sizeof(decoded_skin_t));
   int tex_width, tex_height, channels;
   stbi_uc *pixels = stbi_load_from_memory(buffer, (int)size, &tex_width, &tex_height, &channels, STBI_rgb_alpha);
-  if (out_preview_texture) *out_preview_texture = NULL;
   if (!pixels) {
     log_error(LOG_SOURCE, "Failed to load skin from memory buffer.");
-    return -1;
+    return false;
   }
 
   if (tex_width <= 0 || tex_height <= 0 || tex_width % 256 != 0 || tex_height % 128 != 0) {
     log_error(LOG_SOURCE, "Skin from memory has invalid dimensions (%dx%d), must be a multiple of 256x128", tex_width, tex_height);
     stbi_image_free(pixels);
-    return -1;
+    return false;
   }
 
-  // create a smaller separate preview texture for the skin browser
-  if (out_preview_texture) {
-    int preview_width = 128;
-    int preview_height = 64;
-    unsigned char *resized_preview_pixels = malloc(preview_width * preview_height * 4);
-    if (resized_preview_pixels) {
-      stbir_resize_uint8_linear(pixels, tex_width, tex_height, 0, resized_preview_pixels, preview_width, preview_height, 0, STBIR_RGBA);
-      *out_preview_texture = renderer_create_texture_from_rgba(h, resized_preview_pixels, preview_width, preview_height);
-      free(resized_preview_pixels);
+  // create a smaller separate preview image for the skin browser
+  if (want_preview) {
+    out->preview_pixels = malloc(SKIN_PREVIEW_WIDTH * SKIN_PREVIEW_HEIGHT * 4);
+    if (out->preview_pixels) {
+      stbir_resize_uint8_linear(pixels, tex_width, tex_height, 0, out->preview_pixels, SKIN_PREVIEW_WIDTH, SKIN_PREVIEW_HEIGHT, 0,
+                                STBIR_RGBA);
     } else {
       log_error(LOG_SOURCE, "Failed to allocate memory for skin preview resize.");
     }
@@ -1915,16 +1922,15 @@ int renderer_load_skin_from_memory(gfx_handler_t *h, const unsigned char *buffer
     pixels[idx + 2] = (uint8_t)((int)pixels[idx + 2] * a / 255);
   }
 
-  const int final_width = 512;
-  const int final_height = 512;
+  const int final_width = SKIN_FINAL_SIZE;
+  const int final_height = SKIN_FINAL_SIZE;
   stbi_uc *repacked_pixels = calloc(1, final_width * final_height * 4);
   if (!repacked_pixels) {
     stbi_image_free(pixels);
-    return -1;
+    renderer_free_decoded_skin(out);
+    return false;
   }
 
-  memset(repacked_pixels, 0, final_width * final_height * 4);
-
   int scale = tex_width / 256;
 
 #define COPY_PART(src_x, src_y, w, h, dst_x, dst_y)                                                                                \
@@ -1951,19 +1957,6 @@ int renderer_load_skin_from_memory(gfx_handler_t *h, const unsigned char *buffer
     }
   }
 
-  renderer_state_t *r = &h->renderer;
-  int layer = skin_manager_alloc_layer(r);
-  if (layer < 0) {
-    log_error(LOG_SOURCE, "No free skin layers available (max %d reached).", MAX_SKINS);
-    if (out_preview_texture && *out_preview_texture) {
-      renderer_destroy_texture(h, *out_preview_texture);
-      *out_preview_texture = NULL;
-    }
-    free(repacked_pixels);
-    stbi_image_free(pixels);
-    return -1;
-  }
-
   // do ddnet grayscale retard logic
   // Note: this is done on the original 'pixels' for best quality before resize
   uint32_t freq[256] = {0};
@@ -1983,9 +1976,47 @@ int renderer_load_skin_from_memory(gfx_handler_t *h, const unsigned char *buffer
   for (int i = 1; i < 256; ++i) {
     if (freq[org_weight] < freq[i]) org_weight = (uint8_t)i;
   }
-  r->skin_manager.atlas_array[layer].gs_org = org_weight;
+  stbi_image_free(pixels);
+
+  out->pixels = repacked_pixels;
+  out->gs_org = org_weight;
+  return true;
+}
+
+void renderer_free_decoded_skin(decoded_skin_t *skin) {
+  free(skin->pixels);
+  free(skin->preview_pixels);
+  skin->pixels = NULL;
+  skin->preview_pixels = NULL;
+}
+
+// GPU half of skin loading, must run on the main thread. Consumes the decoded pixels.
+int renderer_upload_decoded_skin(gfx_handler_t *h, decoded_skin_t *skin, texture_t **out_preview_texture) {
+  if (out_preview_texture) *out_preview_texture = NULL;
+  if (!skin->pixels) {
+    renderer_free_decoded_skin(skin);
+    return -1;
+  }
+
+  if (out_preview_texture && skin->preview_pixels)
+    *out_preview_texture = renderer_create_texture_from_rgba(h, skin->preview_pixels, SKIN_PREVIEW_WIDTH, SKIN_PREVIEW_HEIGHT);
+
+  renderer_state_t *r = &h->renderer;
+  int layer = skin_manager_alloc_layer(r);
+  if (layer < 0) {
+    log_error(LOG_SOURCE, "No free skin layers available (max %d reached).", MAX_SKINS);
+    if (out_preview_texture && *out_preview_texture) {
+      renderer_destroy_texture(h, *out_preview_texture);
+      *out_preview_texture = NULL;
+    }
+    renderer_free_decoded_skin(skin);
+    return -1;
+  }
+  r->skin_manager.atlas_array[layer].gs_org = skin->gs_org;
 
   // Upload to Vulkan
+  const int final_width = SKIN_FINAL_SIZE;
+  const int final_height = SKIN_FINAL_SIZE;
   VkDeviceSize image_size = final_width * final_height * 4;
   buffer_t staging;
   create_buffer(h, image_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
@@ -1993,10 +2024,9 @@ int renderer_load_skin_from_memory(gfx_handler_t *h, const unsigned char *buffer
 
   void *data;
   vkMapMemory(h->g_device, staging.memory, 0, image_size, 0, &data);
-  memcpy(data, repacked_pixels, image_size);
+  memcpy(data, skin->pixels, image_size);
   vkUnmapMemory(h->g_device, staging.memory);
-  free(repacked_pixels);
-  stbi_image_free(pixels);
+  renderer_free_decoded_skin(skin);
 
   transition_image_layout(h, r->transfer_command_pool, r->skin_manager.atlas_array->image, VK_FORMAT_R8G8B8A8_UNORM,
                           VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
@@ -2023,6 +2053,15 @@ int renderer_load_skin_from_memory(gfx_handler_t *h, const unsigned char *buffer
   return layer;
 }
 
+int renderer_load_skin_from_memory(gfx_handler_t *h, const unsigned char *buffer, size_t size, texture_t **out_preview_texture) {
+  decoded_skin_t skin;
+  if (!renderer_decode_skin(buffer, size, out_preview_texture != NULL, &skin)) {
+    if (out_preview_texture) *out_preview_texture = NULL;
+    return -1;
+  }
+  return renderer_upload_decoded_skin(h, &skin, out_preview_texture);
+}
+
 int renderer_load_skin_from_file(gfx_handler_t *h, const char *path, texture_t **out_preview_texture) {
   FILE *f = fopen(path, "rb");
   if (!f) {
@@ -2452,6 +2491,7 @@ void renderer_submit_atlas_batch(struct gfx_handler_t *h, struct atlas_renderer_
 void renderer_flush_queue(struct gfx_handler_t *h, VkCommandBuffer cmd) {
   struct renderer_state_t *r = &h->renderer;
   if (r->queue.count == 0) return;
+  PROFILE_BEGIN("renderer_flush_queue");
 
   // Sort by Z-order
   qsort(r->queue.commands, r->queue.count, sizeof(render_command_t), compare_render_commands);
@@ -2590,4 +2630,5 @@ void renderer_flush_queue(struct gfx_handler_t *h, VkCommandBuffer cmd) {
   }
 
   r->queue.count = 0;
+  PROFILE_END();
 }
@@ -106,6 +106,7 @@ struct map_buffer_object_t {
   vec3 transform; // x, y, zoom
   float aspect;
   float lod_bias;
+  float overlay_alpha;
 };
 
 struct pipeline_cache_entry_t {
@@ -151,6 +152,13 @@ struct skin_renderer_t {
   uint32_t instance_count;
 };
 
+// CPU-side result of renderer_decode_skin, waiting to be uploaded
+struct decoded_skin_t {
+  unsigned char *pixels;         // 512x512 RGBA in atlas layout
+  unsigned char *preview_pixels; // 128x64 RGBA, NULL if no preview was requested
+  uint8_t gs_org;
+};
+
 #define MAX_SKINS 128
 struct skin_atlas_manager_t {
   texture_t *atlas_array; // giant 2D array texture for all skins
@@ -318,6 +326,9 @@ void renderer_push_skin_instance(gfx_handler_t *h, vec2 pos, float scale, int sk
 void renderer_flush_skins(gfx_handler_t *h, VkCommandBuffer cmd, texture_t *skin_array);
 int renderer_load_skin_from_file(gfx_handler_t *h, const char *path, texture_t **out_preview_texture);
 int renderer_load_skin_from_memory(gfx_handler_t *h, const unsigned char *buffer, size_t size, texture_t **out_preview_texture);
+bool renderer_decode_skin(const unsigned char *buffer, size_t size, bool want_preview, decoded_skin_t *out);
+int renderer_upload_decoded_skin(gfx_handler_t *h, decoded_skin_t *skin, texture_t **out_preview_texture);
+void renderer_free_decoded_skin(decoded_skin_t *skin);
 void renderer_unload_skin(gfx_handler_t *h, int layer);
 
 void create_image(gfx_handler_t *handler, uint32_t width, uint32_t height, uint32_t mip_levels, uint32_t array_layers, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage *image, VkDeviceMemory *image_memory);
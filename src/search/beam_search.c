@@ -0,0 +1,286 @@
+#include "beam_search.h"
+#include <logger/logger.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <user_interface/timeline/timeline_commands.h>
+
+static const char *LOG_SOURCE = "BeamSearch";
+
+static uint32_t hash_u32(uint32_t x) {
+  x ^= x >> 16;
+  x *= 0x7feb352du;
+  x ^= x >> 15;
+  x *= 0x846ca68bu;
+  x ^= x >> 16;
+  return x;
+}
+
+static float score_state(const beam_search_t *bs, SWorldCore *world) {
+  const SCharacterCore *core = &world->m_pCharacters[bs->ctx.character];
+  if (bs->objective.avoid_freeze && search_is_frozen(core)) return INFINITY;
+  if (search_is_reached(&bs->objective, world, bs->ctx.character)) return BEAM_SEARCH_REACHED_SCORE;
+
+  float distance = search_distance(&bs->objective, core) / 32.0f;
+  if (bs->config.heuristic == BEAM_HEURISTIC_DISTANCE) return distance;
+
+  // speed toward the target, distance only separates equally fast states
+  float dx = vgetx(bs->objective.target) - vgetx(core->m_Pos), dy = vgety(bs->objective.target) - vgety(core->m_Pos);
+  float length = sqrtf(dx * dx + dy * dy);
+  if (length < 1.0f) return distance;
+  float toward = (vgetx(core->m_Vel) * dx + vgety(core->m_Vel) * dy) / length;
+  return -toward + distance * 0.01f;
+}
+
+// Expansion
+
+static void expand_job(void *user_data, int begin, int end) {
+  beam_search_t *bs = user_data;
+  const int samples = bs->config.samples, width = bs->config.width, tick = bs->tick;
+  SWorldCore scratch = wc_empty();
+  long long nodes = 0;
+
+  for (int i = begin; i < end; ++i) {
+    int *choices = &bs->child_choices[i * samples];
+    float *scores = &bs->child_scores[i * samples];
+    uint64_t *keys = &bs->child_keys[i * samples];
+    int previous = tick > 0 ? bs->steps[(tick - 1) * width + i].choice : -1;
+
+    for (int k = 0; k < samples; ++k) {
+      if (k == 0 && previous >= 0) choices[k] = previous;
+      else choices[k] = (int)(hash_u32(bs->config.seed ^ hash_u32((uint32_t)(tick * width + i) * BEAM_SEARCH_MAX_SAMPLES + k)) % (uint32_t)bs->choice_count);
+
+      bool duplicate = false;
+      for (int j = 0; j < k && !duplicate; ++j)
+        duplicate = choices[j] == choices[k];
+      if (duplicate) {
+        scores[k] = INFINITY;
+        continue;
+      }
+
+      wc_copy_world(&scratch, &bs->beam[i]);
+      SPlayerInput input = search_space_decode(&bs->space, choices[k]);
+      search_context_step(&bs->ctx, &scratch, tick, &input);
+      scores[k] = score_state(bs, &scratch);
+      if (bs->table) keys[k] = search_state_key(&bs->ctx, &scratch, tick + 1);
+      ++nodes;
+    }
+  }
+  wc_free(&scratch);
+
+  thread_mutex_lock(bs->lock);
+  bs->nodes += nodes;
+  thread_mutex_unlock(bs->lock);
+}
+
+static void advance_job(void *user_data, int begin, int end) {
+  beam_search_t *bs = user_data;
+  const int samples = bs->config.samples, width = bs->config.width, tick = bs->tick;
+  for (int i = begin; i < end; ++i) {
+    int child = bs->candidates[i].child;
+    beam_step_t *step = &bs->steps[tick * width + i];
+    step->parent = child / samples;
+    step->choice = bs->child_choices[child];
+
+    wc_copy_world(&bs->next_beam[i], &bs->beam[step->parent]);
+    SPlayerInput input = search_space_decode(&bs->space, step->choice);
+    search_context_step(&bs->ctx, &bs->next_beam[i], tick, &input);
+  }
+}
+
+static int compare_candidates(const void *a, const void *b) {
+  const beam_candidate_t *ca = a, *cb = b;
+  if (ca->score != cb->score) return ca->score < cb->score ? -1 : 1;
+  return ca->child - cb->child;
+}
+
+// runs on the driver thread instead when the pool has no room for another job
+static void run_parallel(beam_search_t *bs, int count, job_func_t func) {
+  job_handle_t job = thread_pool_parallel_for(bs->pool, count, 0, func, bs);
+  if (job == JOB_HANDLE_INVALID) func(bs, 0, count);
+  else thread_pool_wait(bs->pool, job);
+}
+
+static void driver_job(void *user_data, int begin, int end) {
+  beam_search_t *bs = user_data;
+  for (int tick = 0; tick < bs->ctx.ticks; ++tick) {
+    thread_mutex_lock(bs->lock);
+    bs->tick = tick;
+    bool cancelled = bs->cancelled;
+    thread_mutex_unlock(bs->lock);
+    if (cancelled) break;
+
+    run_parallel(bs, bs->beam_size, expand_job);
+
+    // drops children equal to a lower child of this tick. Probed in child order here, probing from the
+    // expansion threads would let scheduling pick which of the equal states survives.
+    int count = 0;
+    for (int c = 0; c < bs->beam_size * bs->config.samples; ++c) {
+      float score = bs->child_scores[c];
+      if (!isfinite(score)) continue;
+      if (bs->table && score != BEAM_SEARCH_REACHED_SCORE && transposition_visit(bs->table, bs->child_keys[c], tick + 1, 0)) continue;
+      bs->candidates[count++] = (beam_candidate_t){score, c};
+    }
+    if (count == 0) break; // every child froze, keep the previous tick as the result
+    qsort(bs->candidates, count, sizeof(beam_candidate_t), compare_candidates);
+
+    bool reached = bs->candidates[0].score == BEAM_SEARCH_REACHED_SCORE;
+    int keep = reached ? 1 : imin(count, bs->config.width);
+    run_parallel(bs, keep, advance_job);
+
+    SWorldCore *swap = bs->beam;
+    bs->beam = bs->next_beam;
+    bs->next_beam = swap;
+    bs->beam_size = keep;
+
+    thread_mutex_lock(bs->lock);
+    bs->best_score = bs->candidates[0].score;
+    bs->best_length = tick + 1;
+    bs->reached = reached;
+    thread_mutex_unlock(bs->lock);
+    if (reached) break;
+  }
+}
+
+// Lifecycle
+
+static void free_buffers(beam_search_t *bs) {
+  for (int i = 0; bs->beam && i < bs->config.width; ++i) {
+    wc_free(&bs->beam[i]);
+    wc_free(&bs->next_beam[i]);
+  }
+  free(bs->beam);
+  free(bs->next_beam);
+  free(bs->child_scores);
+  free(bs->child_choices);
+  free(bs->child_keys);
+  free(bs->candidates);
+  free(bs->steps);
+  bs->beam = bs->next_beam = NULL;
+  bs->child_scores = NULL;
+  bs->child_choices = NULL;
+  bs->child_keys = NULL;
+  bs->candidates = NULL;
+  bs->steps = NULL;
+  search_context_free(&bs->ctx);
+}
+
+bool beam_search_start(beam_search_t *bs, thread_pool_t *pool, transposition_table_t *table, timeline_state_t *ts, int track_index,
+                       int start_tick, int ticks, const search_space_t *space, const search_objective_t *objective,
+                       const beam_search_config_t *config) {
+  if (bs->running) return false;
+  if (ticks <= 0 || ticks > BEAM_SEARCH_MAX_TICKS) {
+    log_error(LOG_SOURCE, "Window must be between 1 and %d ticks.", BEAM_SEARCH_MAX_TICKS);
+    return false;
+  }
+  if (!bs->lock) bs->lock = thread_mutex_create();
+  if (!bs->lock) return false;
+
+  free_buffers(bs);
+  bs->config = *config;
+  bs->config.width = imax(imin(config->width, BEAM_SEARCH_MAX_WIDTH), 1);
+  bs->config.samples = imax(imin(config->samples, BEAM_SEARCH_MAX_SAMPLES), 1);
+  if (!search_context_init(&bs->ctx, ts, track_index, start_tick, ticks)) {
+    log_error(LOG_SOURCE, "Could not prepare the world at tick %d.", start_tick);
+    return false;
+  }
+
+  const int width = bs->config.width, children = width * bs->config.samples;
+  bs->beam = malloc(width * sizeof(SWorldCore));
+  bs->next_beam = malloc(width * sizeof(SWorldCore));
+  bs->child_scores = malloc(children * sizeof(float));
+  bs->child_choices = malloc(children * sizeof(int));
+  bs->child_keys = malloc(children * sizeof(uint64_t));
+  bs->candidates = malloc(children * sizeof(beam_candidate_t));
+  bs->steps = malloc((size_t)ticks * width * sizeof(beam_step_t));
+  if (!bs->beam || !bs->next_beam || !bs->child_scores || !bs->child_choices || !bs->child_keys || !bs->candidates || !bs->steps) {
+    log_error(LOG_SOURCE, "Out of memory for a beam of %d states over %d ticks.", width, ticks);
+    free(bs->beam);
+    free(bs->next_beam);
+    bs->beam = bs->next_beam = NULL;
+    free_buffers(bs);
+    return false;
+  }
+  for (int i = 0; i < width; ++i) {
+    bs->beam[i] = wc_empty();
+    bs->next_beam[i] = wc_empty();
+  }
+  wc_copy_world(&bs->beam[0], &bs->ctx.start);
+  bs->beam_size = 1;
+
+  bs->space = *space;
+  bs->objective = *objective;
+  bs->pool = pool;
+  bs->table = table;
+  if (table) transposition_clear(table);
+  bs->choice_count = search_space_choice_count(space);
+  bs->tick = 0;
+  bs->nodes = 0;
+  bs->best_score = INFINITY;
+  bs->best_length = 0;
+  bs->reached = false;
+  bs->cancelled = false;
+
+  bs->job = thread_pool_submit(pool, driver_job, bs);
+  if (bs->job == JOB_HANDLE_INVALID) {
+    free_buffers(bs);
+    return false;
+  }
+  bs->running = true;
+  log_info(LOG_SOURCE, "Searching %d ticks with a beam of %d states and %d samples each.", ticks, width, bs->config.samples);
+  return true;
+}
+
+bool beam_search_poll(beam_search_t *bs) {
+  if (!bs->running) return false;
+  if (!thread_pool_is_done(bs->pool, bs->job)) return true;
+  thread_pool_wait(bs->pool, bs->job);
+  bs->running = false;
+
+  if (bs->reached) log_info(LOG_SOURCE, "Objective reached after %d ticks (%lld ticks simulated).", bs->best_length, bs->nodes);
+  else if (bs->best_length == 0) log_warn(LOG_SOURCE, "Every sequence ended up frozen on the first tick.");
+  else log_info(LOG_SOURCE, "Objective not reached, best score %.2f after %d ticks.", bs->best_score, bs->best_length);
+  return false;
+}
+
+void beam_search_cancel(beam_search_t *bs) {
+  if (!bs->running) return;
+  thread_mutex_lock(bs->lock);
+  bs->cancelled = true;
+  thread_mutex_unlock(bs->lock);
+}
+
+float beam_search_progress(beam_search_t *bs) {
+  if (!bs->lock || bs->ctx.ticks == 0) return 0.0f;
+  thread_mutex_lock(bs->lock);
+  float progress = (float)bs->best_length / (float)bs->ctx.ticks;
+  thread_mutex_unlock(bs->lock);
+  return progress;
+}
+
+bool beam_search_has_result(beam_search_t *bs) { return !bs->running && bs->best_length > 0; }
+
+// the best state always sits at index 0 of the last row, its parents lead back to the window start
+bool beam_search_apply(beam_search_t *bs, ui_handler_t *ui) {
+  if (!beam_search_has_result(bs)) return false;
+  InputWrite write = {bs->ctx.character, bs->ctx.start_tick, bs->best_length, malloc(bs->best_length * sizeof(SPlayerInput))};
+  if (!write.inputs) return false;
+  int entry = 0;
+  for (int t = bs->best_length - 1; t >= 0; --t) {
+    const beam_step_t *step = &bs->steps[t * bs->config.width + entry];
+    write.inputs[t] = search_space_decode(&bs->space, step->choice);
+    entry = step->parent;
+  }
+  return timeline_api_write_inputs(ui, &write, 1, "Beam search");
+}
+
+void beam_search_free(beam_search_t *bs) {
+  if (bs->running) {
+    beam_search_cancel(bs);
+    thread_pool_wait(bs->pool, bs->job);
+    bs->running = false;
+  }
+  free_buffers(bs);
+  thread_mutex_destroy(bs->lock);
+  memset(bs, 0, sizeof(beam_search_t));
+}
@@ -0,0 +1,78 @@
+#ifndef BEAM_SEARCH_H
+#define BEAM_SEARCH_H
+
+#include "search.h"
+#include "transposition.h"
+#include <system/thread_pool.h>
+#include <types.h>
+
+#define BEAM_SEARCH_MAX_TICKS 3000
+#define BEAM_SEARCH_MAX_WIDTH 4096
+#define BEAM_SEARCH_MAX_SAMPLES 64
+#define BEAM_SEARCH_REACHED_SCORE (-1e9f)
+
+typedef enum { BEAM_HEURISTIC_DISTANCE, BEAM_HEURISTIC_VELOCITY } beam_heuristic_t;
+
+struct beam_search_config_t {
+  int width;   // states kept after every tick
+  int samples; // children per state, the first one always repeats the parent's input
+  beam_heuristic_t heuristic;
+  uint32_t seed;
+};
+
+// one tick of one beam entry, enough to walk a sequence back from its last tick
+typedef struct {
+  int parent;
+  int choice;
+} beam_step_t;
+
+typedef struct {
+  float score;
+  int child;
+} beam_candidate_t;
+
+// Keeps the `width` best states and expands each of them with sampled inputs every tick.
+// A driver job owns the tick loop and spreads each expansion over the thread pool. Children are
+// only scored, the few that survive are simulated again from their parent so memory stays at two
+// beams of worlds. Scores are lower-is-better, reaching the objective ends the search on that tick.
+struct beam_search_t {
+  search_context_t ctx;
+  search_space_t space;
+  search_objective_t objective;
+  beam_search_config_t config;
+  thread_pool_t *pool;
+  transposition_table_t *table; // optional, owned by the caller
+  job_handle_t job;
+  int choice_count;
+  bool running;
+
+  SWorldCore *beam; // config.width states, double buffered with next_beam
+  SWorldCore *next_beam;
+  float *child_scores; // width * samples
+  int *child_choices;
+  uint64_t *child_keys; // transposition keys, probed by the driver in child order
+  beam_candidate_t *candidates;
+  beam_step_t *steps; // ticks rows of width entries
+  int beam_size;
+
+  thread_mutex_t *lock; // guards everything below
+  int tick;
+  long long nodes;
+  float best_score;
+  int best_length;
+  bool reached;
+  bool cancelled;
+};
+
+bool beam_search_start(beam_search_t *bs, thread_pool_t *pool, transposition_table_t *table, timeline_state_t *ts, int track_index,
+                       int start_tick, int ticks, const search_space_t *space, const search_objective_t *objective,
+                       const beam_search_config_t *config);
+// returns true while the search is still running, releases the job once it finished
+bool beam_search_poll(beam_search_t *bs);
+void beam_search_cancel(beam_search_t *bs);
+float beam_search_progress(beam_search_t *bs);
+bool beam_search_has_result(beam_search_t *bs);
+bool beam_search_apply(beam_search_t *bs, ui_handler_t *ui);
+void beam_search_free(beam_search_t *bs);
+
+#endif // BEAM_SEARCH_H
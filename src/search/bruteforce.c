@@ -0,0 +1,285 @@
+#include "bruteforce.h"
+#include <logger/logger.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <user_interface/timeline/timeline_commands.h>
+
+static const char *LOG_SOURCE = "Bruteforce";
+
+#define SYNC_INTERVAL 4096 // ticks simulated between two looks at the shared state
+#define MAX_PREFIXES (1 << 20)
+
+typedef struct {
+  bruteforce_t *bf;
+  SWorldCore worlds[BRUTEFORCE_MAX_TICKS + 1]; // worlds[d] is the state after d ticks
+  int prefix[BRUTEFORCE_MAX_TICKS];
+  int choices[BRUTEFORCE_MAX_TICKS];
+  int prefix_index; // rank of the subtree being walked, lower prefixes hold lexicographically smaller sequences
+  long long nodes;
+  float best; // cached copy of bf->best_score
+  bool stop;
+} bruteforce_worker_t;
+
+double bruteforce_candidate_count(const search_space_t *space, int ticks) {
+  return pow((double)search_space_choice_count(space), (double)ticks);
+}
+
+static void sync_worker(bruteforce_worker_t *w) {
+  bruteforce_t *bf = w->bf;
+  thread_mutex_lock(bf->lock);
+  bf->nodes += w->nodes;
+  w->nodes = 0;
+  w->best = bf->best_score;
+  w->stop = bf->cancelled;
+  thread_mutex_unlock(bf->lock);
+}
+
+// ties go to the lexicographically smaller sequence so the result does not depend on scheduling.
+// The transposition table only lets a state be skipped by a path of the same or a lower prefix, which
+// walked it earlier in that lexicographic order, so the smallest best sequence is never pruned away.
+static bool is_lexicographically_smaller(const int *a, const int *b, int length) {
+  for (int i = 0; i < length; ++i)
+    if (a[i] != b[i]) return a[i] < b[i];
+  return false;
+}
+
+// expects bf->lock to be held
+static void merge_locked(bruteforce_t *bf, const int *choices, int length, float score) {
+  bool better = score < bf->best_score;
+  if (!better && score == bf->best_score) better = bf->best_length == 0 || is_lexicographically_smaller(choices, bf->best_choices, length);
+  if (!better) return;
+  bf->best_score = score;
+  bf->best_length = length;
+  memcpy(bf->best_choices, choices, length * sizeof(int));
+}
+
+static void record(bruteforce_worker_t *w, int length, float score) {
+  if (score > w->best) return;
+  bruteforce_t *bf = w->bf;
+  thread_mutex_lock(bf->lock);
+  merge_locked(bf, w->choices, length, score);
+  w->best = bf->best_score;
+  thread_mutex_unlock(bf->lock);
+}
+
+void bruteforce_merge(bruteforce_t *bf, const int *choices, int length, float score, long long nodes) {
+  thread_mutex_lock(bf->lock);
+  bf->nodes += nodes;
+  if (length > 0 && length <= BRUTEFORCE_MAX_TICKS) merge_locked(bf, choices, length, score);
+  thread_mutex_unlock(bf->lock);
+}
+
+static void search_subtree(bruteforce_worker_t *w, int depth) {
+  bruteforce_t *bf = w->bf;
+  const int ticks = bf->ctx.ticks, character = bf->ctx.character;
+  int first = 0, last = bf->choice_count;
+  if (depth < bf->prefix_depth) {
+    first = w->prefix[depth];
+    last = first + 1;
+  }
+
+  for (int c = first; c < last && !w->stop; ++c) {
+    SWorldCore *world = &w->worlds[depth + 1];
+    wc_copy_world(world, &w->worlds[depth]);
+    SPlayerInput input = search_space_decode(&bf->space, c);
+    search_context_step(&bf->ctx, world, depth, &input);
+    w->choices[depth] = c;
+    if (++w->nodes >= SYNC_INTERVAL) sync_worker(w);
+
+    SCharacterCore *core = &world->m_pCharacters[character];
+    if (bf->objective.avoid_freeze && search_is_frozen(core)) continue;
+    if (search_is_reached(&bf->objective, world, character)) {
+      record(w, depth + 1, (float)(depth + 1));
+      break; // later siblings can at best tie and lose the tie break
+    }
+    if (depth + 1 == ticks) {
+      record(w, ticks, (float)ticks + search_distance(&bf->objective, core) / 32.0f);
+      continue;
+    }
+    // nothing below can reach the objective sooner than the best known sequence
+    if ((float)(depth + 2) > w->best) continue;
+    if (bf->table && transposition_visit(bf->table, search_state_key(&bf->ctx, world, depth + 1), depth + 1, w->prefix_index)) continue;
+    search_subtree(w, depth + 1);
+  }
+}
+
+static void bruteforce_job(void *user_data, int begin, int end) {
+  bruteforce_t *bf = user_data;
+  bruteforce_worker_t *w = malloc(sizeof(bruteforce_worker_t));
+  if (!w) {
+    // the prefixes of this task go unsearched, so the result can't be trusted
+    thread_mutex_lock(bf->lock);
+    bf->failed = true;
+    thread_mutex_unlock(bf->lock);
+    return;
+  }
+  w->bf = bf;
+  w->nodes = 0;
+  for (int d = 0; d <= bf->ctx.ticks; ++d)
+    w->worlds[d] = wc_empty();
+  wc_copy_world(&w->worlds[0], &bf->ctx.start);
+  sync_worker(w);
+
+  for (int i = begin; i < end && !w->stop; ++i) {
+    int index = bf->prefix_offset + i;
+    w->prefix_index = index;
+    for (int d = bf->prefix_depth - 1; d >= 0; --d) {
+      w->prefix[d] = index % bf->choice_count;
+      index /= bf->choice_count;
+    }
+    search_subtree(w, 0);
+  }
+
+  sync_worker(w);
+  for (int d = 0; d <= bf->ctx.ticks; ++d)
+    wc_free(&w->worlds[d]);
+  free(w);
+}
+
+static void reset(bruteforce_t *bf) {
+  search_context_free(&bf->ctx);
+  bf->nodes = 0;
+  bf->best_score = INFINITY;
+  bf->best_length = 0;
+  bf->cancelled = false;
+  bf->failed = false;
+}
+
+bool bruteforce_prepare(bruteforce_t *bf, transposition_table_t *table, search_context_t *ctx, const search_space_t *space,
+                        const search_objective_t *objective) {
+  if (bf->running) return false;
+  if (!bf->lock) bf->lock = thread_mutex_create();
+  if (!bf->lock) return false;
+
+  reset(bf);
+  bf->ctx = *ctx;
+  memset(ctx, 0, sizeof(search_context_t));
+  if (objective->avoid_freeze && search_is_frozen(&bf->ctx.start.m_pCharacters[bf->ctx.character]))
+    log_warn(LOG_SOURCE, "The character is frozen at the start of the window, no sequence can avoid freeze.");
+
+  bf->space = *space;
+  bf->objective = *objective;
+  bf->table = table;
+  if (table) transposition_clear(table);
+  bf->choice_count = search_space_choice_count(space);
+  return true;
+}
+
+// enough prefixes to keep every thread busy while the subtrees vary in size
+int bruteforce_split(bruteforce_t *bf, int parallelism) {
+  int prefixes = 1;
+  bf->prefix_depth = 0;
+  while (bf->prefix_depth < bf->ctx.ticks && prefixes < parallelism * 16 && prefixes * bf->choice_count <= MAX_PREFIXES) {
+    prefixes *= bf->choice_count;
+    ++bf->prefix_depth;
+  }
+  return prefixes;
+}
+
+bool bruteforce_launch(bruteforce_t *bf, thread_pool_t *pool, int first_prefix, int count, float bound) {
+  if (bf->running) return false;
+  bf->pool = pool;
+  bf->prefix_offset = first_prefix;
+  thread_mutex_lock(bf->lock);
+  bf->best_score = bound;
+  bf->best_length = 0;
+  bf->cancelled = false;
+  bf->failed = false;
+  thread_mutex_unlock(bf->lock);
+
+  bf->job = thread_pool_parallel_for(pool, count, 1, bruteforce_job, bf);
+  if (bf->job == JOB_HANDLE_INVALID) return false;
+  bf->running = true;
+  return true;
+}
+
+void bruteforce_wait(bruteforce_t *bf) {
+  if (!bf->running) return;
+  thread_pool_wait(bf->pool, bf->job);
+  bf->running = false;
+}
+
+bool bruteforce_validate(const search_space_t *space, int ticks) {
+  if (ticks <= 0 || ticks > BRUTEFORCE_MAX_TICKS) {
+    log_error(LOG_SOURCE, "Window must be between 1 and %d ticks.", BRUTEFORCE_MAX_TICKS);
+    return false;
+  }
+  double candidates = bruteforce_candidate_count(space, ticks);
+  if (candidates > BRUTEFORCE_MAX_CANDIDATES) {
+    log_error(LOG_SOURCE, "%.3g candidates is too many, shrink the window or the search space.", candidates);
+    return false;
+  }
+  return true;
+}
+
+bool bruteforce_start(bruteforce_t *bf, thread_pool_t *pool, transposition_table_t *table, timeline_state_t *ts, int track_index,
+                      int start_tick, int ticks, const search_space_t *space, const search_objective_t *objective) {
+  if (bf->running || !bruteforce_validate(space, ticks)) return false;
+
+  search_context_t ctx;
+  if (!search_context_init(&ctx, ts, track_index, start_tick, ticks)) {
+    log_error(LOG_SOURCE, "Could not prepare the world at tick %d.", start_tick);
+    return false;
+  }
+  if (!bruteforce_prepare(bf, table, &ctx, space, objective)) {
+    search_context_free(&ctx);
+    return false;
+  }
+
+  int prefixes = bruteforce_split(bf, pool->worker_count + 1);
+  if (!bruteforce_launch(bf, pool, 0, prefixes, INFINITY)) {
+    search_context_free(&bf->ctx);
+    return false;
+  }
+  log_info(LOG_SOURCE, "Searching %.3g candidates over %d ticks (%d choices per tick).", bruteforce_candidate_count(space, ticks), ticks,
+           bf->choice_count);
+  return true;
+}
+
+bool bruteforce_poll(bruteforce_t *bf) {
+  if (!bf->running) return false;
+  if (!thread_pool_is_done(bf->pool, bf->job)) return true;
+  thread_pool_wait(bf->pool, bf->job);
+  bf->running = false;
+  bruteforce_log_result(bf);
+  return false;
+}
+
+void bruteforce_log_result(bruteforce_t *bf) {
+  if (bf->failed) log_error(LOG_SOURCE, "Ran out of memory, part of the search space was skipped (%lld ticks simulated).", bf->nodes);
+  else if (bf->cancelled) log_info(LOG_SOURCE, "Cancelled after %lld ticks simulated.", bf->nodes);
+  else if (!bruteforce_has_result(bf)) log_warn(LOG_SOURCE, "Every sequence ended up frozen (%lld ticks simulated).", bf->nodes);
+  else if (bf->best_score <= (float)bf->ctx.ticks)
+    log_info(LOG_SOURCE, "Objective reached after %d ticks (%lld ticks simulated).", bf->best_length, bf->nodes);
+  else log_info(LOG_SOURCE, "Objective not reached, closest miss is %.2f tiles away.", bf->best_score - (float)bf->ctx.ticks);
+}
+
+void bruteforce_cancel(bruteforce_t *bf) {
+  if (!bf->running) return;
+  thread_mutex_lock(bf->lock);
+  bf->cancelled = true;
+  thread_mutex_unlock(bf->lock);
+  thread_pool_cancel(bf->pool, bf->job);
+}
+
+bool bruteforce_has_result(bruteforce_t *bf) { return !bf->running && !bf->failed && bf->best_length > 0; }
+
+bool bruteforce_apply(bruteforce_t *bf, ui_handler_t *ui) {
+  if (!bruteforce_has_result(bf)) return false;
+  InputWrite write = {bf->ctx.character, bf->ctx.start_tick, bf->best_length, malloc(bf->best_length * sizeof(SPlayerInput))};
+  if (!write.inputs) return false;
+  for (int t = 0; t < bf->best_length; ++t)
+    write.inputs[t] = search_space_decode(&bf->space, bf->best_choices[t]);
+  return timeline_api_write_inputs(ui, &write, 1, "Bruteforce");
+}
+
+void bruteforce_free(bruteforce_t *bf) {
+  if (bf->running) {
+    bruteforce_cancel(bf);
+    bruteforce_wait(bf);
+  }
+  search_context_free(&bf->ctx);
+  thread_mutex_destroy(bf->lock);
+  memset(bf, 0, sizeof(bruteforce_t));
+}
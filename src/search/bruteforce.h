@@ -0,0 +1,62 @@
+#ifndef BRUTEFORCE_H
+#define BRUTEFORCE_H
+
+#include "search.h"
+#include "transposition.h"
+#include <system/thread_pool.h>
+#include <types.h>
+
+#define BRUTEFORCE_MAX_TICKS 64
+#define BRUTEFORCE_MAX_CANDIDATES 1e12 // before pruning
+
+// Exhaustive depth first search over every input sequence of the window. The first tick choices
+// are split into prefixes that run as thread pool tasks, each task walks its subtree with one
+// reusable world per depth. Scores are lower-is-better: reaching the objective after t ticks
+// scores t, sequences that never reach it score ticks + remaining distance in tiles.
+struct bruteforce_t {
+  search_context_t ctx;
+  search_space_t space;
+  search_objective_t objective;
+  thread_pool_t *pool;
+  transposition_table_t *table; // optional, owned by the caller
+  job_handle_t job;
+  int choice_count;
+  int prefix_depth;
+  int prefix_offset; // prefix index of the launched job's first item
+  bool running;
+
+  thread_mutex_t *lock; // guards everything below, workers only take it every few thousand ticks
+  long long nodes;
+  float best_score;
+  int best_length;
+  int best_choices[BRUTEFORCE_MAX_TICKS];
+  bool cancelled;
+  bool failed; // a task couldn't run, its prefixes were never searched
+};
+
+double bruteforce_candidate_count(const search_space_t *space, int ticks);
+// logs why a window can't be searched
+bool bruteforce_validate(const search_space_t *space, int ticks);
+
+bool bruteforce_start(bruteforce_t *bf, thread_pool_t *pool, transposition_table_t *table, timeline_state_t *ts, int track_index,
+                      int start_tick, int ticks, const search_space_t *space, const search_objective_t *objective);
+// Building blocks of bruteforce_start, also used to run prefix batches for a remote coordinator.
+// prepare takes ownership of ctx, split returns the number of prefixes for `parallelism` threads.
+bool bruteforce_prepare(bruteforce_t *bf, transposition_table_t *table, search_context_t *ctx, const search_space_t *space,
+                        const search_objective_t *objective);
+int bruteforce_split(bruteforce_t *bf, int parallelism);
+// only sequences scoring at most `bound` are reported
+bool bruteforce_launch(bruteforce_t *bf, thread_pool_t *pool, int first_prefix, int count, float bound);
+void bruteforce_wait(bruteforce_t *bf);
+void bruteforce_merge(bruteforce_t *bf, const int *choices, int length, float score, long long nodes);
+
+// returns true while the search is still running, releases the job once it finished
+bool bruteforce_poll(bruteforce_t *bf);
+void bruteforce_log_result(bruteforce_t *bf);
+void bruteforce_cancel(bruteforce_t *bf);
+bool bruteforce_has_result(bruteforce_t *bf);
+// writes the best sequence onto the searched track as one undo step
+bool bruteforce_apply(bruteforce_t *bf, ui_handler_t *ui);
+void bruteforce_free(bruteforce_t *bf);
+
+#endif // BRUTEFORCE_H
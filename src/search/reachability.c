@@ -0,0 +1,264 @@
+#include "reachability.h"
+#include <logger/logger.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *LOG_SOURCE = "Reachability";
+
+static int tile_index(const reachability_t *rs, const SCharacterCore *core) {
+  int tx = (int)(vgetx(core->m_Pos) / 32.0f), ty = (int)(vgety(core->m_Pos) / 32.0f);
+  if (tx < 0 || ty < 0 || tx >= rs->width || ty >= rs->height) return -1;
+  return ty * rs->width + tx;
+}
+
+// Expansion
+
+static void expand_job(void *user_data, int begin, int end) {
+  reachability_t *rs = user_data;
+  const int choices = rs->choice_count, depth = rs->tick;
+  SWorldCore scratch = wc_empty();
+  long long nodes = 0;
+
+  for (int i = begin; i < end; ++i) {
+    for (int k = 0; k < choices; ++k) {
+      int child = i * choices + k;
+      wc_copy_world(&scratch, &rs->frontier[i]);
+      SPlayerInput input = search_space_decode(&rs->space, k);
+      search_context_step(&rs->ctx, &scratch, depth, &input);
+      ++nodes;
+
+      rs->child_keys[child] = search_quantized_key(&rs->ctx, &scratch, depth + 1, rs->config.position_bucket, rs->config.velocity_bucket);
+      const SCharacterCore *core = &scratch.m_pCharacters[rs->ctx.character];
+      rs->child_tiles[child] = tile_index(rs, core);
+      rs->child_expand[child] = rs->config.expand_frozen || !search_is_frozen(core);
+    }
+  }
+  wc_free(&scratch);
+
+  thread_mutex_lock(rs->lock);
+  rs->nodes += nodes;
+  thread_mutex_unlock(rs->lock);
+}
+
+static void advance_job(void *user_data, int begin, int end) {
+  reachability_t *rs = user_data;
+  for (int i = begin; i < end; ++i) {
+    int child = rs->survivors[i];
+    wc_copy_world(&rs->next_frontier[i], &rs->frontier[child / rs->choice_count]);
+    SPlayerInput input = search_space_decode(&rs->space, child % rs->choice_count);
+    search_context_step(&rs->ctx, &rs->next_frontier[i], rs->tick, &input);
+  }
+}
+
+static void publish(reachability_t *rs, int depth, int reached, bool truncated) {
+  thread_mutex_lock(rs->lock);
+  memcpy(rs->published, rs->earliest, (size_t)rs->width * rs->height * sizeof(uint16_t));
+  rs->depth = depth;
+  rs->reached_tiles = reached;
+  rs->truncated |= truncated;
+  rs->dirty = true;
+  thread_mutex_unlock(rs->lock);
+}
+
+// runs on the driver thread instead when the pool has no room for another job
+static void run_parallel(reachability_t *rs, int count, job_func_t func) {
+  job_handle_t job = thread_pool_parallel_for(rs->pool, count, 0, func, rs);
+  if (job == JOB_HANDLE_INVALID) func(rs, 0, count);
+  else thread_pool_wait(rs->pool, job);
+}
+
+static void driver_job(void *user_data, int begin, int end) {
+  reachability_t *rs = user_data;
+  int reached = 0;
+  int start_tile = tile_index(rs, &rs->frontier[0].m_pCharacters[rs->ctx.character]);
+  if (start_tile >= 0) {
+    rs->earliest[start_tile] = 1;
+    reached = 1;
+  }
+  publish(rs, 0, reached, false);
+
+  for (int depth = 0; depth < rs->ctx.ticks && rs->frontier_size > 0; ++depth) {
+    thread_mutex_lock(rs->lock);
+    bool cancelled = rs->cancelled;
+    thread_mutex_unlock(rs->lock);
+    if (cancelled) break;
+
+    rs->tick = depth;
+    run_parallel(rs, rs->frontier_size, expand_job);
+
+    // children are deduplicated and visited in (state, choice) order so the kept frontier does not
+    // depend on scheduling
+    int kept = 0;
+    bool truncated = false;
+    for (int c = 0; c < rs->frontier_size * rs->choice_count; ++c) {
+      if (transposition_visit(&rs->table, rs->child_keys[c], depth + 1, 0)) continue;
+      int tile = rs->child_tiles[c];
+      if (tile >= 0 && rs->earliest[tile] == 0) {
+        rs->earliest[tile] = (uint16_t)(depth + 2);
+        ++reached;
+      }
+      if (!rs->child_expand[c]) continue;
+      if (kept < rs->config.max_frontier) rs->survivors[kept++] = c;
+      else truncated = true;
+    }
+
+    run_parallel(rs, kept, advance_job);
+    SWorldCore *swap = rs->frontier;
+    rs->frontier = rs->next_frontier;
+    rs->next_frontier = swap;
+    rs->frontier_size = kept;
+    publish(rs, depth + 1, reached, truncated);
+  }
+}
+
+// Lifecycle
+
+static void free_buffers(reachability_t *rs) {
+  for (int i = 0; rs->frontier && i < rs->config.max_frontier; ++i) {
+    wc_free(&rs->frontier[i]);
+    wc_free(&rs->next_frontier[i]);
+  }
+  free(rs->frontier);
+  free(rs->next_frontier);
+  free(rs->child_tiles);
+  free(rs->child_expand);
+  free(rs->child_keys);
+  free(rs->survivors);
+  free(rs->earliest);
+  free(rs->published);
+  rs->frontier = rs->next_frontier = NULL;
+  rs->child_tiles = NULL;
+  rs->child_expand = NULL;
+  rs->child_keys = NULL;
+  rs->survivors = NULL;
+  rs->earliest = rs->published = NULL;
+  search_context_free(&rs->ctx);
+}
+
+bool reachability_start(reachability_t *rs, thread_pool_t *pool, timeline_state_t *ts, int track_index, int start_tick,
+                        const search_space_t *space, const reachability_config_t *config) {
+  if (rs->running) return false;
+  if (config->ticks <= 0 || config->ticks > REACHABILITY_MAX_TICKS) {
+    log_error(LOG_SOURCE, "Depth must be between 1 and %d ticks.", REACHABILITY_MAX_TICKS);
+    return false;
+  }
+  if (!rs->lock) rs->lock = thread_mutex_create();
+  if (!rs->lock) return false;
+
+  free_buffers(rs);
+  rs->config = *config;
+  rs->space = *space;
+  rs->choice_count = search_space_choice_count(space);
+  rs->config.max_frontier = imax(imin(config->max_frontier, REACHABILITY_MAX_FRONTIER), 1);
+  if (rs->config.max_frontier * rs->choice_count > REACHABILITY_MAX_CHILDREN) {
+    rs->config.max_frontier = imax(REACHABILITY_MAX_CHILDREN / rs->choice_count, 1);
+    log_warn(LOG_SOURCE, "Keeping at most %d states per tick with %d choices each.", rs->config.max_frontier, rs->choice_count);
+  }
+  if (rs->config.position_bucket < 1.0f) rs->config.position_bucket = 1.0f;
+  if (rs->config.velocity_bucket < 0.01f) rs->config.velocity_bucket = 0.01f;
+  if (!search_context_init(&rs->ctx, ts, track_index, start_tick, config->ticks)) {
+    log_error(LOG_SOURCE, "Could not prepare the world at tick %d.", start_tick);
+    return false;
+  }
+
+  if (!rs->table.entries && !transposition_init(&rs->table, imax(config->table_mb, 1), TRANSPOSITION_REPLACE_SHALLOW)) {
+    free_buffers(rs);
+    return false;
+  }
+  transposition_clear(&rs->table);
+
+  const int frontier = rs->config.max_frontier, children = frontier * rs->choice_count;
+  rs->width = rs->ctx.start.m_pCollision->m_MapData.width;
+  rs->height = rs->ctx.start.m_pCollision->m_MapData.height;
+  size_t tiles = (size_t)rs->width * rs->height;
+  rs->frontier = malloc(frontier * sizeof(SWorldCore));
+  rs->next_frontier = malloc(frontier * sizeof(SWorldCore));
+  rs->child_tiles = malloc(children * sizeof(int));
+  rs->child_expand = malloc(children);
+  rs->child_keys = malloc(children * sizeof(uint64_t));
+  rs->survivors = malloc(frontier * sizeof(int));
+  rs->earliest = calloc(tiles, sizeof(uint16_t));
+  rs->published = calloc(tiles, sizeof(uint16_t));
+  if (!rs->frontier || !rs->next_frontier || !rs->child_tiles || !rs->child_expand || !rs->child_keys || !rs->survivors || !rs->earliest || !rs->published) {
+    log_error(LOG_SOURCE, "Out of memory for a frontier of %d states.", frontier);
+    free(rs->frontier);
+    free(rs->next_frontier);
+    rs->frontier = rs->next_frontier = NULL;
+    free_buffers(rs);
+    return false;
+  }
+  for (int i = 0; i < frontier; ++i) {
+    rs->frontier[i] = wc_empty();
+    rs->next_frontier[i] = wc_empty();
+  }
+  wc_copy_world(&rs->frontier[0], &rs->ctx.start);
+  rs->frontier_size = 1;
+  transposition_visit(&rs->table,
+                      search_quantized_key(&rs->ctx, &rs->ctx.start, 0, rs->config.position_bucket, rs->config.velocity_bucket), 0, 0);
+
+  rs->pool = pool;
+  rs->tick = 0;
+  rs->depth = 0;
+  rs->nodes = 0;
+  rs->reached_tiles = 0;
+  rs->truncated = false;
+  rs->dirty = false;
+  rs->cancelled = false;
+
+  rs->job = thread_pool_submit(pool, driver_job, rs);
+  if (rs->job == JOB_HANDLE_INVALID) {
+    free_buffers(rs);
+    return false;
+  }
+  rs->running = true;
+  log_info(LOG_SOURCE, "Mapping tiles reachable within %d ticks (%d choices per tick).", config->ticks, rs->choice_count);
+  return true;
+}
+
+bool reachability_poll(reachability_t *rs) {
+  if (!rs->running) return false;
+  if (!thread_pool_is_done(rs->pool, rs->job)) return true;
+  thread_pool_wait(rs->pool, rs->job);
+  rs->running = false;
+
+  log_info(LOG_SOURCE, "Reached %d tiles within %d ticks (%lld ticks simulated).", rs->reached_tiles, rs->depth, rs->nodes);
+  if (rs->truncated) log_warn(LOG_SOURCE, "Some ticks had more states than the frontier holds, later tiles may be missing.");
+  return false;
+}
+
+void reachability_cancel(reachability_t *rs) {
+  if (!rs->running) return;
+  thread_mutex_lock(rs->lock);
+  rs->cancelled = true;
+  thread_mutex_unlock(rs->lock);
+}
+
+float reachability_progress(reachability_t *rs) {
+  if (!rs->lock || rs->ctx.ticks == 0) return 0.0f;
+  thread_mutex_lock(rs->lock);
+  float progress = (float)rs->depth / (float)rs->ctx.ticks;
+  thread_mutex_unlock(rs->lock);
+  return progress;
+}
+
+bool reachability_fetch(reachability_t *rs, uint16_t *out) {
+  if (!rs->lock) return false;
+  thread_mutex_lock(rs->lock);
+  bool dirty = rs->dirty && rs->published;
+  if (dirty) memcpy(out, rs->published, (size_t)rs->width * rs->height * sizeof(uint16_t));
+  rs->dirty = false;
+  thread_mutex_unlock(rs->lock);
+  return dirty;
+}
+
+void reachability_free(reachability_t *rs) {
+  if (rs->running) {
+    reachability_cancel(rs);
+    thread_pool_wait(rs->pool, rs->job);
+    rs->running = false;
+  }
+  free_buffers(rs);
+  transposition_destroy(&rs->table);
+  thread_mutex_destroy(rs->lock);
+  memset(rs, 0, sizeof(reachability_t));
+}
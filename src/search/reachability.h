@@ -0,0 +1,66 @@
+#ifndef REACHABILITY_H
+#define REACHABILITY_H
+
+#include "search.h"
+#include "transposition.h"
+#include <system/thread_pool.h>
+#include <types.h>
+
+#define REACHABILITY_MAX_TICKS 1000
+#define REACHABILITY_MAX_FRONTIER (1 << 16)
+#define REACHABILITY_MAX_CHILDREN (1 << 22) // frontier * choices per tick
+
+struct reachability_config_t {
+  int ticks;
+  int max_frontier;      // states kept per tick, the rest of a crowded tick is not expanded
+  float position_bucket; // world units
+  float velocity_bucket;
+  int table_mb;
+  bool expand_frozen;
+};
+
+// Breadth first search from the world at the playhead that records the earliest tick every tile
+// is entered on. States are deduplicated by a quantized key, so the frontier stays bounded by the
+// number of distinct position and velocity buckets instead of growing exponentially.
+struct reachability_t {
+  search_context_t ctx;
+  search_space_t space;
+  reachability_config_t config;
+  thread_pool_t *pool;
+  job_handle_t job;
+  transposition_table_t table;
+  int choice_count;
+  SWorldCore *frontier;
+  SWorldCore *next_frontier;
+  int frontier_size;
+  int *child_tiles;      // tile of every (state, choice) pair
+  uint8_t *child_expand; // whether the child goes on to the next tick
+  uint64_t *child_keys;  // quantized keys, deduplicated by the driver in child order
+  int *survivors;
+  uint16_t *earliest; // earliest tick + 1 per tile, 0 when never reached, owned by the driver
+  int width;
+  int height;
+  int tick; // tick being expanded, only written between parallel passes
+  bool running;
+
+  thread_mutex_t *lock; // guards everything below
+  uint16_t *published;  // copy of `earliest` as of the last finished tick
+  int depth;
+  long long nodes;
+  int reached_tiles;
+  bool truncated;
+  bool dirty;
+  bool cancelled;
+};
+
+bool reachability_start(reachability_t *rs, thread_pool_t *pool, timeline_state_t *ts, int track_index, int start_tick,
+                        const search_space_t *space, const reachability_config_t *config);
+// returns true while the search is still running
+bool reachability_poll(reachability_t *rs);
+void reachability_cancel(reachability_t *rs);
+float reachability_progress(reachability_t *rs);
+// copies the grid into `out` (width * height) when it changed since the last fetch
+bool reachability_fetch(reachability_t *rs, uint16_t *out);
+void reachability_free(reachability_t *rs);
+
+#endif // REACHABILITY_H
@@ -0,0 +1,224 @@
+#include "search.h"
+#include <ddnet_physics/collision.h>
+#include <logger/logger.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <user_interface/timeline/timeline_model.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+static const char *LOG_SOURCE = "Search";
+
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+static int direction_count(const search_space_t *space) {
+  int count = 0;
+  for (int i = 0; i < SEARCH_DIRECTION_COUNT; ++i)
+    count += space->directions[i];
+  return count;
+}
+
+int search_space_choice_count(const search_space_t *space) {
+  int directions = direction_count(space);
+  if (directions == 0) directions = 1; // keeps the base direction
+  int aims = imax(imin(space->aim_steps, SEARCH_MAX_AIM_STEPS), 1);
+  return directions * (space->vary_jump ? 2 : 1) * (space->vary_hook ? 2 : 1) * aims;
+}
+
+// choices are ordered aim, hook, jump, direction from the least significant digit
+SPlayerInput search_space_decode(const search_space_t *space, int choice) {
+  SPlayerInput input = space->base;
+
+  int aims = imax(imin(space->aim_steps, SEARCH_MAX_AIM_STEPS), 1);
+  if (aims > 1) {
+    int step = choice % aims;
+    float degrees = space->aim_min + (space->aim_max - space->aim_min) * (float)step / (float)(aims - 1);
+    float radians = degrees * (float)M_PI / 180.0f;
+    input.m_TargetX = (int)roundf(cosf(radians) * space->aim_distance);
+    input.m_TargetY = (int)roundf(-sinf(radians) * space->aim_distance);
+  }
+  choice /= aims;
+
+  if (space->vary_hook) {
+    input.m_Hook = choice % 2;
+    choice /= 2;
+  }
+  if (space->vary_jump) {
+    input.m_Jump = choice % 2;
+    choice /= 2;
+  }
+  if (direction_count(space) > 0) {
+    for (int i = 0; i < SEARCH_DIRECTION_COUNT; ++i) {
+      if (!space->directions[i]) continue;
+      if (choice-- == 0) {
+        input.m_Direction = i - 1;
+        break;
+      }
+    }
+  }
+  return input;
+}
+
+bool search_is_frozen(const SCharacterCore *character) { return character->m_FreezeTime > 0 || character->m_DeepFrozen; }
+
+static bool is_finish_tile(SWorldCore *world, mvec2 pos) {
+  map_data_t *map = &world->m_pCollision->m_MapData;
+  int tx = (int)(vgetx(pos) / 32.0f), ty = (int)(vgety(pos) / 32.0f);
+  if (tx < 0 || ty < 0 || tx >= map->width || ty >= map->height) return false;
+  int idx = ty * map->width + tx;
+  if (map->game_layer.data[idx] == TILE_FINISH) return true;
+  return map->front_layer.data && map->front_layer.data[idx] == TILE_FINISH;
+}
+
+bool search_is_reached(const search_objective_t *objective, SWorldCore *world, int character) {
+  const SCharacterCore *core = &world->m_pCharacters[character];
+  if (objective->goal == SEARCH_GOAL_FINISH) return is_finish_tile(world, core->m_Pos);
+  return vdistance(core->m_Pos, objective->target) <= objective->radius;
+}
+
+float search_distance(const search_objective_t *objective, const SCharacterCore *character) {
+  return vdistance(character->m_Pos, objective->target);
+}
+
+// Fingerprint
+
+static uint64_t fnv_update(uint64_t h, const void *data, size_t size) {
+  const uint8_t *p = data;
+  for (size_t i = 0; i < size; ++i) {
+    h ^= p[i];
+    h *= FNV_PRIME;
+  }
+  return h;
+}
+
+static uint64_t fnv_int(uint64_t h, int v) { return fnv_update(h, &v, sizeof(v)); }
+static uint64_t fnv_float(uint64_t h, float v) { return fnv_update(h, &v, sizeof(v)); }
+static uint64_t fnv_vec(uint64_t h, mvec2 v) { return fnv_float(fnv_float(h, vgetx(v)), vgety(v)); }
+
+// Everything that decides how a character moves from here on. Absolute ticks (m_GameTick, attack and
+// freeze start ticks) are left out on purpose, so equal states reached on different ticks collide.
+// Projectiles and lasers are only counted, worlds that rely on them dedupe less precisely.
+uint64_t search_world_fingerprint(const SWorldCore *world) {
+  uint64_t h = fnv_int(FNV_OFFSET, world->m_NumCharacters);
+  for (int i = 0; i < world->m_NumCharacters; ++i) {
+    const SCharacterCore *c = &world->m_pCharacters[i];
+    h = fnv_vec(h, c->m_Pos);
+    h = fnv_vec(h, c->m_Vel);
+    h = fnv_int(h, c->m_HookState);
+    if (c->m_HookState != HOOK_IDLE) {
+      h = fnv_vec(h, c->m_HookPos);
+      h = fnv_vec(h, c->m_HookDir);
+      h = fnv_int(h, c->m_HookTick);
+      h = fnv_int(h, c->m_HookedPlayer);
+    }
+    h = fnv_int(h, c->m_Jumped);
+    h = fnv_int(h, c->m_JumpedTotal);
+    h = fnv_int(h, c->m_Jumps);
+    h = fnv_int(h, c->m_FreezeTime);
+    h = fnv_int(h, c->m_DeepFrozen);
+    h = fnv_int(h, c->m_LiveFrozen);
+    h = fnv_int(h, c->m_ActiveWeapon);
+    h = fnv_int(h, c->m_ReloadTimer);
+    h = fnv_int(h, c->m_TeleCheckpoint);
+    h = fnv_int(h, c->m_StartTick >= 0);
+    // the previous input decides jump, hook and fire edges
+    h = fnv_int(h, c->m_Input.m_Jump);
+    h = fnv_int(h, c->m_Input.m_Hook);
+    h = fnv_int(h, c->m_Input.m_Fire);
+  }
+  for (int type = 0; type < NUM_WORLD_ENTTYPES; ++type) {
+    int count = 0;
+    for (SEntity *ent = world->m_apFirstEntityTypes[type]; ent; ent = ent->m_pNextTypeEntity)
+      ++count;
+    h = fnv_int(h, count);
+  }
+  return h;
+}
+
+// Context
+
+bool search_context_init(search_context_t *ctx, timeline_state_t *ts, int track_index, int start_tick, int ticks) {
+  memset(ctx, 0, sizeof(search_context_t));
+  if (ts->vec.current_size == 0 || track_index < 0 || ticks <= 0) return false;
+
+  int snapshot_index = imax(imin(start_tick / PHYSICS_SNAPSHOT_STEP, (int)ts->vec.current_size - 1), 0);
+  ctx->start = wc_empty();
+  wc_copy_world(&ctx->start, &ts->vec.data[snapshot_index]);
+  ctx->start.particle = NULL;
+  ctx->start.user_data = NULL;
+  if (track_index >= ctx->start.m_NumCharacters) {
+    log_error(LOG_SOURCE, "Track %d has no character in the world.", track_index);
+    wc_free(&ctx->start);
+    return false;
+  }
+
+  while (ctx->start.m_GameTick < start_tick) {
+    for (int p = 0; p < ctx->start.m_NumCharacters && p < ts->player_track_count; ++p) {
+      SPlayerInput input = model_get_input_at_tick(ts, p, ctx->start.m_GameTick);
+      cc_on_input(&ctx->start.m_pCharacters[p], &input);
+    }
+    wc_tick(&ctx->start);
+  }
+
+  ctx->num_characters = ctx->start.m_NumCharacters;
+  ctx->character = track_index;
+  ctx->start_tick = ctx->start.m_GameTick;
+  ctx->ticks = ticks;
+  ctx->inputs = calloc((size_t)ticks * ctx->num_characters, sizeof(SPlayerInput));
+  if (!ctx->inputs) {
+    wc_free(&ctx->start);
+    return false;
+  }
+  for (int t = 0; t < ticks; ++t)
+    for (int p = 0; p < ctx->num_characters && p < ts->player_track_count; ++p)
+      ctx->inputs[t * ctx->num_characters + p] = model_get_input_at_tick(ts, p, ctx->start_tick + t);
+  return true;
+}
+
+void search_context_free(search_context_t *ctx) {
+  if (ctx->inputs) wc_free(&ctx->start);
+  free(ctx->inputs);
+  memset(ctx, 0, sizeof(search_context_t));
+}
+
+static int quantize(float v, float bucket) { return (int)floorf(v / bucket); }
+
+// Coarse key of the searched character alone: states in the same position and velocity bucket
+// with the same hook and jump state count as one.
+uint64_t search_quantized_key(const search_context_t *ctx, const SWorldCore *world, int depth, float position_bucket,
+                              float velocity_bucket) {
+  const SCharacterCore *c = &world->m_pCharacters[ctx->character];
+  uint64_t h = fnv_int(FNV_OFFSET, quantize(vgetx(c->m_Pos), position_bucket));
+  h = fnv_int(h, quantize(vgety(c->m_Pos), position_bucket));
+  h = fnv_int(h, quantize(vgetx(c->m_Vel), velocity_bucket));
+  h = fnv_int(h, quantize(vgety(c->m_Vel), velocity_bucket));
+  h = fnv_int(h, c->m_HookState);
+  if (c->m_HookState != HOOK_IDLE) {
+    h = fnv_int(h, quantize(vgetx(c->m_HookPos), position_bucket));
+    h = fnv_int(h, quantize(vgety(c->m_HookPos), position_bucket));
+  }
+  h = fnv_int(h, c->m_Jumped);
+  h = fnv_int(h, c->m_JumpedTotal);
+  h = fnv_int(h, search_is_frozen(c));
+  h = fnv_int(h, c->m_Input.m_Jump);
+  h = fnv_int(h, c->m_Input.m_Hook);
+  return ctx->num_characters > 1 ? fnv_int(h, depth) : h;
+}
+
+// Equal states only match on the same depth. Other characters follow tick dependent timeline inputs,
+// and even a lone character has fewer ticks left to score with when it gets there later.
+uint64_t search_state_key(const search_context_t *ctx, const SWorldCore *world, int depth) {
+  return fnv_int(search_world_fingerprint(world), depth);
+}
+
+// `input` replaces the searched character's timeline input for this tick
+void search_context_step(const search_context_t *ctx, SWorldCore *world, int tick_offset, const SPlayerInput *input) {
+  const SPlayerInput *row = &ctx->inputs[imin(tick_offset, ctx->ticks - 1) * ctx->num_characters];
+  for (int p = 0; p < ctx->num_characters; ++p)
+    cc_on_input(&world->m_pCharacters[p], p == ctx->character ? input : &row[p]);
+  wc_tick(world);
+}
@@ -0,0 +1,59 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <ddnet_physics/gamecore.h>
+#include <types.h>
+
+#define SEARCH_MAX_AIM_STEPS 64
+
+enum { SEARCH_DIRECTION_LEFT, SEARCH_DIRECTION_NONE, SEARCH_DIRECTION_RIGHT, SEARCH_DIRECTION_COUNT };
+
+typedef enum { SEARCH_GOAL_POSITION, SEARCH_GOAL_FINISH } search_goal_t;
+
+// The inputs tried on every tick. Fields that are not searched are taken from `base`.
+struct search_space_t {
+  SPlayerInput base;
+  bool directions[SEARCH_DIRECTION_COUNT];
+  bool vary_jump;
+  bool vary_hook;
+  int aim_steps; // <= 1 keeps the aim of `base`
+  float aim_min; // degrees, 0 is right and 90 is up
+  float aim_max;
+  float aim_distance;
+};
+
+struct search_objective_t {
+  search_goal_t goal;
+  mvec2 target; // world units, also guides SEARCH_GOAL_FINISH as the distance heuristic
+  float radius;
+  bool avoid_freeze;
+};
+
+// The world at the start of the window plus the timeline inputs of every other character,
+// so workers can simulate without touching the timeline.
+struct search_context_t {
+  SWorldCore start;
+  SPlayerInput *inputs; // ticks rows of num_characters inputs, tick-major
+  int num_characters;
+  int character;
+  int start_tick;
+  int ticks;
+};
+
+int search_space_choice_count(const search_space_t *space);
+SPlayerInput search_space_decode(const search_space_t *space, int choice);
+
+bool search_is_frozen(const SCharacterCore *character);
+bool search_is_reached(const search_objective_t *objective, SWorldCore *world, int character);
+float search_distance(const search_objective_t *objective, const SCharacterCore *character);
+uint64_t search_world_fingerprint(const SWorldCore *world);
+uint64_t search_state_key(const search_context_t *ctx, const SWorldCore *world, int depth);
+uint64_t search_quantized_key(const search_context_t *ctx, const SWorldCore *world, int depth, float position_bucket,
+                              float velocity_bucket);
+
+// must be called from the main thread, the context does not reference the timeline afterwards
+bool search_context_init(search_context_t *ctx, timeline_state_t *ts, int track_index, int start_tick, int ticks);
+void search_context_free(search_context_t *ctx);
+void search_context_step(const search_context_t *ctx, SWorldCore *world, int tick_offset, const SPlayerInput *input);
+
+#endif // SEARCH_H
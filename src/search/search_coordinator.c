@@ -0,0 +1,405 @@
+#include "search_coordinator.h"
+#include "search_protocol.h"
+#include "search_worker.h"
+#include <logger/logger.h>
+#include <math.h>
+#include <physics/physics.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *LOG_SOURCE = "SearchCoordinator";
+
+#define POLL_INTERVAL_MS 100
+#define BATCHES_PER_THREAD 4
+
+struct search_link_t {
+  search_coordinator_t *c;
+  net_socket_t *socket;
+  thread_t *thread;
+  int threads;
+  uint32_t map_generation;    // map the worker holds, 0 for none
+  uint32_t search_generation; // context the worker holds, 0 for none
+  bool alive;
+  bool finished; // link_main returned, the slot can be reused
+};
+
+static bool is_shutting_down(search_coordinator_t *c) {
+  thread_mutex_lock(c->lock);
+  bool result = c->shutting_down;
+  thread_mutex_unlock(c->lock);
+  return result;
+}
+
+static bool has_work(search_coordinator_t *c) {
+  return c->running && !c->cancelled && (c->retry_count > 0 || c->next_prefix < c->prefix_count);
+}
+
+// expects c->lock to be held
+static bool has_live_link(search_coordinator_t *c) {
+  for (int i = 0; i < c->link_count; ++i)
+    if (c->links[i]->alive) return true;
+  return false;
+}
+
+// expects c->lock to be held
+static search_batch_t take_batch(search_coordinator_t *c, search_link_t *link) {
+  if (c->retry_count > 0) return c->retry[--c->retry_count];
+  search_batch_t batch = {c->next_prefix, imin(c->prefix_count - c->next_prefix, imax(link->threads, 1) * BATCHES_PER_THREAD)};
+  c->next_prefix += batch.count;
+  return batch;
+}
+
+// waits for the batch result, telling the worker to wrap up early once the search got cancelled
+static bool receive_result(search_link_t *link, search_msg_result_t *result) {
+  search_coordinator_t *c = link->c;
+  bool cancel_sent = false;
+  while (!net_wait_readable(link->socket, POLL_INTERVAL_MS)) {
+    thread_mutex_lock(c->lock);
+    bool stop = c->cancelled || c->shutting_down;
+    thread_mutex_unlock(c->lock);
+    if (stop && !cancel_sent) {
+      if (!search_msg_send(link->socket, SEARCH_MSG_CANCEL, NULL, 0)) return false;
+      cancel_sent = true;
+    }
+  }
+
+  search_msg_type_t type;
+  void *payload;
+  uint32_t size;
+  if (!search_msg_recv(link->socket, &type, &payload, &size)) return false;
+  bool ok = type == SEARCH_MSG_RESULT && size == sizeof(search_msg_result_t);
+  if (ok) memcpy(result, payload, sizeof(search_msg_result_t));
+  free(payload);
+  return ok && result->length >= 0 && result->length <= BRUTEFORCE_MAX_TICKS;
+}
+
+static bool receive_hello(search_link_t *link) {
+  while (!net_wait_readable(link->socket, POLL_INTERVAL_MS))
+    if (is_shutting_down(link->c)) return false;
+
+  search_msg_type_t type;
+  void *payload;
+  uint32_t size;
+  if (!search_msg_recv(link->socket, &type, &payload, &size)) return false;
+  search_msg_hello_t hello = {0};
+  bool ok = type == SEARCH_MSG_HELLO && size == sizeof(hello);
+  if (ok) memcpy(&hello, payload, sizeof(hello));
+  free(payload);
+  if (!ok || hello.version != SEARCH_PROTOCOL_VERSION || hello.character_size != sizeof(SCharacterCore)) {
+    log_error(LOG_SOURCE, "Rejected a worker from a different build.");
+    return false;
+  }
+  link->threads = imax(hello.threads, 1);
+  return true;
+}
+
+static void serve_link(search_link_t *link) {
+  search_coordinator_t *c = link->c;
+  if (!receive_hello(link)) return;
+
+  thread_mutex_lock(c->lock);
+  link->alive = true;
+  thread_cond_broadcast(c->changed);
+  log_info(LOG_SOURCE, "Worker connected with %d threads.", link->threads);
+
+  for (;;) {
+    while (!c->shutting_down && !has_work(c))
+      thread_cond_wait(c->changed, c->lock);
+    if (c->shutting_down) break;
+
+    search_batch_t batch = take_batch(c, link);
+    ++c->in_flight;
+    uint32_t map_generation = c->map_generation, search_generation = c->search_generation;
+    const void *map = c->map, *context = c->context;
+    uint32_t map_size = c->map_size, context_size = c->context_size;
+    search_msg_batch_t message = {batch.first_prefix, batch.count, c->bf->prefix_depth, INFINITY};
+    thread_mutex_lock(c->bf->lock);
+    message.bound = c->bf->best_score;
+    thread_mutex_unlock(c->bf->lock);
+    thread_mutex_unlock(c->lock);
+
+    // map and context stay untouched until every batch of the search came back
+    bool ok = true;
+    if (link->map_generation != map_generation) ok = search_msg_send(link->socket, SEARCH_MSG_MAP, map, map_size);
+    if (ok && link->search_generation != search_generation)
+      ok = search_msg_send(link->socket, SEARCH_MSG_CONTEXT, context, context_size);
+    if (ok) ok = search_msg_send(link->socket, SEARCH_MSG_BATCH, &message, sizeof(message));
+    search_msg_result_t result;
+    if (ok) ok = receive_result(link, &result);
+    if (ok) bruteforce_merge(c->bf, result.choices, result.length, result.score, result.nodes);
+
+    thread_mutex_lock(c->lock);
+    --c->in_flight;
+    if (ok) {
+      c->completed += batch.count;
+      link->map_generation = map_generation;
+      link->search_generation = search_generation;
+    } else {
+      c->retry[c->retry_count++] = batch;
+      log_warn(LOG_SOURCE, "Lost a worker, its batch goes to the others.");
+    }
+    thread_cond_broadcast(c->changed);
+    if (!ok) break;
+  }
+
+  bool say_bye = link->alive && c->shutting_down;
+  link->alive = false;
+  thread_mutex_unlock(c->lock);
+  if (say_bye) search_msg_send(link->socket, SEARCH_MSG_BYE, NULL, 0);
+}
+
+static void link_main(void *arg) {
+  search_link_t *link = arg;
+  serve_link(link);
+  thread_mutex_lock(link->c->lock);
+  link->finished = true;
+  thread_mutex_unlock(link->c->lock);
+}
+
+static void free_link(search_link_t *link) {
+  thread_join(link->thread);
+  net_close(link->socket);
+  free(link);
+}
+
+// frees the slots of links whose worker went away, so reconnecting workers aren't refused
+static void reap_links(search_coordinator_t *c) {
+  search_link_t *dead[SEARCH_COORDINATOR_MAX_WORKERS];
+  int dead_count = 0;
+  thread_mutex_lock(c->lock);
+  for (int i = 0; i < c->link_count;) {
+    if (c->links[i]->finished) {
+      dead[dead_count++] = c->links[i];
+      c->links[i] = c->links[--c->link_count];
+    } else {
+      ++i;
+    }
+  }
+  thread_mutex_unlock(c->lock);
+  for (int i = 0; i < dead_count; ++i)
+    free_link(dead[i]);
+}
+
+static void accept_main(void *arg) {
+  search_coordinator_t *c = arg;
+  while (!is_shutting_down(c)) {
+    net_socket_t *socket = net_accept(c->listener, POLL_INTERVAL_MS);
+    if (!socket) continue;
+    reap_links(c);
+
+    search_link_t *link = calloc(1, sizeof(search_link_t));
+    thread_mutex_lock(c->lock);
+    bool full = c->link_count >= SEARCH_COORDINATOR_MAX_WORKERS;
+    if (link && !full) {
+      link->c = c;
+      link->socket = socket;
+      c->links[c->link_count++] = link;
+    }
+    thread_mutex_unlock(c->lock);
+    if (!link || full) {
+      log_warn(LOG_SOURCE, "Refusing a worker, at most %d can connect.", SEARCH_COORDINATOR_MAX_WORKERS);
+      free(link);
+      net_close(socket);
+      continue;
+    }
+    // only this thread reaps links, so the handle is set before anyone joins it. joining a NULL
+    // thread is a no-op, a link that never got one is reaped like a finished one
+    link->thread = thread_create(link_main, link);
+    if (!link->thread) {
+      thread_mutex_lock(c->lock);
+      link->finished = true;
+      thread_mutex_unlock(c->lock);
+    }
+  }
+}
+
+// Lifecycle
+
+bool search_coordinator_listen(search_coordinator_t *c) {
+  if (c->listener) return true;
+  if (!net_init()) return false;
+  c->lock = thread_mutex_create();
+  c->changed = thread_cond_create();
+  c->listener = net_listen("127.0.0.1", 0, &c->port);
+  if (!c->lock || !c->changed || !c->listener) {
+    log_error(LOG_SOURCE, "Failed to listen for search workers.");
+    search_coordinator_shutdown(c);
+    return false;
+  }
+  c->accept_thread = thread_create(accept_main, c);
+  if (!c->accept_thread) {
+    search_coordinator_shutdown(c);
+    return false;
+  }
+  log_info(LOG_SOURCE, "Listening for search workers on 127.0.0.1:%d.", c->port);
+  return true;
+}
+
+int search_coordinator_spawn_workers(search_coordinator_t *c, int count, int threads) {
+  if (!search_coordinator_listen(c)) return 0;
+  char address[32], thread_arg[16];
+  snprintf(address, sizeof(address), "127.0.0.1:%d", c->port);
+  snprintf(thread_arg, sizeof(thread_arg), "%d", threads);
+  const char *args[] = {SEARCH_WORKER_FLAG, address, threads > 0 ? "--threads" : NULL, thread_arg, NULL};
+
+  int spawned = 0;
+  while (spawned < count && c->process_count < SEARCH_COORDINATOR_MAX_WORKERS) {
+    process_t *process = process_spawn_self(args);
+    if (!process) break;
+    c->processes[c->process_count++] = process;
+    ++spawned;
+  }
+  return spawned;
+}
+
+int search_coordinator_worker_count(search_coordinator_t *c, int *threads) {
+  int workers = 0, total = 0;
+  if (c->lock) {
+    thread_mutex_lock(c->lock);
+    for (int i = 0; i < c->link_count; ++i) {
+      if (!c->links[i]->alive) continue;
+      ++workers;
+      total += c->links[i]->threads;
+    }
+    thread_mutex_unlock(c->lock);
+  }
+  if (threads) *threads = total;
+  return workers;
+}
+
+// workers only need a new copy when the editor loaded another map in the meantime
+static bool update_map(search_coordinator_t *c, physics_handler_t *ph) {
+  const void *data = ph->collision.m_MapData._map_file_data;
+  size_t size = ph->collision.m_MapData._map_file_size;
+  if (!data || size == 0 || size > SEARCH_PROTOCOL_MAX_PAYLOAD) return false;
+  if (c->map && c->map_size == size && memcmp(c->map, data, size) == 0) return true;
+
+  void *copy = malloc(size);
+  if (!copy) return false;
+  memcpy(copy, data, size);
+  free(c->map);
+  c->map = copy;
+  c->map_size = (uint32_t)size;
+  ++c->map_generation;
+  return true;
+}
+
+bool search_coordinator_start(search_coordinator_t *c, bruteforce_t *bf, physics_handler_t *ph, timeline_state_t *ts, int track_index,
+                              int start_tick, int ticks, const search_space_t *space, const search_objective_t *objective,
+                              bool use_table, int table_mb, int table_policy) {
+  if (!c->listener || c->running || bf->running || !ph->loaded || !bruteforce_validate(space, ticks)) return false;
+  int threads;
+  if (search_coordinator_worker_count(c, &threads) == 0) {
+    log_error(LOG_SOURCE, "No search workers are connected.");
+    return false;
+  }
+
+  search_context_t ctx;
+  if (!search_context_init(&ctx, ts, track_index, start_tick, ticks)) {
+    log_error(LOG_SOURCE, "Could not prepare the world at tick %d.", start_tick);
+    return false;
+  }
+  // the transposition tables live in the workers
+  if (!bruteforce_prepare(bf, NULL, &ctx, space, objective)) {
+    search_context_free(&ctx);
+    return false;
+  }
+  int prefixes = bruteforce_split(bf, threads);
+
+  search_msg_context_t settings = {0};
+  settings.use_table = use_table;
+  settings.table_mb = table_mb;
+  settings.table_policy = table_policy;
+  uint32_t context_size;
+  void *context = search_context_serialize(&bf->ctx, space, objective, &settings, &context_size);
+  if (!context) return false;
+
+  thread_mutex_lock(c->lock);
+  bool ok = update_map(c, ph);
+  if (ok) {
+    free(c->context);
+    c->context = context;
+    c->context_size = context_size;
+    ++c->search_generation;
+    c->bf = bf;
+    c->prefix_count = prefixes;
+    c->next_prefix = 0;
+    c->completed = 0;
+    c->retry_count = 0;
+    c->cancelled = false;
+    c->running = true;
+    thread_cond_broadcast(c->changed);
+  }
+  thread_mutex_unlock(c->lock);
+  if (!ok) {
+    free(context);
+    return false;
+  }
+  log_info(LOG_SOURCE, "Searching %.3g candidates over %d ticks on %d remote threads.", bruteforce_candidate_count(space, ticks), ticks,
+           threads);
+  return true;
+}
+
+bool search_coordinator_poll(search_coordinator_t *c) {
+  if (!c->lock) return false;
+  thread_mutex_lock(c->lock);
+  bool was_running = c->running;
+  // nobody is left to pick up the remaining batches, stop with what came back so far
+  bool abandoned = c->in_flight == 0 && has_work(c) && !has_live_link(c);
+  if (abandoned) c->cancelled = true;
+  if (c->running && c->in_flight == 0 && (c->cancelled || c->completed == c->prefix_count)) c->running = false;
+  bool finished = was_running && !c->running;
+  bool cancelled = c->cancelled;
+  int completed = c->completed, prefix_count = c->prefix_count;
+  thread_mutex_unlock(c->lock);
+
+  if (abandoned) log_error(LOG_SOURCE, "Every search worker disconnected, stopping after %d of %d prefixes.", completed, prefix_count);
+  if (finished) {
+    thread_mutex_lock(c->bf->lock);
+    c->bf->cancelled = cancelled;
+    thread_mutex_unlock(c->bf->lock);
+    bruteforce_log_result(c->bf);
+  }
+  return was_running && !finished;
+}
+
+float search_coordinator_progress(search_coordinator_t *c) {
+  if (!c->lock) return 0.0f;
+  thread_mutex_lock(c->lock);
+  float progress = c->prefix_count > 0 ? (float)c->completed / (float)c->prefix_count : 0.0f;
+  thread_mutex_unlock(c->lock);
+  return progress;
+}
+
+void search_coordinator_cancel(search_coordinator_t *c) {
+  if (!c->lock) return;
+  thread_mutex_lock(c->lock);
+  if (c->running) c->cancelled = true;
+  thread_cond_broadcast(c->changed);
+  thread_mutex_unlock(c->lock);
+}
+
+void search_coordinator_shutdown(search_coordinator_t *c) {
+  if (c->lock) {
+    thread_mutex_lock(c->lock);
+    c->shutting_down = true;
+    thread_cond_broadcast(c->changed);
+    thread_mutex_unlock(c->lock);
+  }
+  thread_join(c->accept_thread);
+  // links finish their batch first, a cancel makes that quick
+  for (int i = 0; i < c->link_count; ++i)
+    free_link(c->links[i]);
+  for (int i = 0; i < c->process_count; ++i)
+    process_wait(c->processes[i]);
+  if (c->listener) {
+    net_close(c->listener);
+    net_cleanup();
+  }
+  free(c->map);
+  free(c->context);
+  thread_cond_destroy(c->changed);
+  thread_mutex_destroy(c->lock);
+  memset(c, 0, sizeof(search_coordinator_t));
+}
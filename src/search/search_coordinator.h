@@ -0,0 +1,67 @@
+#ifndef SEARCH_COORDINATOR_H
+#define SEARCH_COORDINATOR_H
+
+#include "bruteforce.h"
+#include <system/net_socket.h>
+#include <system/process.h>
+#include <types.h>
+
+#define SEARCH_COORDINATOR_MAX_WORKERS 32
+
+typedef struct search_link_t search_link_t;
+
+typedef struct {
+  int first_prefix;
+  int count;
+} search_batch_t;
+
+// Hands the prefixes of a bruteforce search out to `--search-worker` processes and merges their
+// results into a bruteforce_t, so one window can use the cores of several processes or machines.
+// Every connection gets its own thread that feeds it one batch at a time.
+struct search_coordinator_t {
+  net_socket_t *listener;
+  int port;
+  thread_t *accept_thread;
+  process_t *processes[SEARCH_COORDINATOR_MAX_WORKERS];
+  int process_count;
+
+  thread_mutex_t *lock; // guards everything below
+  thread_cond_t *changed;
+  search_link_t *links[SEARCH_COORDINATOR_MAX_WORKERS];
+  int link_count;
+  bruteforce_t *bf;
+  void *map;
+  uint32_t map_size;
+  uint32_t map_generation;
+  void *context; // serialized CONTEXT payload of the current search
+  uint32_t context_size;
+  uint32_t search_generation;
+  int prefix_count;
+  int next_prefix;
+  int completed;
+  int in_flight;
+  search_batch_t retry[SEARCH_COORDINATOR_MAX_WORKERS]; // batches of connections that died
+  int retry_count;
+  bool running;
+  bool cancelled;
+  bool shutting_down;
+};
+
+// accepts workers on 127.0.0.1 with a free port, see `port`
+bool search_coordinator_listen(search_coordinator_t *c);
+// starts `count` worker processes of this executable, threads <= 0 lets them use every core
+int search_coordinator_spawn_workers(search_coordinator_t *c, int count, int threads);
+// connected workers and their total thread count
+int search_coordinator_worker_count(search_coordinator_t *c, int *threads);
+
+bool search_coordinator_start(search_coordinator_t *c, bruteforce_t *bf, physics_handler_t *ph, timeline_state_t *ts, int track_index,
+                              int start_tick, int ticks, const search_space_t *space, const search_objective_t *objective,
+                              bool use_table, int table_mb, int table_policy);
+// returns true while batches are outstanding, logs the result once the last one came back
+bool search_coordinator_poll(search_coordinator_t *c);
+float search_coordinator_progress(search_coordinator_t *c);
+void search_coordinator_cancel(search_coordinator_t *c);
+// disconnects every worker and waits for the spawned processes to exit
+void search_coordinator_shutdown(search_coordinator_t *c);
+
+#endif // SEARCH_COORDINATOR_H
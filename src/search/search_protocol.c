@@ -0,0 +1,120 @@
+#include "search_protocol.h"
+#include <logger/logger.h>
+#include <physics/physics.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *LOG_SOURCE = "SearchProtocol";
+
+bool search_msg_send(net_socket_t *socket, search_msg_type_t type, const void *payload, uint32_t size) {
+  search_msg_header_t header = {(uint32_t)type, size};
+  if (!net_send_all(socket, &header, sizeof(header))) return false;
+  return size == 0 || net_send_all(socket, payload, size);
+}
+
+bool search_msg_recv(net_socket_t *socket, search_msg_type_t *type, void **payload, uint32_t *size) {
+  search_msg_header_t header;
+  *payload = NULL;
+  if (!net_recv_all(socket, &header, sizeof(header))) return false;
+  if (header.size > SEARCH_PROTOCOL_MAX_PAYLOAD) {
+    log_error(LOG_SOURCE, "Refusing a %u byte message.", header.size);
+    return false;
+  }
+  if (header.size > 0) {
+    *payload = malloc(header.size);
+    if (!*payload || !net_recv_all(socket, *payload, header.size)) {
+      free(*payload);
+      *payload = NULL;
+      return false;
+    }
+  }
+  *type = (search_msg_type_t)header.type;
+  *size = header.size;
+  return true;
+}
+
+// Context
+
+static bool world_has_entities(const SWorldCore *world) {
+  for (int type = 0; type < NUM_WORLD_ENTTYPES; ++type)
+    if (world->m_apFirstEntityTypes[type]) return true;
+  return false;
+}
+
+void *search_context_serialize(const search_context_t *ctx, const search_space_t *space, const search_objective_t *objective,
+                               const search_msg_context_t *settings, uint32_t *size) {
+  // only characters are transferred, entities hold pointer graphs we can't rebind
+  if (world_has_entities(&ctx->start)) {
+    log_error(LOG_SOURCE, "The window starts with projectiles or lasers in flight, it can't be sent to workers.");
+    return NULL;
+  }
+
+  size_t characters = (size_t)ctx->num_characters * sizeof(SCharacterCore);
+  size_t inputs = (size_t)ctx->ticks * ctx->num_characters * sizeof(SPlayerInput);
+  size_t total = sizeof(search_msg_context_t) + characters + inputs;
+  if (total > SEARCH_PROTOCOL_MAX_PAYLOAD) return NULL;
+  char *payload = malloc(total);
+  if (!payload) return NULL;
+
+  search_msg_context_t header = *settings;
+  header.character_size = sizeof(SCharacterCore);
+  header.num_characters = ctx->num_characters;
+  header.character = ctx->character;
+  header.start_tick = ctx->start_tick;
+  header.ticks = ctx->ticks;
+  header.space = *space;
+  header.objective = *objective;
+  memcpy(payload, &header, sizeof(header));
+  memcpy(payload + sizeof(header), ctx->start.m_pCharacters, characters);
+  memcpy(payload + sizeof(header) + characters, ctx->inputs, inputs);
+  *size = (uint32_t)total;
+  return payload;
+}
+
+bool search_context_deserialize(search_context_t *ctx, physics_handler_t *ph, const void *payload, uint32_t size,
+                                search_msg_context_t *header) {
+  memset(ctx, 0, sizeof(search_context_t));
+  if (size < sizeof(search_msg_context_t)) return false;
+  memcpy(header, payload, sizeof(search_msg_context_t));
+  if (header->character_size != sizeof(SCharacterCore) || header->num_characters <= 0 || header->ticks <= 0 ||
+      header->ticks > BRUTEFORCE_MAX_TICKS || header->character < 0 || header->character >= header->num_characters)
+    return false;
+  size_t characters = (size_t)header->num_characters * sizeof(SCharacterCore);
+  size_t inputs = (size_t)header->ticks * header->num_characters * sizeof(SPlayerInput);
+  if (size != sizeof(search_msg_context_t) + characters + inputs) return false;
+
+  ctx->start = wc_empty();
+  wc_copy_world(&ctx->start, &ph->world);
+  if (ctx->start.m_NumCharacters < header->num_characters &&
+      !wc_add_character(&ctx->start, header->num_characters - ctx->start.m_NumCharacters)) {
+    wc_free(&ctx->start);
+    return false;
+  }
+
+  // same rebinding as the snapshot cache: take the state, keep this process' pointers
+  const SCharacterCore *source = (const SCharacterCore *)((const char *)payload + sizeof(search_msg_context_t));
+  ctx->start.m_GameTick = header->start_tick;
+  for (int c = 0; c < header->num_characters; ++c) {
+    SCharacterCore *core = &ctx->start.m_pCharacters[c];
+    SWorldCore *owner = core->m_pWorld;
+    SCollision *collision = core->m_pCollision;
+    *core = source[c];
+    core->m_pWorld = owner;
+    core->m_pCollision = collision;
+  }
+  int grid_size = ctx->start.m_pCollision->m_MapData.width * ctx->start.m_pCollision->m_MapData.height;
+  memset(ctx->start.m_Accelerator.m_pGrid->m_pTeeGrid, -1, grid_size * sizeof(int));
+  ctx->start.m_Accelerator.hash = 0;
+
+  ctx->inputs = malloc(inputs);
+  if (!ctx->inputs) {
+    wc_free(&ctx->start);
+    return false;
+  }
+  memcpy(ctx->inputs, (const char *)payload + sizeof(search_msg_context_t) + characters, inputs);
+  ctx->num_characters = header->num_characters;
+  ctx->character = header->character;
+  ctx->start_tick = header->start_tick;
+  ctx->ticks = header->ticks;
+  return true;
+}
@@ -0,0 +1,75 @@
+#ifndef SEARCH_PROTOCOL_H
+#define SEARCH_PROTOCOL_H
+
+#include "bruteforce.h"
+#include <system/net_socket.h>
+#include <types.h>
+
+// Messages between the editor and `--search-worker` processes. Structs are sent as they are in
+// memory, so both sides have to be the same build; HELLO carries enough to reject anything else.
+#define SEARCH_PROTOCOL_VERSION 1
+#define SEARCH_PROTOCOL_MAX_PAYLOAD (256u << 20)
+
+typedef enum {
+  SEARCH_MSG_HELLO = 1, // worker -> editor
+  SEARCH_MSG_MAP,       // editor -> worker, raw map file
+  SEARCH_MSG_CONTEXT,   // editor -> worker, window start state and settings
+  SEARCH_MSG_BATCH,     // editor -> worker
+  SEARCH_MSG_RESULT,    // worker -> editor, one per batch
+  SEARCH_MSG_CANCEL,    // editor -> worker, the running batch reports what it found so far
+  SEARCH_MSG_BYE,       // editor -> worker
+} search_msg_type_t;
+
+typedef struct {
+  uint32_t type;
+  uint32_t size;
+} search_msg_header_t;
+
+typedef struct {
+  uint32_t version;
+  uint32_t character_size;
+  int32_t threads;
+} search_msg_hello_t;
+
+// followed by num_characters SCharacterCore and ticks * num_characters SPlayerInput
+typedef struct {
+  uint32_t character_size;
+  int32_t num_characters;
+  int32_t character;
+  int32_t start_tick;
+  int32_t ticks;
+  search_space_t space;
+  search_objective_t objective;
+  int32_t use_table;
+  int32_t table_mb;
+  int32_t table_policy;
+} search_msg_context_t;
+
+typedef struct {
+  int32_t first_prefix;
+  int32_t count;
+  int32_t prefix_depth;
+  float bound; // only sequences scoring at most this are worth reporting
+} search_msg_batch_t;
+
+typedef struct {
+  int32_t first_prefix;
+  int32_t count;
+  int64_t nodes;
+  float score;
+  int32_t length; // 0 when nothing within the bound was found
+  int32_t choices[BRUTEFORCE_MAX_TICKS];
+} search_msg_result_t;
+
+bool search_msg_send(net_socket_t *socket, search_msg_type_t type, const void *payload, uint32_t size);
+// `payload` is malloc'd and owned by the caller, NULL for empty messages
+bool search_msg_recv(net_socket_t *socket, search_msg_type_t *type, void **payload, uint32_t *size);
+
+// CONTEXT payload for a prepared search, fails for windows that start with projectiles or lasers
+void *search_context_serialize(const search_context_t *ctx, const search_space_t *space, const search_objective_t *objective,
+                               const search_msg_context_t *settings, uint32_t *size);
+// rebuilds the start world on top of `ph`, which must hold the same map as the editor
+bool search_context_deserialize(search_context_t *ctx, physics_handler_t *ph, const void *payload, uint32_t size,
+                                search_msg_context_t *header);
+
+#endif // SEARCH_PROTOCOL_H
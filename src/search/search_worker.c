@@ -0,0 +1,164 @@
+#include "search_worker.h"
+#include "search_protocol.h"
+#include <logger/logger.h>
+#include <math.h>
+#include <physics/physics.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *LOG_SOURCE = "SearchWorker";
+
+typedef struct {
+  net_socket_t *socket;
+  thread_pool_t pool;
+  physics_handler_t physics;
+  bruteforce_t bf;
+  transposition_table_t table;
+  bool has_context;
+  bool quit;
+} search_worker_t;
+
+static bool handle_context(search_worker_t *w, const void *payload, uint32_t size) {
+  w->has_context = false;
+  if (!w->physics.loaded) {
+    log_error(LOG_SOURCE, "Got a search before the map.");
+    return false;
+  }
+  search_context_t ctx;
+  search_msg_context_t header;
+  if (!search_context_deserialize(&ctx, &w->physics, payload, size, &header)) {
+    log_error(LOG_SOURCE, "Invalid search context.");
+    return false;
+  }
+
+  transposition_table_t *table = NULL;
+  if (header.use_table) {
+    transposition_destroy(&w->table);
+    if (transposition_init(&w->table, header.table_mb, (transposition_policy_t)header.table_policy)) table = &w->table;
+  }
+  if (!bruteforce_prepare(&w->bf, table, &ctx, &header.space, &header.objective)) {
+    search_context_free(&ctx);
+    return false;
+  }
+  w->has_context = true;
+  return true;
+}
+
+// runs one batch, still listening so a cancel or a vanished editor stops it early. without a
+// context the worker hangs up instead of answering, so the editor hands the batch to another one.
+static bool handle_batch(search_worker_t *w, const search_msg_batch_t *batch) {
+  if (!w->has_context) {
+    log_error(LOG_SOURCE, "Got a batch without a usable search context.");
+    return false;
+  }
+  search_msg_result_t result;
+  memset(&result, 0, sizeof(result));
+  result.first_prefix = batch->first_prefix;
+  result.count = batch->count;
+  result.score = batch->bound;
+  w->bf.prefix_depth = batch->prefix_depth;
+  w->bf.nodes = 0;
+  // the bound is inclusive so ties can still win the editor's tie break
+  if (!bruteforce_launch(&w->bf, &w->pool, batch->first_prefix, batch->count, nextafterf(batch->bound, INFINITY))) return false;
+  while (!thread_pool_is_done(&w->pool, w->bf.job)) {
+    if (!net_wait_readable(w->socket, 50)) continue;
+    search_msg_type_t type;
+    void *payload;
+    uint32_t size;
+    bool ok = search_msg_recv(w->socket, &type, &payload, &size);
+    free(payload);
+    if (!ok || type == SEARCH_MSG_BYE) w->quit = true;
+    if (!ok || type == SEARCH_MSG_BYE || type == SEARCH_MSG_CANCEL) {
+      bruteforce_cancel(&w->bf);
+      break;
+    }
+  }
+  bruteforce_wait(&w->bf);
+  // a batch with skipped prefixes goes back to the editor like a lost one
+  if (w->bf.failed) {
+    log_error(LOG_SOURCE, "Ran out of memory during a batch.");
+    return false;
+  }
+
+  result.nodes = w->bf.nodes;
+  if (w->bf.best_length > 0) {
+    result.score = w->bf.best_score;
+    result.length = w->bf.best_length;
+    memcpy(result.choices, w->bf.best_choices, w->bf.best_length * sizeof(int));
+  }
+  if (w->quit) return false;
+  return search_msg_send(w->socket, SEARCH_MSG_RESULT, &result, sizeof(result));
+}
+
+static void run(search_worker_t *w) {
+  search_msg_hello_t hello = {SEARCH_PROTOCOL_VERSION, sizeof(SCharacterCore), w->pool.worker_count};
+  if (!search_msg_send(w->socket, SEARCH_MSG_HELLO, &hello, sizeof(hello))) return;
+
+  while (!w->quit) {
+    search_msg_type_t type;
+    void *payload;
+    uint32_t size;
+    if (!search_msg_recv(w->socket, &type, &payload, &size)) break;
+
+    switch (type) {
+    case SEARCH_MSG_MAP:
+      // the physics handler takes ownership of the buffer
+      physics_init_from_memory(&w->physics, payload, size);
+      payload = NULL;
+      w->has_context = false;
+      if (!w->physics.loaded) log_error(LOG_SOURCE, "Failed to load the map sent by the editor.");
+      break;
+    case SEARCH_MSG_CONTEXT: handle_context(w, payload, size); break;
+    case SEARCH_MSG_BATCH:
+      if (size != sizeof(search_msg_batch_t) || !handle_batch(w, payload)) w->quit = true;
+      break;
+    case SEARCH_MSG_CANCEL: break; // the batch it was meant for already finished
+    case SEARCH_MSG_BYE: w->quit = true; break;
+    default: log_warn(LOG_SOURCE, "Ignoring message type %u.", (unsigned)type); break;
+    }
+    free(payload);
+  }
+}
+
+int search_worker_main(int argc, char **argv) {
+  const char *address = NULL;
+  int threads = 0;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], SEARCH_WORKER_FLAG) == 0 && i + 1 < argc) address = argv[++i];
+    else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) threads = atoi(argv[++i]);
+  }
+
+  char host[256];
+  int port;
+  if (!address || !net_parse_address(address, host, sizeof(host), &port)) {
+    log_error(LOG_SOURCE, "Usage: %s host:port [--threads N]", SEARCH_WORKER_FLAG);
+    return 1;
+  }
+  if (!net_init()) return 1;
+
+  static search_worker_t w;
+  w.socket = net_connect(host, port);
+  if (!w.socket) {
+    log_error(LOG_SOURCE, "Could not connect to %s:%d.", host, port);
+    net_cleanup();
+    return 1;
+  }
+  // the main thread only watches the socket, so every core gets a pool thread
+  if (!thread_pool_init(&w.pool, threads > 0 ? threads : thread_hardware_concurrency())) {
+    net_close(w.socket);
+    net_cleanup();
+    return 1;
+  }
+  log_info(LOG_SOURCE, "Connected to %s:%d with %d threads.", host, port, w.pool.worker_count);
+
+  run(&w);
+
+  bruteforce_free(&w.bf);
+  transposition_destroy(&w.table);
+  physics_free(&w.physics);
+  thread_pool_destroy(&w.pool);
+  net_close(w.socket);
+  net_cleanup();
+  log_info(LOG_SOURCE, "Disconnected.");
+  return 0;
+}
@@ -0,0 +1,10 @@
+#ifndef SEARCH_WORKER_H
+#define SEARCH_WORKER_H
+
+#define SEARCH_WORKER_FLAG "--search-worker"
+
+// Entry point of `frametee --search-worker host:port [--threads N]`. Connects to an editor,
+// runs the bruteforce batches it hands out and exits once the editor says bye or goes away.
+int search_worker_main(int argc, char **argv);
+
+#endif // SEARCH_WORKER_H
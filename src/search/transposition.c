@@ -0,0 +1,104 @@
+#include "transposition.h"
+#include <logger/logger.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *LOG_SOURCE = "Transposition";
+
+bool transposition_init(transposition_table_t *table, int size_mb, transposition_policy_t policy) {
+  memset(table, 0, sizeof(transposition_table_t));
+  size_t bytes = (size_t)(size_mb > 0 ? size_mb : 1) << 20;
+  size_t buckets = 1;
+  while (buckets * 2 * TRANSPOSITION_BUCKET_SIZE * sizeof(transposition_entry_t) <= bytes && buckets < (1u << 30))
+    buckets *= 2;
+
+  table->entries = calloc(buckets * TRANSPOSITION_BUCKET_SIZE, sizeof(transposition_entry_t));
+  if (!table->entries) {
+    log_error(LOG_SOURCE, "Failed to allocate %d MB.", size_mb);
+    return false;
+  }
+  table->bucket_count = (int)buckets;
+  table->policy = policy;
+  for (int i = 0; i < TRANSPOSITION_LOCK_STRIPES; ++i)
+    table->locks[i] = thread_mutex_create();
+  return true;
+}
+
+void transposition_destroy(transposition_table_t *table) {
+  free(table->entries);
+  for (int i = 0; i < TRANSPOSITION_LOCK_STRIPES; ++i)
+    thread_mutex_destroy(table->locks[i]);
+  memset(table, 0, sizeof(transposition_table_t));
+}
+
+// must not race with transposition_visit
+void transposition_clear(transposition_table_t *table) {
+  if (!table->entries) return;
+  memset(table->entries, 0, (size_t)table->bucket_count * TRANSPOSITION_BUCKET_SIZE * sizeof(transposition_entry_t));
+  memset(table->stripe_stats, 0, sizeof(table->stripe_stats));
+}
+
+bool transposition_visit(transposition_table_t *table, uint64_t key, int depth, int order) {
+  if (key == 0) key = 1;
+  int bucket_index = (int)(key & (uint64_t)(table->bucket_count - 1));
+  int stripe = bucket_index % TRANSPOSITION_LOCK_STRIPES;
+  transposition_entry_t *bucket = &table->entries[(size_t)bucket_index * TRANSPOSITION_BUCKET_SIZE];
+  transposition_stats_t *stats = &table->stripe_stats[stripe];
+
+  thread_mutex_lock(table->locks[stripe]);
+  ++stats->probes;
+  transposition_entry_t *empty = NULL, *victim = NULL;
+  for (int i = 0; i < TRANSPOSITION_BUCKET_SIZE; ++i) {
+    transposition_entry_t *entry = &bucket[i];
+    if (entry->key == key) {
+      bool seen = entry->depth < depth || (entry->depth == depth && entry->order <= order);
+      if (seen) {
+        ++stats->hits;
+      } else {
+        entry->depth = depth;
+        entry->order = order;
+      }
+      thread_mutex_unlock(table->locks[stripe]);
+      return seen;
+    }
+    if (entry->key == 0) {
+      if (!empty) empty = entry;
+    } else if (!victim || entry->depth > victim->depth) {
+      victim = entry;
+    }
+  }
+
+  if (empty) {
+    empty->key = key;
+    empty->depth = depth;
+    empty->order = order;
+    ++stats->stores;
+    thread_mutex_unlock(table->locks[stripe]);
+    return false;
+  }
+
+  if (table->policy == TRANSPOSITION_REPLACE_ALWAYS || victim->depth > depth) {
+    victim->key = key;
+    victim->depth = depth;
+    victim->order = order;
+    ++stats->replacements;
+  } else {
+    ++stats->rejected;
+  }
+  thread_mutex_unlock(table->locks[stripe]);
+  return false;
+}
+
+void transposition_get_stats(transposition_table_t *table, transposition_stats_t *out, float *fill) {
+  memset(out, 0, sizeof(transposition_stats_t));
+  for (int i = 0; i < TRANSPOSITION_LOCK_STRIPES && table->entries; ++i) {
+    thread_mutex_lock(table->locks[i]);
+    out->probes += table->stripe_stats[i].probes;
+    out->hits += table->stripe_stats[i].hits;
+    out->stores += table->stripe_stats[i].stores;
+    out->replacements += table->stripe_stats[i].replacements;
+    out->rejected += table->stripe_stats[i].rejected;
+    thread_mutex_unlock(table->locks[i]);
+  }
+  if (fill) *fill = table->entries ? (float)out->stores / (float)((long long)table->bucket_count * TRANSPOSITION_BUCKET_SIZE) : 0.0f;
+}
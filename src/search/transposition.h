@@ -0,0 +1,50 @@
+#ifndef TRANSPOSITION_H
+#define TRANSPOSITION_H
+
+#include <system/threading.h>
+#include <types.h>
+
+#define TRANSPOSITION_BUCKET_SIZE 4
+#define TRANSPOSITION_LOCK_STRIPES 64
+
+typedef enum {
+  TRANSPOSITION_REPLACE_ALWAYS,  // a full bucket drops one of its entries for every new state
+  TRANSPOSITION_REPLACE_SHALLOW, // a full bucket only makes room for states found on an earlier tick
+} transposition_policy_t;
+
+typedef struct {
+  uint64_t key; // 0 marks an empty slot
+  int depth;
+  int order;
+} transposition_entry_t;
+
+typedef struct {
+  long long probes;
+  long long hits;
+  long long stores;
+  long long replacements;
+  long long rejected;
+} transposition_stats_t;
+
+// Fixed size set of world fingerprints, shared by every search thread. Buckets are guarded by
+// striped locks so concurrent probes rarely wait on each other.
+struct transposition_table_t {
+  transposition_entry_t *entries;
+  int bucket_count; // power of two
+  transposition_policy_t policy;
+  thread_mutex_t *locks[TRANSPOSITION_LOCK_STRIPES];
+  transposition_stats_t stripe_stats[TRANSPOSITION_LOCK_STRIPES]; // guarded by the matching lock
+};
+
+bool transposition_init(transposition_table_t *table, int size_mb, transposition_policy_t policy);
+void transposition_destroy(transposition_table_t *table);
+void transposition_clear(transposition_table_t *table);
+
+// Returns true when the state was already seen at an earlier depth, or at the same depth with an
+// equal or lower `order`, and can be skipped. Otherwise remembers it at `depth` and `order`.
+// Concurrent callers get a result independent of scheduling only if the paths they search are
+// ranked by `order`, callers probing from one thread can pass 0.
+bool transposition_visit(transposition_table_t *table, uint64_t key, int depth, int order);
+void transposition_get_stats(transposition_table_t *table, transposition_stats_t *out, float *fill);
+
+#endif // TRANSPOSITION_H
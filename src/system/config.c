@@ -180,6 +180,11 @@ void config_load(ui_handler_t *ui) {
       ui->lod_bias = (float)lod_bias.u.fp64;
     }
 
+    toml_datum_t particle_budget = toml_get(graphics_settings, "particle_budget");
+    if (particle_budget.type == TOML_INT64 && particle_budget.u.int64 >= 0) {
+      ui->particle_budget = (int)particle_budget.u.int64;
+    }
+
     toml_datum_t bg_color = toml_get(graphics_settings, "bg_color");
     if (bg_color.type == TOML_ARRAY && bg_color.u.arr.size == 3) {
       for (int i = 0; i < 3; ++i) {
@@ -204,6 +209,32 @@ void config_load(ui_handler_t *ui) {
     }
   }
 
+  toml_datum_t undo_settings = toml_get(res.toptab, "undo");
+  if (undo_settings.type == TOML_TABLE) {
+    toml_datum_t budget = toml_get(undo_settings, "memory_budget_mb");
+    if (budget.type == TOML_INT64 && budget.u.int64 >= 0) {
+      ui->undo_manager.memory_budget = (size_t)budget.u.int64 * 1024 * 1024;
+    }
+
+    toml_datum_t spill = toml_get(undo_settings, "spill_to_disk");
+    if (spill.type == TOML_BOOLEAN) {
+      ui->undo_manager.spill_to_disk = spill.u.boolean;
+    }
+  }
+
+  toml_datum_t plugin_settings = toml_get(res.toptab, "plugins");
+  if (plugin_settings.type == TOML_TABLE) {
+    toml_datum_t budget = toml_get(plugin_settings, "frame_budget_ms");
+    if (budget.type == TOML_FP64 && budget.u.fp64 >= 0.0) {
+      ui->plugin_manager.frame_budget_ms = (float)budget.u.fp64;
+    }
+
+    toml_datum_t count_calls = toml_get(plugin_settings, "count_api_calls");
+    if (count_calls.type == TOML_BOOLEAN) {
+      ui->plugin_manager.count_api_calls = count_calls.u.boolean;
+    }
+  }
+
   toml_free(res);
   log_info(LOG_SOURCE, "Config loaded successfully from %s.", config_path);
 }
@@ -285,10 +316,19 @@ void config_save(ui_handler_t *ui) {
   fprintf(fp, "show_fps = %s\n", ui->show_fps ? "true" : "false");
   fprintf(fp, "fps_limit = %d\n", ui->fps_limit);
   fprintf(fp, "lod_bias = %.2f\n", ui->lod_bias);
+  fprintf(fp, "particle_budget = %d\n", ui->particle_budget);
   fprintf(fp, "bg_color = [%.3f, %.3f, %.3f]\n", ui->bg_color[0], ui->bg_color[1], ui->bg_color[2]);
   fprintf(fp, "prediction_alpha = [%.3f, %.3f]\n", ui->prediction_alpha[0], ui->prediction_alpha[1]);
   fprintf(fp, "center_dot = %s\n", ui->center_dot ? "true" : "false");
 
+  fprintf(fp, "\n[undo]\n");
+  fprintf(fp, "memory_budget_mb = %zu\n", ui->undo_manager.memory_budget / (1024 * 1024));
+  fprintf(fp, "spill_to_disk = %s\n", ui->undo_manager.spill_to_disk ? "true" : "false");
+
+  fprintf(fp, "\n[plugins]\n");
+  fprintf(fp, "frame_budget_ms = %.2f\n", ui->plugin_manager.frame_budget_ms);
+  fprintf(fp, "count_api_calls = %s\n", ui->plugin_manager.count_api_calls ? "true" : "false");
+
   fclose(fp);
   log_info(LOG_SOURCE, "Config saved to %s.", config_path);
 }
@@ -0,0 +1,163 @@
+#include "net_socket.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+typedef SOCKET socket_handle_t;
+#define INVALID_HANDLE INVALID_SOCKET
+#define close_handle closesocket
+#define SHUTDOWN_BOTH SD_BOTH
+
+bool net_init(void) {
+  WSADATA data;
+  return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+}
+void net_cleanup(void) { WSACleanup(); }
+
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+typedef int socket_handle_t;
+#define INVALID_HANDLE (-1)
+#define close_handle close
+#define SHUTDOWN_BOTH SHUT_RDWR
+
+bool net_init(void) {
+  signal(SIGPIPE, SIG_IGN); // a worker going away must not take the editor with it
+  return true;
+}
+void net_cleanup(void) {}
+#endif
+
+struct net_socket_t {
+  socket_handle_t handle;
+};
+
+static net_socket_t *wrap(socket_handle_t handle) {
+  if (handle == INVALID_HANDLE) return NULL;
+  net_socket_t *socket = malloc(sizeof(net_socket_t));
+  if (!socket) {
+    close_handle(handle);
+    return NULL;
+  }
+  socket->handle = handle;
+  return socket;
+}
+
+static bool make_address(const char *host, int port, struct sockaddr_in *out) {
+  memset(out, 0, sizeof(*out));
+  out->sin_family = AF_INET;
+  out->sin_port = htons((unsigned short)port);
+  return inet_pton(AF_INET, host, &out->sin_addr) == 1;
+}
+
+net_socket_t *net_listen(const char *host, int port, int *out_port) {
+  struct sockaddr_in address;
+  if (!make_address(host, port, &address)) return NULL;
+  socket_handle_t handle = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (handle == INVALID_HANDLE) return NULL;
+
+  int reuse = 1;
+  setsockopt(handle, SOL_SOCKET, SO_REUSEADDR, (const char *)&reuse, sizeof(reuse));
+  if (bind(handle, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(handle, 16) != 0) {
+    close_handle(handle);
+    return NULL;
+  }
+  if (out_port) {
+    socklen_t length = sizeof(address);
+    getsockname(handle, (struct sockaddr *)&address, &length);
+    *out_port = ntohs(address.sin_port);
+  }
+  return wrap(handle);
+}
+
+bool net_wait_readable(net_socket_t *socket, int timeout_ms) {
+  fd_set set;
+  FD_ZERO(&set);
+  FD_SET(socket->handle, &set);
+  struct timeval timeout = {timeout_ms / 1000, (timeout_ms % 1000) * 1000};
+  return select((int)socket->handle + 1, &set, NULL, NULL, &timeout) != 0;
+}
+
+net_socket_t *net_accept(net_socket_t *listener, int timeout_ms) {
+  if (!net_wait_readable(listener, timeout_ms)) return NULL;
+
+  socket_handle_t handle = accept(listener->handle, NULL, NULL);
+  if (handle == INVALID_HANDLE) return NULL;
+  int no_delay = 1;
+  setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, (const char *)&no_delay, sizeof(no_delay));
+  return wrap(handle);
+}
+
+net_socket_t *net_connect(const char *host, int port) {
+  struct sockaddr_in address;
+  if (!make_address(host, port, &address)) return NULL;
+  socket_handle_t handle = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (handle == INVALID_HANDLE) return NULL;
+  if (connect(handle, (struct sockaddr *)&address, sizeof(address)) != 0) {
+    close_handle(handle);
+    return NULL;
+  }
+  int no_delay = 1;
+  setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, (const char *)&no_delay, sizeof(no_delay));
+  return wrap(handle);
+}
+
+bool net_send_all(net_socket_t *socket, const void *data, size_t size) {
+  const char *p = data;
+  while (size > 0) {
+    int chunk = size > (1 << 30) ? (1 << 30) : (int)size;
+    int sent = (int)send(socket->handle, p, chunk, 0);
+    if (sent <= 0) return false;
+    p += sent;
+    size -= (size_t)sent;
+  }
+  return true;
+}
+
+bool net_recv_all(net_socket_t *socket, void *data, size_t size) {
+  char *p = data;
+  while (size > 0) {
+    int chunk = size > (1 << 30) ? (1 << 30) : (int)size;
+    int received = (int)recv(socket->handle, p, chunk, 0);
+    if (received <= 0) return false;
+    p += received;
+    size -= (size_t)received;
+  }
+  return true;
+}
+
+void net_shutdown(net_socket_t *socket) {
+  if (socket) shutdown(socket->handle, SHUTDOWN_BOTH);
+}
+
+void net_close(net_socket_t *socket) {
+  if (!socket) return;
+  close_handle(socket->handle);
+  free(socket);
+}
+
+bool net_parse_address(const char *address, char *host, size_t host_size, int *port) {
+  const char *colon = strrchr(address, ':');
+  if (!colon) {
+    snprintf(host, host_size, "127.0.0.1");
+    *port = atoi(address);
+  } else {
+    size_t length = (size_t)(colon - address);
+    if (length == 0 || length >= host_size) return false;
+    memcpy(host, address, length);
+    host[length] = '\0';
+    *port = atoi(colon + 1);
+  }
+  return *port > 0 && *port < 65536;
+}
@@ -0,0 +1,30 @@
+#ifndef NET_SOCKET_H
+#define NET_SOCKET_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Thin blocking TCP wrapper over BSD sockets and Winsock
+typedef struct net_socket_t net_socket_t;
+
+bool net_init(void);
+void net_cleanup(void);
+
+// port 0 picks a free one, the bound port is written to out_port
+net_socket_t *net_listen(const char *host, int port, int *out_port);
+// returns NULL when nobody connected within timeout_ms
+net_socket_t *net_accept(net_socket_t *listener, int timeout_ms);
+net_socket_t *net_connect(const char *host, int port);
+
+bool net_send_all(net_socket_t *socket, const void *data, size_t size);
+bool net_recv_all(net_socket_t *socket, void *data, size_t size);
+// true when a read would not block, that includes a closed or broken connection
+bool net_wait_readable(net_socket_t *socket, int timeout_ms);
+// wakes up a thread blocked on the socket, the socket still has to be closed
+void net_shutdown(net_socket_t *socket);
+void net_close(net_socket_t *socket);
+
+// splits "host:port", host falls back to 127.0.0.1 when only a port is given
+bool net_parse_address(const char *address, char *host, size_t host_size, int *port);
+
+#endif // NET_SOCKET_H
@@ -0,0 +1,115 @@
+#include "process.h"
+#include <logger/logger.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *LOG_SOURCE = "Process";
+
+static char g_argv0[4096];
+
+void process_set_argv0(const char *argv0) {
+  if (!argv0) return;
+  strncpy(g_argv0, argv0, sizeof(g_argv0) - 1);
+  g_argv0[sizeof(g_argv0) - 1] = '\0';
+}
+
+#ifdef _WIN32
+#include <windows.h>
+
+struct process_t {
+  PROCESS_INFORMATION info;
+};
+
+process_t *process_spawn_self(const char *const *args) {
+  char path[MAX_PATH];
+  if (GetModuleFileNameA(NULL, path, sizeof(path)) == 0) return NULL;
+
+  // windows wants a single command line, quote every argument
+  char command_line[8192];
+  int length = snprintf(command_line, sizeof(command_line), "\"%s\"", path);
+  for (int i = 0; args[i] && length < (int)sizeof(command_line); ++i)
+    length += snprintf(command_line + length, sizeof(command_line) - length, " \"%s\"", args[i]);
+  if (length >= (int)sizeof(command_line)) return NULL;
+
+  process_t *process = calloc(1, sizeof(process_t));
+  if (!process) return NULL;
+  STARTUPINFOA startup = {sizeof(STARTUPINFOA)};
+  if (!CreateProcessA(path, command_line, NULL, NULL, FALSE, CREATE_NO_WINDOW, NULL, NULL, &startup, &process->info)) {
+    log_error(LOG_SOURCE, "Failed to start '%s' (error %lu).", path, GetLastError());
+    free(process);
+    return NULL;
+  }
+  CloseHandle(process->info.hThread);
+  return process;
+}
+
+void process_wait(process_t *process) {
+  if (!process) return;
+  WaitForSingleObject(process->info.hProcess, INFINITE);
+  CloseHandle(process->info.hProcess);
+  free(process);
+}
+
+#else
+#include <spawn.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifdef __APPLE__
+#include <mach-o/dyld.h>
+#endif
+
+extern char **environ;
+
+struct process_t {
+  pid_t pid;
+};
+
+static bool executable_path(char *buffer, size_t size) {
+#if defined(__linux__)
+  ssize_t length = readlink("/proc/self/exe", buffer, size - 1);
+  if (length > 0) {
+    buffer[length] = '\0';
+    return true;
+  }
+#elif defined(__APPLE__)
+  uint32_t length = (uint32_t)size;
+  if (_NSGetExecutablePath(buffer, &length) == 0) return true;
+#endif
+  if (!g_argv0[0]) return false;
+  snprintf(buffer, size, "%s", g_argv0);
+  return true;
+}
+
+process_t *process_spawn_self(const char *const *args) {
+  char path[4096];
+  if (!executable_path(path, sizeof(path))) return NULL;
+
+  int count = 0;
+  while (args[count])
+    ++count;
+  char **argv = calloc(count + 2, sizeof(char *));
+  if (!argv) return NULL;
+  argv[0] = path;
+  for (int i = 0; i < count; ++i)
+    argv[i + 1] = (char *)args[i];
+
+  process_t *process = calloc(1, sizeof(process_t));
+  int result = process ? posix_spawnp(&process->pid, path, NULL, NULL, argv, environ) : -1;
+  free(argv);
+  if (result != 0) {
+    log_error(LOG_SOURCE, "Failed to start '%s' (%d).", path, result);
+    free(process);
+    return NULL;
+  }
+  return process;
+}
+
+void process_wait(process_t *process) {
+  if (!process) return;
+  int status;
+  waitpid(process->pid, &status, 0);
+  free(process);
+}
+#endif
@@ -0,0 +1,16 @@
+#ifndef PROCESS_H
+#define PROCESS_H
+
+#include <stdbool.h>
+
+// child processes of this executable, e.g. search workers
+typedef struct process_t process_t;
+
+// remembers argv[0] as a fallback for platforms without a way to query the executable path
+void process_set_argv0(const char *argv0);
+// starts this executable again with `args` (NULL terminated, without the program name)
+process_t *process_spawn_self(const char *const *args);
+// blocks until the process exited and frees the handle
+void process_wait(process_t *process);
+
+#endif // PROCESS_H
@@ -0,0 +1,223 @@
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 199309L // clock_gettime
+#endif
+#include "profiler.h"
+#include "threading.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef FRAMETEE_TRACY
+#include <tracy/TracyC.h>
+#endif
+
+#ifdef _WIN32
+#include <windows.h>
+#define THREAD_LOCAL __declspec(thread)
+#else
+#include <time.h>
+#define THREAD_LOCAL __thread
+#endif
+
+typedef struct {
+  const char *name;
+  uint64_t start_ns;
+#ifdef FRAMETEE_TRACY
+  TracyCZoneCtx tracy;
+#endif
+} open_zone_t;
+
+// Written by its own thread only. The lock is uncontended except for the reader copying zones
+// out once per frame.
+typedef struct {
+  thread_mutex_t *lock;
+  profiler_zone_t zones[PROFILER_RING_SIZE];
+  uint32_t written;
+  const char *name;
+  open_zone_t stack[PROFILER_MAX_DEPTH];
+  int depth;
+  int suppressed; // zones opened while disabled or too deep, their end is ignored
+  int index;
+} thread_buffer_t;
+
+static thread_mutex_t *g_registry_lock;
+static thread_buffer_t *g_threads[PROFILER_MAX_THREADS];
+static int g_thread_count;
+static uint64_t g_frames[PROFILER_FRAME_HISTORY]; // guarded by g_registry_lock
+static uint32_t g_frames_written;
+static volatile bool g_enabled = true;
+static THREAD_LOCAL thread_buffer_t *t_buffer;
+static THREAD_LOCAL const char *t_pending_name;
+static THREAD_LOCAL bool t_registration_failed;
+
+uint64_t profiler_now_ns(void) {
+#ifdef _WIN32
+  static LARGE_INTEGER frequency;
+  LARGE_INTEGER counter;
+  if (frequency.QuadPart == 0) QueryPerformanceFrequency(&frequency);
+  QueryPerformanceCounter(&counter);
+  return (uint64_t)((double)counter.QuadPart * 1e9 / (double)frequency.QuadPart);
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+void profiler_init(void) {
+  if (!g_registry_lock) g_registry_lock = thread_mutex_create();
+}
+
+void profiler_shutdown(void) {
+  for (int i = 0; i < g_thread_count; ++i) {
+    thread_mutex_destroy(g_threads[i]->lock);
+    free(g_threads[i]);
+    g_threads[i] = NULL;
+  }
+  g_thread_count = 0;
+  thread_mutex_destroy(g_registry_lock);
+  g_registry_lock = NULL;
+}
+
+static thread_buffer_t *current_buffer(void) {
+  if (t_buffer || t_registration_failed || !g_registry_lock) return t_buffer;
+
+  thread_buffer_t *buffer = calloc(1, sizeof(thread_buffer_t));
+  if (buffer) buffer->lock = thread_mutex_create();
+  thread_mutex_lock(g_registry_lock);
+  bool full = g_thread_count >= PROFILER_MAX_THREADS;
+  if (buffer && buffer->lock && !full) {
+    buffer->index = g_thread_count;
+    buffer->name = t_pending_name;
+    g_threads[g_thread_count++] = buffer;
+  }
+  thread_mutex_unlock(g_registry_lock);
+  if (!buffer || !buffer->lock || full) {
+    if (buffer) thread_mutex_destroy(buffer->lock);
+    free(buffer);
+    t_registration_failed = true;
+    return NULL;
+  }
+  t_buffer = buffer;
+  return buffer;
+}
+
+void profiler_set_thread_name(const char *name) {
+  t_pending_name = name;
+  thread_buffer_t *buffer = current_buffer();
+  if (buffer) {
+    thread_mutex_lock(buffer->lock);
+    buffer->name = name;
+    thread_mutex_unlock(buffer->lock);
+  }
+#ifdef FRAMETEE_TRACY
+  ___tracy_set_thread_name(name);
+#endif
+}
+
+void profiler_set_enabled(bool enabled) { g_enabled = enabled; }
+bool profiler_is_enabled(void) { return g_enabled; }
+
+// Recording
+
+void profiler_begin(const char *name, const char *file, int line) {
+  thread_buffer_t *buffer = current_buffer();
+  if (!buffer) return;
+  if (!g_enabled || buffer->suppressed > 0 || buffer->depth >= PROFILER_MAX_DEPTH) {
+    ++buffer->suppressed;
+    return;
+  }
+  open_zone_t *zone = &buffer->stack[buffer->depth++];
+  zone->name = name;
+#ifdef FRAMETEE_TRACY
+  uint64_t srcloc = ___tracy_alloc_srcloc_name(line, file, strlen(file), name, strlen(name), name, strlen(name), 0);
+  zone->tracy = ___tracy_emit_zone_begin_alloc(srcloc, 1);
+#else
+  (void)file;
+  (void)line;
+#endif
+  zone->start_ns = profiler_now_ns();
+}
+
+void profiler_end(void) {
+  uint64_t now = profiler_now_ns();
+  thread_buffer_t *buffer = t_buffer;
+  if (!buffer) return;
+  if (buffer->suppressed > 0) {
+    --buffer->suppressed;
+    return;
+  }
+  if (buffer->depth == 0) return;
+
+  open_zone_t *zone = &buffer->stack[--buffer->depth];
+#ifdef FRAMETEE_TRACY
+  ___tracy_emit_zone_end(zone->tracy);
+#endif
+  profiler_zone_t record = {zone->name, zone->start_ns, now, (uint8_t)buffer->depth, (uint8_t)buffer->index};
+  thread_mutex_lock(buffer->lock);
+  buffer->zones[buffer->written % PROFILER_RING_SIZE] = record;
+  ++buffer->written;
+  thread_mutex_unlock(buffer->lock);
+}
+
+void profiler_frame_mark(void) {
+  if (!g_registry_lock || !g_enabled) return;
+  uint64_t now = profiler_now_ns();
+  thread_mutex_lock(g_registry_lock);
+  g_frames[g_frames_written % PROFILER_FRAME_HISTORY] = now;
+  ++g_frames_written;
+  thread_mutex_unlock(g_registry_lock);
+#ifdef FRAMETEE_TRACY
+  ___tracy_emit_frame_mark(NULL);
+#endif
+}
+
+// Reading
+
+int profiler_thread_count(void) {
+  if (!g_registry_lock) return 0;
+  thread_mutex_lock(g_registry_lock);
+  int count = g_thread_count;
+  thread_mutex_unlock(g_registry_lock);
+  return count;
+}
+
+const char *profiler_thread_name(int thread) {
+  static char fallback[32];
+  const char *name = NULL;
+  if (g_registry_lock && thread >= 0) {
+    thread_mutex_lock(g_registry_lock);
+    if (thread < g_thread_count) name = g_threads[thread]->name;
+    thread_mutex_unlock(g_registry_lock);
+  }
+  if (name) return name;
+  snprintf(fallback, sizeof(fallback), "Thread %d", thread);
+  return fallback;
+}
+
+int profiler_collect(profiler_zone_t *out, int capacity, uint64_t since_ns) {
+  int count = 0;
+  int threads = profiler_thread_count();
+  for (int t = 0; t < threads && count < capacity; ++t) {
+    thread_buffer_t *buffer = g_threads[t];
+    thread_mutex_lock(buffer->lock);
+    uint32_t available = buffer->written < PROFILER_RING_SIZE ? buffer->written : PROFILER_RING_SIZE;
+    for (uint32_t i = buffer->written - available; i != buffer->written && count < capacity; ++i) {
+      const profiler_zone_t *zone = &buffer->zones[i % PROFILER_RING_SIZE];
+      if (zone->end_ns > since_ns) out[count++] = *zone;
+    }
+    thread_mutex_unlock(buffer->lock);
+  }
+  return count;
+}
+
+int profiler_collect_frames(uint64_t *out, int capacity) {
+  if (!g_registry_lock) return 0;
+  thread_mutex_lock(g_registry_lock);
+  uint32_t available = g_frames_written < PROFILER_FRAME_HISTORY ? g_frames_written : PROFILER_FRAME_HISTORY;
+  if ((uint32_t)capacity < available) available = (uint32_t)capacity;
+  for (uint32_t i = 0; i < available; ++i)
+    out[i] = g_frames[(g_frames_written - available + i) % PROFILER_FRAME_HISTORY];
+  thread_mutex_unlock(g_registry_lock);
+  return (int)available;
+}
@@ -0,0 +1,52 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <types.h>
+
+// Instrumentation zones for the hot paths of the editor. Every thread writes finished zones into
+// its own ring buffer, the profiler window reads them back. Zones must be closed on every return
+// path; names must be string literals since only the pointer is stored.
+#ifndef FRAMETEE_NO_PROFILER
+#define PROFILE_BEGIN(name) profiler_begin(name, __FILE__, __LINE__)
+#define PROFILE_END() profiler_end()
+#define PROFILE_FRAME() profiler_frame_mark()
+#else
+#define PROFILE_BEGIN(name) ((void)0)
+#define PROFILE_END() ((void)0)
+#define PROFILE_FRAME() ((void)0)
+#endif
+
+#define PROFILER_MAX_THREADS 72
+#define PROFILER_RING_SIZE 8192 // finished zones kept per thread
+#define PROFILER_MAX_DEPTH 32
+#define PROFILER_FRAME_HISTORY 256
+
+typedef struct {
+  const char *name;
+  uint64_t start_ns;
+  uint64_t end_ns;
+  uint8_t depth;
+  uint8_t thread;
+} profiler_zone_t;
+
+// init must run before any other thread starts, zones recorded before it are dropped
+void profiler_init(void);
+void profiler_shutdown(void);
+
+void profiler_begin(const char *name, const char *file, int line);
+void profiler_end(void);
+void profiler_frame_mark(void);
+// names the calling thread in the profiler window, the string must outlive the thread
+void profiler_set_thread_name(const char *name);
+void profiler_set_enabled(bool enabled);
+bool profiler_is_enabled(void);
+uint64_t profiler_now_ns(void);
+
+int profiler_thread_count(void);
+const char *profiler_thread_name(int thread);
+// copies the zones that ended after `since_ns`, oldest first per thread, returns the count
+int profiler_collect(profiler_zone_t *out, int capacity, uint64_t since_ns);
+// start times of the most recent frames, newest last, returns the count
+int profiler_collect_frames(uint64_t *out, int capacity);
+
+#endif // PROFILER_H
@@ -3,6 +3,8 @@
 #include <logger/logger.h>
 #include <renderer/graphics_backend.h>
 #include <renderer/renderer.h>
+#include <system/profiler.h>
+#include <system/snapshot_cache.h>
 #include <user_interface/net_events.h>
 #include <user_interface/timeline/timeline_model.h>
 
@@ -23,9 +25,11 @@ static bool read_and_load_timeline(FILE *f, ui_handler_t *ui, uint32_t version);
 
 // Saving {{{
 bool save_project(ui_handler_t *ui, const char *path) {
+  PROFILE_BEGIN("save_project");
   FILE *f = fopen(path, "wb");
   if (!f) {
     log_error(LOG_SOURCE, "Failed to open file for writing: '%s'", path);
+    PROFILE_END();
     return false;
   }
 
@@ -37,6 +41,7 @@ bool save_project(ui_handler_t *ui, const char *path) {
   long map_start = ftell(f);
   if (!write_map_data(f, &ui->gfx_handler->physics_handler)) {
     fclose(f);
+    PROFILE_END();
     return false;
   }
   header.map_data_size = ftell(f) - map_start;
@@ -44,6 +49,7 @@ bool save_project(ui_handler_t *ui, const char *path) {
   // write skin data
   if (!write_skin_data(f, ui)) {
     fclose(f);
+    PROFILE_END();
     return false;
   }
   header.num_skins = ui->skin_manager.num_skins;
@@ -52,6 +58,7 @@ bool save_project(ui_handler_t *ui, const char *path) {
   long timeline_start = ftell(f);
   if (!write_timeline_data(f, &ui->timeline)) {
     fclose(f);
+    PROFILE_END();
     return false;
   }
   header.timeline_data_size = ftell(f) - timeline_start;
@@ -65,6 +72,10 @@ bool save_project(ui_handler_t *ui, const char *path) {
 
   fclose(f);
   log_info(LOG_SOURCE, "Project saved successfully to '%s'", path);
+
+  // the snapshot cache is optional, a failure here doesn't invalidate the project
+  snapshot_cache_save(ui, path);
+  PROFILE_END();
   return true;
 }
 
@@ -218,6 +229,8 @@ bool load_project(ui_handler_t *ui, const char *path) {
   log_info(LOG_SOURCE, "Project loaded successfully from '%s'", path);
 
   model_recalc_physics(&ui->timeline, 0); // recalculate physics from the start
+  snapshot_cache_load(ui, path); // then skip ahead with whatever keyframes are still valid
+  ui->timeline.project_loaded = true;
   return true;
 }
 
@@ -238,45 +251,82 @@ static bool read_and_load_map(FILE *f, ui_handler_t *ui, uint32_t map_data_size)
   return true;
 }
 
+typedef struct {
+  skin_file_header_t header;
+  unsigned char *texture_data;
+  decoded_skin_t decoded;
+  bool decoded_ok;
+} pending_skin_t;
+
+static void decode_skins_job(void *user_data, int begin, int end) {
+  pending_skin_t *skins = user_data;
+  for (int i = begin; i < end; ++i)
+    skins[i].decoded_ok = renderer_decode_skin(skins[i].texture_data, skins[i].header.texture_data_size, true, &skins[i].decoded);
+}
+
+// Reads every skin first, decodes them in parallel on the thread pool, then uploads them in order
 static bool read_and_load_skins(FILE *f, ui_handler_t *ui, uint32_t num_skins) {
-  for (uint32_t i = 0; i < num_skins; i++) {
-    skin_file_header_t skin_header;
-    if (fread(&skin_header, sizeof(skin_file_header_t), 1, f) != 1) {
+  if (num_skins == 0) return true;
+  pending_skin_t *skins = calloc(num_skins, sizeof(pending_skin_t));
+  if (!skins) {
+    log_error(LOG_SOURCE, "Failed to allocate memory for %u skins.", num_skins);
+    return false;
+  }
+
+  bool ok = true;
+  for (uint32_t i = 0; i < num_skins && ok; i++) {
+    pending_skin_t *skin = &skins[i];
+    if (fread(&skin->header, sizeof(skin_file_header_t), 1, f) != 1) {
       log_error(LOG_SOURCE, "Failed to read skin header %u.", i);
-      return false;
+      ok = false;
+      break;
     }
 
-    unsigned char *texture_data = malloc(skin_header.texture_data_size);
-    if (!texture_data) {
+    skin->texture_data = malloc(skin->header.texture_data_size);
+    if (!skin->texture_data) {
       log_error(LOG_SOURCE, "Failed to allocate memory for skin texture %u.", i);
-      return false;
+      ok = false;
+      break;
     }
 
-    if (fread(texture_data, skin_header.texture_data_size, 1, f) != 1) {
+    if (fread(skin->texture_data, skin->header.texture_data_size, 1, f) != 1) {
       log_error(LOG_SOURCE, "Failed to read skin texture data for skin %u.", i);
-      free(texture_data);
-      return false;
+      ok = false;
     }
+  }
+  if (!ok) {
+    for (uint32_t i = 0; i < num_skins; i++)
+      free(skins[i].texture_data);
+    free(skins);
+    return false;
+  }
+
+  job_handle_t job = thread_pool_parallel_for(&ui->thread_pool, (int)num_skins, 1, decode_skins_job, skins);
+  if (job == JOB_HANDLE_INVALID) decode_skins_job(skins, 0, (int)num_skins);
+  else thread_pool_wait(&ui->thread_pool, job);
 
+  for (uint32_t i = 0; i < num_skins; i++) {
+    pending_skin_t *skin = &skins[i];
     skin_info_t info = {0};
-    int loaded_id = renderer_load_skin_from_memory(ui->gfx_handler, texture_data, skin_header.texture_data_size, &info.preview_texture_res);
+    int loaded_id = skin->decoded_ok ? renderer_upload_decoded_skin(ui->gfx_handler, &skin->decoded, &info.preview_texture_res) : -1;
 
     // Store the data in the info structure for future saves
-    info.data = texture_data;
-    info.data_size = skin_header.texture_data_size;
+    info.data = skin->texture_data;
+    info.data_size = skin->header.texture_data_size;
 
     if (loaded_id >= 0) {
       info.id = loaded_id;
-      strncpy(info.name, skin_header.name, sizeof(info.name) - 1);
+      strncpy(info.name, skin->header.name, sizeof(info.name) - 1);
       if (info.preview_texture_res) {
         info.preview_texture = ImTextureRef_ImTextureRef_TextureID((ImTextureID)ImGui_ImplVulkan_AddTexture(
             info.preview_texture_res->sampler, info.preview_texture_res->image_view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL));
       }
       skin_manager_add(&ui->skin_manager, &info);
     } else {
-      free(texture_data);
+      free(skin->texture_data);
     }
   }
+  free(skins);
   return true;
 }
 
@@ -0,0 +1,275 @@
+#include "snapshot_cache.h"
+#include <ddnet_physics/gamecore.h>
+#include <logger/logger.h>
+#include <physics/event_log.h>
+#include <renderer/graphics_backend.h>
+#include <user_interface/timeline/timeline_model.h>
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *LOG_SOURCE = "SnapshotCache";
+
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+static uint64_t fnv_update(uint64_t h, const void *data, size_t size) {
+  const uint8_t *p = data;
+  for (size_t i = 0; i < size; ++i) {
+    h ^= p[i];
+    h *= FNV_PRIME;
+  }
+  return h;
+}
+
+static uint64_t fnv_int(uint64_t h, int v) { return fnv_update(h, &v, sizeof(v)); }
+
+static void get_cache_path(char *buffer, size_t size, const char *project_path) {
+  snprintf(buffer, size, "%s%s", project_path, SNAPSHOT_CACHE_EXTENSION);
+}
+
+static uint64_t hash_map(physics_handler_t *ph) {
+  return fnv_update(FNV_OFFSET, ph->collision.m_MapData._map_file_data, ph->collision.m_MapData._map_file_size);
+}
+
+// everything that shapes the initial world besides the map itself
+static uint64_t hash_initial_state(timeline_state_t *ts) {
+  uint64_t h = fnv_int(FNV_OFFSET, ts->player_track_count);
+  for (int i = 0; i < ts->player_track_count; ++i) {
+    const starting_config_t *sc = &ts->player_tracks[i].starting_config;
+    h = fnv_int(h, sc->enabled);
+    if (!sc->enabled) continue;
+    h = fnv_update(h, sc->position, sizeof(sc->position));
+    h = fnv_update(h, sc->velocity, sizeof(sc->velocity));
+    h = fnv_int(h, sc->active_weapon);
+    for (int w = 0; w < NUM_WEAPONS; ++w)
+      h = fnv_int(h, sc->has_weapons[w]);
+  }
+  return h;
+}
+
+// hashed field by field so struct padding never leaks into the result
+static uint64_t hash_input(uint64_t h, const SPlayerInput *in) {
+  h = fnv_int(h, in->m_Direction);
+  h = fnv_int(h, in->m_TargetX);
+  h = fnv_int(h, in->m_TargetY);
+  h = fnv_int(h, in->m_Jump);
+  h = fnv_int(h, in->m_Fire);
+  h = fnv_int(h, in->m_Hook);
+  h = fnv_int(h, in->m_WantedWeapon);
+  h = fnv_int(h, in->m_TeleOut);
+  h = fnv_int(h, in->m_Flags);
+  return h;
+}
+
+// Advances the running input hash from tick `from` up to (excluding) tick `to`.
+static uint64_t hash_inputs_until(timeline_state_t *ts, uint64_t h, int from, int to) {
+  for (int t = from; t < to; ++t) {
+    for (int p = 0; p < ts->player_track_count; ++p) {
+      SPlayerInput input = model_get_input_at_tick(ts, p, t);
+      h = hash_input(h, &input);
+    }
+  }
+  return h;
+}
+
+static bool world_has_entities(const SWorldCore *world) {
+  for (int type = 0; type < NUM_WORLD_ENTTYPES; ++type)
+    if (world->m_apFirstEntityTypes[type]) return true;
+  return false;
+}
+
+// what load makes of a keyframe: world 0 (copied into `world` beforehand) with its characters
+static void restore_characters(SWorldCore *world, const SCharacterCore *characters, int game_tick) {
+  world->m_GameTick = game_tick;
+  for (int c = 0; c < world->m_NumCharacters; ++c) {
+    SCharacterCore *core = &world->m_pCharacters[c];
+    SWorldCore *owner = core->m_pWorld;
+    SCollision *collision = core->m_pCollision;
+    *core = characters[c];
+    core->m_pWorld = owner;
+    core->m_pCollision = collision;
+  }
+  // positions moved, let the accelerator rebuild its tee grid
+  int size = world->m_pCollision->m_MapData.width * world->m_pCollision->m_MapData.height;
+  memset(world->m_Accelerator.m_pGrid->m_pTeeGrid, -1, size * sizeof(int));
+  world->m_Accelerator.hash = 0;
+}
+
+// Only the characters and the tick of a keyframe are stored, the rest of the world comes from world
+// 0 on load. Switch states are world state too, so maps with switches aren't cached at all.
+static bool map_has_switches(physics_handler_t *ph) { return ph->collision.m_MapData.switch_layer.type != NULL; }
+
+bool snapshot_cache_save(ui_handler_t *ui, const char *project_path) {
+  timeline_state_t *ts = &ui->timeline;
+  physics_handler_t *ph = &ui->gfx_handler->physics_handler;
+  if (!ph->loaded || ts->player_track_count <= 0) return false;
+
+  // keyframe 0 is rebuilt from the map on load, so only the ones after it are worth storing.
+  // entities (projectiles, lasers) hold pointer graphs we can't rebind, so the cache ends at the
+  // first keyframe that has any.
+  uint32_t num_keyframes = 0;
+  for (uint32_t i = 1; i < ts->vec.current_size && !map_has_switches(ph); ++i) {
+    if (world_has_entities(&ts->vec.data[i]) || ts->vec.data[i].m_NumCharacters != ts->player_track_count) break;
+    ++num_keyframes;
+  }
+
+  char path[4096];
+  get_cache_path(path, sizeof(path), project_path);
+  if (num_keyframes == 0) {
+    remove(path); // don't leave a cache from an older save around
+    return true;
+  }
+
+  FILE *f = fopen(path, "wb");
+  if (!f) {
+    log_error(LOG_SOURCE, "Failed to open cache for writing: '%s'", path);
+    return false;
+  }
+
+  // memset so no padding or stale memory ends up in the file
+  snapshot_cache_header_t header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, SNAPSHOT_CACHE_FILE_MAGIC, 4);
+  header.version = SNAPSHOT_CACHE_FILE_VERSION;
+  header.physics_version = SNAPSHOT_CACHE_PHYSICS_VERSION;
+  header.character_size = sizeof(SCharacterCore);
+  header.map_hash = hash_map(ph);
+  header.num_characters = ts->player_track_count;
+  header.num_keyframes = num_keyframes;
+  header.keyframe_step = PHYSICS_SNAPSHOT_STEP;
+  // the timeline log starts at tick 0, events are only worth keeping up to the last keyframe,
+  // later ones would be ticked again anyway
+  const event_log_t *log = &ts->event_log;
+  header.num_event_ticks = imin(log->tick_count, ts->vec.data[num_keyframes].m_GameTick);
+  header.num_events = header.num_event_ticks ? log->tick_end[header.num_event_ticks - 1] : 0;
+  fwrite(&header, sizeof(header), 1, f);
+  fwrite(log->tick_end, sizeof(int), header.num_event_ticks, f);
+  fwrite(log->events, sizeof(game_event_t), header.num_events, f);
+
+  // characters are written without their world and collision pointers, load rebinds those anyway
+  SCharacterCore *characters = malloc(sizeof(SCharacterCore) * header.num_characters);
+  if (!characters) {
+    fclose(f);
+    remove(path);
+    return false;
+  }
+  uint64_t h = hash_initial_state(ts);
+  int hashed_until = 0;
+  for (uint32_t i = 1; i <= num_keyframes; ++i) {
+    const SWorldCore *world = &ts->vec.data[i];
+    h = hash_inputs_until(ts, h, hashed_until, world->m_GameTick);
+    hashed_until = world->m_GameTick;
+
+    snapshot_cache_keyframe_t kf;
+    memset(&kf, 0, sizeof(kf));
+    kf.game_tick = world->m_GameTick;
+    kf.input_hash = h;
+    fwrite(&kf, sizeof(kf), 1, f);
+    memcpy(characters, world->m_pCharacters, sizeof(SCharacterCore) * header.num_characters);
+    for (uint32_t c = 0; c < header.num_characters; ++c) {
+      characters[c].m_pWorld = NULL;
+      characters[c].m_pCollision = NULL;
+    }
+    fwrite(characters, sizeof(SCharacterCore), header.num_characters, f);
+  }
+
+  free(characters);
+  fclose(f);
+  log_info(LOG_SOURCE, "Stored %u physics keyframes in '%s'", num_keyframes, path);
+  return true;
+}
+
+bool snapshot_cache_load(ui_handler_t *ui, const char *project_path) {
+  timeline_state_t *ts = &ui->timeline;
+  physics_handler_t *ph = &ui->gfx_handler->physics_handler;
+
+  char path[4096];
+  get_cache_path(path, sizeof(path), project_path);
+  FILE *f = fopen(path, "rb");
+  if (!f) return false; // no cache is not an error
+
+  snapshot_cache_header_t header;
+  if (fread(&header, sizeof(header), 1, f) != 1 || strncmp(header.magic, SNAPSHOT_CACHE_FILE_MAGIC, 4) != 0 ||
+      header.version != SNAPSHOT_CACHE_FILE_VERSION || header.num_event_ticks > INT_MAX / sizeof(int) ||
+      header.num_events > INT_MAX / sizeof(game_event_t)) {
+    log_warn(LOG_SOURCE, "Ignoring invalid snapshot cache '%s'", path);
+    fclose(f);
+    return false;
+  }
+  if (header.physics_version != SNAPSHOT_CACHE_PHYSICS_VERSION || header.character_size != sizeof(SCharacterCore) ||
+      header.keyframe_step != PHYSICS_SNAPSHOT_STEP || header.map_hash != hash_map(ph) ||
+      header.num_characters != (uint32_t)ts->player_track_count || map_has_switches(ph)) {
+    log_info(LOG_SOURCE, "Snapshot cache '%s' is stale, ignoring it.", path);
+    fclose(f);
+    return false;
+  }
+
+  // events are read up front and installed once it is known how many keyframes are still valid
+  SCharacterCore *characters = malloc(sizeof(SCharacterCore) * header.num_characters);
+  int *tick_end = malloc(sizeof(int) * ((size_t)header.num_event_ticks + 1));
+  game_event_t *events = malloc(sizeof(game_event_t) * ((size_t)header.num_events + 1));
+  bool events_valid = tick_end && events && fread(tick_end, sizeof(int), header.num_event_ticks, f) == header.num_event_ticks &&
+                      fread(events, sizeof(game_event_t), header.num_events, f) == header.num_events;
+  if (!characters || !events_valid) {
+    free(characters);
+    free(tick_end);
+    free(events);
+    fclose(f);
+    return false;
+  }
+  for (uint32_t i = 0; i < header.num_event_ticks && events_valid; ++i)
+    events_valid = tick_end[i] >= (i ? tick_end[i - 1] : 0) && tick_end[i] <= (int)header.num_events;
+
+  // restoring resets the tee grid of the copy, which must not be the one of world 0 or the live world
+  SWorldCore world = wc_empty();
+  wc_copy_world(&world, &ts->vec.data[0]);
+  const void *grid = world.m_Accelerator.m_pGrid;
+  if (!grid || grid == ts->vec.data[0].m_Accelerator.m_pGrid || grid == ph->world.m_Accelerator.m_pGrid) {
+    log_error(LOG_SOURCE, "Copied world shares its tee grid, not restoring '%s'.", path);
+    wc_free(&world);
+    free(characters);
+    free(tick_end);
+    free(events);
+    fclose(f);
+    return false;
+  }
+
+  uint64_t h = hash_initial_state(ts);
+  int hashed_until = 0;
+  uint32_t restored = 0;
+  for (uint32_t i = 1; i <= header.num_keyframes; ++i) {
+    snapshot_cache_keyframe_t kf;
+    if (fread(&kf, sizeof(kf), 1, f) != 1) break;
+    if (fread(characters, sizeof(SCharacterCore), header.num_characters, f) != header.num_characters) break;
+    if (kf.game_tick != (int)(i * PHYSICS_SNAPSHOT_STEP)) break;
+
+    // the first keyframe whose inputs changed since the save invalidates itself and all after it
+    h = hash_inputs_until(ts, h, hashed_until, kf.game_tick);
+    hashed_until = kf.game_tick;
+    if (h != kf.input_hash) break;
+
+    restore_characters(&world, characters, kf.game_tick);
+    model_push_snapshot(ts, &world);
+    ++restored;
+  }
+
+  wc_free(&world);
+  free(characters);
+  fclose(f);
+
+  // events of a tick depend on the inputs up to it, the ones before the last valid keyframe still hold
+  int event_ticks = events_valid ? imin((int)header.num_event_ticks, (int)(restored * PHYSICS_SNAPSHOT_STEP)) : 0;
+  if (event_ticks > 0 && event_log_end(&ts->event_log) < event_ticks)
+    event_log_assign(&ts->event_log, 0, tick_end, event_ticks, events, tick_end[event_ticks - 1]);
+  free(tick_end);
+  free(events);
+
+  if (restored < header.num_keyframes)
+    log_info(LOG_SOURCE, "Restored %u of %u cached keyframes, the rest were stale.", restored, header.num_keyframes);
+  else
+    log_info(LOG_SOURCE, "Restored %u cached keyframes.", restored);
+  return restored > 0;
+}
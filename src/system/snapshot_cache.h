@@ -0,0 +1,40 @@
+#ifndef SNAPSHOT_CACHE_H
+#define SNAPSHOT_CACHE_H
+
+#include <types.h>
+#include <user_interface/user_interface.h>
+
+#define SNAPSHOT_CACHE_FILE_MAGIC "TASC"
+#define SNAPSHOT_CACHE_FILE_VERSION 3
+// bump whenever ddnet_physics changes in a way that makes old snapshots diverge
+#define SNAPSHOT_CACHE_PHYSICS_VERSION 1
+#define SNAPSHOT_CACHE_EXTENSION ".cache"
+
+// header of the sidecar file written next to a project ("<project>.cache")
+struct snapshot_cache_header_t {
+  char magic[4];
+  uint32_t version;
+  uint32_t physics_version;
+  uint32_t character_size; // sizeof(SCharacterCore) of the writer
+  uint64_t map_hash;
+  uint32_t num_characters;
+  uint32_t num_keyframes;
+  uint32_t keyframe_step;
+  uint32_t num_event_ticks; // event log of the ticks [0, num_event_ticks), see below
+  uint32_t num_events;
+  uint32_t reserved; // spells out the tail padding, always 0
+};
+
+// after the header: num_event_ticks int32 tick ends and num_events game_event_t, then the keyframes
+
+// written once per keyframe, followed by num_characters raw SCharacterCore with NULL world pointers
+struct snapshot_cache_keyframe_t {
+  int32_t game_tick;
+  uint32_t reserved; // always 0
+  uint64_t input_hash; // hash of every input in [0, game_tick) across all tracks
+};
+
+bool snapshot_cache_save(ui_handler_t *ui, const char *project_path);
+bool snapshot_cache_load(ui_handler_t *ui, const char *project_path);
+
+#endif // SNAPSHOT_CACHE_H
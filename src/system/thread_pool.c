@@ -0,0 +1,358 @@
+#include "thread_pool.h"
+#include "profiler.h"
+#include <logger/logger.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *LOG_SOURCE = "ThreadPool";
+
+#define JOB_INDEX_MASK ((1u << THREAD_POOL_JOB_INDEX_BITS) - 1)
+#define JOB_GENERATION_MASK ((1u << (31 - THREAD_POOL_JOB_INDEX_BITS)) - 1)
+
+// Job table, all of these expect pool->lock to be held
+
+static job_handle_t make_handle(int index, uint32_t generation) {
+  return (job_handle_t)(((generation & JOB_GENERATION_MASK) << THREAD_POOL_JOB_INDEX_BITS) | (uint32_t)index);
+}
+
+static thread_pool_job_t *resolve_locked(thread_pool_t *pool, job_handle_t handle) {
+  if (handle < 0) return NULL;
+  int index = (int)((uint32_t)handle & JOB_INDEX_MASK);
+  if (index >= pool->job_capacity) return NULL;
+  thread_pool_job_t *job = &pool->jobs[index];
+  if (!job->in_use || (job->generation & JOB_GENERATION_MASK) != (uint32_t)handle >> THREAD_POOL_JOB_INDEX_BITS) return NULL;
+  return job;
+}
+
+static int acquire_job_locked(thread_pool_t *pool) {
+  if (pool->free_job_head < 0) {
+    int new_capacity = pool->job_capacity == 0 ? 16 : pool->job_capacity * 2;
+    if (new_capacity > (int)JOB_INDEX_MASK) return -1;
+    thread_pool_job_t *jobs = realloc(pool->jobs, sizeof(thread_pool_job_t) * new_capacity);
+    if (!jobs) return -1;
+    memset(jobs + pool->job_capacity, 0, sizeof(thread_pool_job_t) * (new_capacity - pool->job_capacity));
+    for (int i = new_capacity - 1; i >= pool->job_capacity; --i) {
+      jobs[i].next_free = pool->free_job_head;
+      pool->free_job_head = i;
+    }
+    pool->jobs = jobs;
+    pool->job_capacity = new_capacity;
+  }
+  int index = pool->free_job_head;
+  pool->free_job_head = pool->jobs[index].next_free;
+  return index;
+}
+
+static void release_job_locked(thread_pool_t *pool, int index) {
+  thread_pool_job_t *job = &pool->jobs[index];
+  job->in_use = false;
+  ++job->generation;
+  job->next_free = pool->free_job_head;
+  pool->free_job_head = index;
+}
+
+// Deques
+
+static bool deque_push(thread_pool_worker_t *w, thread_pool_task_t task) {
+  thread_mutex_lock(w->lock);
+  if (w->count == w->capacity) {
+    int new_capacity = w->capacity == 0 ? 64 : w->capacity * 2;
+    thread_pool_task_t *tasks = malloc(sizeof(thread_pool_task_t) * new_capacity);
+    if (!tasks) {
+      thread_mutex_unlock(w->lock);
+      return false;
+    }
+    for (int i = 0; i < w->count; ++i)
+      tasks[i] = w->tasks[(w->head + i) % w->capacity];
+    free(w->tasks);
+    w->tasks = tasks;
+    w->capacity = new_capacity;
+    w->head = 0;
+  }
+  w->tasks[(w->head + w->count) % w->capacity] = task;
+  ++w->count;
+  thread_mutex_unlock(w->lock);
+  return true;
+}
+
+static bool deque_pop_back(thread_pool_worker_t *w, thread_pool_task_t *out) {
+  thread_mutex_lock(w->lock);
+  bool found = w->count > 0;
+  if (found) *out = w->tasks[(w->head + --w->count) % w->capacity];
+  thread_mutex_unlock(w->lock);
+  return found;
+}
+
+static bool deque_steal_front(thread_pool_worker_t *w, thread_pool_task_t *out) {
+  thread_mutex_lock(w->lock);
+  bool found = w->count > 0;
+  if (found) {
+    *out = w->tasks[w->head];
+    w->head = (w->head + 1) % w->capacity;
+    --w->count;
+  }
+  thread_mutex_unlock(w->lock);
+  return found;
+}
+
+// takes the oldest queued task of `job`, wherever it sits in the deque
+static bool deque_steal_job(thread_pool_worker_t *w, int job, thread_pool_task_t *out) {
+  thread_mutex_lock(w->lock);
+  bool found = false;
+  for (int i = 0; i < w->count && !found; ++i) {
+    if (w->tasks[(w->head + i) % w->capacity].job != job) continue;
+    *out = w->tasks[(w->head + i) % w->capacity];
+    for (int k = i; k + 1 < w->count; ++k)
+      w->tasks[(w->head + k) % w->capacity] = w->tasks[(w->head + k + 1) % w->capacity];
+    --w->count;
+    found = true;
+  }
+  thread_mutex_unlock(w->lock);
+  return found;
+}
+
+static bool find_task(thread_pool_t *pool, int self, thread_pool_task_t *out) {
+  if (deque_pop_back(&pool->workers[self], out)) return true;
+  for (int i = 1; i < pool->worker_count; ++i)
+    if (deque_steal_front(&pool->workers[(self + i) % pool->worker_count], out)) return true;
+  return false;
+}
+
+// A waiting thread only helps with the job it waits on. Picking up another job's task could
+// block it for as long as that task runs, a search driver or subtree can take seconds.
+static bool find_job_task(thread_pool_t *pool, int job, thread_pool_task_t *out) {
+  for (int i = 0; i < pool->worker_count; ++i)
+    if (deque_steal_job(&pool->workers[i], job, out)) return true;
+  return false;
+}
+
+static void run_task(thread_pool_t *pool, const thread_pool_task_t *task) {
+  thread_mutex_lock(pool->lock);
+  --pool->queued_tasks;
+  thread_pool_job_t *job = &pool->jobs[task->job];
+  --job->queued_tasks;
+  bool skip = job->cancelled;
+  job_func_t func = job->func;
+  void *user_data = job->user_data;
+  thread_mutex_unlock(pool->lock);
+
+  if (!skip) {
+    PROFILE_BEGIN("thread_pool_task");
+    func(user_data, task->begin, task->end);
+    PROFILE_END();
+  }
+
+  thread_mutex_lock(pool->lock);
+  job = &pool->jobs[task->job]; // the table may have grown meanwhile
+  if (!skip) job->done_items += task->end - task->begin;
+  if (--job->outstanding_tasks == 0) thread_cond_broadcast(pool->job_finished);
+  thread_mutex_unlock(pool->lock);
+}
+
+static void worker_main(void *arg) {
+  thread_pool_worker_t *self = arg;
+  thread_pool_t *pool = self->pool;
+  profiler_set_thread_name(self->name);
+  for (;;) {
+    thread_pool_task_t task;
+    if (find_task(pool, self->index, &task)) {
+      run_task(pool, &task);
+      continue;
+    }
+    thread_mutex_lock(pool->lock);
+    while (pool->queued_tasks == 0 && !pool->shutting_down)
+      thread_cond_wait(pool->work_available, pool->lock);
+    bool stop = pool->shutting_down;
+    thread_mutex_unlock(pool->lock);
+    if (stop) return;
+  }
+}
+
+// Public API
+
+bool thread_pool_init(thread_pool_t *pool, int worker_count) {
+  memset(pool, 0, sizeof(thread_pool_t));
+  pool->free_job_head = -1;
+  if (worker_count <= 0) worker_count = thread_hardware_concurrency() - 1;
+  worker_count = worker_count < 1 ? 1 : worker_count > THREAD_POOL_MAX_WORKERS ? THREAD_POOL_MAX_WORKERS : worker_count;
+
+  pool->lock = thread_mutex_create();
+  pool->work_available = thread_cond_create();
+  pool->job_finished = thread_cond_create();
+  pool->workers = calloc(worker_count, sizeof(thread_pool_worker_t));
+  if (!pool->lock || !pool->work_available || !pool->job_finished || !pool->workers) {
+    log_error(LOG_SOURCE, "Failed to allocate thread pool.");
+    thread_pool_destroy(pool);
+    return false;
+  }
+
+  for (int i = 0; i < worker_count; ++i) {
+    thread_pool_worker_t *w = &pool->workers[i];
+    w->pool = pool;
+    w->index = i;
+    snprintf(w->name, sizeof(w->name), "Worker %d", i);
+    w->lock = thread_mutex_create();
+    if (!w->lock) break;
+    pool->worker_count = i + 1;
+  }
+  for (int i = 0; i < pool->worker_count; ++i) {
+    pool->workers[i].thread = thread_create(worker_main, &pool->workers[i]);
+    if (!pool->workers[i].thread) log_warn(LOG_SOURCE, "Failed to start worker %d.", i);
+  }
+  log_info(LOG_SOURCE, "Started %d worker threads.", pool->worker_count);
+  return true;
+}
+
+void thread_pool_destroy(thread_pool_t *pool) {
+  if (pool->lock) {
+    thread_mutex_lock(pool->lock);
+    pool->shutting_down = true;
+    thread_cond_broadcast(pool->work_available);
+    thread_mutex_unlock(pool->lock);
+  }
+  for (int i = 0; i < pool->worker_count; ++i) {
+    thread_join(pool->workers[i].thread);
+    thread_mutex_destroy(pool->workers[i].lock);
+    free(pool->workers[i].tasks);
+  }
+  free(pool->workers);
+  free(pool->jobs);
+  thread_cond_destroy(pool->job_finished);
+  thread_cond_destroy(pool->work_available);
+  thread_mutex_destroy(pool->lock);
+  memset(pool, 0, sizeof(thread_pool_t));
+  pool->free_job_head = -1;
+}
+
+job_handle_t thread_pool_submit(thread_pool_t *pool, job_func_t func, void *user_data) {
+  return thread_pool_parallel_for(pool, 1, 1, func, user_data);
+}
+
+// Splits [0, count) into chunks of `grain` items and spreads them over the worker deques.
+// grain <= 0 picks a chunk size that gives every worker a few chunks to balance with.
+job_handle_t thread_pool_parallel_for(thread_pool_t *pool, int count, int grain, job_func_t func, void *user_data) {
+  if (!pool->lock || !func || count <= 0) return JOB_HANDLE_INVALID;
+  if (grain <= 0) {
+    grain = count / (pool->worker_count * 4 + 1);
+    if (grain < 1) grain = 1;
+  }
+  int task_count = (count + grain - 1) / grain;
+
+  thread_mutex_lock(pool->lock);
+  int index = acquire_job_locked(pool);
+  if (index < 0) {
+    thread_mutex_unlock(pool->lock);
+    log_error(LOG_SOURCE, "Too many jobs in flight.");
+    return JOB_HANDLE_INVALID;
+  }
+  thread_pool_job_t *job = &pool->jobs[index];
+  job->func = func;
+  job->user_data = user_data;
+  job->total_items = count;
+  job->done_items = 0;
+  job->outstanding_tasks = task_count;
+  // counted as queued before they are pushed, a worker may pop and run one before this function
+  // takes the lock again
+  job->queued_tasks = task_count;
+  pool->queued_tasks += task_count;
+  job->cancelled = false;
+  job->in_use = true;
+  job_handle_t handle = make_handle(index, job->generation);
+  unsigned cursor = pool->submit_cursor;
+  pool->submit_cursor += task_count;
+  thread_mutex_unlock(pool->lock);
+
+  int pushed = 0;
+  for (int t = 0; t < task_count; ++t) {
+    thread_pool_task_t task = {index, t * grain, t * grain + grain < count ? t * grain + grain : count};
+    thread_pool_worker_t *w = &pool->workers[cursor++ % pool->worker_count];
+    if (deque_push(w, task)) {
+      ++pushed;
+    } else {
+      // out of memory, run it right here instead of losing it
+      thread_mutex_lock(pool->lock);
+      --pool->queued_tasks;
+      --pool->jobs[index].queued_tasks;
+      thread_mutex_unlock(pool->lock);
+      func(user_data, task.begin, task.end);
+      thread_mutex_lock(pool->lock);
+      pool->jobs[index].done_items += task.end - task.begin;
+      if (--pool->jobs[index].outstanding_tasks == 0) thread_cond_broadcast(pool->job_finished);
+      thread_mutex_unlock(pool->lock);
+    }
+  }
+
+  thread_mutex_lock(pool->lock);
+  if (pushed > 0) thread_cond_broadcast(pool->work_available);
+  thread_mutex_unlock(pool->lock);
+  return handle;
+}
+
+// The waiting thread runs queued chunks of the job itself instead of idling, so waiting from
+// inside a task is fine as well.
+void thread_pool_wait(thread_pool_t *pool, job_handle_t handle) {
+  if (!pool->lock) return;
+  for (;;) {
+    thread_mutex_lock(pool->lock);
+    thread_pool_job_t *job = resolve_locked(pool, handle);
+    if (!job) {
+      thread_mutex_unlock(pool->lock);
+      return;
+    }
+    if (job->outstanding_tasks == 0) {
+      release_job_locked(pool, (int)((uint32_t)handle & JOB_INDEX_MASK));
+      thread_mutex_unlock(pool->lock);
+      return;
+    }
+    thread_mutex_unlock(pool->lock);
+
+    thread_pool_task_t task;
+    if (find_job_task(pool, (int)((uint32_t)handle & JOB_INDEX_MASK), &task)) {
+      run_task(pool, &task);
+      continue;
+    }
+
+    // everything left is already running on a worker
+    thread_mutex_lock(pool->lock);
+    job = resolve_locked(pool, handle);
+    if (job && job->outstanding_tasks > 0 && job->queued_tasks <= 0) thread_cond_wait(pool->job_finished, pool->lock);
+    thread_mutex_unlock(pool->lock);
+  }
+}
+
+// Queued chunks of a cancelled job are skipped, running ones can bail out early by polling thread_pool_is_cancelled
+void thread_pool_cancel(thread_pool_t *pool, job_handle_t handle) {
+  if (!pool->lock) return;
+  thread_mutex_lock(pool->lock);
+  thread_pool_job_t *job = resolve_locked(pool, handle);
+  if (job) job->cancelled = true;
+  thread_mutex_unlock(pool->lock);
+}
+
+bool thread_pool_is_cancelled(thread_pool_t *pool, job_handle_t handle) {
+  if (!pool->lock) return false;
+  thread_mutex_lock(pool->lock);
+  thread_pool_job_t *job = resolve_locked(pool, handle);
+  bool cancelled = job && job->cancelled;
+  thread_mutex_unlock(pool->lock);
+  return cancelled;
+}
+
+bool thread_pool_is_done(thread_pool_t *pool, job_handle_t handle) {
+  if (!pool->lock) return true;
+  thread_mutex_lock(pool->lock);
+  thread_pool_job_t *job = resolve_locked(pool, handle);
+  bool done = !job || job->outstanding_tasks == 0;
+  thread_mutex_unlock(pool->lock);
+  return done;
+}
+
+float thread_pool_progress(thread_pool_t *pool, job_handle_t handle) {
+  if (!pool->lock) return 1.0f;
+  thread_mutex_lock(pool->lock);
+  thread_pool_job_t *job = resolve_locked(pool, handle);
+  float progress = !job ? 1.0f : job->total_items > 0 ? (float)job->done_items / (float)job->total_items : 1.0f;
+  thread_mutex_unlock(pool->lock);
+  return progress;
+}
@@ -0,0 +1,77 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include "threading.h"
+#include <types.h>
+
+#define JOB_HANDLE_INVALID (-1)
+#define THREAD_POOL_MAX_WORKERS 64
+#define THREAD_POOL_JOB_INDEX_BITS 16 // the remaining bits of a handle hold the job generation
+
+typedef int32_t job_handle_t;
+
+// runs items [begin, end) of a job, single jobs are called once with [0, 1)
+typedef void (*job_func_t)(void *user_data, int begin, int end);
+
+struct thread_pool_task_t {
+  int job;
+  int begin;
+  int end;
+};
+
+// each worker owns a ring buffer deque: it pops from the back, idle threads steal from the front
+struct thread_pool_worker_t {
+  thread_pool_t *pool;
+  thread_t *thread;
+  thread_mutex_t *lock;
+  thread_pool_task_t *tasks;
+  int head;
+  int count;
+  int capacity;
+  int index;
+  char name[16]; // shown in the profiler window
+};
+
+struct thread_pool_job_t {
+  job_func_t func;
+  void *user_data;
+  int total_items;
+  int done_items;
+  int outstanding_tasks;
+  int queued_tasks; // outstanding tasks not picked up by a thread yet
+  uint32_t generation;
+  int next_free;
+  bool in_use;
+  bool cancelled;
+};
+
+struct thread_pool_t {
+  thread_pool_worker_t *workers;
+  int worker_count;
+
+  // guards everything below
+  unsigned submit_cursor;
+  thread_mutex_t *lock;
+  thread_cond_t *work_available;
+  thread_cond_t *job_finished;
+  thread_pool_job_t *jobs;
+  int job_capacity;
+  int free_job_head;
+  int queued_tasks;
+  bool shutting_down;
+};
+
+// worker_count <= 0 sizes the pool to the machine, leaving one core for the calling thread
+bool thread_pool_init(thread_pool_t *pool, int worker_count);
+void thread_pool_destroy(thread_pool_t *pool);
+
+// Every handle must be passed to thread_pool_wait exactly once, that also releases it.
+job_handle_t thread_pool_submit(thread_pool_t *pool, job_func_t func, void *user_data);
+job_handle_t thread_pool_parallel_for(thread_pool_t *pool, int count, int grain, job_func_t func, void *user_data);
+void thread_pool_wait(thread_pool_t *pool, job_handle_t job);
+void thread_pool_cancel(thread_pool_t *pool, job_handle_t job);
+bool thread_pool_is_cancelled(thread_pool_t *pool, job_handle_t job);
+bool thread_pool_is_done(thread_pool_t *pool, job_handle_t job);
+float thread_pool_progress(thread_pool_t *pool, job_handle_t job);
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,148 @@
+#include "threading.h"
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <process.h>
+#include <windows.h>
+
+struct thread_mutex_t {
+  SRWLOCK lock;
+};
+struct thread_cond_t {
+  CONDITION_VARIABLE cond;
+};
+struct thread_t {
+  HANDLE handle;
+  thread_func_t func;
+  void *arg;
+};
+
+static unsigned __stdcall thread_entry(void *arg) {
+  thread_t *thread = arg;
+  thread->func(thread->arg);
+  return 0;
+}
+
+thread_mutex_t *thread_mutex_create(void) {
+  thread_mutex_t *mutex = malloc(sizeof(thread_mutex_t));
+  if (mutex) InitializeSRWLock(&mutex->lock);
+  return mutex;
+}
+void thread_mutex_destroy(thread_mutex_t *mutex) { free(mutex); }
+void thread_mutex_lock(thread_mutex_t *mutex) { AcquireSRWLockExclusive(&mutex->lock); }
+void thread_mutex_unlock(thread_mutex_t *mutex) { ReleaseSRWLockExclusive(&mutex->lock); }
+
+thread_cond_t *thread_cond_create(void) {
+  thread_cond_t *cond = malloc(sizeof(thread_cond_t));
+  if (cond) InitializeConditionVariable(&cond->cond);
+  return cond;
+}
+void thread_cond_destroy(thread_cond_t *cond) { free(cond); }
+void thread_cond_wait(thread_cond_t *cond, thread_mutex_t *mutex) { SleepConditionVariableSRW(&cond->cond, &mutex->lock, INFINITE, 0); }
+void thread_cond_signal(thread_cond_t *cond) { WakeConditionVariable(&cond->cond); }
+void thread_cond_broadcast(thread_cond_t *cond) { WakeAllConditionVariable(&cond->cond); }
+
+thread_t *thread_create(thread_func_t func, void *arg) {
+  thread_t *thread = malloc(sizeof(thread_t));
+  if (!thread) return NULL;
+  thread->func = func;
+  thread->arg = arg;
+  thread->handle = (HANDLE)_beginthreadex(NULL, 0, thread_entry, thread, 0, NULL);
+  if (!thread->handle) {
+    free(thread);
+    return NULL;
+  }
+  return thread;
+}
+
+void thread_join(thread_t *thread) {
+  if (!thread) return;
+  WaitForSingleObject(thread->handle, INFINITE);
+  CloseHandle(thread->handle);
+  free(thread);
+}
+
+int thread_hardware_concurrency(void) {
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+}
+
+#else
+#include <pthread.h>
+#include <unistd.h>
+
+struct thread_mutex_t {
+  pthread_mutex_t lock;
+};
+struct thread_cond_t {
+  pthread_cond_t cond;
+};
+struct thread_t {
+  pthread_t handle;
+  thread_func_t func;
+  void *arg;
+};
+
+static void *thread_entry(void *arg) {
+  thread_t *thread = arg;
+  thread->func(thread->arg);
+  return NULL;
+}
+
+thread_mutex_t *thread_mutex_create(void) {
+  thread_mutex_t *mutex = malloc(sizeof(thread_mutex_t));
+  if (mutex && pthread_mutex_init(&mutex->lock, NULL) != 0) {
+    free(mutex);
+    return NULL;
+  }
+  return mutex;
+}
+void thread_mutex_destroy(thread_mutex_t *mutex) {
+  if (!mutex) return;
+  pthread_mutex_destroy(&mutex->lock);
+  free(mutex);
+}
+void thread_mutex_lock(thread_mutex_t *mutex) { pthread_mutex_lock(&mutex->lock); }
+void thread_mutex_unlock(thread_mutex_t *mutex) { pthread_mutex_unlock(&mutex->lock); }
+
+thread_cond_t *thread_cond_create(void) {
+  thread_cond_t *cond = malloc(sizeof(thread_cond_t));
+  if (cond && pthread_cond_init(&cond->cond, NULL) != 0) {
+    free(cond);
+    return NULL;
+  }
+  return cond;
+}
+void thread_cond_destroy(thread_cond_t *cond) {
+  if (!cond) return;
+  pthread_cond_destroy(&cond->cond);
+  free(cond);
+}
+void thread_cond_wait(thread_cond_t *cond, thread_mutex_t *mutex) { pthread_cond_wait(&cond->cond, &mutex->lock); }
+void thread_cond_signal(thread_cond_t *cond) { pthread_cond_signal(&cond->cond); }
+void thread_cond_broadcast(thread_cond_t *cond) { pthread_cond_broadcast(&cond->cond); }
+
+thread_t *thread_create(thread_func_t func, void *arg) {
+  thread_t *thread = malloc(sizeof(thread_t));
+  if (!thread) return NULL;
+  thread->func = func;
+  thread->arg = arg;
+  if (pthread_create(&thread->handle, NULL, thread_entry, thread) != 0) {
+    free(thread);
+    return NULL;
+  }
+  return thread;
+}
+
+void thread_join(thread_t *thread) {
+  if (!thread) return;
+  pthread_join(thread->handle, NULL);
+  free(thread);
+}
+
+int thread_hardware_concurrency(void) {
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+  return count > 0 ? (int)count : 1;
+}
+#endif
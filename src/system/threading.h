@@ -0,0 +1,29 @@
+#ifndef THREADING_H
+#define THREADING_H
+
+#include <types.h>
+
+// thin platform layer over win32 / pthreads, the handles are opaque so no system headers leak out
+typedef struct thread_mutex_t thread_mutex_t;
+typedef struct thread_cond_t thread_cond_t;
+typedef struct thread_t thread_t;
+
+typedef void (*thread_func_t)(void *arg);
+
+thread_mutex_t *thread_mutex_create(void);
+void thread_mutex_destroy(thread_mutex_t *mutex);
+void thread_mutex_lock(thread_mutex_t *mutex);
+void thread_mutex_unlock(thread_mutex_t *mutex);
+
+thread_cond_t *thread_cond_create(void);
+void thread_cond_destroy(thread_cond_t *cond);
+void thread_cond_wait(thread_cond_t *cond, thread_mutex_t *mutex);
+void thread_cond_signal(thread_cond_t *cond);
+void thread_cond_broadcast(thread_cond_t *cond);
+
+thread_t *thread_create(thread_func_t func, void *arg);
+void thread_join(thread_t *thread);
+
+int thread_hardware_concurrency(void);
+
+#endif // THREADING_H
@@ -9,22 +9,38 @@
 // System
 typedef struct tas_project_header_t tas_project_header_t;
 typedef struct skin_file_header_t skin_file_header_t;
+typedef struct snapshot_cache_header_t snapshot_cache_header_t;
+typedef struct snapshot_cache_keyframe_t snapshot_cache_keyframe_t;
+typedef struct thread_pool_t thread_pool_t;
+typedef struct thread_pool_job_t thread_pool_job_t;
+typedef struct thread_pool_task_t thread_pool_task_t;
+typedef struct thread_pool_worker_t thread_pool_worker_t;
 
 // Physics
 typedef struct physics_handler_t physics_handler_t;
 typedef struct physics_v_t physics_v_t;
+typedef struct game_event_t game_event_t;
+typedef struct event_log_t event_log_t;
 
 // Plugins
 typedef struct plugin_manager_t plugin_manager_t;
 typedef struct loaded_plugin_t loaded_plugin_t;
+typedef struct plugin_stats_t plugin_stats_t;
 typedef struct tas_context_t tas_context_t;
 typedef struct plugin_info_t plugin_info_t;
 typedef struct tas_api_t tas_api_t;
+typedef struct world_pool_t world_pool_t;
+typedef struct world_pool_slot_t world_pool_slot_t;
 
 typedef void *(*plugin_init_func)(tas_context_t *context, const tas_api_t *api);
 typedef void (*plugin_shutdown_func)(void *plugin_data);
 typedef void (*plugin_update_func)(void *plugin_data);
+typedef void (*plugin_draw_func)(void *plugin_data);
 typedef plugin_info_t (*get_plugin_info_func)(void);
+typedef void (*plugin_on_tick_changed_func)(void *plugin_data, int tick);
+typedef void (*plugin_on_inputs_changed_func)(void *plugin_data, int track_index, int start_tick, int end_tick);
+typedef void (*plugin_on_project_loaded_func)(void *plugin_data);
+typedef void (*plugin_on_world_invalidated_func)(void *plugin_data, int from_tick);
 
 // Renderer
 typedef struct pipeline_cache_entry_t pipeline_cache_entry_t;
@@ -39,6 +55,7 @@ typedef struct atlas_renderer_t atlas_renderer_t;
 typedef struct atlas_instance_t atlas_instance_t;
 typedef struct skin_renderer_t skin_renderer_t;
 typedef struct skin_instance_t skin_instance_t;
+typedef struct decoded_skin_t decoded_skin_t;
 typedef struct primitive_ubo_t primitive_ubo_t;
 typedef struct gfx_handler_t gfx_handler_t;
 typedef struct raw_mouse_t raw_mouse_t;
@@ -60,6 +77,8 @@ typedef struct animation_t animation_t;
 
 // User Interface
 typedef struct demo_exporter_t demo_exporter_t;
+typedef struct profiler_window_t profiler_window_t;
+typedef struct search_window_t search_window_t;
 typedef struct ui_handler_t ui_handler_t;
 
 // Keybinds
@@ -77,6 +96,18 @@ typedef struct skin_info_t skin_info_t;
 typedef struct undo_command_t undo_command_t;
 typedef struct undo_manager_t undo_manager_t;
 
+// Search
+typedef struct search_space_t search_space_t;
+typedef struct search_objective_t search_objective_t;
+typedef struct search_context_t search_context_t;
+typedef struct bruteforce_t bruteforce_t;
+typedef struct beam_search_config_t beam_search_config_t;
+typedef struct beam_search_t beam_search_t;
+typedef struct transposition_table_t transposition_table_t;
+typedef struct reachability_config_t reachability_config_t;
+typedef struct reachability_t reachability_t;
+typedef struct search_coordinator_t search_coordinator_t;
+
 // Timeline
 typedef struct recording_snippet_vector_t recording_snippet_vector_t;
 typedef struct timeline_drag_state_t timeline_drag_state_t;
@@ -87,5 +118,8 @@ typedef struct timeline_state timeline_state_t;
 typedef struct input_snippet_t input_snippet_t;
 typedef struct player_track_t player_track_t;
 typedef struct net_event_t net_event_t;
+typedef struct input_change_t input_change_t;
+typedef struct input_chunk_t input_chunk_t;
+typedef struct chunked_inputs_t chunked_inputs_t;
 
 #endif // TYPES_H
@@ -2,12 +2,14 @@
 #include "ddnet_physics/vmath.h"
 #include "nfd.h"
 #include "timeline/timeline_model.h"
-#include <ddnet_physics/collision.h>
 #include <ddnet_physics/gamecore.h>
 #include <logger/logger.h>
+#include <physics/event_log.h>
 #include <renderer/graphics_backend.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <system/profiler.h>
 
 #define DDNET_DEMO_IMPLEMENTATION
 #include <ddnet_demo/ddnet_demo.h>
@@ -174,14 +176,54 @@ int round_to_int(float f) {
   else return (int)(f - 0.5f);
 }
 
-static void on_hammer_hit(mvec2 pos, int type, int cid, void *data) {
-  (void)cid;
-  demo_exporter_t *exporter = data;
-  if (type == PARTICLE_TYPE_HAMMER_HIT)
-    if (exporter->num_hammerhits < MAX_HAMMERHITS_PER_TICK) exporter->hammerhits[exporter->num_hammerhits++] = pos;
+static void add_sound(dd_snapshot_builder *sb, int *next_item_id, const float pos[2], int sound_id) {
+  dd_netevent_sound_world *ns = demo_sb_add_item(sb, DD_NETEVENTTYPE_SOUNDWORLD, (*next_item_id)++, sizeof(dd_netevent_sound_world));
+  if (!ns) return;
+  ns->common.m_X = pos[0] - MAP_EXPAND32;
+  ns->common.m_Y = pos[1] - MAP_EXPAND32;
+  ns->m_SoundId = sound_id;
 }
 
-static void snap_world(dd_snapshot_builder *sb, timeline_state_t *ts, SWorldCore *prev, SWorldCore *cur) {
+// net events of the game events that happened while ticking into `cur`
+static void snap_events(dd_snapshot_builder *sb, int *next_item_id, const event_log_t *events, SWorldCore *cur) {
+  if (!event_log_has_tick(events, cur->m_GameTick - 1)) return;
+  int count;
+  const game_event_t *e = event_log_tick_events(events, cur->m_GameTick - 1, &count);
+  for (int i = 0; i < count; ++i, ++e) {
+    if (e->type == GAME_EVENT_SPAWN) {
+      add_sound(sb, next_item_id, e->pos, DD_SOUND_PLAYER_SPAWN);
+      dd_netevent_spawn *ns = demo_sb_add_item(sb, DD_NETEVENTTYPE_SPAWN, (*next_item_id)++, sizeof(dd_netevent_spawn));
+      if (!ns) continue;
+      ns->common.m_X = e->pos[0] - MAP_EXPAND32;
+      ns->common.m_Y = e->pos[1] - MAP_EXPAND32;
+    } else if (e->type == GAME_EVENT_DEATH) {
+      add_sound(sb, next_item_id, e->pos, DD_SOUND_PLAYER_DIE);
+      dd_netevent_death *nd = demo_sb_add_item(sb, DD_NETEVENTTYPE_DEATH, (*next_item_id)++, sizeof(dd_netevent_death));
+      if (!nd) continue;
+      nd->common.m_X = e->pos[0] - MAP_EXPAND32;
+      nd->common.m_Y = e->pos[1] - MAP_EXPAND32;
+      nd->m_ClientId = e->cid >= 0 && e->cid < cur->m_NumCharacters ? cur->m_pCharacters[e->cid].m_Id : e->cid;
+    } else if (e->type == GAME_EVENT_HOOK_ATTACH) {
+      add_sound(sb, next_item_id, e->pos, e->arg ? DD_SOUND_HOOK_ATTACH_PLAYER : DD_SOUND_HOOK_ATTACH_GROUND);
+    } else if (e->type == GAME_EVENT_JUMP) {
+      add_sound(sb, next_item_id, e->pos, DD_SOUND_PLAYER_JUMP);
+    } else if (e->type == GAME_EVENT_HAMMER_HIT) {
+      dd_netevent_hammer_hit *nhh = demo_sb_add_item(sb, DD_NETEVENTTYPE_HAMMERHIT, (*next_item_id)++, sizeof(dd_netevent_hammer_hit));
+      if (!nhh) continue;
+      nhh->common.m_X = e->pos[0] - MAP_EXPAND32;
+      nhh->common.m_Y = e->pos[1] - MAP_EXPAND32;
+    } else if (e->type == GAME_EVENT_EXPLOSION) {
+      dd_netevent_explosion *ne = demo_sb_add_item(sb, DD_NETEVENTTYPE_EXPLOSION, (*next_item_id)++, sizeof(dd_netevent_explosion));
+      if (ne) {
+        ne->common.m_X = e->pos[0] - MAP_EXPAND32;
+        ne->common.m_Y = e->pos[1] - MAP_EXPAND32;
+      }
+      add_sound(sb, next_item_id, e->pos, DD_SOUND_GRENADE_EXPLODE);
+    }
+  }
+}
+
+static void snap_world(dd_snapshot_builder *sb, timeline_state_t *ts, const event_log_t *events, SWorldCore *prev, SWorldCore *cur) {
   int next_item_id = cur->m_NumCharacters; // start after reserved player ids
 
   // do pickups first since they have static ids basically
@@ -319,39 +361,6 @@ static void snap_world(dd_snapshot_builder *sb, timeline_state_t *ts, SWorldCore
     dc->m_TargetX = c_cur->m_Input.m_TargetX;
     dc->m_TargetY = c_cur->m_Input.m_TargetY;
 
-    if (c_cur->m_RespawnDelay > c_prev->m_RespawnDelay) {
-      dd_netevent_sound_world *nss;
-      nss = demo_sb_add_item(sb, DD_NETEVENTTYPE_SOUNDWORLD, next_item_id++, sizeof(dd_netevent_sound_world));
-      nss->common.m_X = vgetx(c_cur->m_Pos) - MAP_EXPAND32;
-      nss->common.m_Y = vgety(c_cur->m_Pos) - MAP_EXPAND32;
-      nss->m_SoundId = DD_SOUND_PLAYER_SPAWN;
-      nss = demo_sb_add_item(sb, DD_NETEVENTTYPE_SOUNDWORLD, next_item_id++, sizeof(dd_netevent_sound_world));
-      nss->common.m_X = vgetx(c_prev->m_Pos) - MAP_EXPAND32;
-      nss->common.m_Y = vgety(c_prev->m_Pos) - MAP_EXPAND32;
-      nss->m_SoundId = DD_SOUND_PLAYER_DIE;
-
-      dd_netevent_spawn *ns = demo_sb_add_item(sb, DD_NETEVENTTYPE_SPAWN, next_item_id++, sizeof(dd_netevent_spawn));
-      ns->common.m_X = vgetx(c_cur->m_Pos) - MAP_EXPAND32;
-      ns->common.m_Y = vgety(c_cur->m_Pos) - MAP_EXPAND32;
-
-      dd_netevent_death *nd = demo_sb_add_item(sb, DD_NETEVENTTYPE_DEATH, next_item_id++, sizeof(dd_netevent_death));
-      nd->common.m_X = vgetx(c_prev->m_Pos) - MAP_EXPAND32;
-      nd->common.m_Y = vgety(c_prev->m_Pos) - MAP_EXPAND32;
-      nd->m_ClientId = c_cur->m_Id;
-    }
-    if (c_prev->m_HookState != HOOK_GRABBED && c_cur->m_HookState == HOOK_GRABBED) {
-      dd_netevent_sound_world *nhs = demo_sb_add_item(sb, DD_NETEVENTTYPE_SOUNDWORLD, next_item_id++, sizeof(dd_netevent_sound_world));
-      nhs->common.m_X = vgetx(c_cur->m_Pos) - MAP_EXPAND32;
-      nhs->common.m_Y = vgety(c_cur->m_Pos) - MAP_EXPAND32;
-      if (c_prev->m_HookedPlayer == -1 && c_cur->m_HookedPlayer != -1) nhs->m_SoundId = DD_SOUND_HOOK_ATTACH_PLAYER;
-      else nhs->m_SoundId = DD_SOUND_HOOK_ATTACH_GROUND;
-    }
-    if (c_cur->m_Jumped && c_cur->m_Grounded) {
-      dd_netevent_sound_world *njs = demo_sb_add_item(sb, DD_NETEVENTTYPE_SOUNDWORLD, next_item_id++, sizeof(dd_netevent_sound_world));
-      njs->common.m_X = vgetx(c_cur->m_Pos) - MAP_EXPAND32;
-      njs->common.m_Y = vgety(c_cur->m_Pos) - MAP_EXPAND32;
-      njs->m_SoundId = DD_SOUND_PLAYER_JUMP;
-    }
     if (c_cur->m_ReloadTimer > c_prev->m_ReloadTimer) {
       if (c_cur->m_ActiveWeapon <= 1) {
         dd_netevent_sound_world *nhs = demo_sb_add_item(sb, DD_NETEVENTTYPE_SOUNDWORLD, next_item_id++, sizeof(dd_netevent_sound_world));
@@ -362,11 +371,7 @@ static void snap_world(dd_snapshot_builder *sb, timeline_state_t *ts, SWorldCore
     }
   }
 
-  for (int i = 0; i < ts->ui->demo_exporter.num_hammerhits; ++i) {
-    dd_netevent_hammer_hit *nhh = demo_sb_add_item(sb, DD_NETEVENTTYPE_HAMMERHIT, next_item_id++, sizeof(dd_netevent_hammer_hit));
-    nhh->common.m_X = vgetx(ts->ui->demo_exporter.hammerhits[i]) - MAP_EXPAND32;
-    nhh->common.m_Y = vgety(ts->ui->demo_exporter.hammerhits[i]) - MAP_EXPAND32;
-  }
+  snap_events(sb, &next_item_id, events, cur);
 
   // do entities
   for (SProjectile *proj = (SProjectile *)cur->m_apFirstEntityTypes[WORLD_ENTTYPE_PROJECTILE]; proj;
@@ -400,34 +405,12 @@ static void snap_world(dd_snapshot_builder *sb, timeline_state_t *ts, SWorldCore
     }
 
     const mvec2 pos = prj_get_pos(proj, (cur->m_GameTick - proj->m_StartTick) / (float)GAME_TICK_SPEED);
-    const mvec2 next_pos = prj_get_pos(proj, (cur->m_GameTick - proj->m_StartTick + 1) / (float)GAME_TICK_SPEED);
     if (proj->m_Owner >= 0 && proj->m_Base.m_Spawned) {
       dd_netevent_sound_world *nf = demo_sb_add_item(sb, DD_NETEVENTTYPE_SOUNDWORLD, next_item_id++, sizeof(dd_netevent_sound_world));
       nf->common.m_X = vgetx(pos) - MAP_EXPAND32;
       nf->common.m_Y = vgety(pos) - MAP_EXPAND32;
       nf->m_SoundId = DD_SOUND_GRENADE_FIRE;
     }
-    if (proj->m_Explosive) {
-      mvec2 out, _out;
-      if (intersect_line(proj->m_Base.m_pCollision, pos, next_pos, &out, &_out)) {
-        dd_netevent_explosion *ne = demo_sb_add_item(sb, DD_NETEVENTTYPE_EXPLOSION, next_item_id++, sizeof(dd_netevent_explosion));
-        ne->common.m_X = vgetx(out) - MAP_EXPAND32;
-        ne->common.m_Y = vgety(out) - MAP_EXPAND32;
-        dd_netevent_sound_world *nes = demo_sb_add_item(sb, DD_NETEVENTTYPE_SOUNDWORLD, next_item_id++, sizeof(dd_netevent_sound_world));
-        nes->common.m_X = vgetx(out) - MAP_EXPAND32;
-        nes->common.m_Y = vgety(out) - MAP_EXPAND32;
-        nes->m_SoundId = DD_SOUND_GRENADE_EXPLODE;
-      }
-      if (proj->m_LifeSpan <= 0) {
-        dd_netevent_explosion *ne = demo_sb_add_item(sb, DD_NETEVENTTYPE_EXPLOSION, next_item_id++, sizeof(dd_netevent_explosion));
-        ne->common.m_X = vgetx(pos) - MAP_EXPAND32;
-        ne->common.m_Y = vgety(pos) - MAP_EXPAND32;
-        dd_netevent_sound_world *nes = demo_sb_add_item(sb, DD_NETEVENTTYPE_SOUNDWORLD, next_item_id++, sizeof(dd_netevent_sound_world));
-        nes->common.m_X = vgetx(pos) - MAP_EXPAND32;
-        nes->common.m_Y = vgety(pos) - MAP_EXPAND32;
-        nes->m_SoundId = DD_SOUND_GRENADE_EXPLODE;
-      }
-    }
   }
 
   for (SLaser *laser = (SLaser *)cur->m_apFirstEntityTypes[WORLD_ENTTYPE_LASER]; laser; laser = (SLaser *)laser->m_Base.m_pNextTypeEntity) {
@@ -464,7 +447,142 @@ static void snap_world(dd_snapshot_builder *sb, timeline_state_t *ts, SWorldCore
   }
 }
 
+// Parallel export
+// The timeline is split into segments that are simulated and snapped independently on the thread
+// pool, each starting from the closest cached keyframe before it. The writer then consumes the
+// finished snapshots in order, a batch of segments at a time to bound memory.
+
+#define DEMO_EXPORT_SEGMENT_TICKS 500
+
+typedef struct {
+  int start_tick;
+  int end_tick;
+  uint8_t *snaps; // snapshots of all ticks back to back
+  size_t snaps_size;
+  size_t snaps_capacity;
+  int *snap_sizes; // per tick, 0 if the tick produced no snapshot
+  event_log_t events; // the tick before the one being snapped, when the timeline has not logged it
+  bool failed;
+} demo_segment_t;
+
+typedef struct {
+  ui_handler_t *ui;
+  demo_segment_t *segments;
+} demo_export_job_t;
+
+static bool segment_append_snap(demo_segment_t *seg, int index, const uint8_t *data, int size) {
+  if (seg->snaps_size + size > seg->snaps_capacity) {
+    size_t new_capacity = seg->snaps_capacity ? seg->snaps_capacity * 2 : 64 * 1024;
+    while (new_capacity < seg->snaps_size + size)
+      new_capacity *= 2;
+    uint8_t *snaps = realloc(seg->snaps, new_capacity);
+    if (!snaps) return false;
+    seg->snaps = snaps;
+    seg->snaps_capacity = new_capacity;
+  }
+  memcpy(seg->snaps + seg->snaps_size, data, size);
+  seg->snaps_size += size;
+  seg->snap_sizes[index] = size;
+  return true;
+}
+
+static void simulate_segment(ui_handler_t *ui, demo_segment_t *seg) {
+  timeline_state_t *ts = &ui->timeline;
+  int start = seg->start_tick;
+  seg->snap_sizes = calloc(seg->end_tick - start, sizeof(int));
+  dd_snapshot_builder *sb = demo_sb_create();
+  uint8_t *snap_buf = malloc(DD_SNAPSHOT_MAX_SIZE);
+  if (!seg->snap_sizes || !sb || !snap_buf) {
+    seg->failed = true;
+    if (sb) demo_sb_destroy(&sb);
+    free(snap_buf);
+    return;
+  }
+
+  // the tick before the segment has to be simulated as well, it provides `prev` and the events
+  int base_index = start > 0 ? imin((start - 1) / PHYSICS_SNAPSHOT_STEP, (int)ts->vec.current_size - 1) : 0;
+  SWorldCore prev = wc_empty();
+  SWorldCore cur = wc_empty();
+  wc_copy_world(&cur, &ts->vec.data[imax(base_index, 0)]);
+  if (start == 0) wc_copy_world(&prev, &cur);
+
+  for (int t = cur.m_GameTick; t < seg->end_tick; ++t) {
+    for (int i = 0; i < cur.m_NumCharacters; ++i) {
+      SPlayerInput input = model_get_input_at_tick(ts, i, cur.m_GameTick);
+      cc_on_input(&cur.m_pCharacters[i], &input);
+    }
+    if (t >= start) {
+      // events the timeline already recorded are read from its log
+      const event_log_t *events = event_log_has_tick(&ts->event_log, t - 1) ? &ts->event_log : &seg->events;
+      demo_sb_clear(sb);
+      snap_world(sb, ts, events, &prev, &cur);
+      int snap_size = demo_sb_finish(sb, snap_buf);
+      if (snap_size > 0 && !segment_append_snap(seg, t - start, snap_buf, snap_size)) {
+        seg->failed = true;
+        break;
+      }
+    }
+    if (t >= start - 1) wc_copy_world(&prev, &cur);
+    bool record = !event_log_has_tick(&ts->event_log, t);
+    if (record) {
+      event_log_reset(&seg->events, t);
+      event_log_begin_tick(&seg->events, &cur);
+    }
+    wc_tick(&cur);
+    if (record) event_log_end_tick(&seg->events, &cur);
+  }
+
+  demo_sb_destroy(&sb);
+  free(snap_buf);
+  wc_free(&prev);
+  wc_free(&cur);
+}
+
+static void simulate_segments_job(void *user_data, int begin, int end) {
+  demo_export_job_t *job = user_data;
+  for (int i = begin; i < end; ++i)
+    simulate_segment(job->ui, &job->segments[i]);
+}
+
+static void free_segment(demo_segment_t *seg) {
+  free(seg->snaps);
+  free(seg->snap_sizes);
+  event_log_free(&seg->events);
+  seg->snaps = NULL;
+  seg->snap_sizes = NULL;
+}
+
+static void write_net_events(dd_demo_writer *writer, timeline_state_t *ts, int t) {
+  for (int i = 0; i < ts->net_event_count; ++i) {
+    net_event_t *ev = &ts->net_events[i];
+    if (ev->tick == t) {
+      if (ev->type == NET_EVENT_CHAT) {
+        demo_w_write_msg_sv_chat(writer, ev->team, ev->client_id, ev->message);
+      } else if (ev->type == NET_EVENT_BROADCAST) {
+        demo_w_write_msg_sv_broadcast(writer, ev->message);
+      } else if (ev->type == NET_EVENT_KILLMSG) {
+        demo_w_write_msg_sv_killmsg(writer, ev->killer, ev->victim, ev->weapon, ev->mode_special);
+      } else if (ev->type == NET_EVENT_SOUND_GLOBAL) {
+        demo_w_write_msg_sv_sound_global(writer, ev->sound_id);
+      } else if (ev->type == NET_EVENT_EMOTICON) {
+        demo_w_write_msg_sv_emoticon(writer, ev->client_id, ev->emoticon);
+      } else if (ev->type == NET_EVENT_VOTE_SET) {
+        demo_w_write_msg_sv_vote_set(writer, ev->vote_timeout, ev->message, ev->reason);
+      } else if (ev->type == NET_EVENT_VOTE_STATUS) {
+        demo_w_write_msg_sv_vote_status(writer, ev->vote_yes, ev->vote_no, ev->vote_pass, ev->vote_total);
+      } else if (ev->type == NET_EVENT_DDRACE_TIME) {
+        demo_w_write_msg_sv_ddrace_time_legacy(writer, ev->time, ev->check, ev->finish);
+      } else if (ev->type == NET_EVENT_RECORD) {
+        demo_w_write_msg_sv_record_legacy(writer, ev->server_time_best, ev->player_time_best);
+      }
+    }
+  }
+}
+
 int export_to_demo(ui_handler_t *ui, const char *path, const char *map_name, int ticks) {
+  PROFILE_BEGIN("export_to_demo");
+  timeline_state_t *ts = &ui->timeline;
+
   // set up demo things
   void *map_data = ui->gfx_handler->physics_handler.collision.m_MapData._map_file_data;
   size_t map_size = ui->gfx_handler->physics_handler.collision.m_MapData._map_file_size;
@@ -479,71 +597,66 @@ int export_to_demo(ui_handler_t *ui, const char *path, const char *map_name, int
   FILE *f_demo = fopen(path, "wb");
   if (!writer || !f_demo) {
     log_error(LOG_SOURCE, "Error: Could not create demo writer or open output file.");
+    if (writer) demo_w_destroy(&writer);
+    if (f_demo) fclose(f_demo);
+    PROFILE_END();
     return 1;
   }
 
   demo_w_begin(writer, f_demo, map_name, map_crc, "Race");
   demo_w_write_map(writer, map_sha256, map_data, map_size);
 
-  dd_snapshot_builder *sb = demo_sb_create();
-  uint8_t snap_buf[DD_SNAPSHOT_MAX_SIZE];
-
-  // empty previous and current worlds
-  SWorldCore prev = wc_empty();
-  SWorldCore cur = wc_empty();
-
-  // get initial worlds
-  model_get_world_state_at_tick(&ui->timeline, 0, &cur, false);
-  wc_copy_world(&prev, &cur);
-  cur.user_data = &ui->demo_exporter;
-  cur.particle = on_hammer_hit;
+  // make sure every segment has a nearby keyframe to start from
+  SWorldCore warm = wc_empty();
+  model_get_world_state_at_tick(ts, imax(ticks - 1, 0), &warm, false);
+  wc_free(&warm);
+
+  int segment_count = (ticks + DEMO_EXPORT_SEGMENT_TICKS - 1) / DEMO_EXPORT_SEGMENT_TICKS;
+  int batch_size = (ui->thread_pool.worker_count + 1) * 2;
+  demo_segment_t *segments = calloc(batch_size, sizeof(demo_segment_t));
+  if (!segments) {
+    demo_w_finish(writer);
+    demo_w_destroy(&writer);
+    PROFILE_END();
+    return 1;
+  }
 
-  for (int t = 0; t < ticks; ++t) {
-    demo_sb_clear(sb);
-    for (int i = 0; i < cur.m_NumCharacters; ++i) {
-      SPlayerInput input = model_get_input_at_tick(&ui->timeline, i, cur.m_GameTick);
-      cc_on_input(&cur.m_pCharacters[i], &input);
+  bool failed = false;
+  for (int first = 0; first < segment_count && !failed; first += batch_size) {
+    int count = imin(batch_size, segment_count - first);
+    for (int i = 0; i < count; ++i) {
+      memset(&segments[i], 0, sizeof(demo_segment_t));
+      segments[i].start_tick = (first + i) * DEMO_EXPORT_SEGMENT_TICKS;
+      segments[i].end_tick = imin(segments[i].start_tick + DEMO_EXPORT_SEGMENT_TICKS, ticks);
     }
-    snap_world(sb, &ui->timeline, &prev, &cur);
-    wc_copy_world(&prev, &cur);
-    ui->demo_exporter.num_hammerhits = 0;
-    wc_tick(&cur);
 
-    int snap_size = demo_sb_finish(sb, snap_buf);
-    if (snap_size > 0) demo_w_write_snap(writer, t, snap_buf, snap_size);
-
-    // Write Net Events
-    for (int i = 0; i < ui->timeline.net_event_count; ++i) {
-      net_event_t *ev = &ui->timeline.net_events[i];
-      if (ev->tick == t) {
-        if (ev->type == NET_EVENT_CHAT) {
-          demo_w_write_msg_sv_chat(writer, ev->team, ev->client_id, ev->message);
-          log_info("what", "Id: %d, team: %d, msg: %s", ev->client_id, ev->team, ev->message);
-        } else if (ev->type == NET_EVENT_BROADCAST) {
-          demo_w_write_msg_sv_broadcast(writer, ev->message);
-        } else if (ev->type == NET_EVENT_KILLMSG) {
-          demo_w_write_msg_sv_killmsg(writer, ev->killer, ev->victim, ev->weapon, ev->mode_special);
-        } else if (ev->type == NET_EVENT_SOUND_GLOBAL) {
-          demo_w_write_msg_sv_sound_global(writer, ev->sound_id);
-        } else if (ev->type == NET_EVENT_EMOTICON) {
-          demo_w_write_msg_sv_emoticon(writer, ev->client_id, ev->emoticon);
-        } else if (ev->type == NET_EVENT_VOTE_SET) {
-          demo_w_write_msg_sv_vote_set(writer, ev->vote_timeout, ev->message, ev->reason);
-        } else if (ev->type == NET_EVENT_VOTE_STATUS) {
-          demo_w_write_msg_sv_vote_status(writer, ev->vote_yes, ev->vote_no, ev->vote_pass, ev->vote_total);
-        } else if (ev->type == NET_EVENT_DDRACE_TIME) {
-          demo_w_write_msg_sv_ddrace_time_legacy(writer, ev->time, ev->check, ev->finish);
-        } else if (ev->type == NET_EVENT_RECORD) {
-          demo_w_write_msg_sv_record_legacy(writer, ev->server_time_best, ev->player_time_best);
-        }
+    demo_export_job_t job = {ui, segments};
+    job_handle_t handle = thread_pool_parallel_for(&ui->thread_pool, count, 1, simulate_segments_job, &job);
+    if (handle == JOB_HANDLE_INVALID) simulate_segments_job(&job, 0, count);
+    else thread_pool_wait(&ui->thread_pool, handle);
+
+    for (int i = 0; i < count; ++i) {
+      demo_segment_t *seg = &segments[i];
+      if (seg->failed) {
+        log_error(LOG_SOURCE, "Failed to simulate ticks %d-%d.", seg->start_tick, seg->end_tick);
+        failed = true;
       }
+      size_t offset = 0;
+      for (int t = seg->start_tick; t < seg->end_tick && !failed; ++t) {
+        int snap_size = seg->snap_sizes[t - seg->start_tick];
+        if (snap_size > 0) demo_w_write_snap(writer, t, seg->snaps + offset, snap_size);
+        offset += snap_size;
+        write_net_events(writer, ts, t);
+      }
+      free_segment(seg);
     }
   }
+
+  free(segments);
   demo_w_finish(writer);
   demo_w_destroy(&writer);
-  demo_sb_destroy(&sb);
-  wc_free(&cur);
-  return 0;
+  PROFILE_END();
+  return failed ? 1 : 0;
 }
 
 void render_demo_window(ui_handler_t *ui) {
@@ -0,0 +1,188 @@
+#include "profiler_window.h"
+#include <ddnet_physics/vmath.h>
+#include <math.h>
+#include <renderer/graphics_backend.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <system/include_cimgui.h>
+#include <user_interface/widgets/imcol.h>
+
+void profiler_window_init(profiler_window_t *pw) {
+  memset(pw, 0, sizeof(profiler_window_t));
+  pw->window_ms = 100.0f;
+}
+
+void profiler_window_cleanup(profiler_window_t *pw) {
+  free(pw->zones);
+  pw->zones = NULL;
+  pw->zone_count = 0;
+}
+
+static ImU32 zone_color(const char *name) {
+  uint32_t hash = 2166136261u;
+  for (const char *c = name; *c; ++c)
+    hash = (hash ^ (uint8_t)*c) * 16777619u;
+  float r, g, b;
+  igColorConvertHSVtoRGB((float)(hash % 360) / 360.0f, 0.55f, 0.85f, &r, &g, &b);
+  return IM_COL32((int)(r * 255), (int)(g * 255), (int)(b * 255), 255);
+}
+
+static int compare_aggregates(const void *a, const void *b) {
+  const profiler_aggregate_t *x = a, *y = b;
+  return x->total_ns < y->total_ns ? 1 : x->total_ns > y->total_ns ? -1 : 0;
+}
+
+static void aggregate_zones(profiler_window_t *pw) {
+  pw->aggregate_count = 0;
+  for (int i = 0; i < pw->zone_count; ++i) {
+    const profiler_zone_t *zone = &pw->zones[i];
+    profiler_aggregate_t *agg = NULL;
+    for (int a = 0; a < pw->aggregate_count && !agg; ++a)
+      if (pw->aggregates[a].name == zone->name || strcmp(pw->aggregates[a].name, zone->name) == 0) agg = &pw->aggregates[a];
+    if (!agg) {
+      if (pw->aggregate_count >= PROFILER_WINDOW_MAX_NAMES) continue;
+      agg = &pw->aggregates[pw->aggregate_count++];
+      memset(agg, 0, sizeof(profiler_aggregate_t));
+      agg->name = zone->name;
+    }
+    uint64_t duration = zone->end_ns - zone->start_ns;
+    ++agg->count;
+    agg->total_ns += duration;
+    if (duration > agg->max_ns) agg->max_ns = duration;
+  }
+  qsort(pw->aggregates, pw->aggregate_count, sizeof(profiler_aggregate_t), compare_aggregates);
+}
+
+static void capture(profiler_window_t *pw) {
+  if (!pw->zones) pw->zones = malloc(PROFILER_WINDOW_MAX_ZONES * sizeof(profiler_zone_t));
+  if (!pw->zones) return;
+  pw->view_end_ns = profiler_now_ns();
+  uint64_t span = (uint64_t)(pw->window_ms * 1e6);
+  uint64_t since = pw->view_end_ns > span ? pw->view_end_ns - span : 0;
+  pw->zone_count = profiler_collect(pw->zones, PROFILER_WINDOW_MAX_ZONES, since);
+  pw->frame_count = profiler_collect_frames(pw->frames, PROFILER_FRAME_HISTORY);
+  aggregate_zones(pw);
+}
+
+// Timeline
+
+static void render_timeline_view(profiler_window_t *pw) {
+  float dpi_scale = gfx_get_ui_scale();
+  const float row_height = 18.0f * dpi_scale, lane_gap = 6.0f * dpi_scale, label_width = 90.0f * dpi_scale;
+  int threads = profiler_thread_count();
+  if (threads == 0) {
+    igTextDisabled("No zones recorded yet.");
+    return;
+  }
+
+  int lane_depth[PROFILER_MAX_THREADS] = {0};
+  for (int i = 0; i < pw->zone_count; ++i) {
+    const profiler_zone_t *zone = &pw->zones[i];
+    if (zone->depth + 1 > lane_depth[zone->thread]) lane_depth[zone->thread] = zone->depth + 1;
+  }
+  float lane_top[PROFILER_MAX_THREADS + 1];
+  float height = 0.0f;
+  for (int t = 0; t < threads; ++t) {
+    lane_top[t] = height;
+    height += (float)imax(lane_depth[t], 1) * row_height + lane_gap;
+  }
+
+  ImVec2 origin, avail;
+  igGetCursorScreenPos(&origin);
+  igGetContentRegionAvail(&avail);
+  float width = avail.x - label_width;
+  if (width < 50.0f) return;
+  igInvisibleButton("##profiler_timeline", (ImVec2){avail.x, height}, 0);
+  bool hovered = igIsItemHovered(ImGuiHoveredFlags_None);
+  ImVec2 mouse = igGetIO_Nil()->MousePos;
+
+  ImDrawList *draw_list = igGetWindowDrawList();
+  const float x0 = origin.x + label_width;
+  const double span_ns = (double)pw->window_ms * 1e6;
+  const double view_start = (double)pw->view_end_ns - span_ns;
+
+  for (int t = 0; t < threads; ++t) {
+    float top = origin.y + lane_top[t];
+    ImDrawList_AddRectFilled(draw_list, (ImVec2){origin.x, top}, (ImVec2){origin.x + avail.x, top + imax(lane_depth[t], 1) * row_height},
+                             IM_COL32(255, 255, 255, t % 2 ? 8 : 16), 0.0f, 0);
+    ImDrawList_AddText_Vec2(draw_list, (ImVec2){origin.x + 4.0f, top + 2.0f}, IM_COL32(200, 200, 200, 255), profiler_thread_name(t), NULL);
+  }
+
+  // frame boundaries
+  for (int i = 0; i < pw->frame_count; ++i) {
+    double x = x0 + ((double)pw->frames[i] - view_start) / span_ns * width;
+    if (x < x0 || x > x0 + width) continue;
+    ImDrawList_AddLine(draw_list, (ImVec2){(float)x, origin.y}, (ImVec2){(float)x, origin.y + height}, IM_COL32(255, 255, 255, 40), 1.0f);
+  }
+
+  const profiler_zone_t *hovered_zone = NULL;
+  for (int i = 0; i < pw->zone_count; ++i) {
+    const profiler_zone_t *zone = &pw->zones[i];
+    double start = x0 + ((double)zone->start_ns - view_start) / span_ns * width;
+    double end = x0 + ((double)zone->end_ns - view_start) / span_ns * width;
+    if (end < x0 || start > x0 + width) continue;
+    ImVec2 min = {(float)fmax(start, x0), origin.y + lane_top[zone->thread] + zone->depth * row_height};
+    ImVec2 max = {(float)fmin(fmax(end, start + 1.0), x0 + width), min.y + row_height - 1.0f};
+    ImDrawList_AddRectFilled(draw_list, min, max, zone_color(zone->name), 2.0f, 0);
+
+    ImVec2 text_size;
+    igCalcTextSize(&text_size, zone->name, NULL, false, -1.0f);
+    if (max.x - min.x > text_size.x + 6.0f)
+      ImDrawList_AddText_Vec2(draw_list, (ImVec2){min.x + 3.0f, min.y + 1.0f}, IM_COL32(20, 20, 20, 255), zone->name, NULL);
+    if (hovered && mouse.x >= min.x && mouse.x < max.x && mouse.y >= min.y && mouse.y < max.y) hovered_zone = zone;
+  }
+
+  if (hovered_zone)
+    igSetTooltip("%s\n%.3f ms on %s", hovered_zone->name, (double)(hovered_zone->end_ns - hovered_zone->start_ns) / 1e6,
+                 profiler_thread_name(hovered_zone->thread));
+}
+
+static void render_aggregate_table(profiler_window_t *pw) {
+  if (pw->aggregate_count == 0) return;
+  if (!igBeginTable("ProfilerZones", 5, ImGuiTableFlags_BordersInnerV | ImGuiTableFlags_RowBg, (ImVec2){0, 0}, 0)) return;
+  igTableSetupColumn("Zone", ImGuiTableColumnFlags_WidthStretch, 0.0f, 0);
+  igTableSetupColumn("Count", ImGuiTableColumnFlags_WidthFixed, 0.0f, 0);
+  igTableSetupColumn("Total", ImGuiTableColumnFlags_WidthFixed, 0.0f, 0);
+  igTableSetupColumn("Avg", ImGuiTableColumnFlags_WidthFixed, 0.0f, 0);
+  igTableSetupColumn("Max", ImGuiTableColumnFlags_WidthFixed, 0.0f, 0);
+  igTableHeadersRow();
+  for (int i = 0; i < pw->aggregate_count; ++i) {
+    const profiler_aggregate_t *agg = &pw->aggregates[i];
+    igTableNextRow(0, 0);
+    igTableSetColumnIndex(0);
+    igText("%s", agg->name);
+    igTableSetColumnIndex(1);
+    igText("%d", agg->count);
+    igTableSetColumnIndex(2);
+    igText("%.3f ms", (double)agg->total_ns / 1e6);
+    igTableSetColumnIndex(3);
+    igText("%.3f ms", (double)agg->total_ns / 1e6 / agg->count);
+    igTableSetColumnIndex(4);
+    igText("%.3f ms", (double)agg->max_ns / 1e6);
+  }
+  igEndTable();
+}
+
+void render_profiler_window(profiler_window_t *pw) {
+  if (!pw->show) return;
+  if (!pw->paused) capture(pw);
+
+  igSetNextWindowSize((ImVec2){720, 420}, ImGuiCond_FirstUseEver);
+  if (igBegin("Profiler", &pw->show, 0)) {
+    bool enabled = profiler_is_enabled();
+    if (igCheckbox("Record", &enabled)) profiler_set_enabled(enabled);
+    igSameLine(0, -1);
+    igCheckbox("Pause", &pw->paused);
+    igSameLine(0, -1);
+    igSetNextItemWidth(200.0f * gfx_get_ui_scale());
+    igSliderFloat("Window (ms)", &pw->window_ms, 5.0f, 1000.0f, "%.0f", ImGuiSliderFlags_Logarithmic);
+    if (pw->zone_count >= PROFILER_WINDOW_MAX_ZONES) igTextDisabled("Too many zones, only the first %d are shown.", PROFILER_WINDOW_MAX_ZONES);
+    igSeparator();
+
+    render_timeline_view(pw);
+    igSeparator();
+    render_aggregate_table(pw);
+  }
+  igEnd();
+}
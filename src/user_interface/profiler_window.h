@@ -0,0 +1,34 @@
+#ifndef PROFILER_WINDOW_H
+#define PROFILER_WINDOW_H
+
+#include <system/profiler.h>
+#include <types.h>
+
+#define PROFILER_WINDOW_MAX_ZONES (1 << 16)
+#define PROFILER_WINDOW_MAX_NAMES 128
+
+typedef struct {
+  const char *name;
+  int count;
+  uint64_t total_ns;
+  uint64_t max_ns;
+} profiler_aggregate_t;
+
+struct profiler_window_t {
+  profiler_zone_t *zones; // zones of the shown time window, refreshed every frame unless paused
+  int zone_count;
+  uint64_t frames[PROFILER_FRAME_HISTORY];
+  int frame_count;
+  profiler_aggregate_t aggregates[PROFILER_WINDOW_MAX_NAMES];
+  int aggregate_count;
+  uint64_t view_end_ns;
+  float window_ms;
+  bool paused;
+  bool show;
+};
+
+void profiler_window_init(profiler_window_t *pw);
+void profiler_window_cleanup(profiler_window_t *pw);
+void render_profiler_window(profiler_window_t *pw);
+
+#endif // PROFILER_WINDOW_H
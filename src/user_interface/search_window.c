@@ -0,0 +1,402 @@
+#include "search_window.h"
+#include "user_interface.h"
+#include <ddnet_physics/collision.h>
+#include <logger/logger.h>
+#include <renderer/graphics_backend.h>
+#include <stdlib.h>
+#include <string.h>
+#include <system/include_cimgui.h>
+#include <user_interface/timeline/timeline_model.h>
+
+static const char *LOG_SOURCE = "Search";
+
+void search_window_init(search_window_t *sw) {
+  memset(sw, 0, sizeof(search_window_t));
+  sw->window_ticks = 8;
+  sw->space.directions[SEARCH_DIRECTION_LEFT] = true;
+  sw->space.directions[SEARCH_DIRECTION_NONE] = true;
+  sw->space.directions[SEARCH_DIRECTION_RIGHT] = true;
+  sw->space.vary_jump = true;
+  sw->space.aim_steps = 1;
+  sw->space.aim_min = 0.0f;
+  sw->space.aim_max = 180.0f;
+  sw->space.aim_distance = 256.0f;
+  sw->objective.goal = SEARCH_GOAL_POSITION;
+  sw->objective.radius = 16.0f;
+  sw->objective.avoid_freeze = true;
+  sw->beam_config.width = 256;
+  sw->beam_config.samples = 8;
+  sw->beam_config.heuristic = BEAM_HEURISTIC_DISTANCE;
+  sw->beam_config.seed = 1;
+  sw->use_table = true;
+  sw->table_mb = 64;
+  sw->table_policy = TRANSPOSITION_REPLACE_SHALLOW;
+  sw->spawn_count = 1;
+  sw->reach_config.ticks = 50;
+  sw->reach_config.max_frontier = 4096;
+  sw->reach_config.position_bucket = 8.0f;
+  sw->reach_config.velocity_bucket = 1.0f;
+  sw->reach_config.table_mb = 64;
+  sw->show_overlay = true;
+  sw->overlay_opacity = 0.5f;
+}
+
+void search_window_cleanup(search_window_t *sw) {
+  // workers merge into the bruteforce state, so they go first
+  search_coordinator_shutdown(&sw->coordinator);
+  bruteforce_free(&sw->bruteforce);
+  beam_search_free(&sw->beam_search);
+  reachability_free(&sw->reachability);
+  free(sw->reach_grid);
+  free(sw->reach_planes[0]);
+  free(sw->reach_planes[1]);
+  transposition_destroy(&sw->table);
+}
+
+// (re)allocates the table when its settings changed since the last run
+static transposition_table_t *prepare_table(search_window_t *sw) {
+  if (!sw->use_table) return NULL;
+  transposition_table_t *table = &sw->table;
+  size_t bytes = (size_t)table->bucket_count * TRANSPOSITION_BUCKET_SIZE * sizeof(transposition_entry_t);
+  bool stale = !table->entries || bytes > ((size_t)sw->table_mb << 20) || bytes * 2 <= ((size_t)sw->table_mb << 20);
+  if (stale) {
+    transposition_destroy(table);
+    if (!transposition_init(table, sw->table_mb, (transposition_policy_t)sw->table_policy)) return NULL;
+  }
+  table->policy = (transposition_policy_t)sw->table_policy;
+  return table;
+}
+
+static void pick_target_from_playhead(ui_handler_t *ui) {
+  search_window_t *sw = &ui->search_window;
+  timeline_state_t *ts = &ui->timeline;
+  SWorldCore world = wc_empty();
+  model_get_world_state_at_tick(ts, ts->current_tick, &world, false);
+  if (ts->selected_player_track_index >= 0 && ts->selected_player_track_index < world.m_NumCharacters) {
+    SCharacterCore *chr = &world.m_pCharacters[ts->selected_player_track_index];
+    sw->target_block[0] = vgetx(chr->m_Pos) / 32.0f - MAP_EXPAND;
+    sw->target_block[1] = vgety(chr->m_Pos) / 32.0f - MAP_EXPAND;
+  }
+  wc_free(&world);
+}
+
+static int selected_track(timeline_state_t *ts) {
+  int track = ts->selected_player_track_index;
+  if (track >= 0 && track < ts->player_track_count) return track;
+  log_warn(LOG_SOURCE, "Select the player track to search for first.");
+  return -1;
+}
+
+// everything the search does not vary keeps the input the track already has at the window start
+static search_space_t space_at_playhead(search_window_t *sw, timeline_state_t *ts, int track) {
+  search_space_t space = sw->space;
+  space.base = model_get_input_at_tick(ts, track, ts->current_tick);
+  return space;
+}
+
+static void run_search(ui_handler_t *ui) {
+  search_window_t *sw = &ui->search_window;
+  timeline_state_t *ts = &ui->timeline;
+  int track = selected_track(ts);
+  if (track < 0) return;
+
+  search_space_t space = space_at_playhead(sw, ts, track);
+  search_objective_t objective = sw->objective;
+  objective.target = vec2_init((sw->target_block[0] + MAP_EXPAND) * 32.0f, (sw->target_block[1] + MAP_EXPAND) * 32.0f);
+  transposition_table_t *table = prepare_table(sw);
+  if (sw->mode == SEARCH_MODE_BEAM)
+    beam_search_start(&sw->beam_search, &ui->thread_pool, table, ts, track, ts->current_tick, sw->window_ticks, &space, &objective,
+                      &sw->beam_config);
+  else if (sw->distributed)
+    search_coordinator_start(&sw->coordinator, &sw->bruteforce, &ui->gfx_handler->physics_handler, ts, track, ts->current_tick,
+                             sw->window_ticks, &space, &objective, sw->use_table, sw->table_mb, sw->table_policy);
+  else bruteforce_start(&sw->bruteforce, &ui->thread_pool, table, ts, track, ts->current_tick, sw->window_ticks, &space, &objective);
+}
+
+static void run_reachability(ui_handler_t *ui) {
+  search_window_t *sw = &ui->search_window;
+  timeline_state_t *ts = &ui->timeline;
+  int track = selected_track(ts);
+  if (track < 0) return;
+  search_space_t space = space_at_playhead(sw, ts, track);
+  if (reachability_start(&sw->reachability, &ui->thread_pool, ts, track, ts->current_tick, &space, &sw->reach_config))
+    sw->reach_uploaded_at = 0.0;
+}
+
+// Overlay
+
+// r = earliest tick scaled to the search depth, g = reached
+static void upload_overlay(ui_handler_t *ui) {
+  search_window_t *sw = &ui->search_window;
+  reachability_t *rs = &sw->reachability;
+  gfx_handler_t *gfx = ui->gfx_handler;
+  if (!gfx->map_data || rs->width != (int)gfx->map_data->width || rs->height != (int)gfx->map_data->height) return;
+
+  int tiles = rs->width * rs->height;
+  if (sw->reach_tiles != tiles) {
+    free(sw->reach_grid);
+    free(sw->reach_planes[0]);
+    free(sw->reach_planes[1]);
+    sw->reach_grid = malloc(tiles * sizeof(uint16_t));
+    sw->reach_planes[0] = malloc(tiles);
+    sw->reach_planes[1] = malloc(tiles);
+    sw->reach_tiles = sw->reach_grid && sw->reach_planes[0] && sw->reach_planes[1] ? tiles : 0;
+    if (sw->reach_tiles == 0) return;
+  }
+  if (!reachability_fetch(rs, sw->reach_grid)) return;
+
+  int ticks = imax(rs->config.ticks, 1);
+  for (int i = 0; i < tiles; ++i) {
+    int earliest = sw->reach_grid[i];
+    sw->reach_planes[0][i] = earliest ? (uint8_t)((earliest - 1) * 255 / ticks) : 0;
+    sw->reach_planes[1][i] = earliest ? 255 : 0;
+  }
+  const uint8_t *planes[3] = {sw->reach_planes[0], sw->reach_planes[1], NULL};
+  gfx_set_map_overlay(gfx, planes);
+}
+
+static void update_overlay(ui_handler_t *ui, bool running) {
+  search_window_t *sw = &ui->search_window;
+  gfx_handler_t *gfx = ui->gfx_handler;
+  // re-uploading the whole grid every tick of the search would stall the frame, a few times a second is enough
+  double now = igGetTime();
+  if (!running || now - sw->reach_uploaded_at >= 0.25) {
+    upload_overlay(ui);
+    sw->reach_uploaded_at = now;
+  }
+  bool has_overlay = gfx->map_texture_count > MAP_OVERLAY_TEXTURE && gfx->map_textures[MAP_OVERLAY_TEXTURE] != gfx->renderer.default_texture;
+  gfx->map_overlay_alpha = sw->show_overlay && has_overlay ? sw->overlay_opacity : 0.0f;
+}
+
+static void render_space_settings(search_window_t *sw) {
+  search_space_t *space = &sw->space;
+  igText("Direction");
+  igSameLine(0, -1);
+  igCheckbox("Left", &space->directions[SEARCH_DIRECTION_LEFT]);
+  igSameLine(0, -1);
+  igCheckbox("None", &space->directions[SEARCH_DIRECTION_NONE]);
+  igSameLine(0, -1);
+  igCheckbox("Right", &space->directions[SEARCH_DIRECTION_RIGHT]);
+  igCheckbox("Vary jump", &space->vary_jump);
+  igSameLine(0, -1);
+  igCheckbox("Vary hook", &space->vary_hook);
+
+  igSliderInt("Aim steps", &space->aim_steps, 1, SEARCH_MAX_AIM_STEPS, space->aim_steps <= 1 ? "Keep" : "%d", 0);
+  if (space->aim_steps > 1) {
+    igDragFloatRange2("Aim angle", &space->aim_min, &space->aim_max, 1.0f, -180.0f, 180.0f, "%.0f deg", NULL, 0);
+    igDragFloat("Aim distance", &space->aim_distance, 1.0f, 1.0f, 1000.0f, "%.0f", 0);
+  }
+}
+
+static void render_beam_settings(search_window_t *sw) {
+  beam_search_config_t *config = &sw->beam_config;
+  igSliderInt("Beam width", &config->width, 1, BEAM_SEARCH_MAX_WIDTH, "%d", ImGuiSliderFlags_Logarithmic);
+  igSliderInt("Samples", &config->samples, 1, BEAM_SEARCH_MAX_SAMPLES, "%d", 0);
+  if (igIsItemHovered(ImGuiHoveredFlags_None)) igSetTooltip("Inputs tried from every kept state, the first one repeats its last input.");
+  int heuristic = config->heuristic;
+  if (igCombo_Str("Heuristic", &heuristic, "Distance to target\0Velocity toward target\0\0", 0)) config->heuristic = (beam_heuristic_t)heuristic;
+  int seed = (int)config->seed;
+  if (igInputInt("Seed", &seed, 1, 100, 0)) config->seed = (uint32_t)seed;
+}
+
+static void render_table_settings(search_window_t *sw, bool running) {
+  igBeginDisabled(running);
+  igCheckbox("Skip repeated states", &sw->use_table);
+  if (igIsItemHovered(ImGuiHoveredFlags_None)) igSetTooltip("Remembers every world state seen and prunes sequences that reach one again.");
+  if (sw->use_table) {
+    igSliderInt("Table size", &sw->table_mb, 1, 4096, "%d MB", ImGuiSliderFlags_Logarithmic);
+    igCombo_Str("Replacement", &sw->table_policy, "Always\0Keep earliest\0\0", 0);
+  }
+  igEndDisabled();
+  if (!sw->use_table || !sw->table.entries) return;
+
+  transposition_stats_t stats;
+  float fill;
+  transposition_get_stats(&sw->table, &stats, &fill);
+  float hit_rate = stats.probes > 0 ? (float)stats.hits / (float)stats.probes : 0.0f;
+  igText("Probes: %lld, hits: %.1f%%, fill: %.1f%%", stats.probes, hit_rate * 100.0f, fill * 100.0f);
+  if (stats.replacements + stats.rejected > 0) igText("Replaced: %lld, dropped: %lld", stats.replacements, stats.rejected);
+}
+
+static void render_distributed_settings(search_window_t *sw, bool running) {
+  igBeginDisabled(running);
+  if (igCheckbox("Run on worker processes", &sw->distributed) && sw->distributed) search_coordinator_listen(&sw->coordinator);
+  igEndDisabled();
+  if (igIsItemHovered(ImGuiHoveredFlags_None))
+    igSetTooltip("Splits the search over '--search-worker' processes, each with its own threads and table.");
+  if (!sw->distributed || !sw->coordinator.listener) return;
+
+  int threads;
+  int workers = search_coordinator_worker_count(&sw->coordinator, &threads);
+  igText("Listening on 127.0.0.1:%d, %d workers with %d threads", sw->coordinator.port, workers, threads);
+  igSliderInt("Workers", &sw->spawn_count, 1, 16, "%d", 0);
+  igSliderInt("Threads each", &sw->spawn_threads, 0, 64, sw->spawn_threads <= 0 ? "All cores" : "%d", 0);
+  if (igButton("Spawn local workers", (ImVec2){0, 0})) search_coordinator_spawn_workers(&sw->coordinator, sw->spawn_count, sw->spawn_threads);
+}
+
+static void render_objective_settings(search_window_t *sw) {
+  search_objective_t *objective = &sw->objective;
+  int goal = objective->goal;
+  if (igCombo_Str("Goal", &goal, "Reach position\0Reach finish\0\0", 0)) objective->goal = (search_goal_t)goal;
+  igDragFloat2("Target (blocks)", sw->target_block, 0.1f, -MAP_EXPAND, 10000.0f, "%.2f", 0);
+  if (objective->goal == SEARCH_GOAL_FINISH && igIsItemHovered(ImGuiHoveredFlags_None))
+    igSetTooltip("Only guides sequences that do not finish inside the window.");
+  if (objective->goal == SEARCH_GOAL_POSITION) igDragFloat("Radius", &objective->radius, 1.0f, 1.0f, 512.0f, "%.0f units", 0);
+  igCheckbox("Avoid freeze", &objective->avoid_freeze);
+}
+
+static void render_bruteforce_status(ui_handler_t *ui, bool running) {
+  search_window_t *sw = &ui->search_window;
+  bruteforce_t *bf = &sw->bruteforce;
+  if (running && sw->coordinator.running) {
+    igProgressBar(search_coordinator_progress(&sw->coordinator), (ImVec2){-1, 0}, NULL);
+    if (igButton("Cancel", (ImVec2){0, 0})) search_coordinator_cancel(&sw->coordinator);
+  } else if (running) {
+    igProgressBar(thread_pool_progress(&ui->thread_pool, bf->job), (ImVec2){-1, 0}, NULL);
+    if (igButton("Cancel", (ImVec2){0, 0})) bruteforce_cancel(bf);
+  } else {
+    double candidates = bruteforce_candidate_count(&ui->search_window.space, ui->search_window.window_ticks);
+    igBeginDisabled(candidates > BRUTEFORCE_MAX_CANDIDATES || !ui->gfx_handler->physics_handler.loaded);
+    if (igButton("Run", (ImVec2){0, 0})) run_search(ui);
+    igEndDisabled();
+    igSameLine(0, -1);
+    igBeginDisabled(!bruteforce_has_result(bf));
+    if (igButton("Apply", (ImVec2){0, 0})) bruteforce_apply(bf, ui);
+    igEndDisabled();
+  }
+  if (!bf->lock) return;
+
+  thread_mutex_lock(bf->lock);
+  long long nodes = bf->nodes;
+  float best = bf->best_score;
+  int length = bf->best_length;
+  thread_mutex_unlock(bf->lock);
+
+  igText("Ticks simulated: %lld", nodes);
+  if (length == 0) igTextDisabled("No sequence yet.");
+  else if (best <= (float)bf->ctx.ticks) igText("Best: reached after %d ticks", length);
+  else igText("Best: missed by %.2f blocks", best - (float)bf->ctx.ticks);
+}
+
+static void render_beam_status(ui_handler_t *ui, bool running) {
+  beam_search_t *bs = &ui->search_window.beam_search;
+  if (running) {
+    igProgressBar(beam_search_progress(bs), (ImVec2){-1, 0}, NULL);
+    if (igButton("Cancel", (ImVec2){0, 0})) beam_search_cancel(bs);
+  } else {
+    igBeginDisabled(!ui->gfx_handler->physics_handler.loaded);
+    if (igButton("Run", (ImVec2){0, 0})) run_search(ui);
+    igEndDisabled();
+    igSameLine(0, -1);
+    igBeginDisabled(!beam_search_has_result(bs));
+    if (igButton("Apply", (ImVec2){0, 0})) beam_search_apply(bs, ui);
+    igEndDisabled();
+  }
+  if (!bs->lock) return;
+
+  thread_mutex_lock(bs->lock);
+  long long nodes = bs->nodes;
+  float best = bs->best_score;
+  int length = bs->best_length;
+  bool reached = bs->reached;
+  thread_mutex_unlock(bs->lock);
+
+  igText("Ticks simulated: %lld", nodes);
+  if (length == 0) igTextDisabled("No sequence yet.");
+  else if (reached) igText("Best: reached after %d ticks", length);
+  else igText("Best: score %.2f after %d ticks", best, length);
+}
+
+static void render_reachability(ui_handler_t *ui, bool running) {
+  search_window_t *sw = &ui->search_window;
+  reachability_t *rs = &sw->reachability;
+  reachability_config_t *config = &sw->reach_config;
+  if (!igCollapsingHeader_TreeNodeFlags("Reachability map", 0)) return;
+
+  igBeginDisabled(running);
+  igSliderInt("Depth", &config->ticks, 1, REACHABILITY_MAX_TICKS, "%d ticks", ImGuiSliderFlags_Logarithmic);
+  igSliderInt("Frontier", &config->max_frontier, 1, REACHABILITY_MAX_FRONTIER, "%d states", ImGuiSliderFlags_Logarithmic);
+  if (igIsItemHovered(ImGuiHoveredFlags_None)) igSetTooltip("Distinct states kept per tick, the rest of a crowded tick is not expanded.");
+  igDragFloat("Position bucket", &config->position_bucket, 0.5f, 1.0f, 64.0f, "%.1f units", 0);
+  igDragFloat("Velocity bucket", &config->velocity_bucket, 0.05f, 0.01f, 16.0f, "%.2f", 0);
+  if (igIsItemHovered(ImGuiHoveredFlags_None)) igSetTooltip("States within the same buckets count as one. Larger buckets search faster but coarser.");
+  igCheckbox("Expand frozen states", &config->expand_frozen);
+  igEndDisabled();
+  igCheckbox("Show overlay", &sw->show_overlay);
+  igSameLine(0, -1);
+  igSliderFloat("##opacity", &sw->overlay_opacity, 0.05f, 1.0f, "%.2f", 0);
+
+  if (running) {
+    igProgressBar(reachability_progress(rs), (ImVec2){-1, 0}, NULL);
+    if (igButton("Cancel##reachability", (ImVec2){0, 0})) reachability_cancel(rs);
+  } else {
+    igBeginDisabled(!ui->gfx_handler->physics_handler.loaded);
+    if (igButton("Map reachable tiles", (ImVec2){0, 0})) run_reachability(ui);
+    igEndDisabled();
+    igSameLine(0, -1);
+    if (igButton("Clear overlay", (ImVec2){0, 0})) gfx_set_map_overlay(ui->gfx_handler, NULL);
+  }
+  if (!rs->lock) return;
+
+  thread_mutex_lock(rs->lock);
+  int depth = rs->depth, reached = rs->reached_tiles;
+  long long nodes = rs->nodes;
+  bool truncated = rs->truncated;
+  thread_mutex_unlock(rs->lock);
+  igText("%d tiles within %d ticks, %lld ticks simulated", reached, depth, nodes);
+  if (truncated) igTextDisabled("Frontier was full on some ticks.");
+}
+
+void render_search_window(ui_handler_t *ui) {
+  search_window_t *sw = &ui->search_window;
+  bool bruteforce_running = bruteforce_poll(&sw->bruteforce);
+  bruteforce_running |= search_coordinator_poll(&sw->coordinator);
+  bool beam_running = beam_search_poll(&sw->beam_search);
+  bool reach_running = reachability_poll(&sw->reachability);
+  update_overlay(ui, reach_running);
+  if (!sw->show) return;
+
+  igSetNextWindowSize((ImVec2){380, 480}, ImGuiCond_FirstUseEver);
+  if (igBegin("Input Search", &sw->show, 0)) {
+    timeline_state_t *ts = &ui->timeline;
+    int mode = sw->mode;
+    igBeginDisabled(bruteforce_running || beam_running);
+    if (igCombo_Str("Mode", &mode, "Bruteforce\0Beam search\0\0", 0)) sw->mode = (search_mode_t)mode;
+    igEndDisabled();
+
+    int max_ticks = sw->mode == SEARCH_MODE_BEAM ? BEAM_SEARCH_MAX_TICKS : BRUTEFORCE_MAX_TICKS;
+    sw->window_ticks = imin(sw->window_ticks, max_ticks);
+    igText("Track %d, ticks %d - %d", ts->selected_player_track_index + 1, ts->current_tick, ts->current_tick + sw->window_ticks);
+    igSliderInt("Window", &sw->window_ticks, 1, max_ticks, "%d ticks", 0);
+
+    igSeparator();
+    render_space_settings(sw);
+    if (sw->mode == SEARCH_MODE_BEAM) {
+      igSeparator();
+      render_beam_settings(sw);
+    }
+    igSeparator();
+    render_table_settings(sw, bruteforce_running || beam_running);
+    if (sw->mode == SEARCH_MODE_BRUTEFORCE) {
+      igSeparator();
+      render_distributed_settings(sw, bruteforce_running);
+    }
+    igSeparator();
+    render_objective_settings(sw);
+    if (igButton("Target from playhead", (ImVec2){0, 0})) pick_target_from_playhead(ui);
+    if (igIsItemHovered(ImGuiHoveredFlags_None)) igSetTooltip("Uses the position of the selected player at the playhead.");
+    igSeparator();
+
+    if (sw->mode == SEARCH_MODE_BEAM) {
+      igText("%d choices per tick", search_space_choice_count(&sw->space));
+      render_beam_status(ui, beam_running);
+    } else {
+      igText("%d choices per tick, %.3g candidates", search_space_choice_count(&sw->space),
+             bruteforce_candidate_count(&sw->space, sw->window_ticks));
+      render_bruteforce_status(ui, bruteforce_running);
+    }
+    igSeparator();
+    render_reachability(ui, reach_running);
+  }
+  igEnd();
+}
@@ -0,0 +1,45 @@
+#ifndef SEARCH_WINDOW_H
+#define SEARCH_WINDOW_H
+
+#include <search/beam_search.h>
+#include <search/bruteforce.h>
+#include <search/reachability.h>
+#include <search/search_coordinator.h>
+#include <types.h>
+
+typedef enum { SEARCH_MODE_BRUTEFORCE, SEARCH_MODE_BEAM } search_mode_t;
+
+struct search_window_t {
+  bruteforce_t bruteforce;
+  beam_search_t beam_search;
+  beam_search_config_t beam_config;
+  transposition_table_t table;
+  int table_mb; // size of `table` once allocated, changes apply on the next run
+  int table_policy;
+  bool use_table;
+  search_coordinator_t coordinator;
+  bool distributed; // bruteforce runs on worker processes instead of the editor's thread pool
+  int spawn_count;
+  int spawn_threads;
+  search_mode_t mode;
+  search_space_t space;
+  search_objective_t objective;
+  float target_block[2]; // objective target in map blocks, as shown in player info
+  int window_ticks;
+  bool show;
+
+  reachability_t reachability;
+  reachability_config_t reach_config;
+  uint16_t *reach_grid; // last fetched grid, turned into the map overlay
+  uint8_t *reach_planes[2];
+  int reach_tiles;
+  double reach_uploaded_at;
+  bool show_overlay;
+  float overlay_opacity;
+};
+
+void search_window_init(search_window_t *sw);
+void search_window_cleanup(search_window_t *sw);
+void render_search_window(ui_handler_t *ui);
+
+#endif // SEARCH_WINDOW_H
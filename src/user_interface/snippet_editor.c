@@ -137,6 +137,27 @@ static void end_action(ui_handler_t *ui, input_snippet_t *snippet) {
   editor_state.action_in_progress = false;
 }
 
+// A paint drag is one undo transaction, the physics are invalidated once when the mouse is released
+static void start_painting(ui_handler_t *ui, int column) {
+  editor_state.is_painting = true;
+  editor_state.painting_column = column;
+  undo_manager_begin_transaction(&ui->undo_manager, &ui->timeline, "Paint Inputs");
+}
+
+static void stop_painting(ui_handler_t *ui) {
+  input_snippet_t *snippet = model_find_snippet_by_id(&ui->timeline, editor_state.active_snippet_id, NULL);
+  editor_state.is_painting = false;
+  if (editor_state.action_in_progress && snippet) end_action(ui, snippet);
+  undo_manager_commit_transaction(&ui->undo_manager, &ui->timeline);
+}
+
+// live edits write straight into the snippet, the undo command is only recorded afterwards
+static void mark_inputs_changed(timeline_state_t *ts, input_snippet_t *snippet, int start_tick, int end_tick) {
+  int track_index = -1;
+  if (snippet->is_active && model_find_snippet_by_id(ts, snippet->id, &track_index) == snippet)
+    model_mark_inputs_changed(ts, track_index, start_tick, end_tick);
+}
+
 static const char *weapon_options[] = {"Hammer", "Gun", "Shotgun", "Grenade", "Laser", "Ninja"};
 
 // Bulk Edit Panel
@@ -280,6 +301,7 @@ static void render_bulk_edit_panel(ui_handler_t *ui, input_snippet_t *snippet) {
 
     if (earliest_tick != -1) {
       // All actions now create undo commands, which already call recalc.
+      mark_inputs_changed(ts, snippet, snippet->start_tick + earliest_tick, snippet->end_tick);
       model_recalc_physics(ts, snippet->start_tick + earliest_tick);
     }
   }
@@ -301,6 +323,8 @@ static void commit_single_edit(ui_handler_t *ui, input_snippet_t *snippet, int i
 
 void render_snippet_editor_panel(ui_handler_t *ui) {
   timeline_state_t *ts = &ui->timeline;
+  // checked before anything can return early, a drag must not leave its transaction open
+  if (editor_state.is_painting && !igIsMouseDown_Nil(ImGuiMouseButton_Left)) stop_painting(ui);
   if (igBegin("Snippet Editor", NULL, 0)) {
     // Check the number of selected snippets first
     if (ts->selected_snippets.count == 0) {
@@ -328,6 +352,7 @@ void render_snippet_editor_panel(ui_handler_t *ui) {
       return;
     }
     if (editor_state.active_snippet_id != snippet->id) {
+      if (editor_state.is_painting) stop_painting(ui);
       reset_editor_state();
       editor_state.active_snippet_id = snippet->id;
     }
@@ -360,13 +385,6 @@ void render_snippet_editor_panel(ui_handler_t *ui) {
       igTableSetupColumn("Tele", ImGuiTableColumnFlags_None, 0.0f, 8);
       igTableHeadersRow();
 
-      if (igIsMouseReleased_Nil(ImGuiMouseButton_Left)) {
-        editor_state.is_painting = false;
-        if (editor_state.action_in_progress) {
-          end_action(ui, snippet);
-        }
-      }
-
       ImGuiListClipper *clipper = ImGuiListClipper_ImGuiListClipper();
       ImGuiListClipper_Begin(clipper, snippet->input_count, 0);
       while (ImGuiListClipper_Step(clipper)) {
@@ -455,8 +473,7 @@ void render_snippet_editor_panel(ui_handler_t *ui) {
           if (igIsItemClicked(ImGuiMouseButton_Left)) {
             // Now that a selection is guaranteed, begin the action.
             begin_action();
-            editor_state.is_painting = true;
-            editor_state.painting_column = 1;
+            start_painting(ui, 1);
             record_change_if_new(snippet, i); // Record state before changing
             inp->m_Direction = (inp->m_Direction + 1 + 1) % 3 - 1;
             editor_state.painting_value = inp->m_Direction;
@@ -538,8 +555,7 @@ void render_snippet_editor_panel(ui_handler_t *ui) {
             ImDrawList_AddRectFilled(igGetWindowDrawList(), r_min, r_max, *val ? c_on : c_off, 2.0f, 0);
             if (igIsItemClicked(ImGuiMouseButton_Left)) {
               begin_action();
-              editor_state.is_painting = true;
-              editor_state.painting_column = current_column;
+              start_painting(ui, current_column);
               record_change_if_new(snippet, i);
               *val = !*val;
               editor_state.painting_value = *val;
@@ -598,7 +614,10 @@ void render_snippet_editor_panel(ui_handler_t *ui) {
           igPopItemWidth();
           igPopID();
 
-          if (needs_recalc) model_recalc_physics(ts, recalc_tick);
+          if (needs_recalc) {
+            mark_inputs_changed(ts, snippet, recalc_tick, recalc_tick + 1);
+            model_recalc_physics(ts, recalc_tick);
+          }
         }
       }
       ImGuiListClipper_End(clipper);
@@ -719,6 +738,7 @@ void render_snippet_editor_panel(ui_handler_t *ui) {
       }
 
       if (changed && earliest_tick != -1) {
+        mark_inputs_changed(ts, snippet, snippet->start_tick + earliest_tick, snippet->end_tick);
         model_recalc_physics(ts, snippet->start_tick + earliest_tick);
       }
     }
@@ -0,0 +1,133 @@
+#include "input_chunks.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define CHUNK_BUCKETS 4096
+
+// main thread only like the rest of the undo history, see input_chunks.h
+static input_chunk_t *buckets[CHUNK_BUCKETS];
+static size_t total_bytes = 0;
+
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+static uint64_t fnv_int(uint64_t h, int v) {
+  const uint8_t *p = (const uint8_t *)&v;
+  for (size_t i = 0; i < sizeof(v); ++i) {
+    h ^= p[i];
+    h *= FNV_PRIME;
+  }
+  return h;
+}
+
+// field by field so struct padding never splits equal inputs into different chunks
+static uint64_t hash_inputs(const SPlayerInput *inputs, int count) {
+  uint64_t h = FNV_OFFSET;
+  for (int i = 0; i < count; ++i) {
+    const SPlayerInput *in = &inputs[i];
+    h = fnv_int(h, in->m_Direction);
+    h = fnv_int(h, in->m_TargetX);
+    h = fnv_int(h, in->m_TargetY);
+    h = fnv_int(h, in->m_Jump);
+    h = fnv_int(h, in->m_Fire);
+    h = fnv_int(h, in->m_Hook);
+    h = fnv_int(h, in->m_WantedWeapon);
+    h = fnv_int(h, in->m_TeleOut);
+    h = fnv_int(h, in->m_Flags);
+  }
+  return h;
+}
+
+static bool inputs_equal(const SPlayerInput *a, const SPlayerInput *b, int count) {
+  for (int i = 0; i < count; ++i) {
+    if (a[i].m_Direction != b[i].m_Direction || a[i].m_TargetX != b[i].m_TargetX || a[i].m_TargetY != b[i].m_TargetY ||
+        a[i].m_Jump != b[i].m_Jump || a[i].m_Fire != b[i].m_Fire || a[i].m_Hook != b[i].m_Hook ||
+        a[i].m_WantedWeapon != b[i].m_WantedWeapon || a[i].m_TeleOut != b[i].m_TeleOut || a[i].m_Flags != b[i].m_Flags)
+      return false;
+  }
+  return true;
+}
+
+static size_t chunk_bytes(int count) { return sizeof(input_chunk_t) + sizeof(SPlayerInput) * count; }
+
+static input_chunk_t *chunk_acquire(const SPlayerInput *inputs, int count) {
+  uint64_t hash = hash_inputs(inputs, count);
+  input_chunk_t **bucket = &buckets[hash % CHUNK_BUCKETS];
+  for (input_chunk_t *c = *bucket; c; c = c->next) {
+    if (c->hash == hash && c->count == count && inputs_equal(c->inputs, inputs, count)) {
+      c->refcount++;
+      return c;
+    }
+  }
+
+  input_chunk_t *c = malloc(chunk_bytes(count));
+  if (!c) return NULL;
+  c->hash = hash;
+  c->refcount = 1;
+  c->count = count;
+  memcpy(c->inputs, inputs, sizeof(SPlayerInput) * count);
+  c->next = *bucket;
+  *bucket = c;
+  total_bytes += chunk_bytes(count);
+  return c;
+}
+
+static void chunk_release(input_chunk_t *chunk) {
+  if (--chunk->refcount > 0) return;
+  input_chunk_t **link = &buckets[chunk->hash % CHUNK_BUCKETS];
+  while (*link && *link != chunk)
+    link = &(*link)->next;
+  if (*link) *link = chunk->next;
+  total_bytes -= chunk_bytes(chunk->count);
+  free(chunk);
+}
+
+bool chunked_inputs_build(chunked_inputs_t *out, const SPlayerInput *inputs, int count) {
+  memset(out, 0, sizeof(chunked_inputs_t));
+  if (!inputs || count <= 0) return true;
+
+  int chunk_count = (count + INPUT_CHUNK_SIZE - 1) / INPUT_CHUNK_SIZE;
+  out->chunks = malloc(sizeof(input_chunk_t *) * chunk_count);
+  if (!out->chunks) return false;
+
+  for (int i = 0; i < chunk_count; ++i) {
+    int offset = i * INPUT_CHUNK_SIZE;
+    int n = count - offset < INPUT_CHUNK_SIZE ? count - offset : INPUT_CHUNK_SIZE;
+    input_chunk_t *c = chunk_acquire(&inputs[offset], n);
+    if (!c) {
+      chunked_inputs_free(out);
+      return false;
+    }
+    out->chunks[out->chunk_count++] = c;
+    out->input_count += n;
+  }
+  return true;
+}
+
+SPlayerInput *chunked_inputs_flatten(const chunked_inputs_t *in) {
+  if (in->input_count <= 0) return NULL;
+  SPlayerInput *inputs = malloc(sizeof(SPlayerInput) * in->input_count);
+  if (!inputs) return NULL;
+  int offset = 0;
+  for (int i = 0; i < in->chunk_count; ++i) {
+    memcpy(&inputs[offset], in->chunks[i]->inputs, sizeof(SPlayerInput) * in->chunks[i]->count);
+    offset += in->chunks[i]->count;
+  }
+  return inputs;
+}
+
+void chunked_inputs_free(chunked_inputs_t *in) {
+  for (int i = 0; i < in->chunk_count; ++i)
+    chunk_release(in->chunks[i]);
+  free(in->chunks);
+  memset(in, 0, sizeof(chunked_inputs_t));
+}
+
+size_t chunked_inputs_shared_bytes(const chunked_inputs_t *in) {
+  size_t bytes = sizeof(input_chunk_t *) * in->chunk_count;
+  for (int i = 0; i < in->chunk_count; ++i)
+    bytes += chunk_bytes(in->chunks[i]->count) / in->chunks[i]->refcount;
+  return bytes;
+}
+
+size_t input_chunks_total_bytes(void) { return total_bytes; }
@@ -0,0 +1,38 @@
+#ifndef UI_TIMELINE_INPUT_CHUNKS_H
+#define UI_TIMELINE_INPUT_CHUNKS_H
+
+#include "timeline_types.h"
+
+// Immutable, reference counted blocks of inputs used by undo snapshots.
+// Chunks are interned by content, so snapshots of the same track taken by
+// different commands share every chunk that didn't change in between.
+// The intern table is not locked, everything here is main thread only like the undo history.
+
+#define INPUT_CHUNK_SIZE 256
+
+struct input_chunk_t {
+  input_chunk_t *next; // hash bucket chain
+  uint64_t hash;
+  int refcount;
+  int count;
+  SPlayerInput inputs[];
+};
+
+struct chunked_inputs_t {
+  input_chunk_t **chunks;
+  int chunk_count;
+  int input_count;
+};
+
+// false when out of memory, `out` is left empty then
+bool chunked_inputs_build(chunked_inputs_t *out, const SPlayerInput *inputs, int count);
+// Returns a freshly malloc'd flat copy, or NULL when empty.
+SPlayerInput *chunked_inputs_flatten(const chunked_inputs_t *in);
+void chunked_inputs_free(chunked_inputs_t *in);
+
+// This snapshot's share of its chunks, each chunk split evenly among its owners.
+size_t chunked_inputs_shared_bytes(const chunked_inputs_t *in);
+// Bytes currently held by all live chunks.
+size_t input_chunks_total_bytes(void);
+
+#endif // UI_TIMELINE_INPUT_CHUNKS_H
@@ -1,8 +1,10 @@
 #include "timeline_commands.h"
+#include "input_chunks.h"
 #include "timeline_interaction.h"
 #include "timeline_model.h"
 #include <limits.h>
 #include <renderer/graphics_backend.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <user_interface/user_interface.h>
@@ -10,6 +12,58 @@
 // Define a reasonable max number of tracks to handle for batch operations
 #define MAX_MODIFIED_TRACKS_PER_COMMAND 256
 
+// Snippet copy whose inputs live in shared, immutable chunks (snippet.inputs stays NULL)
+typedef struct {
+  input_snippet_t snippet;
+  chunked_inputs_t inputs;
+} SharedSnippet;
+
+static bool shared_snippet_capture(SharedSnippet *dest, const input_snippet_t *src) {
+  dest->snippet = *src;
+  dest->snippet.inputs = NULL;
+  if (!chunked_inputs_build(&dest->inputs, src->inputs, src->input_count)) return false;
+  dest->snippet.input_count = dest->inputs.input_count;
+  return true;
+}
+
+static void shared_snippet_restore(input_snippet_t *dest, const SharedSnippet *src) {
+  *dest = src->snippet;
+  dest->inputs = chunked_inputs_flatten(&src->inputs);
+  if (!dest->inputs) dest->input_count = 0;
+}
+
+static void shared_snippet_free(SharedSnippet *snippet) { chunked_inputs_free(&snippet->inputs); }
+
+// Memory Accounting & Spilling Helpers
+
+static size_t snippet_input_bytes(const input_snippet_t *snippet) {
+  return snippet->inputs ? sizeof(SPlayerInput) * snippet->input_count : 0;
+}
+
+static bool write_buffer(FILE *f, const void *buffer, size_t size) { return !buffer || size == 0 || fwrite(buffer, size, 1, f) == 1; }
+
+// Reads `size` bytes into a new allocation. Once `ok` is false, later reads are skipped.
+static void *read_buffer(FILE *f, size_t size, bool *ok) {
+  if (!*ok || size == 0) return NULL;
+  void *buffer = malloc(size);
+  if (!buffer || fread(buffer, size, 1, f) != 1) {
+    free(buffer);
+    *ok = false;
+    return NULL;
+  }
+  return buffer;
+}
+
+// Frees the inputs but keeps input_count, so they can be read back later
+static void release_snippet_inputs(input_snippet_t *snippet) {
+  free(snippet->inputs);
+  snippet->inputs = NULL;
+}
+
+static void read_snippet_inputs(FILE *f, input_snippet_t *snippet, bool *ok) {
+  snippet->inputs = read_buffer(f, sizeof(SPlayerInput) * snippet->input_count, ok);
+}
+
 // Command Struct Definitions
 
 typedef struct {
@@ -75,7 +129,8 @@ typedef struct {
 typedef struct {
   undo_command_t base;
   int track_index;
-  player_track_t track_copy;
+  player_track_t track_copy; // snippets are kept in shared_snippets instead
+  SharedSnippet *shared_snippets;
 } RemoveTrackCommand;
 
 typedef struct {
@@ -84,11 +139,19 @@ typedef struct {
   player_info_t player_info;
 } AddTrackCommand;
 
+// A run of consecutive input indices
+typedef struct {
+  int start;
+  int count;
+} InputRange;
+
+// Edited inputs are stored as sorted, non-overlapping ranges; before/after hold `count` states in range order
 typedef struct {
   undo_command_t base;
   int snippet_id;
   int count;
-  int *indices;
+  InputRange *ranges;
+  int range_count;
   SPlayerInput *before;
   SPlayerInput *after;
 } EditInputsCommand;
@@ -98,30 +161,45 @@ typedef struct {
 static void undo_add_snippet(void *cmd, void *ts);
 static void redo_add_snippet(void *cmd, void *ts);
 static void cleanup_add_snippet_cmd(void *cmd);
+static size_t get_size_add_snippet_cmd(void *cmd);
+static bool spill_add_snippet_cmd(void *cmd, FILE *f);
+static bool unspill_add_snippet_cmd(void *cmd, FILE *f);
 
 static void undo_delete_snippets(void *cmd, void *ts);
 static void redo_delete_snippets(void *cmd, void *ts);
 static void cleanup_delete_snippets_cmd(void *cmd);
+static size_t get_size_delete_snippets_cmd(void *cmd);
+static bool spill_delete_snippets_cmd(void *cmd, FILE *f);
+static bool unspill_delete_snippets_cmd(void *cmd, FILE *f);
 
 static void undo_move_snippets(void *cmd, void *ts);
 static void redo_move_snippets(void *cmd, void *ts);
 static void cleanup_move_snippets_cmd(void *cmd);
+static size_t get_size_move_snippets_cmd(void *cmd);
 
 static void undo_duplicate_snippets(void *cmd, void *ts);
 static void redo_duplicate_snippets(void *cmd, void *ts);
 static void cleanup_duplicate_snippets_cmd(void *cmd);
+static size_t get_size_duplicate_snippets_cmd(void *cmd);
 
 static void undo_multi_split(void *cmd, void *ts);
 static void redo_multi_split(void *cmd, void *ts);
 static void cleanup_multi_split_cmd(void *cmd);
+static size_t get_size_multi_split_cmd(void *cmd);
+static bool spill_multi_split_cmd(void *cmd, FILE *f);
+static bool unspill_multi_split_cmd(void *cmd, FILE *f);
 
 static void undo_merge_snippets(void *cmd, void *ts);
 static void redo_merge_snippets(void *cmd, void *ts);
 static void cleanup_merge_snippets_cmd(void *cmd);
+static size_t get_size_merge_snippets_cmd(void *cmd);
+static bool spill_merge_snippets_cmd(void *cmd, FILE *f);
+static bool unspill_merge_snippets_cmd(void *cmd, FILE *f);
 
 static void undo_remove_track(void *cmd, void *ts);
 static void redo_remove_track(void *cmd, void *ts);
 static void cleanup_remove_track_cmd(void *cmd);
+static size_t get_size_remove_track_cmd(void *cmd);
 
 static void undo_add_track(void *cmd, void *ts);
 static void redo_add_track(void *cmd, void *ts);
@@ -130,6 +208,12 @@ static void cleanup_add_track_cmd(void *cmd);
 static void undo_edit_inputs(void *cmd, void *ts);
 static void redo_edit_inputs(void *cmd, void *ts);
 static void cleanup_edit_inputs_cmd(void *cmd);
+static size_t get_size_edit_inputs_cmd(void *cmd);
+static bool spill_edit_inputs_cmd(void *cmd, FILE *f);
+static bool unspill_edit_inputs_cmd(void *cmd, FILE *f);
+static bool merge_edit_inputs_cmd(void *cmd, void *other);
+static bool build_edit_ranges(EditInputsCommand *cmd, const int *indices, const SPlayerInput *before, const SPlayerInput *after,
+                              int count);
 
 // Command Creation Functions
 
@@ -155,6 +239,10 @@ undo_command_t *commands_create_add_snippet(ui_handler_t *ui, int track_idx, int
   cmd->base.undo = undo_add_snippet;
   cmd->base.redo = redo_add_snippet;
   cmd->base.cleanup = cleanup_add_snippet_cmd;
+  cmd->base.get_size = get_size_add_snippet_cmd;
+  cmd->base.spill = spill_add_snippet_cmd;
+  cmd->base.unspill = unspill_add_snippet_cmd;
+  cmd->track_index = track_idx;
   model_snippet_clone(&cmd->snippet_copy, &snip);
 
   // deactivate overlapping snippets
@@ -162,13 +250,14 @@ undo_command_t *commands_create_add_snippet(ui_handler_t *ui, int track_idx, int
     input_snippet_t *other = &track->snippets[i];
     if (other->is_active && snip.start_tick < other->end_tick && snip.end_tick > other->start_tick) {
       other->is_active = false;
+      model_mark_inputs_changed(ts, track_idx, other->start_tick, other->end_tick);
       cmd->deactivated_ids = realloc(cmd->deactivated_ids, sizeof(int) * (cmd->deactivated_count + 1));
       cmd->deactivated_ids[cmd->deactivated_count++] = other->id;
     }
   }
 
   // Perform the action
-  model_insert_snippet_into_track(track, &snip);
+  model_insert_snippet_into_track(ts, track, &snip);
   model_compact_layers_for_track(track);
 
   return &cmd->base;
@@ -183,6 +272,9 @@ undo_command_t *commands_create_delete_selected(ui_handler_t *ui) {
   cmd->base.undo = undo_delete_snippets;
   cmd->base.redo = redo_delete_snippets;
   cmd->base.cleanup = cleanup_delete_snippets_cmd;
+  cmd->base.get_size = get_size_delete_snippets_cmd;
+  cmd->base.spill = spill_delete_snippets_cmd;
+  cmd->base.unspill = unspill_delete_snippets_cmd;
   cmd->count = ts->selected_snippets.count;
   cmd->deleted_info = calloc(cmd->count, sizeof(DeletedSnippetInfo));
 
@@ -218,6 +310,7 @@ undo_command_t *commands_create_move_snippets(ui_handler_t *ui, const MoveSnippe
   cmd->base.undo = undo_move_snippets;
   cmd->base.redo = redo_move_snippets;
   cmd->base.cleanup = cleanup_move_snippets_cmd;
+  cmd->base.get_size = get_size_move_snippets_cmd;
   cmd->count = count;
   cmd->move_info = malloc(sizeof(MoveSnippetInfo) * count);
   memcpy(cmd->move_info, infos, sizeof(MoveSnippetInfo) * count);
@@ -255,6 +348,7 @@ undo_command_t *commands_create_duplicate_snippets(ui_handler_t *ui, const MoveS
   cmd->base.undo = undo_duplicate_snippets;
   cmd->base.redo = redo_duplicate_snippets;
   cmd->base.cleanup = cleanup_duplicate_snippets_cmd;
+  cmd->base.get_size = get_size_duplicate_snippets_cmd;
   cmd->count = count;
   cmd->dup_info = malloc(sizeof(MoveSnippetInfo) * count);
   memcpy(cmd->dup_info, infos, sizeof(MoveSnippetInfo) * count);
@@ -300,6 +394,9 @@ undo_command_t *commands_create_split_selected(ui_handler_t *ui) {
   cmd->base.undo = undo_multi_split;
   cmd->base.redo = redo_multi_split;
   cmd->base.cleanup = cleanup_multi_split_cmd;
+  cmd->base.get_size = get_size_multi_split_cmd;
+  cmd->base.spill = spill_multi_split_cmd;
+  cmd->base.unspill = unspill_multi_split_cmd;
   cmd->split_tick = ts->current_tick;
 
   SplitInfo *valid_splits = NULL;
@@ -356,6 +453,9 @@ undo_command_t *commands_create_merge_selected(ui_handler_t *ui) {
   cmd->base.undo = undo_merge_snippets;
   cmd->base.redo = redo_merge_snippets;
   cmd->base.cleanup = cleanup_merge_snippets_cmd;
+  cmd->base.get_size = get_size_merge_snippets_cmd;
+  cmd->base.spill = spill_merge_snippets_cmd;
+  cmd->base.unspill = unspill_merge_snippets_cmd;
 
   bool merged_something = false;
 
@@ -448,14 +548,26 @@ undo_command_t *commands_create_remove_track(ui_handler_t *ui, int track_index)
   cmd->base.undo = undo_remove_track;
   cmd->base.redo = redo_remove_track;
   cmd->base.cleanup = cleanup_remove_track_cmd;
+  cmd->base.get_size = get_size_remove_track_cmd;
   cmd->track_index = track_index;
 
   player_track_t *original_track = &ts->player_tracks[track_index];
   cmd->track_copy = *original_track;
-  // Then deep-copy the snippets array
-  cmd->track_copy.snippets = malloc(sizeof(input_snippet_t) * original_track->snippet_count);
+  cmd->track_copy.snippets = NULL;
+  cmd->track_copy.recording_snippets = NULL;
+  cmd->track_copy.recording_snippet_count = 0;
+  cmd->track_copy.recording_snippet_capacity = 0;
+  cmd->shared_snippets = calloc(original_track->snippet_count, sizeof(SharedSnippet));
+  if (!cmd->shared_snippets && original_track->snippet_count > 0) {
+    free(cmd);
+    return NULL;
+  }
   for (int i = 0; i < original_track->snippet_count; i++) {
-    model_snippet_clone(&cmd->track_copy.snippets[i], &original_track->snippets[i]);
+    // without a full copy the track couldn't be brought back, so it isn't removed at all
+    if (!shared_snippet_capture(&cmd->shared_snippets[i], &original_track->snippets[i])) {
+      cleanup_remove_track_cmd(&cmd->base);
+      return NULL;
+    }
   }
 
   // Perform the action
@@ -477,7 +589,9 @@ static void undo_add_snippet(void *cmd, void *ts_void) {
 
   for (int i = 0; i < c->deactivated_count; ++i) {
     input_snippet_t *s = model_find_snippet_in_track(track, c->deactivated_ids[i]);
-    if (s) s->is_active = true;
+    if (!s) continue;
+    s->is_active = true;
+    model_mark_inputs_changed(ts, c->track_index, s->start_tick, s->end_tick);
   }
 
   model_compact_layers_for_track(track);
@@ -489,12 +603,14 @@ static void redo_add_snippet(void *cmd, void *ts_void) {
 
   for (int i = 0; i < c->deactivated_count; ++i) {
     input_snippet_t *s = model_find_snippet_in_track(track, c->deactivated_ids[i]);
-    if (s) s->is_active = false;
+    if (!s) continue;
+    s->is_active = false;
+    model_mark_inputs_changed(ts, c->track_index, s->start_tick, s->end_tick);
   }
 
   input_snippet_t new_snip;
   model_snippet_clone(&new_snip, &c->snippet_copy);
-  model_insert_snippet_into_track(track, &new_snip);
+  model_insert_snippet_into_track(ts, track, &new_snip);
   model_compact_layers_for_track(track);
 }
 static void cleanup_add_snippet_cmd(void *cmd) {
@@ -503,6 +619,22 @@ static void cleanup_add_snippet_cmd(void *cmd) {
   free(c->deactivated_ids);
   free(c);
 }
+static size_t get_size_add_snippet_cmd(void *cmd) {
+  AddSnippetCommand *c = (AddSnippetCommand *)cmd;
+  return sizeof(*c) + snippet_input_bytes(&c->snippet_copy) + sizeof(int) * c->deactivated_count;
+}
+static bool spill_add_snippet_cmd(void *cmd, FILE *f) {
+  AddSnippetCommand *c = (AddSnippetCommand *)cmd;
+  if (!write_buffer(f, c->snippet_copy.inputs, snippet_input_bytes(&c->snippet_copy))) return false;
+  release_snippet_inputs(&c->snippet_copy);
+  return true;
+}
+static bool unspill_add_snippet_cmd(void *cmd, FILE *f) {
+  AddSnippetCommand *c = (AddSnippetCommand *)cmd;
+  bool ok = true;
+  read_snippet_inputs(f, &c->snippet_copy, &ok);
+  return ok;
+}
 
 // Snippet Editor Command
 undo_command_t *create_edit_inputs_command(input_snippet_t *snippet, int *indices, int count, SPlayerInput *before_states,
@@ -512,15 +644,21 @@ undo_command_t *create_edit_inputs_command(input_snippet_t *snippet, int *indice
   cmd->base.undo = undo_edit_inputs;
   cmd->base.redo = redo_edit_inputs;
   cmd->base.cleanup = cleanup_edit_inputs_cmd;
-
-  // We must take ownership of the provided pointers
-  cmd->indices = indices;
-  cmd->before = before_states;
-  cmd->after = after_states;
+  cmd->base.get_size = get_size_edit_inputs_cmd;
+  cmd->base.spill = spill_edit_inputs_cmd;
+  cmd->base.unspill = unspill_edit_inputs_cmd;
+  cmd->base.merge = merge_edit_inputs_cmd;
   cmd->snippet_id = snippet->id;
-  cmd->count = count;
 
-  return &cmd->base;
+  // We take ownership of the provided arrays, they are folded into ranges and released
+  if (!build_edit_ranges(cmd, indices, before_states, after_states, count)) {
+    free(cmd);
+    cmd = NULL;
+  }
+  free(indices);
+  free(before_states);
+  free(after_states);
+  return cmd ? &cmd->base : NULL;
 }
 
 // Delete Snippets
@@ -535,7 +673,7 @@ static void undo_delete_snippets(void *cmd, void *ts_void) {
     player_track_t *track = &ts->player_tracks[track_idx];
     input_snippet_t new_snip;
     model_snippet_clone(&new_snip, &c->deleted_info[i].snippet_copy);
-    model_insert_snippet_into_track(track, &new_snip);
+    model_insert_snippet_into_track(ts, track, &new_snip);
     if (track_idx < MAX_MODIFIED_TRACKS_PER_COMMAND) modified_tracks[track_idx] = true;
   }
   // Compact all affected tracks once at the end
@@ -560,6 +698,30 @@ static void redo_delete_snippets(void *cmd, void *ts_void) {
     if (i < MAX_MODIFIED_TRACKS_PER_COMMAND && modified_tracks[i]) model_compact_layers_for_track(&ts->player_tracks[i]);
   }
 }
+static size_t get_size_delete_snippets_cmd(void *cmd) {
+  DeleteSnippetsCommand *c = (DeleteSnippetsCommand *)cmd;
+  size_t size = sizeof(*c) + sizeof(DeletedSnippetInfo) * c->count;
+  for (int i = 0; i < c->count; i++)
+    size += snippet_input_bytes(&c->deleted_info[i].snippet_copy);
+  return size;
+}
+static bool spill_delete_snippets_cmd(void *cmd, FILE *f) {
+  DeleteSnippetsCommand *c = (DeleteSnippetsCommand *)cmd;
+  for (int i = 0; i < c->count; i++) {
+    input_snippet_t *snippet = &c->deleted_info[i].snippet_copy;
+    if (!write_buffer(f, snippet->inputs, snippet_input_bytes(snippet))) return false;
+  }
+  for (int i = 0; i < c->count; i++)
+    release_snippet_inputs(&c->deleted_info[i].snippet_copy);
+  return true;
+}
+static bool unspill_delete_snippets_cmd(void *cmd, FILE *f) {
+  DeleteSnippetsCommand *c = (DeleteSnippetsCommand *)cmd;
+  bool ok = true;
+  for (int i = 0; i < c->count; i++)
+    read_snippet_inputs(f, &c->deleted_info[i].snippet_copy, &ok);
+  return ok;
+}
 static void cleanup_delete_snippets_cmd(void *cmd) {
   DeleteSnippetsCommand *c = (DeleteSnippetsCommand *)cmd;
   for (int i = 0; i < c->count; ++i) {
@@ -582,7 +744,7 @@ static void move_snippet_logic(timeline_state_t *ts, int snippet_id, int from_tr
   snip_copy.layer = to_layer;
 
   model_remove_snippet_from_track(ts, source_track, snippet_id);
-  model_insert_snippet_into_track(&ts->player_tracks[to_track_idx], &snip_copy);
+  model_insert_snippet_into_track(ts, &ts->player_tracks[to_track_idx], &snip_copy);
 }
 
 static void undo_move_snippets(void *cmd, void *ts_void) {
@@ -635,6 +797,10 @@ static void redo_move_snippets(void *cmd, void *ts_void) {
     if (i < MAX_MODIFIED_TRACKS_PER_COMMAND && modified_tracks[i]) model_compact_layers_for_track(&ts->player_tracks[i]);
   }
 }
+static size_t get_size_move_snippets_cmd(void *cmd) {
+  MoveSnippetsCommand *c = (MoveSnippetsCommand *)cmd;
+  return sizeof(*c) + sizeof(MoveSnippetInfo) * c->count + sizeof(int) * c->deactivated_count;
+}
 static void cleanup_move_snippets_cmd(void *cmd) {
   MoveSnippetsCommand *c = (MoveSnippetsCommand *)cmd;
   free(c->move_info);
@@ -709,7 +875,7 @@ static void redo_duplicate_snippets(void *cmd, void *ts_void) {
     new_snippet.end_tick = new_snippet.start_tick + new_snippet.input_count;
     new_snippet.layer = info->new_layer;
 
-    model_insert_snippet_into_track(dst_track, &new_snippet);
+    model_insert_snippet_into_track(ts, dst_track, &new_snippet);
     interaction_add_snippet_to_selection(ts, new_snippet.id);
 
     if (info->new_track_index < MAX_MODIFIED_TRACKS_PER_COMMAND) modified_tracks[info->new_track_index] = true;
@@ -720,6 +886,10 @@ static void redo_duplicate_snippets(void *cmd, void *ts_void) {
   }
 }
 
+static size_t get_size_duplicate_snippets_cmd(void *cmd) {
+  DuplicateSnippetsCommand *c = (DuplicateSnippetsCommand *)cmd;
+  return sizeof(*c) + (sizeof(MoveSnippetInfo) + sizeof(int)) * c->count + sizeof(int) * c->deactivated_count;
+}
 static void cleanup_duplicate_snippets_cmd(void *cmd) {
   DuplicateSnippetsCommand *c = (DuplicateSnippetsCommand *)cmd;
   free(c->dup_info);
@@ -778,7 +948,7 @@ static void redo_multi_split(void *cmd, void *ts_void) {
     memcpy(right.inputs, info->moved_inputs, sizeof(SPlayerInput) * right.input_count);
 
     model_resize_snippet_inputs(ts, original, c->split_tick - original->start_tick);
-    model_insert_snippet_into_track(track, &right);
+    model_insert_snippet_into_track(ts, track, &right);
     interaction_add_snippet_to_selection(ts, right.id);
     if (track_idx < MAX_MODIFIED_TRACKS_PER_COMMAND) modified_tracks[track_idx] = true;
   }
@@ -786,6 +956,31 @@ static void redo_multi_split(void *cmd, void *ts_void) {
     if (i < MAX_MODIFIED_TRACKS_PER_COMMAND && modified_tracks[i]) model_compact_layers_for_track(&ts->player_tracks[i]);
   }
 }
+static size_t get_size_multi_split_cmd(void *cmd) {
+  MultiSplitCommand *c = (MultiSplitCommand *)cmd;
+  size_t size = sizeof(*c) + sizeof(SplitInfo) * c->count;
+  for (int i = 0; i < c->count; i++)
+    if (c->infos[i].moved_inputs) size += sizeof(SPlayerInput) * c->infos[i].moved_inputs_count;
+  return size;
+}
+static bool spill_multi_split_cmd(void *cmd, FILE *f) {
+  MultiSplitCommand *c = (MultiSplitCommand *)cmd;
+  for (int i = 0; i < c->count; i++) {
+    if (!write_buffer(f, c->infos[i].moved_inputs, sizeof(SPlayerInput) * c->infos[i].moved_inputs_count)) return false;
+  }
+  for (int i = 0; i < c->count; i++) {
+    free(c->infos[i].moved_inputs);
+    c->infos[i].moved_inputs = NULL;
+  }
+  return true;
+}
+static bool unspill_multi_split_cmd(void *cmd, FILE *f) {
+  MultiSplitCommand *c = (MultiSplitCommand *)cmd;
+  bool ok = true;
+  for (int i = 0; i < c->count; i++)
+    c->infos[i].moved_inputs = read_buffer(f, sizeof(SPlayerInput) * c->infos[i].moved_inputs_count, &ok);
+  return ok;
+}
 static void cleanup_multi_split_cmd(void *cmd) {
   MultiSplitCommand *c = (MultiSplitCommand *)cmd;
   for (int i = 0; i < c->count; i++) {
@@ -808,7 +1003,7 @@ static void undo_merge_snippets(void *cmd, void *ts_void) {
   for (int i = 0; i < c->merged_snippets_count; i++) {
     input_snippet_t new_snip;
     model_snippet_clone(&new_snip, &c->merged_snippets[i].snippet_copy);
-    model_insert_snippet_into_track(track, &new_snip);
+    model_insert_snippet_into_track(ts, track, &new_snip);
   }
   model_compact_layers_for_track(track);
 }
@@ -835,6 +1030,30 @@ static void redo_merge_snippets(void *cmd, void *ts_void) {
   }
   model_compact_layers_for_track(track);
 }
+static size_t get_size_merge_snippets_cmd(void *cmd) {
+  MergeSnippetsCommand *c = (MergeSnippetsCommand *)cmd;
+  size_t size = sizeof(*c) + sizeof(DeletedSnippetInfo) * c->merged_snippets_count;
+  for (int i = 0; i < c->merged_snippets_count; i++)
+    size += snippet_input_bytes(&c->merged_snippets[i].snippet_copy);
+  return size;
+}
+static bool spill_merge_snippets_cmd(void *cmd, FILE *f) {
+  MergeSnippetsCommand *c = (MergeSnippetsCommand *)cmd;
+  for (int i = 0; i < c->merged_snippets_count; i++) {
+    input_snippet_t *snippet = &c->merged_snippets[i].snippet_copy;
+    if (!write_buffer(f, snippet->inputs, snippet_input_bytes(snippet))) return false;
+  }
+  for (int i = 0; i < c->merged_snippets_count; i++)
+    release_snippet_inputs(&c->merged_snippets[i].snippet_copy);
+  return true;
+}
+static bool unspill_merge_snippets_cmd(void *cmd, FILE *f) {
+  MergeSnippetsCommand *c = (MergeSnippetsCommand *)cmd;
+  bool ok = true;
+  for (int i = 0; i < c->merged_snippets_count; i++)
+    read_snippet_inputs(f, &c->merged_snippets[i].snippet_copy, &ok);
+  return ok;
+}
 static void cleanup_merge_snippets_cmd(void *cmd) {
   MergeSnippetsCommand *c = (MergeSnippetsCommand *)cmd;
   if (c->merged_snippets) {
@@ -872,6 +1091,7 @@ static void undo_toggle_snippets(void *cmd, void *ts_void) {
 
     input_snippet_t *target = model_find_snippet_in_track(track, info->snippet_id);
     if (!target) continue;
+    model_mark_inputs_changed(ts, info->track_index, target->start_tick, target->end_tick);
 
     if (info->new_state) {
       // It WAS activated, so deactivate it
@@ -879,7 +1099,9 @@ static void undo_toggle_snippets(void *cmd, void *ts_void) {
       // And reactivate the ones that were overlapped
       for (int j = 0; j < info->overlapping_count; ++j) {
         input_snippet_t *overlap = model_find_snippet_in_track(track, info->overlapping_ids[j]);
-        if (overlap) overlap->is_active = true;
+        if (!overlap) continue;
+        overlap->is_active = true;
+        model_mark_inputs_changed(ts, info->track_index, overlap->start_tick, overlap->end_tick);
       }
     } else {
       // It WAS deactivated, so activate it
@@ -899,6 +1121,7 @@ static void redo_toggle_snippets(void *cmd, void *ts_void) {
 
     input_snippet_t *target = model_find_snippet_in_track(track, info->snippet_id);
     if (!target) continue;
+    model_mark_inputs_changed(ts, info->track_index, target->start_tick, target->end_tick);
 
     if (info->new_state) {
       // Activate target
@@ -906,7 +1129,9 @@ static void redo_toggle_snippets(void *cmd, void *ts_void) {
       // Deactivate overlaps
       for (int j = 0; j < info->overlapping_count; ++j) {
         input_snippet_t *overlap = model_find_snippet_in_track(track, info->overlapping_ids[j]);
-        if (overlap) overlap->is_active = false;
+        if (!overlap) continue;
+        overlap->is_active = false;
+        model_mark_inputs_changed(ts, info->track_index, overlap->start_tick, overlap->end_tick);
       }
     } else {
       // Deactivate target
@@ -924,6 +1149,14 @@ static void cleanup_toggle_snippets_cmd(void *cmd) {
   free(c);
 }
 
+static size_t get_size_toggle_snippets_cmd(void *cmd) {
+  ToggleSnippetsCommand *c = (ToggleSnippetsCommand *)cmd;
+  size_t size = sizeof(*c) + sizeof(ToggleSnippetInfo) * c->count;
+  for (int i = 0; i < c->count; ++i)
+    size += sizeof(int) * c->infos[i].overlapping_count;
+  return size;
+}
+
 undo_command_t *commands_create_toggle_selected_snippets_active(ui_handler_t *ui) {
   timeline_state_t *ts = &ui->timeline;
   if (ts->selected_snippets.count == 0) return NULL;
@@ -933,6 +1166,7 @@ undo_command_t *commands_create_toggle_selected_snippets_active(ui_handler_t *ui
   cmd->base.undo = undo_toggle_snippets;
   cmd->base.redo = redo_toggle_snippets;
   cmd->base.cleanup = cleanup_toggle_snippets_cmd;
+  cmd->base.get_size = get_size_toggle_snippets_cmd;
   cmd->count = ts->selected_snippets.count;
   cmd->infos = calloc(cmd->count, sizeof(ToggleSnippetInfo));
 
@@ -988,10 +1222,12 @@ static void undo_remove_track(void *cmd, void *ts_void) {
   player_track_t *new_track = &ts->player_tracks[c->track_index];
   *new_track = c->track_copy;
   new_track->snippets = malloc(sizeof(input_snippet_t) * new_track->snippet_count);
+  new_track->snippet_capacity = new_track->snippet_count;
   for (int i = 0; i < new_track->snippet_count; i++) {
-    model_snippet_clone(&new_track->snippets[i], &c->track_copy.snippets[i]);
+    shared_snippet_restore(&new_track->snippets[i], &c->shared_snippets[i]);
   }
   ts->player_track_count = new_count;
+  model_mark_all_inputs_changed(ts);
   model_recalc_physics(ts, 0);
 }
 
@@ -1001,12 +1237,20 @@ static void redo_remove_track(void *cmd, void *ts_void) {
   model_remove_track_logic(ts, c->track_index);
 }
 
+static size_t get_size_remove_track_cmd(void *cmd) {
+  RemoveTrackCommand *c = (RemoveTrackCommand *)cmd;
+  size_t size = sizeof(*c) + sizeof(SharedSnippet) * c->track_copy.snippet_count;
+  for (int i = 0; i < c->track_copy.snippet_count; i++)
+    size += chunked_inputs_shared_bytes(&c->shared_snippets[i].inputs);
+  return size;
+}
+
 static void cleanup_remove_track_cmd(void *cmd) {
   RemoveTrackCommand *c = (RemoveTrackCommand *)cmd;
   for (int i = 0; i < c->track_copy.snippet_count; i++) {
-    model_free_snippet_inputs(&c->track_copy.snippets[i]);
+    shared_snippet_free(&c->shared_snippets[i]);
   }
-  free(c->track_copy.snippets);
+  free(c->shared_snippets);
   free(c);
 }
 
@@ -1056,13 +1300,15 @@ static void redo_add_track(void *cmd, void *ts_void) {
 
 static void cleanup_add_track_cmd(void *cmd) { free(cmd); }
 
-undo_command_t *timeline_api_create_snippet(ui_handler_t *ui, int track_index, int start_tick, int duration, int *out_snippet_id) {
-  timeline_state_t *ts = &ui->timeline;
-  if (track_index < 0 || track_index >= ts->player_track_count || duration <= 0) return NULL;
-
+// Takes ownership of `inputs` (duration entries, NULL for empty inputs)
+static AddSnippetCommand *create_snippet_with_inputs(timeline_state_t *ts, int track_index, int start_tick, int duration,
+                                                     SPlayerInput *inputs, int *out_snippet_id) {
   player_track_t *track = &ts->player_tracks[track_index];
   int new_layer = model_find_available_layer(track, start_tick, start_tick + duration, -1);
-  if (new_layer == -1) return NULL;
+  if (new_layer == -1) {
+    free(inputs);
+    return NULL;
+  }
 
   input_snippet_t snippet;
   snippet.id = ts->next_snippet_id++;
@@ -1071,7 +1317,7 @@ undo_command_t *timeline_api_create_snippet(ui_handler_t *ui, int track_index, i
   snippet.is_active = true;
   snippet.layer = new_layer;
   snippet.input_count = duration;
-  snippet.inputs = calloc(duration, sizeof(SPlayerInput));
+  snippet.inputs = inputs ? inputs : calloc(duration, sizeof(SPlayerInput));
 
   if (out_snippet_id) *out_snippet_id = snippet.id;
 
@@ -1080,76 +1326,234 @@ undo_command_t *timeline_api_create_snippet(ui_handler_t *ui, int track_index, i
   cmd->base.undo = undo_add_snippet;
   cmd->base.redo = redo_add_snippet;
   cmd->base.cleanup = cleanup_add_snippet_cmd;
+  cmd->base.get_size = get_size_add_snippet_cmd;
+  cmd->base.spill = spill_add_snippet_cmd;
+  cmd->base.unspill = unspill_add_snippet_cmd;
+  cmd->track_index = track_index;
   model_snippet_clone(&cmd->snippet_copy, &snippet);
 
-  model_insert_snippet_into_track(track, &snippet);
+  model_insert_snippet_into_track(ts, track, &snippet);
   model_compact_layers_for_track(track);
-  return &cmd->base;
+  return cmd;
 }
 
-static void apply_input_states(timeline_state_t *ts, int snippet_id, int count, const int *indices, const SPlayerInput *states) {
-  input_snippet_t *snippet = model_find_snippet_by_id(ts, snippet_id, NULL);
-  if (!snippet) return;
+undo_command_t *timeline_api_create_snippet(ui_handler_t *ui, int track_index, int start_tick, int duration, int *out_snippet_id) {
+  timeline_state_t *ts = &ui->timeline;
+  if (track_index < 0 || track_index >= ts->player_track_count || duration <= 0) return NULL;
+  AddSnippetCommand *cmd = create_snippet_with_inputs(ts, track_index, start_tick, duration, NULL, out_snippet_id);
+  return cmd ? &cmd->base : NULL;
+}
+
+static void apply_input_states(timeline_state_t *ts, const EditInputsCommand *c, const SPlayerInput *states) {
+  int track_index = -1;
+  input_snippet_t *snippet = model_find_snippet_by_id(ts, c->snippet_id, &track_index);
+  if (!snippet || c->range_count == 0) return;
+  const SPlayerInput *src = states;
+  for (int r = 0; r < c->range_count; r++) {
+    const InputRange *range = &c->ranges[r];
+    int start = imax(range->start, 0);
+    int end = imin(range->start + range->count, snippet->input_count);
+    if (end > start) memcpy(&snippet->inputs[start], src + (start - range->start), sizeof(SPlayerInput) * (end - start));
+    src += range->count;
+  }
+  if (snippet->is_active) {
+    const InputRange *last = &c->ranges[c->range_count - 1];
+    model_mark_inputs_changed(ts, track_index, snippet->start_tick + c->ranges[0].start, snippet->start_tick + last->start + last->count);
+  }
+  model_recalc_physics(ts, snippet->start_tick + c->ranges[0].start);
+}
+
+typedef struct {
+  int index;
+  int order;
+} IndexedEdit;
+
+static int compare_indexed_edits(const void *a, const void *b) {
+  const IndexedEdit *ea = a, *eb = b;
+  if (ea->index != eb->index) return ea->index < eb->index ? -1 : 1;
+  return ea->order - eb->order;
+}
+
+// Folds arbitrary (possibly repeated) index edits into ranges. For a repeated index the earliest
+// `before` and the latest `after` win, so the command still maps the original state to the final one.
+static bool build_edit_ranges(EditInputsCommand *cmd, const int *indices, const SPlayerInput *before, const SPlayerInput *after,
+                              int count) {
+  if (count <= 0) return false;
+  IndexedEdit *edits = malloc(sizeof(IndexedEdit) * count);
+  if (!edits) return false;
+  for (int i = 0; i < count; i++)
+    edits[i] = (IndexedEdit){indices[i], i};
+  qsort(edits, count, sizeof(IndexedEdit), compare_indexed_edits);
+
+  cmd->ranges = malloc(sizeof(InputRange) * count);
+  cmd->before = malloc(sizeof(SPlayerInput) * count);
+  cmd->after = malloc(sizeof(SPlayerInput) * count);
+  if (!cmd->ranges || !cmd->before || !cmd->after) {
+    free(edits);
+    free(cmd->ranges);
+    free(cmd->before);
+    free(cmd->after);
+    return false;
+  }
+
+  cmd->count = 0;
+  cmd->range_count = 0;
   for (int i = 0; i < count; i++) {
-    int idx = indices[i];
-    if (idx >= 0 && idx < snippet->input_count) {
-      snippet->inputs[idx] = states[i];
+    const IndexedEdit *e = &edits[i];
+    if (cmd->count > 0 && edits[i - 1].index == e->index) {
+      cmd->after[cmd->count - 1] = after[e->order];
+      continue;
     }
+    InputRange *last = cmd->range_count > 0 ? &cmd->ranges[cmd->range_count - 1] : NULL;
+    if (last && last->start + last->count == e->index) last->count++;
+    else cmd->ranges[cmd->range_count++] = (InputRange){e->index, 1};
+    cmd->before[cmd->count] = before[e->order];
+    cmd->after[cmd->count] = after[e->order];
+    cmd->count++;
   }
+  free(edits);
+  return true;
 }
 
 static void undo_edit_inputs(void *cmd, void *ts_void) {
   EditInputsCommand *c = (EditInputsCommand *)cmd;
-  struct timeline_state *ts = (struct timeline_state *)ts_void;
-  apply_input_states(ts, c->snippet_id, c->count, c->indices, c->before);
+  apply_input_states((timeline_state_t *)ts_void, c, c->before);
 }
 static void redo_edit_inputs(void *cmd, void *ts_void) {
   EditInputsCommand *c = (EditInputsCommand *)cmd;
-  struct timeline_state *ts = (struct timeline_state *)ts_void;
-  apply_input_states(ts, c->snippet_id, c->count, c->indices, c->after);
+  apply_input_states((timeline_state_t *)ts_void, c, c->after);
 }
 static void cleanup_edit_inputs_cmd(void *cmd) {
   EditInputsCommand *c = (EditInputsCommand *)cmd;
-  free(c->indices);
+  free(c->ranges);
   free(c->before);
   free(c->after);
   free(c);
 }
+static size_t get_size_edit_inputs_cmd(void *cmd) {
+  EditInputsCommand *c = (EditInputsCommand *)cmd;
+  size_t size = sizeof(*c);
+  if (c->ranges) size += sizeof(InputRange) * c->range_count;
+  if (c->before) size += sizeof(SPlayerInput) * c->count;
+  if (c->after) size += sizeof(SPlayerInput) * c->count;
+  return size;
+}
+static bool spill_edit_inputs_cmd(void *cmd, FILE *f) {
+  EditInputsCommand *c = (EditInputsCommand *)cmd;
+  if (!write_buffer(f, c->ranges, sizeof(InputRange) * c->range_count) ||
+      !write_buffer(f, c->before, sizeof(SPlayerInput) * c->count) || !write_buffer(f, c->after, sizeof(SPlayerInput) * c->count))
+    return false;
+  free(c->ranges);
+  free(c->before);
+  free(c->after);
+  c->ranges = NULL;
+  c->before = NULL;
+  c->after = NULL;
+  return true;
+}
+static bool unspill_edit_inputs_cmd(void *cmd, FILE *f) {
+  EditInputsCommand *c = (EditInputsCommand *)cmd;
+  bool ok = true;
+  c->ranges = read_buffer(f, sizeof(InputRange) * c->range_count, &ok);
+  c->before = read_buffer(f, sizeof(SPlayerInput) * c->count, &ok);
+  c->after = read_buffer(f, sizeof(SPlayerInput) * c->count, &ok);
+  return ok;
+}
 
-undo_command_t *timeline_api_set_snippet_inputs(ui_handler_t *ui, int snippet_id, int tick_offset, int count, const SPlayerInput *new_inputs) {
-  timeline_state_t *ts = &ui->timeline;
-  input_snippet_t *snippet = model_find_snippet_by_id(ts, snippet_id, NULL);
-  if (!snippet || !new_inputs || count <= 0 || tick_offset < 0 || tick_offset >= snippet->input_count) return NULL;
+// Expands a command back into per-index arrays, appended at `at`
+static void expand_edit_inputs(const EditInputsCommand *c, int *indices, SPlayerInput *before, SPlayerInput *after, int at) {
+  int n = at;
+  for (int r = 0; r < c->range_count; r++)
+    for (int i = 0; i < c->ranges[r].count; i++)
+      indices[n++] = c->ranges[r].start + i;
+  memcpy(before + at, c->before, sizeof(SPlayerInput) * c->count);
+  memcpy(after + at, c->after, sizeof(SPlayerInput) * c->count);
+}
 
-  int max_write = imin(count, snippet->input_count - tick_offset);
-  if (max_write <= 0) return NULL;
+// Folds a later edit of the same snippet into this one (used inside undo transactions)
+static bool merge_edit_inputs_cmd(void *cmd, void *other_cmd) {
+  EditInputsCommand *c = (EditInputsCommand *)cmd;
+  undo_command_t *other_base = (undo_command_t *)other_cmd;
+  if (other_base->undo != undo_edit_inputs || c->base.spilled || other_base->spilled) return false;
+  EditInputsCommand *o = (EditInputsCommand *)other_cmd;
+  if (o->snippet_id != c->snippet_id) return false;
+
+  int total = c->count + o->count;
+  int *indices = malloc(sizeof(int) * total);
+  SPlayerInput *before = malloc(sizeof(SPlayerInput) * total);
+  SPlayerInput *after = malloc(sizeof(SPlayerInput) * total);
+  bool ok = indices && before && after;
+  if (ok) {
+    expand_edit_inputs(c, indices, before, after, 0);
+    expand_edit_inputs(o, indices, before, after, c->count);
+    EditInputsCommand merged = *c;
+    ok = build_edit_ranges(&merged, indices, before, after, total);
+    if (ok) {
+      free(c->ranges);
+      free(c->before);
+      free(c->after);
+      *c = merged;
+      snprintf(c->base.description, sizeof(c->base.description), "Edit %d Inputs in Snippet %d", c->count, c->snippet_id);
+    }
+  }
+  free(indices);
+  free(before);
+  free(after);
+  return ok;
+}
 
+// A single range edit of [tick_offset, tick_offset + count), takes ownership of `after`. Not applied yet.
+static EditInputsCommand *create_range_edit(const input_snippet_t *snippet, int tick_offset, int count, SPlayerInput *after) {
   EditInputsCommand *cmd = calloc(1, sizeof(EditInputsCommand));
+  if (!cmd) {
+    free(after);
+    return NULL;
+  }
   snprintf(cmd->base.description, sizeof(cmd->base.description), "Set Snippet Inputs (API)");
   cmd->base.undo = undo_edit_inputs;
   cmd->base.redo = redo_edit_inputs;
   cmd->base.cleanup = cleanup_edit_inputs_cmd;
-  cmd->snippet_id = snippet_id;
-  cmd->count = max_write;
-  cmd->indices = malloc(sizeof(int) * max_write);
-  cmd->before = malloc(sizeof(SPlayerInput) * max_write);
-  cmd->after = malloc(sizeof(SPlayerInput) * max_write);
-
-  for (int i = 0; i < max_write; ++i) {
-    int idx = tick_offset + i;
-    cmd->indices[i] = idx;
-    cmd->before[i] = snippet->inputs[idx];
-    cmd->after[i] = new_inputs[i];
-    snippet->inputs[idx] = new_inputs[i]; // Apply change immediately
+  cmd->base.get_size = get_size_edit_inputs_cmd;
+  cmd->base.spill = spill_edit_inputs_cmd;
+  cmd->base.unspill = unspill_edit_inputs_cmd;
+  cmd->base.merge = merge_edit_inputs_cmd;
+  cmd->snippet_id = snippet->id;
+  cmd->count = count;
+  cmd->range_count = 1;
+  cmd->ranges = malloc(sizeof(InputRange));
+  cmd->before = malloc(sizeof(SPlayerInput) * count);
+  cmd->after = after;
+  if (!cmd->ranges || !cmd->before || !cmd->after) {
+    cleanup_edit_inputs_cmd(cmd);
+    return NULL;
   }
 
+  cmd->ranges[0] = (InputRange){tick_offset, count};
+  memcpy(cmd->before, &snippet->inputs[tick_offset], sizeof(SPlayerInput) * count);
+  return cmd;
+}
+
+undo_command_t *timeline_api_set_snippet_inputs(ui_handler_t *ui, int snippet_id, int tick_offset, int count, const SPlayerInput *new_inputs) {
+  timeline_state_t *ts = &ui->timeline;
+  input_snippet_t *snippet = model_find_snippet_by_id(ts, snippet_id, NULL);
+  if (!snippet || !new_inputs || count <= 0 || tick_offset < 0 || tick_offset >= snippet->input_count) return NULL;
+
+  int max_write = imin(count, snippet->input_count - tick_offset);
+  if (max_write <= 0) return NULL;
+
+  SPlayerInput *after = malloc(sizeof(SPlayerInput) * max_write);
+  if (after) memcpy(after, new_inputs, sizeof(SPlayerInput) * max_write);
+  EditInputsCommand *cmd = create_range_edit(snippet, tick_offset, max_write, after);
+  if (!cmd) return NULL;
+  apply_input_states(ts, cmd, cmd->after); // Apply change immediately
+
   return &cmd->base;
 }
 
 // Commit Recording
 typedef struct {
   int track_index;
-  input_snippet_t *snippets;
+  SharedSnippet *snippets;
   int snippet_count;
 } TrackState;
 
@@ -1163,24 +1567,29 @@ typedef struct {
 static void free_track_state(TrackState *state) {
   if (state->snippets) {
     for (int i = 0; i < state->snippet_count; i++) {
-      model_free_snippet_inputs(&state->snippets[i]);
+      shared_snippet_free(&state->snippets[i]);
     }
     free(state->snippets);
   }
 }
 
-static void capture_track_state(timeline_state_t *ts, int track_idx, TrackState *out_state) {
+static bool capture_track_state(timeline_state_t *ts, int track_idx, TrackState *out_state) {
   player_track_t *track = &ts->player_tracks[track_idx];
   out_state->track_index = track_idx;
   out_state->snippet_count = track->snippet_count;
   if (track->snippet_count > 0) {
-    out_state->snippets = malloc(sizeof(input_snippet_t) * track->snippet_count);
+    out_state->snippets = calloc(track->snippet_count, sizeof(SharedSnippet));
+    if (!out_state->snippets) {
+      out_state->snippet_count = 0;
+      return false;
+    }
     for (int i = 0; i < track->snippet_count; i++) {
-      model_snippet_clone(&out_state->snippets[i], &track->snippets[i]);
+      if (!shared_snippet_capture(&out_state->snippets[i], &track->snippets[i])) return false;
     }
   } else {
     out_state->snippets = NULL;
   }
+  return true;
 }
 
 static void restore_track_state(timeline_state_t *ts, const TrackState *state) {
@@ -1199,7 +1608,7 @@ static void restore_track_state(timeline_state_t *ts, const TrackState *state) {
   if (track->snippet_count > 0) {
     track->snippets = malloc(sizeof(input_snippet_t) * track->snippet_count);
     for (int i = 0; i < track->snippet_count; i++) {
-      model_snippet_clone(&track->snippets[i], &state->snippets[i]);
+      shared_snippet_restore(&track->snippets[i], &state->snippets[i]);
     }
   } else {
     track->snippets = NULL;
@@ -1234,6 +1643,21 @@ static void cleanup_commit_recording_cmd(void *cmd) {
   free(c);
 }
 
+static size_t get_size_track_state(const TrackState *state) {
+  size_t size = sizeof(SharedSnippet) * state->snippet_count;
+  for (int i = 0; i < state->snippet_count; i++)
+    size += chunked_inputs_shared_bytes(&state->snippets[i].inputs);
+  return size;
+}
+
+static size_t get_size_commit_recording_cmd(void *cmd) {
+  CommitRecordingCommand *c = (CommitRecordingCommand *)cmd;
+  size_t size = sizeof(*c) + sizeof(TrackState) * 2 * c->count;
+  for (int i = 0; i < c->count; i++)
+    size += get_size_track_state(&c->tracks_before[i]) + get_size_track_state(&c->tracks_after[i]);
+  return size;
+}
+
 undo_command_t *commands_create_commit_recording(ui_handler_t *ui) {
   timeline_state_t *ts = &ui->timeline;
 
@@ -1258,13 +1682,21 @@ undo_command_t *commands_create_commit_recording(ui_handler_t *ui) {
   cmd->base.undo = undo_commit_recording;
   cmd->base.redo = redo_commit_recording;
   cmd->base.cleanup = cleanup_commit_recording_cmd;
+  cmd->base.get_size = get_size_commit_recording_cmd;
   cmd->count = affected_count;
   cmd->tracks_before = calloc(affected_count, sizeof(TrackState));
   cmd->tracks_after = calloc(affected_count, sizeof(TrackState));
 
   // Capture Before State
-  for (int i = 0; i < affected_count; i++) {
-    capture_track_state(ts, affected_indices[i], &cmd->tracks_before[i]);
+  bool captured = cmd->tracks_before && cmd->tracks_after;
+  if (!captured) cmd->count = 0;
+  for (int i = 0; i < affected_count && captured; i++) {
+    captured = capture_track_state(ts, affected_indices[i], &cmd->tracks_before[i]);
+  }
+  if (!captured) {
+    cleanup_commit_recording_cmd(&cmd->base);
+    free(affected_indices);
+    return NULL;
   }
 
   // Perform Merge (Logic moved from interaction)
@@ -1281,10 +1713,91 @@ undo_command_t *commands_create_commit_recording(ui_handler_t *ui) {
   }
 
   // Capture After State
-  for (int i = 0; i < affected_count; i++) {
-    capture_track_state(ts, affected_indices[i], &cmd->tracks_after[i]);
+  for (int i = 0; i < affected_count && captured; i++) {
+    captured = capture_track_state(ts, affected_indices[i], &cmd->tracks_after[i]);
+  }
+  // a merge that can't be redone is rolled back instead of being left without an undo step
+  if (!captured) {
+    undo_commit_recording(&cmd->base, ts);
+    model_recalc_physics(ts, 0);
+    cleanup_commit_recording_cmd(&cmd->base);
+    free(affected_indices);
+    return NULL;
   }
 
   free(affected_indices);
   return &cmd->base;
 }
+
+// Bulk writes
+static input_snippet_t *find_active_snippet_at(player_track_t *track, int tick, int *out_next_start) {
+  *out_next_start = INT_MAX;
+  for (int i = 0; i < track->snippet_count; ++i) {
+    input_snippet_t *snippet = &track->snippets[i];
+    if (!snippet->is_active) continue;
+    if (tick >= snippet->start_tick && tick < snippet->end_tick) return snippet;
+    if (snippet->start_tick > tick) *out_next_start = imin(*out_next_start, snippet->start_tick);
+  }
+  return NULL;
+}
+
+// Splits one write at snippet boundaries: covered parts edit the active snippet, gaps become new snippets.
+// A write that lands inside a single snippet hands its buffer to the command without copying.
+static bool apply_input_write(ui_handler_t *ui, InputWrite *write) {
+  timeline_state_t *ts = &ui->timeline;
+  player_track_t *track = &ts->player_tracks[write->track_index];
+  int end_tick = write->start_tick + write->count;
+  bool ok = true;
+
+  for (int tick = write->start_tick; tick < end_tick;) {
+    int next_start;
+    input_snippet_t *snippet = find_active_snippet_at(track, tick, &next_start);
+    int segment_end = snippet ? imin(end_tick, snippet->end_tick) : imin(end_tick, next_start);
+    int count = segment_end - tick;
+    const SPlayerInput *src = write->inputs + (tick - write->start_tick);
+
+    SPlayerInput *buffer;
+    if (count == write->count) {
+      buffer = write->inputs;
+      write->inputs = NULL;
+    } else {
+      buffer = malloc(sizeof(SPlayerInput) * count);
+      if (buffer) memcpy(buffer, src, sizeof(SPlayerInput) * count);
+    }
+
+    undo_command_t *command = NULL;
+    if (snippet) {
+      EditInputsCommand *edit = create_range_edit(snippet, tick - snippet->start_tick, count, buffer);
+      if (edit) {
+        apply_input_states(ts, edit, edit->after);
+        command = &edit->base;
+      }
+    } else if (buffer) {
+      AddSnippetCommand *add = create_snippet_with_inputs(ts, write->track_index, tick, count, buffer, NULL);
+      if (add) {
+        model_recalc_physics(ts, tick);
+        command = &add->base;
+      }
+    }
+
+    if (command) undo_manager_register_command(&ui->undo_manager, command);
+    else ok = false;
+    tick = segment_end;
+  }
+  return ok;
+}
+
+bool timeline_api_write_inputs(ui_handler_t *ui, InputWrite *writes, int count, const char *description) {
+  timeline_state_t *ts = &ui->timeline;
+  bool ok = true;
+  undo_manager_begin_transaction(&ui->undo_manager, ts, description ? description : "Write Inputs (API)");
+  for (int i = 0; i < count; ++i) {
+    InputWrite *write = &writes[i];
+    if (write->track_index < 0 || write->track_index >= ts->player_track_count || write->count <= 0 || !write->inputs) ok = false;
+    else if (!apply_input_write(ui, write)) ok = false;
+    free(write->inputs);
+    write->inputs = NULL;
+  }
+  undo_manager_commit_transaction(&ui->undo_manager, ts);
+  return ok;
+}
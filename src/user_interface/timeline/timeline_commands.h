@@ -15,6 +15,14 @@ typedef struct {
   int new_layer;
 } MoveSnippetInfo;
 
+// A range of effective inputs on one track, `inputs` holds `count` entries starting at start_tick
+typedef struct {
+  int track_index;
+  int start_tick;
+  int count;
+  SPlayerInput *inputs;
+} InputWrite;
+
 struct undo_command_t *commands_create_add_snippet(ui_handler_t *ui, int track_idx, int start_tick, int duration);
 struct undo_command_t *commands_create_delete_selected(ui_handler_t *ui);
 struct undo_command_t *commands_create_split_selected(ui_handler_t *ui);
@@ -33,6 +41,8 @@ struct undo_command_t *timeline_api_create_track(ui_handler_t *ui, const player_
 struct undo_command_t *timeline_api_create_snippet(ui_handler_t *ui, int track_index, int start_tick, int duration, int *out_snippet_id);
 struct undo_command_t *timeline_api_set_snippet_inputs(ui_handler_t *ui, int snippet_id, int tick_offset, int count,
                                                        const SPlayerInput *new_inputs);
+// Applies all writes as one undo step and takes ownership of every `inputs` buffer
+bool timeline_api_write_inputs(ui_handler_t *ui, InputWrite *writes, int count, const char *description);
 
 struct undo_command_t *commands_create_commit_recording(ui_handler_t *ui);
 
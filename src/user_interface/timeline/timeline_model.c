@@ -7,6 +7,7 @@
 #include <renderer/graphics_backend.h>
 #include <stdlib.h>
 #include <string.h>
+#include <system/profiler.h>
 #include <user_interface/user_interface.h>
 #include <user_interface/widgets/hsl_colorpicker.h>
 
@@ -17,28 +18,27 @@ static void v_init(physics_v_t *t);
 static void v_destroy(physics_v_t *t);
 static void v_push(physics_v_t *t, SWorldCore *world);
 
-static void ui_particle_callback(mvec2 pos, int type, int cid, void *user_data) {
-  ui_handler_t *ui = (ui_handler_t *)user_data;
-  vec2 p = {vgetx(pos), vgety(pos)};
+static void spawn_effect(ui_handler_t *ui, const game_event_t *e) {
+  vec2 p = {e->pos[0], e->pos[1]};
 
   vec2 zero_vel = {0, -1};
   float default_alpha = 1.0f;
   float time_passed = 0.0f;
 
-  if (type == PARTICLE_TYPE_SMOKE) particles_create_smoke(&ui->particle_system, p, zero_vel, default_alpha, time_passed);
-  else if (type == PARTICLE_TYPE_PLAYER_SPAWN) particles_create_player_spawn(&ui->particle_system, p, default_alpha);
-  else if (type == PARTICLE_TYPE_PLAYER_DEATH) {
+  if (e->type == GAME_EVENT_SMOKE) particles_create_smoke(&ui->particle_system, p, zero_vel, default_alpha, time_passed);
+  else if (e->type == GAME_EVENT_SPAWN) particles_create_player_spawn(&ui->particle_system, p, default_alpha);
+  else if (e->type == GAME_EVENT_DEATH) {
     // TODO: the coloring is different on ddnet i can't figure it out
-    // TODO: this is also buggy since we don't re-push color when the player color changes
     vec4 col = {1, 1, 1, 1};
-    if (ui->timeline.player_tracks[cid].player_info.use_custom_color)
-      packed_hsl_to_rgb(ui->timeline.player_tracks[cid].player_info.color_body, col);
+    if (e->cid >= 0 && e->cid < ui->timeline.player_track_count && ui->timeline.player_tracks[e->cid].player_info.use_custom_color)
+      packed_hsl_to_rgb(ui->timeline.player_tracks[e->cid].player_info.color_body, col);
     particles_create_player_death(&ui->particle_system, p, col);
-  } else if (type == PARTICLE_TYPE_AIR_JUMP) particles_create_air_jump(&ui->particle_system, p, default_alpha);
-  else if (type == PARTICLE_TYPE_BULLET_TRAIL) particles_create_bullet_trail(&ui->particle_system, p, default_alpha, time_passed);
-  else if (type == PARTICLE_TYPE_BULLET_STARS) particles_create_star(&ui->particle_system, p);
-  else if (type == PARTICLE_TYPE_EXPLOSION) particles_create_explosion(&ui->particle_system, p);
-  else if (type == PARTICLE_TYPE_HAMMER_HIT) particles_create_hammer_hit(&ui->particle_system, p, default_alpha);
+  } else if (e->type == GAME_EVENT_AIR_JUMP) particles_create_air_jump(&ui->particle_system, p, default_alpha);
+  else if (e->type == GAME_EVENT_BULLET_TRAIL) particles_create_bullet_trail(&ui->particle_system, p, default_alpha, time_passed);
+  else if (e->type == GAME_EVENT_BULLET_STARS) particles_create_star(&ui->particle_system, p);
+  else if (e->type == GAME_EVENT_EXPLOSION) particles_create_explosion(&ui->particle_system, p);
+  else if (e->type == GAME_EVENT_HAMMER_HIT) particles_create_hammer_hit(&ui->particle_system, p, default_alpha);
+  else if (e->type == GAME_EVENT_FROZEN) particles_create_freezing_flakes(&ui->particle_system, p, (vec2){32.0f, 32.0f}, 1.0f);
 }
 
 // New sorting helper for the compaction algorithm
@@ -63,6 +63,8 @@ void model_init(timeline_state_t *ts, ui_handler_t *ui) {
   ts->context_menu_snippet_id = -1;
   ts->active_snippet_id = -1;
   ts->next_snippet_id = 1;
+  ts->deferred_recalc_tick = INT_MAX;
+  ts->invalidated_from_tick = INT_MAX;
 
   ts->drag_state.drag_infos = NULL;
   ts->drag_state.initial_mouse_pos = (ImVec2){0, 0};
@@ -74,6 +76,8 @@ void model_init(timeline_state_t *ts, ui_handler_t *ui) {
   ts->net_event_count = 0;
   ts->net_event_capacity = 0;
 
+  memset(&ts->event_log, 0, sizeof(event_log_t));
+
   snippet_id_vector_init(&ts->selected_snippets);
 }
 
@@ -99,9 +103,12 @@ void model_cleanup(timeline_state_t *ts) {
     free(ts->net_events);
   }
 
+  event_log_free(&ts->event_log);
+
   v_destroy(&ts->vec);
   wc_free(&ts->previous_world);
   snippet_id_vector_free(&ts->selected_snippets);
+  free(ts->input_changes);
 
   memset(ts, 0, sizeof(timeline_state_t));
 }
@@ -252,13 +259,14 @@ void timeline_solve_snippet_layers(input_snippet_t **snippets, int count) {
   }
 }
 
-void model_insert_snippet_into_track(player_track_t *track, const input_snippet_t *snippet) {
+void model_insert_snippet_into_track(timeline_state_t *ts, player_track_t *track, const input_snippet_t *snippet) {
   if (track->snippet_count >= track->snippet_capacity) {
     track->snippet_capacity = track->snippet_capacity == 0 ? 8 : track->snippet_capacity * 2;
     track->snippets = realloc(track->snippets, sizeof(input_snippet_t) * track->snippet_capacity);
   }
   track->snippets[track->snippet_count] = *snippet;
   track->snippet_count++;
+  if (snippet->is_active) model_mark_inputs_changed(ts, (int)(track - ts->player_tracks), snippet->start_tick, snippet->end_tick);
 }
 
 bool model_remove_snippet_from_track(timeline_state_t *ts, player_track_t *track, int snippet_id) {
@@ -272,6 +280,8 @@ bool model_remove_snippet_from_track(timeline_state_t *ts, player_track_t *track
 
   if (found_idx != -1) {
     int removed_start_tick = track->snippets[found_idx].start_tick;
+    if (track->snippets[found_idx].is_active)
+      model_mark_inputs_changed(ts, (int)(track - ts->player_tracks), removed_start_tick, track->snippets[found_idx].end_tick);
     model_free_snippet_inputs(&track->snippets[found_idx]);
 
     memmove(&track->snippets[found_idx], &track->snippets[found_idx + 1], (track->snippet_count - found_idx - 1) * sizeof(input_snippet_t));
@@ -291,6 +301,11 @@ bool model_remove_snippet_from_track(timeline_state_t *ts, player_track_t *track
 }
 
 void model_resize_snippet_inputs(timeline_state_t *ts, input_snippet_t *snippet, int new_duration) {
+  // recording snippets are not part of any track, their inputs only count once merged
+  int track_index = -1;
+  if (snippet->is_active && model_find_snippet_by_id(ts, snippet->id, &track_index) == snippet)
+    model_mark_inputs_changed(ts, track_index, snippet->start_tick + imin(snippet->input_count, imax(new_duration, 0)),
+                              snippet->start_tick + imax(snippet->input_count, new_duration));
   if (new_duration <= 0) {
     model_free_snippet_inputs(snippet);
     snippet->start_tick = snippet->end_tick;
@@ -394,6 +409,7 @@ void model_remove_track_logic(timeline_state_t *ts, int track_index) {
   else if (ts->selected_player_track_index > track_index) ts->selected_player_track_index--;
 
   ts->vec.current_size = 1;
+  model_mark_all_inputs_changed(ts);
   model_recalc_physics(ts, 0);
 }
 
@@ -436,6 +452,8 @@ void model_insert_track_physics(timeline_state_t *ts, int track_index) {
     wc_insert_character_at_index(&ts->ui->gfx_handler->physics_handler.world, track_index);
   }
   ts->vec.current_size = 1;
+  event_log_truncate(&ts->event_log, 0);
+  model_mark_all_inputs_changed(ts);
 }
 
 void model_compact_layers_for_track(player_track_t *track) {
@@ -465,6 +483,7 @@ void model_insert_snippet_into_recording_track(player_track_t *track, const inpu
 }
 
 void model_apply_input_to_main_buffer(timeline_state_t *ts, player_track_t *track, int tick, const SPlayerInput *input) {
+  model_mark_inputs_changed(ts, (int)(track - ts->player_tracks), tick, tick + 1);
   input_snippet_t *overlapping_snippet = NULL;
   for (int j = 0; j < track->snippet_count; ++j) {
     if (track->snippets[j].is_active && tick >= track->snippets[j].start_tick && tick < track->snippets[j].end_tick) {
@@ -513,7 +532,7 @@ void model_apply_input_to_main_buffer(timeline_state_t *ts, player_track_t *trac
     new_snippet.inputs[0] = *input;
     new_snippet.layer = model_find_available_layer(track, tick, tick + 1, -1);
     if (new_snippet.layer == -1) new_snippet.layer = 0;
-    model_insert_snippet_into_track(track, &new_snippet);
+    model_insert_snippet_into_track(ts, track, &new_snippet);
     model_compact_layers_for_track(track);
   }
 }
@@ -534,7 +553,14 @@ void model_clear_all_recording_buffers(timeline_state_t *ts) {
 // Physics & Playback
 
 void model_recalc_physics(timeline_state_t *ts, int tick) {
-  ts->vec.current_size = imin(ts->vec.current_size, imax(tick / 50 + 1, 1));
+  if (ts->recalc_defer_depth > 0) {
+    ts->deferred_recalc_tick = imin(ts->deferred_recalc_tick, tick);
+    return;
+  }
+  ts->vec.current_size = imin(ts->vec.current_size, imax(tick / PHYSICS_SNAPSHOT_STEP + 1, 1));
+  event_log_truncate(&ts->event_log, tick);
+  particle_system_truncate(&ts->ui->particle_system, tick);
+  ts->invalidated_from_tick = imin(ts->invalidated_from_tick, imax(tick, 0));
   if (ts->previous_world.m_GameTick > tick) {
     ts->previous_world.m_GameTick = INT_MAX;
   }
@@ -622,77 +648,89 @@ void model_activate_snippet(timeline_state_t *ts, int track_index, int snippet_i
   }
 
   target_snippet->is_active = true;
+  model_mark_inputs_changed(ts, track_index, target_snippet->start_tick, target_snippet->end_tick);
   model_recalc_physics(ts, target_snippet->start_tick);
 }
 
+// Effects
+
+// particles alive at a tick, plus the flow events that pushed them since they spawned
+#define EFFECT_REBUILD_TICKS (PARTICLE_MAX_LIFE_TICKS + FLOW_DECAY_TICKS)
+
+// Spawns the effects of a logged tick, with the same seed as every other time it is spawned
+static void spawn_logged_tick(timeline_state_t *ts, int tick) {
+  particle_system_t *ps = &ts->ui->particle_system;
+  int count;
+  const game_event_t *events = event_log_tick_events(&ts->event_log, tick, &count);
+  ps->current_time = (double)tick / 50.0;
+  ps->rng_seed = tick;
+
+  for (int i = 0; i < count; ++i)
+    spawn_effect(ts->ui, &events[i]);
+  // pickups never move, their shine is not logged
+  for (int i = 0; i < ts->ui->num_ninja_pickups; ++i) {
+    int p = ts->ui->ninja_pickup_indices[i];
+    vec2 pos = {vgetx(ts->ui->pickup_positions[p]), vgety(ts->ui->pickup_positions[p])};
+    particles_create_powerup_shine(ps, pos, (vec2){96, 18}, 1.0f);
+  }
+  ps->last_simulated_tick = tick;
+}
+
+// Brings the particle set up to `tick` from the log, without ticking physics. The set is kept while
+// it holds every tick of the rebuild window, otherwise the window is respawned. Respawned particles
+// start at their spawn state and particle_system_update_sim simulates them up to the current time.
+static void update_effects(timeline_state_t *ts, int tick) {
+  particle_system_t *ps = &ts->ui->particle_system;
+  const event_log_t *log = &ts->event_log;
+  if (ps->last_simulated_tick >= tick) particle_system_truncate(ps, tick);
+
+  // a frame draws from the tick after the first one it requests, particles that died before are not needed
+  int start = imax(tick - EFFECT_REBUILD_TICKS, log->first_tick);
+  if (ps->first_simulated_tick > start || ps->last_simulated_tick < start - 1 || ps->expired_time > (double)(tick + 1) / 50.0)
+    particle_system_clear(ps, start);
+
+  int end = imin(tick, event_log_end(log));
+  for (int t = ps->last_simulated_tick + 1; t < end; ++t)
+    spawn_logged_tick(ts, t);
+}
+
 void model_get_world_state_at_tick(timeline_state_t *ts, int tick, SWorldCore *out_world, bool effects) {
-  const int step = 50;
+  PROFILE_BEGIN("model_get_world_state_at_tick");
+  const int step = PHYSICS_SNAPSHOT_STEP;
   particle_system_t *ps = &ts->ui->particle_system;
+  event_log_t *log = &ts->event_log;
+  int log_end = event_log_end(log);
 
   // Jump or Rewind Logic
-  if (tick < ts->previous_world.m_GameTick || (tick - ts->previous_world.m_GameTick) > 100) {
-    int raw_index = (tick - 1) / step;
-    // Go back one extra snapshot to ensure we re-simulate recent particles
-    // that might have expired in the future state we are rewinding from.
-    // TODO: this doesnt solve the real issue of long lasting particles not being rendered when reversing
-    if (effects && raw_index > 0) raw_index--;
-    int base_index = imin(raw_index, ts->vec.current_size - 1);
+  // The event log has no gaps, ticking past its end has to resume where it ends so the skipped
+  // ticks are logged too.
+  if (tick < ts->previous_world.m_GameTick || (tick - ts->previous_world.m_GameTick) > 100 ||
+      (tick > log_end && ts->previous_world.m_GameTick > log_end)) {
+    int base_index = imin((tick - 1) / step, (int)ts->vec.current_size - 1);
+    if (tick > log_end) base_index = imin(base_index, log_end / step);
     if (base_index < 0) base_index = 0;
     wc_copy_world(out_world, &ts->vec.data[base_index]);
-
-    if (effects) {
-      double snapshot_time = (double)out_world->m_GameTick / 50.0;
-      particle_system_prune_by_time(ps, snapshot_time);
-
-      ps->current_time = snapshot_time;
-      ps->last_simulated_tick = out_world->m_GameTick - 1;
-    }
   } else {
     wc_copy_world(out_world, &ts->previous_world);
   }
-
-  out_world->user_data = ts->ui;
+  if (effects) update_effects(ts, tick);
 
   while (out_world->m_GameTick < tick) {
     int current_sim_tick = out_world->m_GameTick;
 
-    bool is_new_logic_tick = (effects && current_sim_tick > ps->last_simulated_tick);
-
-    if (is_new_logic_tick) {
-      out_world->particle = ui_particle_callback;
-      ps->current_time = (double)current_sim_tick / 50.0;
-      ps->rng_seed = current_sim_tick;
-    } else {
-      out_world->particle = NULL;
-    }
+    // every tick is logged the first time it is ticked, whether its effects are shown or not
+    bool record = current_sim_tick == event_log_end(log);
 
     for (int p = 0; p < out_world->m_NumCharacters; ++p) {
       SPlayerInput input = model_get_input_at_tick(ts, p, current_sim_tick);
       cc_on_input(&out_world->m_pCharacters[p], &input);
     }
 
+    if (record) event_log_begin_tick(log, out_world);
     wc_tick(out_world);
+    if (record) event_log_end_tick(log, out_world);
 
-    // other effects
-    if (is_new_logic_tick) {
-      if (out_world->m_GameTick % 5 == 0) {
-        for (int p = 0; p < out_world->m_NumCharacters; ++p) {
-          SCharacterCore *core = &out_world->m_pCharacters[p];
-          if (core->m_FreezeTime > 0) {
-            vec2 p = {vgetx(core->m_Pos), vgety(core->m_Pos)};
-            particles_create_freezing_flakes(ps, p, (vec2){32.0f, 32.0f}, 1.0f);
-          }
-        }
-      }
-      for (int i = 0; i < ts->ui->num_ninja_pickups; ++i) {
-        int p = ts->ui->ninja_pickup_indices[i];
-        vec2 pos = {vgetx(ts->ui->pickup_positions[p]), vgety(ts->ui->pickup_positions[p])};
-        particles_create_powerup_shine(ps, pos, (vec2){96, 18}, 1.0f);
-      }
-    }
-
-    if (is_new_logic_tick)
-      ps->last_simulated_tick = current_sim_tick;
+    if (effects && current_sim_tick > ps->last_simulated_tick && event_log_has_tick(log, current_sim_tick)) spawn_logged_tick(ts, current_sim_tick);
 
     if (out_world->m_GameTick % step == 0) {
       int cache_index = out_world->m_GameTick / step;
@@ -701,8 +739,8 @@ void model_get_world_state_at_tick(timeline_state_t *ts, int tick, SWorldCore *o
     }
   }
 
-  out_world->particle = NULL;
   wc_copy_world(&ts->previous_world, out_world);
+  PROFILE_END();
 }
 
 void model_apply_starting_config(timeline_state_t *ts, int track_index) {
@@ -727,6 +765,24 @@ void model_apply_starting_config(timeline_state_t *ts, int track_index) {
   model_recalc_physics(ts, 0);
 }
 
+// While deferred, invalidations only record the earliest tick and are applied once the outermost
+// caller resumes. Used by undo transactions so a batch of edits truncates the cache once.
+void model_defer_physics_recalc(timeline_state_t *ts, bool defer) {
+  if (defer) {
+    if (ts->recalc_defer_depth++ == 0) ts->deferred_recalc_tick = INT_MAX;
+    return;
+  }
+  if (ts->recalc_defer_depth <= 0 || --ts->recalc_defer_depth > 0) return;
+  if (ts->deferred_recalc_tick != INT_MAX) model_recalc_physics(ts, ts->deferred_recalc_tick);
+  ts->deferred_recalc_tick = INT_MAX;
+}
+
+// Appends a world to the snapshot cache, it must sit exactly one step after the last cached one
+void model_push_snapshot(timeline_state_t *ts, SWorldCore *world) {
+  if (world->m_GameTick != (int)ts->vec.current_size * PHYSICS_SNAPSHOT_STEP) return;
+  v_push(&ts->vec, world);
+}
+
 // Static Physics Vector Helpers
 static void v_init(physics_v_t *t) {
   t->current_size = 1;
@@ -767,3 +823,28 @@ static void v_push(physics_v_t *t, SWorldCore *world) {
   }
   wc_copy_world(&t->data[t->current_size - 1], world);
 }
+
+// Change Notifications
+void model_mark_inputs_changed(timeline_state_t *ts, int track_index, int start_tick, int end_tick) {
+  if (track_index < 0 || track_index >= ts->player_track_count || end_tick <= start_tick) return;
+  for (int i = 0; i < ts->input_change_count; ++i) {
+    input_change_t *change = &ts->input_changes[i];
+    if (change->track_index != track_index) continue;
+    change->start_tick = imin(change->start_tick, start_tick);
+    change->end_tick = imax(change->end_tick, end_tick);
+    return;
+  }
+  if (ts->input_change_count >= ts->input_change_capacity) {
+    ts->input_change_capacity = ts->input_change_capacity == 0 ? 8 : ts->input_change_capacity * 2;
+    ts->input_changes = realloc(ts->input_changes, sizeof(input_change_t) * ts->input_change_capacity);
+  }
+  ts->input_changes[ts->input_change_count++] = (input_change_t){track_index, start_tick, end_tick};
+}
+
+// Track indices shifted, so every track is reported in full
+void model_mark_all_inputs_changed(timeline_state_t *ts) {
+  ts->input_change_count = 0;
+  int end_tick = imax(model_get_max_timeline_tick(ts), 1);
+  for (int i = 0; i < ts->player_track_count; ++i)
+    model_mark_inputs_changed(ts, i, 0, end_tick);
+}
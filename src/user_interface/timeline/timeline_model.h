@@ -23,7 +23,7 @@ int model_get_max_timeline_tick(timeline_state_t *ts);
 
 // Data Modification
 void timeline_solve_snippet_layers(input_snippet_t **snippets, int count);
-void model_insert_snippet_into_track(player_track_t *track, const input_snippet_t *snippet);
+void model_insert_snippet_into_track(timeline_state_t *ts, player_track_t *track, const input_snippet_t *snippet);
 bool model_remove_snippet_from_track(timeline_state_t *ts, player_track_t *track, int snippet_id);
 void model_resize_snippet_inputs(timeline_state_t *ts, input_snippet_t *snippet, int new_duration);
 void model_snippet_clone(input_snippet_t *dest, const input_snippet_t *src);
@@ -45,5 +45,11 @@ void model_advance_tick(timeline_state_t *ts, int steps);
 void model_activate_snippet(timeline_state_t *ts, int track_index, int snippet_id_to_activate);
 void model_get_world_state_at_tick(timeline_state_t *ts, int tick, SWorldCore *out_world, bool effects);
 void model_apply_starting_config(timeline_state_t *ts, int track_index);
+void model_push_snapshot(timeline_state_t *ts, SWorldCore *world);
+void model_defer_physics_recalc(timeline_state_t *ts, bool defer);
+
+// Change Notifications
+void model_mark_inputs_changed(timeline_state_t *ts, int track_index, int start_tick, int end_tick);
+void model_mark_all_inputs_changed(timeline_state_t *ts);
 
 #endif // UI_TIMELINE_MODEL_H
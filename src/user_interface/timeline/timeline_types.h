@@ -1,6 +1,7 @@
 #ifndef UI_TIMELINE_TYPES_H
 #define UI_TIMELINE_TYPES_H
 
+#include <physics/event_log.h>
 #include <physics/physics.h>
 #include <stdbool.h>
 #include <system/include_cimgui.h>
@@ -9,6 +10,7 @@
 
 #define MAX_SNIPPETS_PER_PLAYER 64
 #define MAX_SNIPPET_LAYERS 8
+#define PHYSICS_SNAPSHOT_STEP 50 // ticks between cached worlds in physics_v_t
 
 struct physics_v_t {
   SWorldCore *data;
@@ -88,6 +90,13 @@ struct snippet_id_vector_t {
   int capacity;
 };
 
+// a tick range [start_tick, end_tick) of one track whose effective inputs changed
+struct input_change_t {
+  int track_index;
+  int start_tick;
+  int end_tick;
+};
+
 struct recording_snippet_vector_t {
   input_snippet_t **snippets;
   int count;
@@ -193,6 +202,16 @@ struct timeline_state {
   // Physics Integration
   physics_v_t vec;
   SWorldCore previous_world;
+  int recalc_defer_depth;
+  int deferred_recalc_tick; // earliest invalidated tick while deferred, INT_MAX if none
+  event_log_t event_log; // every tick from 0 on, recorded the first time it is ticked, seeking respawns particles from it
+
+  // Change Notifications, drained by the plugin manager once per frame
+  input_change_t *input_changes; // at most one merged range per track
+  int input_change_count;
+  int input_change_capacity;
+  int invalidated_from_tick; // INT_MAX if nothing was invalidated
+  bool project_loaded;
 
   // Back-pointer to parent UI handler
   ui_handler_t *ui;
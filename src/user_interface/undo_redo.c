@@ -1,9 +1,12 @@
 #include "undo_redo.h"
 #include "timeline/timeline_model.h"
+#include <logger/logger.h>
 #include <stdlib.h>
 #include <string.h>
 #include <system/include_cimgui.h>
 
+static const char *LOG_SOURCE = "UndoRedo";
+
 static void clear_stack(undo_command_t ***stack, int *count, int *capacity) {
   if (!*stack) return;
   for (int i = 0; i < *count; ++i) {
@@ -33,21 +36,240 @@ static undo_command_t *pop_from_stack(undo_command_t **stack, int *count) {
   return stack[--(*count)];
 }
 
+// Nothing references the spill file once both stacks are empty, so start over with a fresh one.
+static void reset_spill_file_if_unused(undo_manager_t *manager) {
+  if (!manager->spill_file || manager->undo_count > 0 || manager->redo_count > 0) return;
+  fclose(manager->spill_file);
+  manager->spill_file = NULL;
+}
+
+static bool spill_command(undo_manager_t *manager, undo_command_t *command) {
+  if (!manager->spill_file) manager->spill_file = tmpfile();
+  if (!manager->spill_file) return false;
+  if (fseek(manager->spill_file, 0, SEEK_END) != 0) return false;
+  long offset = ftell(manager->spill_file);
+  if (!command->spill(command, manager->spill_file)) return false;
+  command->spilled = true;
+  command->spill_offset = offset;
+  command->spill_size = ftell(manager->spill_file) - offset;
+  return true;
+}
+
+static bool unspill_command(undo_manager_t *manager, undo_command_t *command) {
+  if (!command->spilled) return true;
+  if (!manager->spill_file || fseek(manager->spill_file, command->spill_offset, SEEK_SET) != 0) return false;
+  if (!command->unspill(command, manager->spill_file)) return false;
+  command->spilled = false;
+  return true;
+}
+
+static long spilled_bytes(undo_command_t **stack, int count) {
+  long bytes = 0;
+  for (int i = 0; i < count; ++i)
+    if (stack[i]->spilled) bytes += stack[i]->spill_size;
+  return bytes;
+}
+
+static bool copy_spilled(FILE *from, FILE *to, undo_command_t **stack, int count) {
+  char buffer[16384];
+  for (int i = 0; i < count; ++i) {
+    if (!stack[i]->spilled) continue;
+    if (fseek(from, stack[i]->spill_offset, SEEK_SET) != 0) return false;
+    for (long left = stack[i]->spill_size; left > 0;) {
+      size_t chunk = left < (long)sizeof(buffer) ? (size_t)left : sizeof(buffer);
+      if (fread(buffer, 1, chunk, from) != chunk || fwrite(buffer, 1, chunk, to) != chunk) return false;
+      left -= (long)chunk;
+    }
+  }
+  return true;
+}
+
+static void move_spilled(undo_command_t **stack, int count, long *offset) {
+  for (int i = 0; i < count; ++i) {
+    if (!stack[i]->spilled) continue;
+    stack[i]->spill_offset = *offset;
+    *offset += stack[i]->spill_size;
+  }
+}
+
+// The spill file is append-only, records of unspilled or dropped commands stay behind. Once those
+// outweigh the live records, the live ones are copied to a fresh file.
+static void compact_spill_file(undo_manager_t *manager) {
+  if (!manager->spill_file || fseek(manager->spill_file, 0, SEEK_END) != 0) return;
+  long file_size = ftell(manager->spill_file);
+  long live = spilled_bytes(manager->undo_stack, manager->undo_count) + spilled_bytes(manager->redo_stack, manager->redo_count);
+  if (file_size - live <= live) return;
+
+  FILE *compacted = tmpfile();
+  if (!compacted) return;
+  if (!copy_spilled(manager->spill_file, compacted, manager->undo_stack, manager->undo_count) ||
+      !copy_spilled(manager->spill_file, compacted, manager->redo_stack, manager->redo_count)) {
+    log_warn(LOG_SOURCE, "Failed to compact the undo spill file, keeping the old one.");
+    fclose(compacted);
+    return;
+  }
+  long offset = 0;
+  move_spilled(manager->undo_stack, manager->undo_count, &offset);
+  move_spilled(manager->redo_stack, manager->redo_count, &offset);
+  fclose(manager->spill_file);
+  manager->spill_file = compacted;
+}
+
+// Transaction Command
+
+// Several commands collapsed by a transaction, undone in reverse order
+typedef struct {
+  undo_command_t base;
+  undo_command_t **commands;
+  int count;
+} TransactionCommand;
+
+static void undo_transaction(void *cmd, void *ts) {
+  TransactionCommand *c = (TransactionCommand *)cmd;
+  for (int i = c->count - 1; i >= 0; --i)
+    c->commands[i]->undo(c->commands[i], ts);
+}
+
+static void redo_transaction(void *cmd, void *ts) {
+  TransactionCommand *c = (TransactionCommand *)cmd;
+  for (int i = 0; i < c->count; ++i)
+    c->commands[i]->redo(c->commands[i], ts);
+}
+
+static void cleanup_transaction(void *cmd) {
+  TransactionCommand *c = (TransactionCommand *)cmd;
+  for (int i = 0; i < c->count; ++i)
+    if (c->commands[i]->cleanup) c->commands[i]->cleanup(c->commands[i]);
+  free(c->commands);
+  free(c);
+}
+
+static size_t get_size_transaction(void *cmd) {
+  TransactionCommand *c = (TransactionCommand *)cmd;
+  size_t size = sizeof(*c) + sizeof(undo_command_t *) * c->count;
+  for (int i = 0; i < c->count; ++i)
+    size += undo_command_get_size(c->commands[i]);
+  return size;
+}
+
 // Public API Implementation
 
-void undo_manager_init(undo_manager_t *manager) { memset(manager, 0, sizeof(undo_manager_t)); }
+void undo_manager_init(undo_manager_t *manager) {
+  memset(manager, 0, sizeof(undo_manager_t));
+  manager->memory_budget = UNDO_DEFAULT_MEMORY_BUDGET;
+  manager->spill_to_disk = true;
+}
 
 void undo_manager_cleanup(undo_manager_t *manager) {
   clear_stack(&manager->undo_stack, &manager->undo_count, &manager->undo_capacity);
   clear_stack(&manager->redo_stack, &manager->redo_count, &manager->redo_capacity);
+  reset_spill_file_if_unused(manager);
+}
+
+size_t undo_command_get_size(undo_command_t *command) {
+  if (command->get_size) return command->get_size(command);
+  return sizeof(undo_command_t);
+}
+
+size_t undo_manager_get_memory_usage(const undo_manager_t *manager) {
+  size_t total = 0;
+  for (int i = 0; i < manager->undo_count; ++i)
+    total += undo_command_get_size(manager->undo_stack[i]);
+  for (int i = 0; i < manager->redo_count; ++i)
+    total += undo_command_get_size(manager->redo_stack[i]);
+  return total;
+}
+
+// Spills the oldest undo entries first, then drops them if that wasn't enough.
+// The newest entry always stays in memory so the last action remains undoable. Skipped while a
+// transaction is open, dropping entries would move undo_count below transaction_base; the commit
+// enforces it instead.
+void undo_manager_enforce_budget(undo_manager_t *manager) {
+  if (manager->memory_budget == 0 || manager->transaction_depth > 0) return;
+  size_t total = undo_manager_get_memory_usage(manager);
+  if (total <= manager->memory_budget) return;
+
+  if (manager->spill_to_disk) {
+    for (int i = 0; i < manager->undo_count - 1 && total > manager->memory_budget; ++i) {
+      undo_command_t *command = manager->undo_stack[i];
+      if (command->spilled || !command->spill || !command->unspill) continue;
+      size_t before = undo_command_get_size(command);
+      if (!spill_command(manager, command)) break;
+      total -= before - undo_command_get_size(command);
+    }
+  }
+
+  int drop = 0;
+  while (drop < manager->undo_count - 1 && total > manager->memory_budget) {
+    undo_command_t *oldest = manager->undo_stack[drop++];
+    total -= undo_command_get_size(oldest);
+    if (oldest->cleanup) oldest->cleanup(oldest);
+  }
+  if (drop == 0) return;
+  memmove(manager->undo_stack, manager->undo_stack + drop, sizeof(undo_command_t *) * (manager->undo_count - drop));
+  manager->undo_count -= drop;
+  log_info(LOG_SOURCE, "Dropped %d undo entries to stay within the memory budget.", drop);
+  compact_spill_file(manager);
 }
 
 void undo_manager_register_command(undo_manager_t *manager, undo_command_t *command) {
   if (!command) return;
-  // Push the new action to the undo stack
-  push_to_stack(&manager->undo_stack, &manager->undo_count, &manager->undo_capacity, command);
   // A new action clears the redo history
   clear_stack(&manager->redo_stack, &manager->redo_count, &manager->redo_capacity);
+
+  if (manager->transaction_depth > 0) {
+    // Try folding it into the previous command of the same transaction first
+    if (manager->undo_count > manager->transaction_base) {
+      undo_command_t *previous = manager->undo_stack[manager->undo_count - 1];
+      if (previous->merge && previous->merge(previous, command)) {
+        if (command->cleanup) command->cleanup(command);
+        return;
+      }
+    }
+    push_to_stack(&manager->undo_stack, &manager->undo_count, &manager->undo_capacity, command);
+    return; // the budget is enforced once the transaction commits
+  }
+
+  // Push the new action to the undo stack
+  push_to_stack(&manager->undo_stack, &manager->undo_count, &manager->undo_capacity, command);
+  undo_manager_enforce_budget(manager);
+}
+
+void undo_manager_begin_transaction(undo_manager_t *manager, timeline_state_t *ts, const char *description) {
+  if (manager->transaction_depth++ > 0) return;
+  manager->transaction_base = manager->undo_count;
+  snprintf(manager->transaction_description, sizeof(manager->transaction_description), "%s", description ? description : "Transaction");
+  model_defer_physics_recalc(ts, true);
+}
+
+void undo_manager_commit_transaction(undo_manager_t *manager, timeline_state_t *ts) {
+  if (manager->transaction_depth <= 0) return;
+  if (--manager->transaction_depth > 0) return;
+
+  int count = manager->undo_count - manager->transaction_base;
+  if (count > 1) {
+    TransactionCommand *cmd = calloc(1, sizeof(TransactionCommand));
+    undo_command_t **commands = malloc(sizeof(undo_command_t *) * count);
+    if (cmd && commands) {
+      memcpy(commands, &manager->undo_stack[manager->transaction_base], sizeof(undo_command_t *) * count);
+      snprintf(cmd->base.description, sizeof(cmd->base.description), "%s", manager->transaction_description);
+      cmd->base.undo = undo_transaction;
+      cmd->base.redo = redo_transaction;
+      cmd->base.cleanup = cleanup_transaction;
+      cmd->base.get_size = get_size_transaction;
+      cmd->commands = commands;
+      cmd->count = count;
+      manager->undo_count = manager->transaction_base;
+      push_to_stack(&manager->undo_stack, &manager->undo_count, &manager->undo_capacity, &cmd->base);
+    } else {
+      // keep the individual entries rather than losing them
+      free(cmd);
+      free(commands);
+    }
+  }
+
+  model_defer_physics_recalc(ts, false);
+  undo_manager_enforce_budget(manager);
 }
 
 bool undo_manager_can_undo(const undo_manager_t *manager) { return manager->undo_count > 0; }
@@ -57,6 +279,15 @@ bool undo_manager_can_redo(const undo_manager_t *manager) { return manager->redo
 void undo_manager_undo(undo_manager_t *manager, void *ts) {
   undo_command_t *command = pop_from_stack(manager->undo_stack, &manager->undo_count);
   if (command) {
+    if (!unspill_command(manager, command)) {
+      // everything below depends on this entry, so the rest of the history is unusable too
+      log_error(LOG_SOURCE, "Failed to read back '%s' from the spill file, discarding undo history.", command->description);
+      if (command->cleanup) command->cleanup(command);
+      clear_stack(&manager->undo_stack, &manager->undo_count, &manager->undo_capacity);
+      reset_spill_file_if_unused(manager);
+      return;
+    }
+    compact_spill_file(manager);
     command->undo(command, ts);
     push_to_stack(&manager->redo_stack, &manager->redo_count, &manager->redo_capacity, command);
     model_recalc_physics((timeline_state_t *)ts, 0); // Recalculate physics to be safe
@@ -72,6 +303,21 @@ void undo_manager_redo(undo_manager_t *manager, void *ts) {
   }
 }
 
+static void format_bytes(char *buffer, size_t size, size_t bytes) {
+  if (bytes >= 1024 * 1024) snprintf(buffer, size, "%.1f MB", bytes / (1024.0 * 1024.0));
+  else if (bytes >= 1024) snprintf(buffer, size, "%.1f KB", bytes / 1024.0);
+  else snprintf(buffer, size, "%zu B", bytes);
+}
+
+static void render_stack_entry(int index, undo_command_t *command) {
+  char size[32];
+  format_bytes(size, sizeof(size), undo_command_get_size(command));
+  igText("%d. %s", index + 1, command->description);
+  igSameLine(0, 10);
+  if (command->spilled) igTextDisabled("(%s, on disk)", size);
+  else igTextDisabled("(%s)", size);
+}
+
 void undo_manager_render_history_window(undo_manager_t *manager) {
   if (!manager->show_history_window) return;
 
@@ -80,13 +326,26 @@ void undo_manager_render_history_window(undo_manager_t *manager) {
     if (igButton("Clear History", (ImVec2){0, 0})) {
       clear_stack(&manager->undo_stack, &manager->undo_count, &manager->undo_capacity);
       clear_stack(&manager->redo_stack, &manager->redo_count, &manager->redo_capacity);
+      reset_spill_file_if_unused(manager);
+    }
+
+    char usage[32];
+    format_bytes(usage, sizeof(usage), undo_manager_get_memory_usage(manager));
+    igSameLine(0, 10);
+    igText("Memory: %s", usage);
+
+    int budget_mb = (int)(manager->memory_budget / (1024 * 1024));
+    if (igSliderInt("Budget (MB)", &budget_mb, 0, 4096, budget_mb == 0 ? "Unlimited" : "%d", 0)) {
+      manager->memory_budget = (size_t)budget_mb * 1024 * 1024;
     }
+    if (igIsItemDeactivatedAfterEdit()) undo_manager_enforce_budget(manager);
+    if (igCheckbox("Spill old entries to disk", &manager->spill_to_disk)) undo_manager_enforce_budget(manager);
     igSeparator();
 
     igText("Undo Stack:");
     igBeginChild_Str("UndoStack", (ImVec2){0, 150}, true, 0);
     for (int i = manager->undo_count - 1; i >= 0; i--) {
-      igText("%d. %s", i + 1, manager->undo_stack[i]->description);
+      render_stack_entry(i, manager->undo_stack[i]);
     }
     igEndChild();
 
@@ -94,7 +353,7 @@ void undo_manager_render_history_window(undo_manager_t *manager) {
     igText("Redo Stack:");
     igBeginChild_Str("RedoStack", (ImVec2){0, 150}, true, 0);
     for (int i = manager->redo_count - 1; i >= 0; i--) {
-      igText("%d. %s", i + 1, manager->redo_stack[i]->description);
+      render_stack_entry(i, manager->redo_stack[i]);
     }
     igEndChild();
   }
@@ -2,8 +2,11 @@
 #define UNDO_REDO_H
 
 #include <stdbool.h>
+#include <stdio.h>
 #include <types.h>
 
+#define UNDO_DEFAULT_MEMORY_BUDGET ((size_t)256 * 1024 * 1024)
+
 struct undo_command_t {
   char description[64];
   // A function to reverse the action.
@@ -12,6 +15,20 @@ struct undo_command_t {
   void (*redo)(void *cmd, void *ts);
   // A function to free any memory held by the command itself.
   void (*cleanup)(void *cmd);
+  // Optional: bytes currently held in RAM by the command, itself included.
+  size_t (*get_size)(void *cmd);
+  // Optional: write the bulky payload to `f` and free it, or read it back before undo.
+  // Commands without these are dropped instead of spilled when over budget.
+  bool (*spill)(void *cmd, FILE *f);
+  bool (*unspill)(void *cmd, FILE *f);
+  // Optional: fold `other`, registered right after this command inside a transaction, into this one.
+  // Returns false if the two can't be combined. On success the manager cleans up `other`.
+  bool (*merge)(void *cmd, void *other);
+
+  // Owned by the manager
+  bool spilled;
+  long spill_offset;
+  long spill_size;
 };
 
 // The manager holds separate stacks for undo and redo commands.
@@ -22,6 +39,17 @@ struct undo_manager_t {
   int redo_count;
   int undo_capacity;
   int redo_capacity;
+  // Once the stacks hold more than this many bytes, the oldest undo entries are
+  // spilled to a temp file (if allowed and supported) or dropped. 0 = unlimited.
+  size_t memory_budget;
+  bool spill_to_disk;
+  FILE *spill_file;
+
+  // Commands registered between begin/commit are collapsed into a single entry
+  int transaction_depth;
+  int transaction_base; // undo_count when the outermost transaction began
+  char transaction_description[64];
+
   bool show_history_window;
 };
 
@@ -33,6 +61,11 @@ void undo_manager_cleanup(undo_manager_t *manager);
 // Call this AFTER an action is performed to register its corresponding undo command.
 void undo_manager_register_command(undo_manager_t *manager, undo_command_t *command);
 
+// Groups every command registered until the matching commit into one undo entry, merging adjacent
+// commands where possible. Physics invalidation is deferred until the outermost commit.
+void undo_manager_begin_transaction(undo_manager_t *manager, timeline_state_t *ts, const char *description);
+void undo_manager_commit_transaction(undo_manager_t *manager, timeline_state_t *ts);
+
 // Perform undo/redo operations.
 void undo_manager_undo(undo_manager_t *manager, void *ts);
 void undo_manager_redo(undo_manager_t *manager, void *ts);
@@ -41,6 +74,10 @@ void undo_manager_redo(undo_manager_t *manager, void *ts);
 bool undo_manager_can_undo(const undo_manager_t *manager);
 bool undo_manager_can_redo(const undo_manager_t *manager);
 
+size_t undo_command_get_size(undo_command_t *command);
+size_t undo_manager_get_memory_usage(const undo_manager_t *manager);
+void undo_manager_enforce_budget(undo_manager_t *manager);
+
 void undo_manager_render_history_window(undo_manager_t *manager);
 
 #endif // UNDO_REDO_H
@@ -5,6 +5,8 @@
 #include "demo.h"
 #include "net_events.h"
 #include "player_info.h"
+#include "profiler_window.h"
+#include "search_window.h"
 #include "skin_browser.h"
 #include "snippet_editor.h"
 #include "timeline/timeline_commands.h"
@@ -29,6 +31,7 @@
 #include <symbols.h>
 #include <system/config.h>
 #include <system/include_cimgui.h>
+#include <system/profiler.h>
 #include <system/save.h>
 
 #ifndef M_PI
@@ -107,6 +110,9 @@ void render_menu_bar(ui_handler_t *ui) {
       igMenuItem_BoolPtr("Timeline", NULL, &ui->show_timeline, true);
       igMenuItem_BoolPtr("Controls", NULL, &ui->keybinds.show_settings_window, true);
       igMenuItem_BoolPtr("Undo History", NULL, &ui->undo_manager.show_history_window, true);
+      igMenuItem_BoolPtr("Plugins", NULL, &ui->plugin_manager.show_stats_window, true);
+      igMenuItem_BoolPtr("Input Search", NULL, &ui->search_window.show, true);
+      igMenuItem_BoolPtr("Profiler", NULL, &ui->profiler_window.show, true);
       igMenuItem_BoolPtr("Show prediction", NULL, &ui->show_prediction, true);
       igMenuItem_BoolPtr("Show skin manager", NULL, &ui->show_skin_browser, true);
       igMenuItem_BoolPtr("Show net events", NULL, &ui->show_net_events_window, true);
@@ -128,6 +134,15 @@ void render_menu_bar(ui_handler_t *ui) {
           ui->gfx_handler->renderer.lod_bias = ui->lod_bias;
         }
 
+        if (igDragInt("Particle Budget", &ui->particle_budget, 100.0f, 0, 1000000, "%d", 0)) {
+          ui->particle_system.budget = ui->particle_budget;
+        }
+        if (igIsItemHovered(ImGuiHoveredFlags_None)) igSetTooltip("Particles drawn per frame, 0 = Unlimited");
+        particle_pool_stats_t pool;
+        particle_system_get_stats(&ui->particle_system, &pool);
+        igTextDisabled("Particles: %d alive, %d peak, %d pooled (%.1f MB)", pool.active_count, pool.high_water, pool.capacity,
+                       (double)pool.bytes / (1024.0 * 1024.0));
+
         igColorEdit3("Background Color", ui->bg_color, ImGuiColorEditFlags_NoInputs);
         igSeparator();
         igDragFloat("Prediction alpha own", &ui->prediction_alpha[0], 0.1f, 0.0f, 1.0f, "%.3f", 0);
@@ -372,6 +387,7 @@ void ui_init_config(ui_handler_t *ui) {
   ui->vsync = true;
   ui->fps_limit = 0;
   ui->lod_bias = -0.5f;
+  ui->particle_budget = PARTICLE_DEFAULT_BUDGET;
   ui->bg_color[0] = 30.f / 255.f;
   ui->bg_color[1] = 35.f / 255.f;
   ui->bg_color[2] = 40.f / 255.f;
@@ -380,6 +396,7 @@ void ui_init_config(ui_handler_t *ui) {
   ui->center_dot = 1;
 
   keybinds_init(&ui->keybinds);
+  undo_manager_init(&ui->undo_manager);
   config_load(ui);
 }
 
@@ -407,11 +424,15 @@ void ui_init(ui_handler_t *ui, gfx_handler_t *gfx_handler) {
   ui->show_skin_browser = false;
   ui->show_net_events_window = false;
   particle_system_init(&ui->particle_system);
+  ui->particle_system.budget = ui->particle_budget;
   timeline_init(ui);
   camera_init(&gfx_handler->renderer.camera);
-  undo_manager_init(&ui->undo_manager);
   skin_manager_init(&ui->skin_manager);
   NFD_Init();
+  thread_pool_init(&ui->thread_pool, 0);
+  ui->particle_system.pool = &ui->thread_pool;
+  search_window_init(&ui->search_window);
+  profiler_window_init(&ui->profiler_window);
 
   ui->plugin_api = api_init(ui);
   ui->plugin_context.ui_handler = ui;
@@ -421,8 +442,6 @@ void ui_init(ui_handler_t *ui, gfx_handler_t *gfx_handler) {
   plugin_manager_init(&ui->plugin_manager, &ui->plugin_context, &ui->plugin_api);
   plugin_manager_load_all(&ui->plugin_manager, "plugins");
 
-  particle_system_init(&ui->particle_system);
-
   ui->num_pickups = 0;
   ui->pickups = NULL;
   ui->pickup_positions = NULL;
@@ -461,6 +480,7 @@ void render_players(ui_handler_t *ui) {
   gfx_handler_t *gfx = ui->gfx_handler;
   physics_handler_t *ph = &gfx->physics_handler;
   if (!ph->loaded) return;
+  PROFILE_BEGIN("render_players");
 
   SWorldCore prev_world = wc_empty();
   SWorldCore world = wc_empty();
@@ -472,6 +492,7 @@ void render_players(ui_handler_t *ui) {
   if (ui->timeline.player_track_count != world.m_NumCharacters) {
     wc_free(&prev_world);
     wc_free(&world);
+    PROFILE_END();
     return;
   }
 
@@ -816,6 +837,7 @@ void render_players(ui_handler_t *ui) {
   if (ui->timeline.selected_player_track_index < 0 || !ui->show_prediction) {
     wc_free(&prev_world);
     wc_free(&world);
+    PROFILE_END();
     return;
   }
 
@@ -900,6 +922,7 @@ void render_players(ui_handler_t *ui) {
   }
   wc_free(&prev_world);
   wc_free(&world);
+  PROFILE_END();
 }
 
 void render_pickups(ui_handler_t *ui) {
@@ -1030,6 +1053,9 @@ void ui_render(ui_handler_t *ui) {
 
   keybinds_render_settings_window(ui);
   undo_manager_render_history_window(&ui->undo_manager);
+  plugin_manager_render_stats_window(&ui->plugin_manager);
+  render_search_window(ui);
+  render_profiler_window(&ui->profiler_window);
   if (ui->show_skin_browser) render_skin_browser(ui->gfx_handler);
   render_net_events_window(ui);
 }
@@ -1205,6 +1231,10 @@ void ui_cleanup(ui_handler_t *ui) {
   free(ui->ninja_pickup_indices);
   config_save(ui);
   plugin_manager_shutdown(&ui->plugin_manager);
+  api_shutdown();
+  search_window_cleanup(&ui->search_window);
+  profiler_window_cleanup(&ui->profiler_window);
+  thread_pool_destroy(&ui->thread_pool);
   particle_system_cleanup(&ui->particle_system);
   timeline_cleanup(&ui->timeline);
   undo_manager_cleanup(&ui->undo_manager);
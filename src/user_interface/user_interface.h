@@ -3,11 +3,14 @@
 
 #include "demo.h"
 #include "keybinds.h"
+#include "profiler_window.h"
+#include "search_window.h"
 #include "undo_redo.h"
 #include <ddnet_physics/gamecore.h>
 #include <particles/particle_system.h>
 #include <plugins/plugin_manager.h>
 #include <stdbool.h>
+#include <system/thread_pool.h>
 #include <stdint.h>
 #include <types.h>
 
@@ -19,11 +22,14 @@ struct ui_handler_t {
   skin_manager_t skin_manager;
   keybind_manager_t keybinds;
   demo_exporter_t demo_exporter;
+  search_window_t search_window;
+  profiler_window_t profiler_window;
   undo_manager_t undo_manager;
   plugin_manager_t plugin_manager;
   tas_context_t plugin_context;
   tas_api_t plugin_api;
   particle_system_t particle_system;
+  thread_pool_t thread_pool; // shared by the editor and plugins for all CPU heavy work
 
   SPickup *pickups;
   mvec2 *pickup_positions;
@@ -50,6 +56,7 @@ struct ui_handler_t {
   float mouse_sens;
   float mouse_max_distance;
   float lod_bias;
+  int particle_budget; // 0 = unlimited
   float bg_color[3];
   float prediction_alpha[2]; // 0=own,1=others
   bool center_dot;